@@ -64,6 +64,7 @@ class AddressAndSpentIndicesAreOperational (BitcoinTestFramework):
     def verify_reversal_of_spent_index_under_reorg(self):
         staker_node = self.nodes[0]
         hash = staker_node.setgenerate(1)[0]
+        sync_indexes([staker_node])
         transactions = staker_node.getblock(hash)['tx']
         assert_equal(len(transactions),2)
         coinstake_tx_hash = transactions[1]
@@ -75,10 +76,12 @@ class AddressAndSpentIndicesAreOperational (BitcoinTestFramework):
             assert_equal(staker_node.getspentinfo(input)["txid"],coinstake_tx_hash)
 
         staker_node.invalidateblock(hash)
+        sync_indexes([staker_node])
         for input in parsed_inputs:
             assert_raises(JSONRPCException,staker_node.getspentinfo,input)
 
         staker_node.reconsiderblock(hash)
+        sync_indexes([staker_node])
         for input in parsed_inputs:
             assert_equal(staker_node.getspentinfo(input)["txid"],coinstake_tx_hash)
 
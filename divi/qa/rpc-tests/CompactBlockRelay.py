@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The DIVI developers
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+# Tests that new blocks whose transactions are already in the receiver's
+# mempool are relayed as compact blocks, and compares the bytes and time
+# it takes to relay such a block with and without compact blocks.
+
+from test_framework import BitcoinTestFramework
+from util import *
+
+import time
+
+
+class CompactBlockRelay (BitcoinTestFramework):
+
+    def setup_chain (self):
+        super ().setup_chain (number_of_nodes=2)
+
+    def setup_network (self, split=False):
+        self.start_connected_nodes (compactBlocks=True)
+
+    def start_connected_nodes (self, compactBlocks):
+        args = ["-debug=net", "-compactblocks=%d" % (1 if compactBlocks else 0)]
+        self.nodes = start_nodes (2, self.options.tmpdir, extra_args=[args, args])
+        connect_nodes_bi (self.nodes, 0, 1)
+        self.is_network_split = False
+        sync_blocks (self.nodes)
+
+    def restart_nodes (self, compactBlocks):
+        stop_nodes (self.nodes)
+        wait_bitcoinds ()
+        self.start_connected_nodes (compactBlocks)
+
+    def bytes_received_from_peer (self, node):
+        return sum ([peer["bytesrecv"] for peer in node.getpeerinfo ()])
+
+    def relay_block_with_mempool_transactions (self, numberOfTransactions):
+        sender, receiver = self.nodes
+        address = receiver.getnewaddress ()
+        for _ in range (numberOfTransactions):
+            sender.sendtoaddress (address, 1)
+        sync_mempools (self.nodes)
+        assert_equal (len (receiver.getrawmempool ()), numberOfTransactions)
+
+        bytesBefore = self.bytes_received_from_peer (receiver)
+        start = time.time ()
+        blockHash = sender.setgenerate (1)[0]
+        while receiver.getbestblockhash () != blockHash:
+            time.sleep (0.01)
+        elapsed = time.time () - start
+        bytesUsed = self.bytes_received_from_peer (receiver) - bytesBefore
+
+        assert_equal (receiver.getrawmempool (), [])
+        blockSize = len (sender.getblock (blockHash, False)) // 2
+        return bytesUsed, elapsed, blockSize
+
+    def run_test (self):
+        numberOfTransactions = 100
+        self.nodes[0].setgenerate (30)
+        sync_blocks (self.nodes)
+
+        compactBytes, compactSeconds, blockSize = self.relay_block_with_mempool_transactions (numberOfTransactions)
+        print ("Compact block relay: %d bytes received for a %d byte block in %.3fs" % (compactBytes, blockSize, compactSeconds))
+
+        self.restart_nodes (compactBlocks=False)
+        fullBytes, fullSeconds, blockSize = self.relay_block_with_mempool_transactions (numberOfTransactions)
+        print ("Full block relay: %d bytes received for a %d byte block in %.3fs" % (fullBytes, blockSize, fullSeconds))
+
+        assert_greater_than (blockSize, fullBytes // 2)
+        assert_greater_than (fullBytes, 3 * compactBytes)
+
+if __name__ == '__main__':
+    CompactBlockRelay ().main ()
@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+# Copyright (c) 2020 The DIVI developers
+# Distributed under the MIT/X11 software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+# Tests that a fresh node connected to two synced peers fetches the header
+# chain first and then downloads the block bodies from both peers.
+
+from test_framework import BitcoinTestFramework
+from util import *
+
+
+class HeadersFirstSync (BitcoinTestFramework):
+
+    def setup_chain (self):
+        super ().setup_chain (number_of_nodes=3)
+
+    def setup_network (self, split=False):
+        args = ["-debug=net"]
+        self.nodes = start_nodes (3, self.options.tmpdir, extra_args=[args] * 3)
+        connect_nodes_bi (self.nodes, 0, 1)
+        self.is_network_split = False
+
+    def run_test (self):
+        self.nodes[0].setgenerate (100)
+        sync_blocks (self.nodes[0:2])
+        assert_equal (self.nodes[2].getblockcount (), 0)
+
+        connect_nodes (self.nodes[2], 0)
+        connect_nodes (self.nodes[2], 1)
+        sync_blocks (self.nodes)
+        assert_equal (self.nodes[2].getbestblockhash (), self.nodes[0].getbestblockhash ())
+
+        # Both peers should have contributed bodies, not just the one that sent the headers
+        blockBytes = sum ([len (self.nodes[0].getblock (self.nodes[0].getblockhash (height), False)) // 2
+                           for height in range (1, 101)])
+        for peer in self.nodes[2].getpeerinfo ():
+            assert_greater_than (peer["bytesrecv"], blockBytes // 10)
+
+if __name__ == '__main__':
+    HeadersFirstSync ().main ()
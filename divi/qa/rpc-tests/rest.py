@@ -84,6 +84,55 @@ class RESTTest (BitcoinTestFramework):
         for tx in txs:
             assert_equal(tx in json_obj['tx'], True)
 
+        # headers from a block hash along the active chain
+        genesis_hash = self.nodes[0].getblockhash(0)
+        json_string = http_get_call(url.hostname, url.port, '/rest/headers/5/'+genesis_hash+self.FORMAT_SEPARATOR+'json')
+        json_obj = json.loads(json_string)
+        assert_equal(len(json_obj), 5)
+        for height in range(5):
+            assert_equal(json_obj[height]['hash'], self.nodes[0].getblockhash(height))
+            assert_equal(json_obj[height]['height'], height)
+        json_string = http_get_call(url.hostname, url.port, '/rest/headers/2000/'+genesis_hash+self.FORMAT_SEPARATOR+'json')
+        assert_equal(len(json.loads(json_string)), self.nodes[0].getblockcount() + 1)
+        response = http_get_call(url.hostname, url.port, '/rest/headers/2001/'+genesis_hash+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 400)
+        hex_string = http_get_call(url.hostname, url.port, '/rest/headers/1/'+newblockhash[0]+self.FORMAT_SEPARATOR+'hex')
+        assert_equal(hex_string.decode('ascii').strip(), self.nodes[0].getblockheader(newblockhash[0], False))
+
+        # a range of blocks by height
+        json_string = http_get_call(url.hostname, url.port, '/rest/blocks/10/3'+self.FORMAT_SEPARATOR+'json')
+        json_obj = json.loads(json_string)
+        assert_equal([block['hash'] for block in json_obj], [self.nodes[0].getblockhash(height) for height in range(10, 13)])
+        hex_string = http_get_call(url.hostname, url.port, '/rest/blocks/10/3'+self.FORMAT_SEPARATOR+'hex')
+        assert_equal(hex_string.decode('ascii').split(), [self.nodes[0].getblock(self.nodes[0].getblockhash(height), False) for height in range(10, 13)])
+        tip_height = self.nodes[0].getblockcount()
+        json_string = http_get_call(url.hostname, url.port, '/rest/blocks/'+str(tip_height)+'/100'+self.FORMAT_SEPARATOR+'json')
+        assert_equal(len(json.loads(json_string)), 1)
+        response = http_get_call(url.hostname, url.port, '/rest/blocks/'+str(tip_height + 1)+'/1'+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 404)
+
+        # batch utxo lookups against the chain and the mempool
+        unspent = self.nodes[0].listunspent()[0]
+        spent_txid = txs[0]
+        spent_input = self.nodes[0].decoderawtransaction(self.nodes[0].gettransaction(spent_txid)['hex'])['vin'][0]
+        outpoints = [unspent['txid']+'-'+str(unspent['vout']), spent_input['txid']+'-'+str(spent_input['vout']), unspent['txid']+'-1000']
+        json_string = http_get_call(url.hostname, url.port, '/rest/getutxos/'+'/'.join(outpoints)+self.FORMAT_SEPARATOR+'json')
+        json_obj = json.loads(json_string)
+        assert_equal(json_obj['chainHeight'], self.nodes[0].getblockcount())
+        assert_equal(json_obj['chaintipHash'], self.nodes[0].getbestblockhash())
+        assert_equal(json_obj['bitmap'], '100')
+        assert_equal(len(json_obj['utxos']), 1)
+        assert_equal(json_obj['utxos'][0]['value'], unspent['amount'])
+
+        mempool_txid = self.nodes[0].sendtoaddress(self.nodes[2].getnewaddress(), 11)
+        mempool_outpoint = mempool_txid+'-0'
+        json_string = http_get_call(url.hostname, url.port, '/rest/getutxos/'+mempool_outpoint+self.FORMAT_SEPARATOR+'json')
+        assert_equal(json.loads(json_string)['bitmap'], '0')
+        json_string = http_get_call(url.hostname, url.port, '/rest/getutxos/checkmempool/'+mempool_outpoint+self.FORMAT_SEPARATOR+'json')
+        assert_equal(json.loads(json_string)['bitmap'], '1')
+        response = http_get_call(url.hostname, url.port, '/rest/getutxos/'+'/'.join([mempool_outpoint] * 501)+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 400)
+
 
 
 if __name__ == '__main__':
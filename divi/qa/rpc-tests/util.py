@@ -64,6 +64,7 @@ def sync_blocks(rpc_connections, timeout=None):
     while True:
         counts = [ x.getblockcount() for x in rpc_connections if x ]
         if counts == [ counts[0] ]*len(counts):
+            sync_indexes(rpc_connections)
             return True
         if timeout and timeout > 0:
             timeout -= 0.1
@@ -71,6 +72,20 @@ def sync_blocks(rpc_connections, timeout=None):
             return False
         time.sleep(0.1)
 
+def sync_indexes(rpc_connections, timeout=60):
+    """
+    Wait until the address and spent indexes, which are built in the
+    background, have caught up with the chain tip of every node
+    """
+    while True:
+        infos = [ x.getindexinfo() for x in rpc_connections if x ]
+        if all(info["synced"] or not (info["addressindex"] or info["spentindex"]) for info in infos):
+            return
+        if timeout <= 0:
+            raise AssertionError("Indexes did not catch up with the chain tip: %s"%str(infos))
+        timeout -= 0.1
+        time.sleep(0.1)
+
 def sync_mempools(rpc_connections):
     """
     Wait until everybody has the same transactions in their memory
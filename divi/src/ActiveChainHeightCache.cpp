@@ -0,0 +1,80 @@
+#include <ActiveChainHeightCache.h>
+
+#include <blockmap.h>
+#include <chain.h>
+
+ActiveChainHeightCache::ActiveChainHeightCache(
+    const BlockMap& blockIndices
+    ): blockIndices_(blockIndices)
+    , mutex_()
+    , tip_(nullptr)
+    , tipHeight_(-1)
+    , activeBlocks_()
+    , inactiveBlocks_()
+{
+}
+
+void ActiveChainHeightCache::updateTip(const CBlockIndex* tip)
+{
+    if(tip_ == tip) return;
+
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+    const CBlockIndex* previousTip = tip_;
+    if(previousTip == tip) return;
+
+    const CBlockIndex* forkPoint = (previousTip && tip)? LastCommonAncestor(previousTip, tip): nullptr;
+    if(!forkPoint)
+    {
+        // The block index may have been unloaded, so the entries are not looked at
+        activeBlocks_.clear();
+    }
+    else if(forkPoint != previousTip)
+    {
+        // Blocks above the fork point have left the active chain
+        const int forkHeight = forkPoint->nHeight;
+        for(auto it = activeBlocks_.begin(); it != activeBlocks_.end();)
+        {
+            if(it->second->nHeight > forkHeight)
+            {
+                it = activeBlocks_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    inactiveBlocks_.clear();
+    tipHeight_ = tip? tip->nHeight: -1;
+    tip_ = tip;
+}
+
+int ActiveChainHeightCache::tipHeight() const
+{
+    return tipHeight_;
+}
+
+std::pair<const CBlockIndex*,int> ActiveChainHeightCache::findBlockAndDepth(const uint256& blockHash)
+{
+    static const std::pair<const CBlockIndex*,int> defaultValue = std::make_pair(nullptr,0);
+    {
+        boost::shared_lock<boost::shared_mutex> lock(mutex_);
+        const auto it = activeBlocks_.find(blockHash);
+        if(it != activeBlocks_.end())
+        {
+            return std::make_pair(it->second, tipHeight_ - it->second->nHeight + 1);
+        }
+        if(inactiveBlocks_.count(blockHash) > 0) return defaultValue;
+    }
+
+    boost::unique_lock<boost::shared_mutex> lock(mutex_);
+    const CBlockIndex* tip = tip_;
+    const CBlockIndex* pindex = blockIndices_.FindWithoutMainLock(blockHash);
+    if(!pindex || !tip || pindex->nHeight > tip->nHeight || tip->GetAncestor(pindex->nHeight) != pindex)
+    {
+        inactiveBlocks_.insert(blockHash);
+        return defaultValue;
+    }
+    activeBlocks_.emplace(blockHash, pindex);
+    return std::make_pair(pindex, tipHeight_ - pindex->nHeight + 1);
+}
@@ -0,0 +1,48 @@
+#ifndef ACTIVE_CHAIN_HEIGHT_CACHE_H
+#define ACTIVE_CHAIN_HEIGHT_CACHE_H
+#include <uint256.h>
+
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <boost/thread/shared_mutex.hpp>
+
+class BlockMap;
+class CBlockIndex;
+
+/** Wallet-side record of which blocks are on the active chain, so that confirmation
+ *  depths can be worked out without cs_main.
+ *
+ *  Blocks are resolved through the block map the first time they are asked about and
+ *  kept by hash. Whenever the tip moves, the blocks a reorg disconnected are dropped
+ *  and the new tip height is published, after which a depth is a single hash probe
+ *  and a subtraction. Blocks that are not on the active chain are remembered until
+ *  the next tip change, since only that can connect them.
+ */
+class ActiveChainHeightCache
+{
+private:
+    struct BlockHasher
+    {
+        size_t operator()(const uint256& hash) const { return hash.GetLow64(); }
+    };
+
+    const BlockMap& blockIndices_;
+    mutable boost::shared_mutex mutex_;
+    std::atomic<const CBlockIndex*> tip_;
+    std::atomic<int> tipHeight_;
+    std::unordered_map<uint256, const CBlockIndex*, BlockHasher> activeBlocks_;
+    std::unordered_set<uint256, BlockHasher> inactiveBlocks_;
+
+public:
+    explicit ActiveChainHeightCache(const BlockMap& blockIndices);
+
+    /** Moves the cache to a new active tip; cheap when the tip is unchanged */
+    void updateTip(const CBlockIndex* tip);
+    /** -1 before the first tip */
+    int tipHeight() const;
+    /** The block with the given hash and its depth below the tip, {nullptr,0} if it is not on the active chain */
+    std::pair<const CBlockIndex*,int> findBlockAndDepth(const uint256& blockHash);
+};
+#endif// ACTIVE_CHAIN_HEIGHT_CACHE_H
@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <string>
+#include <string.h>
+#include <memory>
 
 #include <DataDirectory.h>
 #include <random.h>
@@ -18,6 +20,121 @@
 
 #include <boost/filesystem.hpp>
 
+namespace
+{
+
+/** Serializes to or from a file through a buffer while hashing the bytes that pass,
+ *  so that peers.dat is checksummed without holding the whole file in memory */
+class HashedFileStream
+{
+private:
+    static constexpr size_t BUFFER_SIZE = 1 << 16;
+
+    CAutoFile& file_;
+    CHashWriter hasher_;
+    std::vector<char> buffer_;
+    size_t bufferPosition_;
+    size_t bufferEnd_;
+
+    void fill()
+    {
+        bufferPosition_ = 0;
+        bufferEnd_ = fread(&buffer_[0], 1, buffer_.size(), file_.Get());
+        if (bufferEnd_ == 0)
+            throw std::ios_base::failure(feof(file_.Get()) ? "HashedFileStream::read : end of file" : "HashedFileStream::read : fread failed");
+    }
+
+    void readWithoutHashing(char* pch, size_t nSize)
+    {
+        while (nSize > 0) {
+            if (bufferPosition_ == bufferEnd_)
+                fill();
+            const size_t nChunk = std::min(nSize, bufferEnd_ - bufferPosition_);
+            memcpy(pch, &buffer_[bufferPosition_], nChunk);
+            bufferPosition_ += nChunk;
+            pch += nChunk;
+            nSize -= nChunk;
+        }
+    }
+
+public:
+    int nType;
+    int nVersion;
+
+    explicit HashedFileStream(CAutoFile& file)
+        : file_(file)
+        , hasher_(file.GetType(), file.GetVersion())
+        , buffer_(BUFFER_SIZE)
+        , bufferPosition_(0)
+        , bufferEnd_(0)
+        , nType(file.GetType())
+        , nVersion(file.GetVersion())
+    {
+    }
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    HashedFileStream& write(const char* pch, size_t nSize)
+    {
+        hasher_.write(pch, nSize);
+        while (nSize > 0) {
+            if (bufferEnd_ == buffer_.size())
+                flush();
+            const size_t nChunk = std::min(nSize, buffer_.size() - bufferEnd_);
+            memcpy(&buffer_[bufferEnd_], pch, nChunk);
+            bufferEnd_ += nChunk;
+            pch += nChunk;
+            nSize -= nChunk;
+        }
+        return *this;
+    }
+
+    HashedFileStream& read(char* pch, size_t nSize)
+    {
+        readWithoutHashing(pch, nSize);
+        hasher_.write(pch, nSize);
+        return *this;
+    }
+
+    void flush()
+    {
+        if (bufferEnd_ > 0)
+            file_.write(&buffer_[0], bufferEnd_);
+        bufferEnd_ = 0;
+    }
+
+    //! Hash of everything written or read so far; invalidates the hasher
+    uint256 GetHash()
+    {
+        return hasher_.GetHash();
+    }
+
+    //! Reads the checksum that trails the hashed data
+    uint256 ReadChecksum()
+    {
+        uint256 hash;
+        readWithoutHashing((char*)hash.begin(), hash.size());
+        return hash;
+    }
+
+    template <typename T>
+    HashedFileStream& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+
+    template <typename T>
+    HashedFileStream& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+} // anonymous namespace
+
 CAddrDB::CAddrDB()
 {
     pathAddr = GetDataDir() / "peers.dat";
@@ -30,29 +147,35 @@ bool CAddrDB::Write(const CAddrMan& addr)
     GetRandBytes((unsigned char*)&randv, sizeof(randv));
     std::string tmpfn = strprintf("peers.dat.%04x", randv);
 
-    // serialize addresses, checksum data up to that point, then append csum
-    CDataStream ssPeers(SER_DISK, CLIENT_VERSION);
-    ssPeers << FLATDATA(Params().MessageStart());
-    ssPeers << addr;
-    uint256 hash = Hash(ssPeers.begin(), ssPeers.end());
-    ssPeers << hash;
+    // Copy the tables first so the address manager is not locked while the file is written
+    std::unique_ptr<CAddrMan::Snapshot> snapshot(new CAddrMan::Snapshot());
+    addr.GetSnapshot(*snapshot);
 
-    // open output file, and associate with CAutoFile
-    boost::filesystem::path pathAddr = GetDataDir() / "peers.dat";
-    FILE* file = fopen(pathAddr.string().c_str(), "wb");
+    // open temp output file, and associate with CAutoFile
+    boost::filesystem::path pathTmp = GetDataDir() / tmpfn;
+    FILE* file = fopen(pathTmp.string().c_str(), "wb");
     CAutoFile fileout(file, SER_DISK, CLIENT_VERSION);
     if (fileout.IsNull())
-        return error("%s : Failed to open file %s", __func__, pathAddr.string());
+        return error("%s : Failed to open file %s", __func__, pathTmp.string());
 
-    // Write and commit header, data
+    // serialize addresses, checksumming them on the way, then append csum
     try {
-        fileout << ssPeers;
+        HashedFileStream stream(fileout);
+        stream << FLATDATA(Params().MessageStart());
+        stream << *snapshot;
+        const uint256 hash = stream.GetHash();
+        stream.flush();
+        fileout << hash;
     } catch (std::exception& e) {
         return error("%s : Serialize or I/O error - %s", __func__, e.what());
     }
     FileCommit(fileout.Get());
     fileout.fclose();
 
+    // replace existing peers.dat, if any, with new peers.dat.XXXX
+    if (!RenameOver(pathTmp, pathAddr))
+        return error("%s : Rename-into-place failed", __func__);
+
     return true;
 }
 
@@ -64,46 +187,31 @@ bool CAddrDB::Read(CAddrMan& addr)
     if (filein.IsNull())
         return error("%s : Failed to open file %s", __func__, pathAddr.string());
 
-    // use file size to size memory buffer
-    int fileSize = boost::filesystem::file_size(pathAddr);
-    int dataSize = fileSize - sizeof(uint256);
-    // Don't try to resize to a negative number if file is small
-    if (dataSize < 0)
-        dataSize = 0;
-    std::vector<unsigned char> vchData;
-    vchData.resize(dataSize);
-    uint256 hashIn;
-
-    // read data and checksum from file
-    try {
-        filein.read((char*)&vchData[0], dataSize);
-        filein >> hashIn;
-    } catch (std::exception& e) {
-        return error("%s : Deserialize or I/O error - %s", __func__, e.what());
-    }
-    filein.fclose();
-
-    CDataStream ssPeers(vchData, SER_DISK, CLIENT_VERSION);
-
-    // verify stored checksum matches input data
-    uint256 hashTmp = Hash(ssPeers.begin(), ssPeers.end());
-    if (hashIn != hashTmp)
-        return error("%s : Checksum mismatch, data corrupted", __func__);
-
     unsigned char pchMsgTmp[4];
     try {
+        HashedFileStream stream(filein);
+
         // de-serialize file header (network specific magic number) and ..
-        ssPeers >> FLATDATA(pchMsgTmp);
+        stream >> FLATDATA(pchMsgTmp);
 
         // ... verify the network matches ours
         if (memcmp(pchMsgTmp, Params().MessageStart(), sizeof(pchMsgTmp)))
             return error("%s : Invalid network magic number", __func__);
 
         // de-serialize address data into one CAddrMan object
-        ssPeers >> addr;
+        stream >> addr;
+
+        // verify stored checksum matches input data
+        const uint256 hashTmp = stream.GetHash();
+        if (stream.ReadChecksum() != hashTmp) {
+            addr.Clear();
+            return error("%s : Checksum mismatch, data corrupted", __func__);
+        }
     } catch (std::exception& e) {
+        addr.Clear();
         return error("%s : Deserialize or I/O error - %s", __func__, e.what());
     }
+    filein.fclose();
 
     return true;
 }
@@ -0,0 +1,224 @@
+#include <AsyncIndexBuilder.h>
+
+#include <algorithm>
+
+#include <addressindex.h>
+#include <blockmap.h>
+#include <chain.h>
+#include <ChainStateSnapshot.h>
+#include <I_BlockDataReader.h>
+#include <IndexDatabaseUpdateCollector.h>
+#include <IndexDatabaseUpdates.h>
+#include <Logging.h>
+#include <primitives/block.h>
+#include <ThreadManagementHelpers.h>
+#include <TransactionLocationReference.h>
+#include <txdb.h>
+#include <BlockUndo.h>
+#include <undo.h>
+
+namespace
+{
+/** Tip changes are not signalled during the initial download, so the builder also
+ *  looks at the chain on its own at this interval while it is idle */
+const int64_t IDLE_POLL_MILLIS = 5000;
+} // anonymous namespace
+
+AsyncIndexBuilder::AsyncIndexBuilder(
+    CSearchIndexDB& searchIndexes,
+    const BlockMap& blockIndicesByHash,
+    const I_BlockDataReader& blockDataReader,
+    bool addressIndexing,
+    bool spentIndexing,
+    unsigned blocksPerBatch
+    ): searchIndexes_(searchIndexes)
+    , blockIndicesByHash_(blockIndicesByHash)
+    , blockDataReader_(blockDataReader)
+    , addressIndexing_(addressIndexing)
+    , spentIndexing_(spentIndexing)
+    , blocksPerBatch_(std::max(blocksPerBatch, 1u))
+    , mutex_()
+    , tipUpdated_()
+    , tipChanged_(false)
+    , indexedTip_(nullptr)
+    , workers_()
+{
+}
+
+AsyncIndexBuilder::~AsyncIndexBuilder()
+{
+    Stop();
+}
+
+bool AsyncIndexBuilder::Initialize()
+{
+    const bool storedFlagsMatch = searchIndexes_.LoadIndexingFlags() &&
+        searchIndexes_.GetAddressIndexing() == addressIndexing_ &&
+        searchIndexes_.GetSpentIndexing() == spentIndexing_;
+    if (!storedFlagsMatch)
+    {
+        if (addressIndexing_ || spentIndexing_)
+            LogPrintf("%s: building address index %s, spent index %s from the genesis block\n",
+                __func__, addressIndexing_ ? "on" : "off", spentIndexing_ ? "on" : "off");
+        if (!searchIndexes_.ResetIndexes(addressIndexing_, spentIndexing_))
+            return false;
+    }
+
+    uint256 bestBlockHash;
+    const CBlockIndex* indexedTip = nullptr;
+    if (searchIndexes_.ReadBestBlockHash(bestBlockHash) && bestBlockHash != 0)
+    {
+        indexedTip = blockIndicesByHash_.FindWithoutMainLock(bestBlockHash);
+        if (!indexedTip)
+        {
+            LogPrintf("%s: indexed block %s is unknown, rebuilding indexes\n", __func__, bestBlockHash);
+            if (!searchIndexes_.ResetIndexes(addressIndexing_, spentIndexing_))
+                return false;
+        }
+    }
+
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    indexedTip_ = indexedTip;
+    LogPrintf("%s: search indexes at height %d\n", __func__, indexedTip_ ? indexedTip_->nHeight : -1);
+    return true;
+}
+
+bool AsyncIndexBuilder::BatchWriteBlock(
+    const CBlockIndex* blockIndex,
+    bool disconnecting,
+    CLevelDBBatch& batch,
+    CSearchIndexDB::AddressBalanceChanges& balanceChanges) const
+{
+    // The genesis block has no undo data, and its outputs are unspendable anyway
+    if (!blockIndex->pprev)
+        return true;
+
+    CBlock block;
+    CBlockUndo blockUndo;
+    if (!blockDataReader_.ReadBlock(blockIndex, block) || !blockDataReader_.ReadBlockUndo(blockIndex, blockUndo))
+        return error("%s: failed to read block %s", __func__, blockIndex->GetBlockHash());
+    if (blockUndo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: undo data of block %s does not match its transactions", __func__, blockIndex->GetBlockHash());
+
+    IndexDatabaseUpdates updates(blockIndex, addressIndexing_, spentIndexing_);
+    for (unsigned step = 0; step < block.vtx.size(); ++step)
+    {
+        const int transactionIndex = disconnecting ? static_cast<int>(block.vtx.size() - 1 - step) : static_cast<int>(step);
+        const CTransaction& tx = block.vtx[transactionIndex];
+        const TransactionLocationReference txLocationReference(tx, blockIndex->nHeight, transactionIndex);
+        const CTxUndo* txUndo = transactionIndex > 0 ? &blockUndo.vtxundo[transactionIndex - 1] : nullptr;
+        if (disconnecting)
+            IndexDatabaseUpdateCollector::ReverseTransaction(tx, txLocationReference, txUndo, updates);
+        else
+            IndexDatabaseUpdateCollector::RecordTransaction(tx, txLocationReference, txUndo, updates);
+    }
+    CSearchIndexDB::BatchWriteUpdates(batch, updates, disconnecting, balanceChanges);
+    return true;
+}
+
+bool AsyncIndexBuilder::SyncBatch(const ChainStateSnapshot& chain, bool& caughtUp)
+{
+    caughtUp = false;
+    const CBlockIndex* indexed;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        indexed = indexedTip_;
+    }
+    if (!chain.Tip())
+    {
+        caughtUp = true;
+        return true;
+    }
+
+    CLevelDBBatch batch;
+    CSearchIndexDB::AddressBalanceChanges balanceChanges;
+    unsigned blocksInBatch = 0;
+    while (indexed && !chain.Contains(indexed) && blocksInBatch < blocksPerBatch_)
+    {
+        if (!BatchWriteBlock(indexed, true, batch, balanceChanges))
+            return false;
+        indexed = indexed->pprev;
+        ++blocksInBatch;
+    }
+    if (!indexed || chain.Contains(indexed))
+    {
+        for (const CBlockIndex* next = chain[indexed ? indexed->nHeight + 1 : 0];
+            next && blocksInBatch < blocksPerBatch_;
+            next = chain[next->nHeight + 1])
+        {
+            if (!BatchWriteBlock(next, false, batch, balanceChanges))
+                return false;
+            indexed = next;
+            ++blocksInBatch;
+        }
+    }
+
+    if (blocksInBatch > 0)
+    {
+        if (!searchIndexes_.CommitUpdates(batch, balanceChanges, indexed ? indexed->GetBlockHash() : uint256(0)))
+            return error("%s: failed to write search indexes", __func__);
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        indexedTip_ = indexed;
+    }
+    caughtUp = indexed == chain.Tip();
+    return true;
+}
+
+void AsyncIndexBuilder::FollowActiveChain()
+{
+    while (true)
+    {
+        boost::this_thread::interruption_point();
+        bool caughtUp = false;
+        const std::shared_ptr<const ChainStateSnapshot> chain = ChainStateSnapshot::Current();
+        if (!SyncBatch(*chain, caughtUp))
+        {
+            // Retried once the tip moves on, since the block data may simply not be flushed yet
+            LogPrintf("%s: search indexes are stuck at height %d\n", __func__, GetStatus().indexedHeight);
+            caughtUp = true;
+        }
+        if (!caughtUp)
+            continue;
+
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        if (!tipChanged_)
+            tipUpdated_.timed_wait(lock, boost::posix_time::milliseconds(IDLE_POLL_MILLIS));
+        tipChanged_ = false;
+    }
+}
+
+void AsyncIndexBuilder::UpdatedBlockTip(const CBlockIndex*)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        tipChanged_ = true;
+    }
+    tipUpdated_.notify_one();
+}
+
+void AsyncIndexBuilder::Start()
+{
+    workers_.create_thread([this](){ TraceThread("indexer", [this](){ FollowActiveChain(); }); });
+}
+
+void AsyncIndexBuilder::Stop()
+{
+    workers_.interrupt_all();
+    workers_.join_all();
+}
+
+AsyncIndexBuilder::Status AsyncIndexBuilder::GetStatus() const
+{
+    const std::shared_ptr<const ChainStateSnapshot> chain = ChainStateSnapshot::Current();
+    Status status;
+    status.addressIndexing = addressIndexing_;
+    status.spentIndexing = spentIndexing_;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        status.indexedHeight = indexedTip_ ? indexedTip_->nHeight : -1;
+        status.indexedBlockHash = indexedTip_ ? indexedTip_->GetBlockHash() : uint256(0);
+        status.synced = indexedTip_ == chain->Tip();
+    }
+    status.chainHeight = chain->Height();
+    return status;
+}
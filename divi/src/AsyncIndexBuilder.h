@@ -0,0 +1,90 @@
+#ifndef ASYNC_INDEX_BUILDER_H
+#define ASYNC_INDEX_BUILDER_H
+#include <NotificationInterface.h>
+#include <uint256.h>
+#include <map>
+#include <utility>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+struct CAddressBalance;
+class BlockMap;
+class CBlockIndex;
+class CLevelDBBatch;
+class CSearchIndexDB;
+class ChainStateSnapshot;
+class I_BlockDataReader;
+
+/** Maintains the optional address and spent indexes in their own database on a
+ *  background thread, instead of writing them while blocks are connected.
+ *
+ *  The entries of a block are derived from the block and its undo data, so the
+ *  builder can start at any point of the chain: it catches up writing many blocks
+ *  per database batch, and when the blocks it indexed were reorganized away it first
+ *  rolls the indexes back to the fork point. Changing which indexes are enabled
+ *  rebuilds them from the genesis block, without a reindex.
+ */
+class AsyncIndexBuilder final: public NotificationInterface
+{
+public:
+    static const unsigned DEFAULT_BLOCKS_PER_BATCH = 1000;
+
+    struct Status
+    {
+        bool addressIndexing;
+        bool spentIndexing;
+        /** -1 while not even the genesis block is indexed */
+        int indexedHeight;
+        uint256 indexedBlockHash;
+        int chainHeight;
+        bool synced;
+    };
+
+private:
+    CSearchIndexDB& searchIndexes_;
+    const BlockMap& blockIndicesByHash_;
+    const I_BlockDataReader& blockDataReader_;
+    const bool addressIndexing_;
+    const bool spentIndexing_;
+    const unsigned blocksPerBatch_;
+
+    mutable boost::mutex mutex_;
+    boost::condition_variable tipUpdated_;
+    bool tipChanged_;
+    const CBlockIndex* indexedTip_;
+    boost::thread_group workers_;
+
+    bool BatchWriteBlock(
+        const CBlockIndex* blockIndex,
+        bool disconnecting,
+        CLevelDBBatch& batch,
+        std::map<std::pair<unsigned int, uint160>, CAddressBalance>& balanceChanges) const;
+    void FollowActiveChain();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindex) override;
+
+public:
+    AsyncIndexBuilder(
+        CSearchIndexDB& searchIndexes,
+        const BlockMap& blockIndicesByHash,
+        const I_BlockDataReader& blockDataReader,
+        bool addressIndexing,
+        bool spentIndexing,
+        unsigned blocksPerBatch = DEFAULT_BLOCKS_PER_BATCH);
+    ~AsyncIndexBuilder();
+
+    /** Loads where the indexes left off, erasing them if they were built for other
+     *  settings or for a block that is no longer known; false on database errors */
+    bool Initialize();
+    /** Moves the indexes at most one batch of blocks towards the tip of chain; false
+     *  if a block could not be indexed. caughtUp is set once they reflect that tip. */
+    bool SyncBatch(const ChainStateSnapshot& chain, bool& caughtUp);
+
+    /** Follows the active chain on a background thread until stopped */
+    void Start();
+    void Stop();
+    Status GetStatus() const;
+};
+#endif// ASYNC_INDEX_BUILDER_H
@@ -5,6 +5,7 @@
 #include <I_AppendOnlyTransactionRecord.h>
 #include <I_MerkleTxConfirmationNumberCalculator.h>
 #include <I_SpentOutputTracker.h>
+#include <WalletUtxoIndex.h>
 
 AvailableUtxoCollector::AvailableUtxoCollector(
     const Settings& settings,
@@ -14,9 +15,11 @@ AvailableUtxoCollector::AvailableUtxoCollector(
     const I_MerkleTxConfirmationNumberCalculator& confsCalculator,
     const I_UtxoOwnershipDetector& ownershipDetector,
     const I_SpentOutputTracker& spentOutputTracker,
+    const WalletUtxoIndex& utxoIndex,
     const LockedCoinsSet& lockedCoins,
     CCriticalSection& mainCriticalSection
-    ): availableUtxoCalculator_(
+    ): utxoIndex_(utxoIndex)
+    , availableUtxoCalculator_(
         blockIndexByHash,
         activeChain,
         settings.GetArg("-vault_min",0)*COIN,
@@ -32,12 +35,18 @@ AvailableUtxoCollector::AvailableUtxoCollector(
 
 void AvailableUtxoCollector::setCoinTypeAndGetAvailableUtxos(bool onlyConfirmed, AvailableCoinsType coinType, std::vector<COutput>& outputs) const
 {
+    // Vault outputs count as spendable once the calculator checked the coin type
+    UtxoOwnershipFilter spendableOrVault(isminetype::ISMINE_SPENDABLE);
+    spendableOrVault.addOwnershipType(isminetype::ISMINE_OWNED_VAULT);
+    spendableOrVault.addOwnershipType(isminetype::ISMINE_MANAGED_VAULT);
+    const std::vector<const CWalletTx*> candidateTransactions = utxoIndex_.GetTransactionsWithUnspentOutputs(spendableOrVault);
+
     availableUtxoCalculator_.setRequirements(coinType,onlyConfirmed,false);
     outputs.clear();
-    filteredTransactions_.applyCalculationToMatchingTransactions(TxFlag::CONFIRMED_AND_MATURE,isminetype::ISMINE_SPENDABLE,outputs);
+    filteredTransactions_.applyCalculationToMatchingTransactions(TxFlag::CONFIRMED_AND_MATURE,isminetype::ISMINE_SPENDABLE,candidateTransactions,outputs);
     if(!onlyConfirmed)
     {
         availableUtxoCalculator_.setRequirements(coinType,onlyConfirmed,true);
-        filteredTransactions_.applyCalculationToMatchingTransactions(TxFlag::UNCONFIRMED,isminetype::ISMINE_SPENDABLE,outputs);
+        filteredTransactions_.applyCalculationToMatchingTransactions(TxFlag::UNCONFIRMED,isminetype::ISMINE_SPENDABLE,candidateTransactions,outputs);
     }
 }
\ No newline at end of file
@@ -14,10 +14,12 @@ class I_AppendOnlyTransactionRecord;
 class I_MerkleTxConfirmationNumberCalculator;
 class I_UtxoOwnershipDetector;
 class I_SpentOutputTracker;
+class WalletUtxoIndex;
 
 class AvailableUtxoCollector
 {
 private:
+    const WalletUtxoIndex& utxoIndex_;
     mutable AvailableUtxoCalculator availableUtxoCalculator_;
     FilteredTransactionsCalculator<std::vector<COutput>> filteredTransactions_;
 
@@ -30,6 +32,7 @@ public:
         const I_MerkleTxConfirmationNumberCalculator& confsCalculator,
         const I_UtxoOwnershipDetector& ownershipDetector,
         const I_SpentOutputTracker& spentOutputTracker,
+        const WalletUtxoIndex& utxoIndex,
         const LockedCoinsSet& lockedCoins,
         CCriticalSection& mainCriticalSection);
     ~AvailableUtxoCollector() = default;
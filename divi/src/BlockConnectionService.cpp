@@ -18,7 +18,6 @@
 #include <I_BlockIncentivesPopulator.h>
 #include <I_BlockDataReader.h>
 #include <IndexDatabaseUpdates.h>
-#include <IndexDatabaseUpdateCollector.h>
 #include <UtxoCheckingAndUpdating.h>
 #include <BlockCheckingHelpers.h>
 #include <Logging.h>
@@ -157,20 +156,6 @@ bool BlockConnectionService::ApplyConnectionUpdateIndexToDBs(
         if (!blocktree_->WriteTxIndex(indexDatabaseUpdates.txLocationData))
             return state.Abort("ConnectingBlock: Failed to write transaction index");
 
-    if (indexDatabaseUpdates.addressIndexingEnabled_) {
-        if (!blocktree_->WriteAddressIndex(indexDatabaseUpdates.addressIndex)) {
-            return state.Abort("ConnectingBlock: Failed to write address index");
-        }
-
-        if (!blocktree_->UpdateAddressUnspentIndex(indexDatabaseUpdates.addressUnspentIndex)) {
-            return state.Abort("ConnectingBlock: Failed to write address unspent index");
-        }
-    }
-
-    if (indexDatabaseUpdates.spentIndexingEnabled_)
-        if (!blocktree_->UpdateSpentIndex(indexDatabaseUpdates.spentIndex))
-            return state.Abort("ConnectingBlock: Failed to write update spent index");
-
     return blocktree_->WriteBestBlockHash(indexDatabaseUpdates.blockIndex_->GetBlockHash());
 }
 
@@ -178,20 +163,6 @@ bool BlockConnectionService::ApplyDisconnectionUpdateIndexToDBs(
     const IndexDatabaseUpdates& indexDBUpdates,
     CValidationState& state) const
 {
-    if (indexDBUpdates.addressIndexingEnabled_) {
-        if (!blocktree_->EraseAddressIndex(indexDBUpdates.addressIndex)) {
-            return state.Abort("Disconnecting block: Failed to delete address index");
-        }
-        if (!blocktree_->UpdateAddressUnspentIndex(indexDBUpdates.addressUnspentIndex)) {
-            return state.Abort("Disconnecting block: Failed to write address unspent index");
-        }
-    }
-    if(indexDBUpdates.addressIndexingEnabled_)
-    {
-        if (!blocktree_->UpdateSpentIndex(indexDBUpdates.spentIndex)) {
-            return state.Abort("Disconnecting block: Failed to write update spent index");
-        }
-    }
     return blocktree_->WriteBestBlockHash(indexDBUpdates.blockIndex_->pprev->GetBlockHash());
 }
 
@@ -234,7 +205,8 @@ bool BlockConnectionService::DisconnectBlock(
     if(blockUndo.vtxundo.size() + 1 != block.vtx.size())
         return error("%s: block and undo data inconsistent", __func__);
 
-    IndexDatabaseUpdates indexDBUpdates(pindex, blocktree_->GetAddressIndexing(), blocktree_->GetSpentIndexing());
+    // Address and spent indexes are rolled back by AsyncIndexBuilder, from the undo data
+    IndexDatabaseUpdates indexDBUpdates(pindex, false, false);
     // undo transactions in reverse order
     for (int transactionIndex = block.vtx.size() - 1; transactionIndex >= 0; transactionIndex--) {
         const CTransaction& tx = block.vtx[transactionIndex];
@@ -246,9 +218,6 @@ bool BlockConnectionService::DisconnectBlock(
         if (!CheckTxReversalStatus(status, fClean))
             return error("%s: error reverting transaction %s in block %s at height %d",
                          __func__, tx.GetHash(), block.GetHash(), pindex->nHeight);
-
-        if(!fJustCheck)
-            IndexDatabaseUpdateCollector::ReverseTransaction(tx,txLocationReference,view,indexDBUpdates);
     }
 
     // undo transactions in reverse order
@@ -314,10 +283,8 @@ bool BlockConnectionService::ConnectBlock(
     }
 
 
-    IndexDatabaseUpdates indexDatabaseUpdates(
-        pindex,
-        blocktree_->GetAddressIndexing(),
-        blocktree_->GetSpentIndexing());
+    // Only the tx index is written here; AsyncIndexBuilder adds the address and spent indexes later
+    IndexDatabaseUpdates indexDatabaseUpdates(pindex, false, false);
     CBlockRewards nExpectedMint = blockSubsidies_.blockSubsidiesProvider().GetBlockSubsidity(pindex->nHeight);
     if(ActivationState(pindex->pprev).IsActive(Fork::DeprecateMasternodes))
     {
@@ -0,0 +1,401 @@
+#include <BlockDownloadScheduler.h>
+
+#include <BlockProofVerifier.h>
+#include <BlocksInFlightRegistry.h>
+#include <chainparams.h>
+#include <I_DifficultyAdjuster.h>
+#include <Logging.h>
+#include <serialize.h>
+#include <ValidationState.h>
+#include <version.h>
+
+BlockDownloadScheduler::BlockDownloadScheduler(
+    size_t maxBufferedBlockBytes,
+    size_t maxPendingHeaders
+    ): pendingBlocks_()
+    , heightByPendingHash_()
+    , bufferedBlocks_()
+    , bufferedBlockBytes_(0)
+    , maxBufferedBlockBytes_(maxBufferedBlockBytes)
+    , maxPendingHeaders_(maxPendingHeaders)
+    , headerChainWasCapped_(false)
+    , awaitedBlockHash_()
+    , awaitedSince_(0)
+{
+}
+
+const BlockDownloadScheduler::PendingBlock* BlockDownloadScheduler::AtHeight(int height) const
+{
+    if (pendingBlocks_.empty() || height < pendingBlocks_.front().height || height > pendingBlocks_.back().height)
+        return nullptr;
+    return &pendingBlocks_[height - pendingBlocks_.front().height];
+}
+
+const BlockDownloadScheduler::PendingBlock* BlockDownloadScheduler::FindPendingBlock(const uint256& hash) const
+{
+    const auto it = heightByPendingHash_.find(hash);
+    return it != heightByPendingHash_.end()? AtHeight(it->second): nullptr;
+}
+
+void BlockDownloadScheduler::ForgetBufferedBlock(const uint256& hash)
+{
+    const auto it = bufferedBlocks_.find(hash);
+    if (it == bufferedBlocks_.end())
+        return;
+    bufferedBlockBytes_ -= it->second.serializedSize;
+    bufferedBlocks_.erase(it);
+}
+
+void BlockDownloadScheduler::TruncateAtHeight(int height, std::vector<uint256>* discardedHashes)
+{
+    while (!pendingBlocks_.empty() && pendingBlocks_.back().height >= height)
+    {
+        if (discardedHashes != nullptr)
+            discardedHashes->push_back(pendingBlocks_.back().hash);
+        ForgetBufferedBlock(pendingBlocks_.back().hash);
+        heightByPendingHash_.erase(pendingBlocks_.back().hash);
+        pendingBlocks_.pop_back();
+    }
+}
+
+bool BlockDownloadScheduler::CheckHeader(
+    const CBlockHeader& header,
+    const CBlockIndex& previousHeader,
+    const CChainParams& chainParameters,
+    const I_DifficultyAdjuster& difficultyAdjuster,
+    int64_t maxBlockTime,
+    const MapCheckpoints* checkpoints,
+    CValidationState& state) const
+{
+    const int height = previousHeader.nHeight + 1;
+    if (header.nVersion < 3)
+        return state.Invalid(error("%s : rejected nVersion=%d header", __func__, header.nVersion),
+                             REJECT_OBSOLETE, "bad-version");
+
+    if (header.GetBlockTime() > maxBlockTime)
+        return state.Invalid(error("%s : header timestamp too far in the future", __func__),
+                             REJECT_INVALID, "time-too-new");
+
+    if (header.GetBlockTime() <= previousHeader.GetMedianTimePast())
+        return state.DoS(50, error("%s : header timestamp is too early", __func__),
+                         REJECT_INVALID, "time-too-old");
+
+    if (header.nBits != difficultyAdjuster.computeNextBlockDifficulty(&previousHeader))
+        return state.DoS(100, error("%s : incorrect difficulty at height %d", __func__, height),
+                         REJECT_INVALID, "bad-diffbits");
+
+    // Stake can only be checked against the coinstake, which comes with the block
+    if (height <= chainParameters.LAST_POW_BLOCK() && !CheckProofOfWork(header.GetHash(), header.nBits, chainParameters))
+        return state.DoS(50, error("%s : proof of work failed at height %d", __func__, height),
+                         REJECT_INVALID, "high-hash");
+
+    if (checkpoints)
+    {
+        const auto it = checkpoints->find(height);
+        if (it != checkpoints->end() && it->second != header.GetHash())
+            return state.DoS(100, error("%s : rejected by checkpoint lock-in at %d", __func__, height),
+                             REJECT_CHECKPOINT, "checkpoint mismatch");
+    }
+    return true;
+}
+
+bool BlockDownloadScheduler::AcceptHeaders(
+    const std::vector<CBlockHeader>& headers,
+    const CBlockIndex* parentIndex,
+    NodeId source,
+    const CChainParams& chainParameters,
+    const I_DifficultyAdjuster& difficultyAdjuster,
+    int64_t maxBlockTime,
+    const MapCheckpoints* checkpoints,
+    const uint256& activeChainWork,
+    CValidationState& state)
+{
+    if (headers.empty())
+        return true;
+
+    std::vector<uint256> hashes;
+    hashes.reserve(headers.size());
+    for (const CBlockHeader& header: headers)
+    {
+        if (!hashes.empty() && header.hashPrevBlock != hashes.back())
+            return state.DoS(20, error("%s : non-continuous headers sequence", __func__), REJECT_INVALID, "bad-headers-sequence");
+        hashes.push_back(header.GetHash());
+    }
+
+    // Work out where the batch attaches: to a pending header, or to the same block the header chain starts from
+    const PendingBlock* parent = FindPendingBlock(headers.front().hashPrevBlock);
+    const bool attached =
+        parent != nullptr ||
+        pendingBlocks_.empty() ||
+        pendingBlocks_.front().hashPrevBlock == headers.front().hashPrevBlock;
+    const CBlockIndex* previousHeader = parent != nullptr? &parent->header: parentIndex;
+    if (previousHeader == nullptr)
+        return state.DoS(0, error("%s : headers do not connect to a known block", __func__), 0, "unconnected-headers");
+    const int firstHeight = previousHeader->nHeight + 1;
+
+    // Each header is checked against the ones before it, which is also how the work they lead to adds up
+    std::vector<CBlockIndex> newHeaders(headers.size());
+    for (size_t index = 0; index < headers.size(); ++index)
+    {
+        if (!CheckHeader(headers[index], *previousHeader, chainParameters, difficultyAdjuster, maxBlockTime, checkpoints, state))
+            return false;
+        CBlockIndex& newHeader = newHeaders[index];
+        newHeader.phashBlock = &hashes[index];
+        newHeader.pprev = const_cast<CBlockIndex*>(previousHeader);
+        newHeader.nHeight = previousHeader->nHeight + 1;
+        newHeader.nVersion = headers[index].nVersion;
+        newHeader.hashMerkleRoot = headers[index].hashMerkleRoot;
+        newHeader.nTime = headers[index].nTime;
+        newHeader.nBits = headers[index].nBits;
+        newHeader.nNonce = headers[index].nNonce;
+        newHeader.nChainWork = previousHeader->nChainWork + newHeader.getBlockProof();
+        previousHeader = &newHeader;
+    }
+
+    const uint256& newChainWork = newHeaders.back().nChainWork;
+    if (newChainWork <= activeChainWork)
+        return true;
+
+    size_t firstNewIndex = 0;
+    if (attached)
+    {
+        while (firstNewIndex < headers.size())
+        {
+            const PendingBlock* existing = AtHeight(firstHeight + static_cast<int>(firstNewIndex));
+            if (existing == nullptr || existing->hash != hashes[firstNewIndex])
+                break;
+            ++firstNewIndex;
+        }
+        if (firstNewIndex == headers.size())
+            return true;
+
+        const int forkHeight = firstHeight + static_cast<int>(firstNewIndex);
+        if (forkHeight <= BestHeaderHeight())
+        {
+            // Two header chains compete; follow the one with the most work, the bodies decide in the end
+            if (newChainWork <= BestHeaderChainWork())
+                return true;
+            LogPrint("net", "%s : header chain forks at height %d, switching to headers from peer=%d\n", __func__, forkHeight, source);
+            TruncateAtHeight(forkHeight);
+        }
+    }
+    else
+    {
+        if (newChainWork <= BestHeaderChainWork())
+            return true;
+        LogPrint("net", "%s : replacing header chain with headers from peer=%d\n", __func__, source);
+        TruncateAtHeight(pendingBlocks_.front().height);
+    }
+
+    for (size_t index = firstNewIndex; index < headers.size(); ++index)
+    {
+        if (pendingBlocks_.size() >= maxPendingHeaders_)
+        {
+            LogPrint("net", "%s : header chain is full at height %d, dropping %u headers from peer=%d\n", __func__,
+                     BestHeaderHeight(), headers.size() - index, source);
+            headerChainWasCapped_ = true;
+            break;
+        }
+        const int height = firstHeight + static_cast<int>(index);
+        pendingBlocks_.push_back(PendingBlock{hashes[index], headers[index].hashPrevBlock, height, source, newHeaders[index]});
+        PendingBlock& pending = pendingBlocks_.back();
+        pending.header.phashBlock = &pending.hash;
+        if (pendingBlocks_.size() > 1u)
+            pending.header.pprev = &pendingBlocks_[pendingBlocks_.size() - 2u].header;
+        else
+            pending.header.pprev = const_cast<CBlockIndex*>(parentIndex);
+        heightByPendingHash_[hashes[index]] = height;
+    }
+    return true;
+}
+
+bool BlockDownloadScheduler::IsPending(const uint256& hash) const
+{
+    return heightByPendingHash_.count(hash) > 0;
+}
+
+int BlockDownloadScheduler::GetPendingHeight(const uint256& hash) const
+{
+    const auto it = heightByPendingHash_.find(hash);
+    return it != heightByPendingHash_.end()? it->second: -1;
+}
+
+int BlockDownloadScheduler::BestHeaderHeight() const
+{
+    return pendingBlocks_.empty()? -1: pendingBlocks_.back().height;
+}
+
+uint256 BlockDownloadScheduler::BestHeaderHash() const
+{
+    return pendingBlocks_.empty()? uint256(0): pendingBlocks_.back().hash;
+}
+
+uint256 BlockDownloadScheduler::BestHeaderChainWork() const
+{
+    return pendingBlocks_.empty()? uint256(0): pendingBlocks_.back().header.nChainWork;
+}
+
+size_t BlockDownloadScheduler::PendingBlockCount() const
+{
+    return pendingBlocks_.size();
+}
+
+bool BlockDownloadScheduler::NeedsMoreHeaders() const
+{
+    return headerChainWasCapped_ && pendingBlocks_.size() <= maxPendingHeaders_ / 2;
+}
+
+void BlockDownloadScheduler::RecordMoreHeadersRequested()
+{
+    headerChainWasCapped_ = false;
+}
+
+std::vector<uint256> BlockDownloadScheduler::GetLocatorHashes() const
+{
+    std::vector<uint256> hashes;
+    int step = 1;
+    for (int index = static_cast<int>(pendingBlocks_.size()) - 1; index >= 0; index -= step)
+    {
+        hashes.push_back(pendingBlocks_[index].hash);
+        if (hashes.size() >= 10)
+            step *= 2;
+    }
+    return hashes;
+}
+
+void BlockDownloadScheduler::FindNextBlocksToDownload(
+    const BlocksInFlightRegistry& blocksInFlight,
+    NodeId nodeId,
+    int peerBestHeight,
+    unsigned int count,
+    std::vector<uint256>& vBlocks,
+    NodeId& nodeStaller) const
+{
+    if (count == 0 || pendingBlocks_.empty())
+        return;
+
+    // The window starts at the first block that still has to be accepted. The block right past
+    // its end is used to detect a peer holding up the whole window, as in FindNextBlocksToDownload.
+    const int firstMissingHeight = pendingBlocks_.front().height;
+    const int windowEnd = firstMissingHeight + static_cast<int>(BLOCK_DOWNLOAD_WINDOW) - 1;
+    const bool bufferIsFull = bufferedBlockBytes_ >= maxBufferedBlockBytes_;
+    NodeId waitingFor = -1;
+    for (const PendingBlock& pending: pendingBlocks_)
+    {
+        if (pending.height > peerBestHeight)
+            return;
+        if (bufferedBlocks_.count(pending.hash) > 0)
+            continue;
+        if (blocksInFlight.BlockIsInFlight(pending.hash))
+        {
+            if (waitingFor == -1)
+                waitingFor = blocksInFlight.GetSourceOfInFlightBlock(pending.hash);
+            continue;
+        }
+        if (pending.height > windowEnd)
+        {
+            if (vBlocks.empty() && waitingFor != nodeId)
+                nodeStaller = waitingFor;
+            return;
+        }
+        // Only the block that can be accepted right away is worth fetching while the buffer is full
+        if (bufferIsFull && pending.height > firstMissingHeight)
+            return;
+        vBlocks.push_back(pending.hash);
+        if (vBlocks.size() == count)
+            return;
+    }
+}
+
+bool BlockDownloadScheduler::BufferBlock(const CBlock& block, NodeId source)
+{
+    const uint256 hash = block.GetHash();
+    if (!IsPending(hash))
+        return false;
+    if (bufferedBlocks_.count(hash) > 0)
+        return true;
+
+    const size_t serializedSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    if (bufferedBlockBytes_ + serializedSize > maxBufferedBlockBytes_)
+        return false;
+    bufferedBlocks_[hash] = BufferedBlock{block, source, serializedSize};
+    bufferedBlockBytes_ += serializedSize;
+    return true;
+}
+
+bool BlockDownloadScheduler::TakeBufferedChild(const uint256& parentHash, CBlock& block, NodeId& source)
+{
+    const PendingBlock* child = nullptr;
+    const PendingBlock* parent = FindPendingBlock(parentHash);
+    if (parent != nullptr)
+        child = AtHeight(parent->height + 1);
+    else if (!pendingBlocks_.empty() && pendingBlocks_.front().hashPrevBlock == parentHash)
+        child = &pendingBlocks_.front();
+    if (child == nullptr)
+        return false;
+
+    const auto it = bufferedBlocks_.find(child->hash);
+    if (it == bufferedBlocks_.end())
+        return false;
+    block = it->second.block;
+    source = it->second.source;
+    ForgetBufferedBlock(child->hash);
+    return true;
+}
+
+size_t BlockDownloadScheduler::BufferedBlockCount() const
+{
+    return bufferedBlocks_.size();
+}
+
+size_t BlockDownloadScheduler::BufferedBlockBytes() const
+{
+    return bufferedBlockBytes_;
+}
+
+void BlockDownloadScheduler::RemoveAcceptedBlocks(const std::function<const CBlockIndex*(const uint256&)>& acceptedBlockIndex)
+{
+    while (!pendingBlocks_.empty())
+    {
+        const CBlockIndex* blockIndex = acceptedBlockIndex(pendingBlocks_.front().hash);
+        if (blockIndex == nullptr)
+            return;
+        ForgetBufferedBlock(pendingBlocks_.front().hash);
+        heightByPendingHash_.erase(pendingBlocks_.front().hash);
+        pendingBlocks_.pop_front();
+        // The header chain now starts from the accepted block
+        if (!pendingBlocks_.empty())
+            pendingBlocks_.front().header.pprev = const_cast<CBlockIndex*>(blockIndex);
+    }
+}
+
+NodeId BlockDownloadScheduler::DiscardFrom(const uint256& hash)
+{
+    const PendingBlock* pending = FindPendingBlock(hash);
+    if (pending == nullptr)
+        return -1;
+    const NodeId headerSource = pending->headerSource;
+    TruncateAtHeight(pending->height);
+    return headerSource;
+}
+
+NodeId BlockDownloadScheduler::DiscardIfFirstBlockNeverArrives(int64_t now, int64_t timeout, std::vector<uint256>& discardedHashes)
+{
+    if (pendingBlocks_.empty())
+        return -1;
+    const PendingBlock& firstBlock = pendingBlocks_.front();
+    if (firstBlock.hash != awaitedBlockHash_)
+    {
+        awaitedBlockHash_ = firstBlock.hash;
+        awaitedSince_ = now;
+        return -1;
+    }
+    if (now - awaitedSince_ <= timeout)
+        return -1;
+
+    const NodeId headerSource = firstBlock.headerSource;
+    LogPrint("net", "%s : block %s of the header chain never arrived, dropping headers from peer=%d\n", __func__, firstBlock.hash, headerSource);
+    TruncateAtHeight(firstBlock.height, &discardedHashes);
+    headerChainWasCapped_ = false;
+    return headerSource;
+}
@@ -0,0 +1,149 @@
+#ifndef BLOCK_DOWNLOAD_SCHEDULER_H
+#define BLOCK_DOWNLOAD_SCHEDULER_H
+#include <NodeId.h>
+#include <chain.h>
+#include <primitives/block.h>
+#include <uint256.h>
+#include <checkpoint_data.h>
+#include <defaultValues.h>
+
+#include <deque>
+#include <functional>
+#include <map>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+class BlocksInFlightRegistry;
+class CChainParams;
+class CValidationState;
+class I_DifficultyAdjuster;
+
+/** Upper bound on the memory taken by blocks that arrived before their parent */
+constexpr size_t MAX_BUFFERED_BLOCK_BYTES = 64 * 1000 * 1000;
+/** Upper bound on the number of headers kept ahead of the block index */
+constexpr size_t MAX_PENDING_HEADERS = 8 * BLOCK_DOWNLOAD_WINDOW;
+
+/** Headers validated ahead of their block bodies, and the plan for fetching those
+ *  bodies from several peers at once during headers-first sync.
+ *
+ *  A Divi block index entry cannot be created from a header alone (its stake and
+ *  lottery data are derived from the coinstake), so the header chain beyond the
+ *  block index is kept here until the bodies have been accepted. Bodies that
+ *  arrive ahead of their parent are buffered and handed back in chain order.
+ */
+class BlockDownloadScheduler
+{
+private:
+    struct PendingBlock
+    {
+        uint256 hash;
+        uint256 hashPrevBlock;
+        int height;
+        NodeId headerSource;
+        /** Header fields the following headers are checked against, linked to the previous
+         *  pending header or to the block index entry the header chain starts from */
+        CBlockIndex header;
+    };
+    struct BufferedBlock
+    {
+        CBlock block;
+        NodeId source;
+        size_t serializedSize;
+    };
+
+    std::deque<PendingBlock> pendingBlocks_;
+    std::map<uint256, int> heightByPendingHash_;
+    std::map<uint256, BufferedBlock> bufferedBlocks_;
+    size_t bufferedBlockBytes_;
+    const size_t maxBufferedBlockBytes_;
+    const size_t maxPendingHeaders_;
+    bool headerChainWasCapped_;
+    uint256 awaitedBlockHash_;
+    int64_t awaitedSince_;
+
+    const PendingBlock* AtHeight(int height) const;
+    const PendingBlock* FindPendingBlock(const uint256& hash) const;
+    void ForgetBufferedBlock(const uint256& hash);
+    void TruncateAtHeight(int height, std::vector<uint256>* discardedHashes = nullptr);
+    bool CheckHeader(
+        const CBlockHeader& header,
+        const CBlockIndex& previousHeader,
+        const CChainParams& chainParameters,
+        const I_DifficultyAdjuster& difficultyAdjuster,
+        int64_t maxBlockTime,
+        const MapCheckpoints* checkpoints,
+        CValidationState& state) const;
+public:
+    explicit BlockDownloadScheduler(
+        size_t maxBufferedBlockBytes = MAX_BUFFERED_BLOCK_BYTES,
+        size_t maxPendingHeaders = MAX_PENDING_HEADERS);
+
+    /** Validates a batch of consecutive headers and adds them to the header chain.
+     *  The first header must follow either a pending header or parentIndex, the block
+     *  index entry it builds on (nullptr if its parent is not in the block index).
+     *  Each header must carry the difficulty required after its parent, a timestamp past
+     *  the median of the blocks before it and, up to the last proof-of-work block, a
+     *  valid proof of work; proof of stake can only be checked once the block arrives.
+     *  Headers are only kept if they lead to more work than activeChainWork, and a batch
+     *  that forks off the header chain only replaces it when it leads to more work.
+     *  At most maxPendingHeaders are kept; the rest is asked for again later, see
+     *  NeedsMoreHeaders. Returns false, with state set, if the headers are invalid. */
+    bool AcceptHeaders(
+        const std::vector<CBlockHeader>& headers,
+        const CBlockIndex* parentIndex,
+        NodeId source,
+        const CChainParams& chainParameters,
+        const I_DifficultyAdjuster& difficultyAdjuster,
+        int64_t maxBlockTime,
+        const MapCheckpoints* checkpoints,
+        const uint256& activeChainWork,
+        CValidationState& state);
+    bool IsPending(const uint256& hash) const;
+    int GetPendingHeight(const uint256& hash) const;
+    /** Height and hash of the last header in the header chain, or -1 and 0 if there is none */
+    int BestHeaderHeight() const;
+    uint256 BestHeaderHash() const;
+    /** Chain work of the last header in the header chain, 0 if there is none */
+    uint256 BestHeaderChainWork() const;
+    size_t PendingBlockCount() const;
+    /** Whether headers were dropped for lack of room and there is room for them again;
+     *  RecordMoreHeadersRequested resets this once they have been asked for */
+    bool NeedsMoreHeaders() const;
+    void RecordMoreHeadersRequested();
+    /** Hashes of the header chain, most recent first and thinning out exponentially,
+     *  to be followed by a locator of the active chain when asking for more headers */
+    std::vector<uint256> GetLocatorHashes() const;
+
+    /** Picks up to count blocks for a peer that has blocks up to peerBestHeight, within
+     *  BLOCK_DOWNLOAD_WINDOW of the first block still missing. If the window is used up
+     *  while the first block missing from it is in flight from another peer, that
+     *  peer is reported through nodeStaller. */
+    void FindNextBlocksToDownload(
+        const BlocksInFlightRegistry& blocksInFlight,
+        NodeId nodeId,
+        int peerBestHeight,
+        unsigned int count,
+        std::vector<uint256>& vBlocks,
+        NodeId& nodeStaller) const;
+
+    /** Holds on to a pending block whose parent has not been accepted yet; returns false
+     *  if it is not pending or does not fit in the buffer, in which case it is fetched again later */
+    bool BufferBlock(const CBlock& block, NodeId source);
+    /** Hands out the buffered block that follows parentHash, if there is one */
+    bool TakeBufferedChild(const uint256& parentHash, CBlock& block, NodeId& source);
+    size_t BufferedBlockCount() const;
+    size_t BufferedBlockBytes() const;
+
+    /** Drops headers from the front of the chain whose blocks are now in the block index;
+     *  acceptedBlockIndex returns the block index entry of an accepted block, nullptr otherwise */
+    void RemoveAcceptedBlocks(const std::function<const CBlockIndex*(const uint256&)>& acceptedBlockIndex);
+    /** Drops an invalid block and everything built on it; returns the peer that sent its header */
+    NodeId DiscardFrom(const uint256& hash);
+    /** Drops the whole header chain if its first block has been awaited for longer than
+     *  timeout (in the unit of now) without arriving, and returns the peer that sent its
+     *  header, or -1. No peer serving that block suggests the header has no body at all.
+     *  The dropped hashes are added to discardedHashes. */
+    NodeId DiscardIfFirstBlockNeverArrives(int64_t now, int64_t timeout, std::vector<uint256>& discardedHashes);
+};
+#endif// BLOCK_DOWNLOAD_SCHEDULER_H
@@ -14,6 +14,7 @@
 #include <boost/thread.hpp>
 #include <chain.h>
 #include <ChainstateManager.h>
+#include <ChainStateSnapshot.h>
 #include <ChainSyncHelpers.h>
 #include <clientversion.h>
 #include <coins.h>
@@ -220,12 +221,7 @@ bool static AttemptBlockDBRecovery(
 {
     expectedBestBlockHash = coinsTip.GetBestBlock();
     if(blockMap.find(expectedBestBlockHash)==blockMap.end()) return false;
-    settings.SetParameter("-addressindex", "0");
-    settings.SetParameter("-spentindex", "0");
-    blockTree.WriteIndexingFlags(
-        settings.GetBoolArg("-addressindex", false),
-        settings.GetBoolArg("-spentindex", false),
-        settings.GetBoolArg("-txindex", true));
+    blockTree.WriteIndexingFlags(settings.GetBoolArg("-txindex", true));
     return blockTree.WriteBestBlockHash(expectedBestBlockHash);
 }
 
@@ -289,7 +285,7 @@ bool static LoadBlockIndexState(Settings& settings, std::string& strError)
     blockTree.ReadReindexing(fReindexing);
     settings.setReindexingFlag( settings.isReindexingBlocks() || fReindexing);
 
-    // Check whether we have address, spent or tx indexing enabled
+    // Check whether we have tx indexing enabled
     blockTree.LoadIndexingFlags();
 
     // If this is written true before the next client init, then we know the shutdown process failed
@@ -300,6 +296,7 @@ bool static LoadBlockIndexState(Settings& settings, std::string& strError)
     if (it == blockMap.end())
         return true;
     chain.SetTip(it->second);
+    ChainStateSnapshot::PublishTip(chain.Tip());
 
     PruneBlockIndexCandidates(chain);
 
@@ -319,6 +316,7 @@ void UnloadBlockIndex(ChainstateManager* chainstate)
     if (chainstate != nullptr)
     {
         chainstate->ActiveChain().SetTip(nullptr);
+        ChainStateSnapshot::Clear();
         auto& blockMap = chainstate->GetBlockMap();
 
         for(auto& blockHashAndBlockIndex: blockMap)
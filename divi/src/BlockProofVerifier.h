@@ -14,6 +14,10 @@ class Settings;
 class CBlock;
 class CBlockIndex;
 
+class uint256;
+
+bool CheckProofOfWork(uint256 hash, unsigned int nBits, const CChainParams& chainParameters);
+
 class BlockProofVerifier final: public I_BlockProofVerifier
 {
 private:
@@ -11,7 +11,6 @@
 #include <clientversion.h>
 #include <BlockRewards.h>
 #include <UtxoCheckingAndUpdating.h>
-#include <IndexDatabaseUpdateCollector.h>
 #include <script/StakingVaultScript.h>
 #include <utilmoneystr.h>
 
@@ -146,7 +145,6 @@ bool BlockTransactionChecker::Check(const CBlockRewards& nExpectedMint, IndexDat
                             REJECT_INVALID, "bad-coinstake-vault-spend");
         }
 
-        IndexDatabaseUpdateCollector::RecordTransaction(tx,txLocationRef,view_, indexDatabaseUpdates);
         view_.UpdateWithConfirmedTransaction(tx,pindex_->nHeight, blockundo_.vtxundo[i>0u? i-1: 0u]);
         txLocationRecorder_.RecordTxLocationData(tx,indexDatabaseUpdates.txLocationData);
     }
@@ -49,13 +49,27 @@ void BlocksInFlightRegistry::MarkBlockAsInFlight(NodeId nodeId, const uint256& h
     allBlocksInFlight_[hash] = std::make_pair(nodeId, it);
 }
 // Requires cs_main.
-bool BlocksInFlightRegistry::BlockIsInFlight(const uint256& hash)
+bool BlocksInFlightRegistry::BlockIsInFlight(const uint256& hash) const
 {
     return allBlocksInFlight_.count(hash)> 0;
 }
-NodeId BlocksInFlightRegistry::GetSourceOfInFlightBlock(const uint256& hash)
+NodeId BlocksInFlightRegistry::GetSourceOfInFlightBlock(const uint256& hash) const
 {
-    return allBlocksInFlight_[hash].first;
+    const auto it = allBlocksInFlight_.find(hash);
+    return it != allBlocksInFlight_.end()? it->second.first: -1;
+}
+// Requires cs_main.
+void BlocksInFlightRegistry::ReleaseBlocksInFlight(NodeId nodeId)
+{
+    if(nodeSyncByNodeId_.count(nodeId)==0) return;
+    NodeBlockSync& nodeSync = nodeSyncByNodeId_[nodeId];
+    for(const QueuedBlock& entry: nodeSync.blocksInFlight)
+    {
+        queuedValidatedHeadersCount_ -= entry.fValidatedHeaders;
+        allBlocksInFlight_.erase(entry.hash);
+    }
+    nodeSync.blocksInFlight.clear();
+    nodeSync.stallingTimestamp = 0;
 }
 
 bool BlocksInFlightRegistry::BlockDownloadHasTimedOut(NodeId nodeId, int64_t nNow, int64_t targetSpacing) const
@@ -44,8 +44,10 @@ public:
     void UnregisterNodeId(NodeId nodeId);
     void MarkBlockAsReceived(const uint256& hash);
     void MarkBlockAsInFlight(NodeId nodeId, const uint256& hash, const CBlockIndex* pindex = nullptr);
-    bool BlockIsInFlight(const uint256& hash);
-    NodeId GetSourceOfInFlightBlock(const uint256& hash);
+    bool BlockIsInFlight(const uint256& hash) const;
+    NodeId GetSourceOfInFlightBlock(const uint256& hash) const;
+    /** Forgets the blocks requested from a peer so they can be requested from others */
+    void ReleaseBlocksInFlight(NodeId nodeId);
 
     bool BlockDownloadHasTimedOut(NodeId nodeId, int64_t nNow, int64_t targetSpacing) const;
     bool BlockDownloadHasStalled(NodeId nodeId, int64_t nNow, int64_t stallingWindow) const;
@@ -230,15 +230,19 @@ CBlockIndex* AddToBlockIndex(
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
     pindexNew->nSequenceId = 0;
-    const auto mi = blockMap.insert(std::make_pair(hash, pindexNew)).first;
-
-    pindexNew->phashBlock = &((*mi).first);
     const auto miPrev = blockMap.find(block.hashPrevBlock);
+    {
+        // Readers without cs_main must not find the entry before it is linked to its parent
+        LOCK(blockMap.GetInsertionLock());
+        const auto mi = blockMap.insert(std::make_pair(hash, pindexNew)).first;
+        pindexNew->phashBlock = &((*mi).first);
+        if (miPrev != blockMap.end()) {
+            pindexNew->pprev = (*miPrev).second;
+            pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
+            pindexNew->BuildSkip();
+        }
+    }
     if (miPrev != blockMap.end()) {
-        pindexNew->pprev = (*miPrev).second;
-        pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
-        pindexNew->BuildSkip();
-
         //update previous block pointer
         pindexNew->pprev->pnext = pindexNew;
 
@@ -699,12 +703,9 @@ bool ChainExtensionService::connectGenesisBlock() const
     if (chainstate_.ActiveChain().Genesis() != nullptr)
         return true;
 
-    // Use the provided setting for transaciton search indices
-    blockTree.WriteIndexingFlags(
-        settings_.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX),
-        settings_.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX),
-        settings_.GetBoolArg("-txindex", true)
-    );
+    // Use the provided setting for the transaction index; address and spent
+    // indexes are kept by AsyncIndexBuilder and follow their settings at any time
+    blockTree.WriteIndexingFlags(settings_.GetBoolArg("-txindex", true));
 
 
     LogPrintf("Connecting genesis block...\n");
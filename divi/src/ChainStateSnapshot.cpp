@@ -0,0 +1,84 @@
+#include <ChainStateSnapshot.h>
+
+#include <atomic>
+#include <chain.h>
+
+namespace
+{
+std::shared_ptr<const ChainStateSnapshot>& PublishedSnapshot()
+{
+    static std::shared_ptr<const ChainStateSnapshot> snapshot = std::make_shared<const ChainStateSnapshot>(nullptr, nullptr);
+    return snapshot;
+}
+} // anonymous namespace
+
+ChainStateSnapshot::ChainStateSnapshot(
+    const CBlockIndex* tip,
+    const CBlockIndex* bestHeader
+    ): tip_(tip)
+    , bestHeader_(bestHeader)
+{
+}
+
+const CBlockIndex* ChainStateSnapshot::Tip() const
+{
+    return tip_;
+}
+
+int ChainStateSnapshot::Height() const
+{
+    return tip_? tip_->nHeight: -1;
+}
+
+const CBlockIndex* ChainStateSnapshot::operator[](int height) const
+{
+    if (tip_ == nullptr || height < 0 || height > tip_->nHeight)
+        return nullptr;
+    return tip_->GetAncestor(height);
+}
+
+bool ChainStateSnapshot::Contains(const CBlockIndex* pindex) const
+{
+    return pindex != nullptr && (*this)[pindex->nHeight] == pindex;
+}
+
+const CBlockIndex* ChainStateSnapshot::Next(const CBlockIndex* pindex) const
+{
+    if (!Contains(pindex))
+        return nullptr;
+    return (*this)[pindex->nHeight + 1];
+}
+
+const CBlockIndex* ChainStateSnapshot::BestHeader() const
+{
+    return bestHeader_;
+}
+
+int ChainStateSnapshot::BestHeaderHeight() const
+{
+    return bestHeader_? bestHeader_->nHeight: -1;
+}
+
+std::shared_ptr<const ChainStateSnapshot> ChainStateSnapshot::Current()
+{
+    return std::atomic_load(&PublishedSnapshot());
+}
+
+void ChainStateSnapshot::PublishTip(const CBlockIndex* tip)
+{
+    const std::shared_ptr<const ChainStateSnapshot> previous = Current();
+    std::atomic_store(&PublishedSnapshot(), std::make_shared<const ChainStateSnapshot>(tip, previous->bestHeader_));
+}
+
+void ChainStateSnapshot::PublishBestHeader(const CBlockIndex* bestHeader)
+{
+    const std::shared_ptr<const ChainStateSnapshot> previous = Current();
+    if (previous->bestHeader_ == bestHeader)
+        return;
+    std::atomic_store(&PublishedSnapshot(), std::make_shared<const ChainStateSnapshot>(previous->tip_, bestHeader));
+}
+
+void ChainStateSnapshot::Clear()
+{
+    std::atomic_store(&PublishedSnapshot(), std::make_shared<const ChainStateSnapshot>(nullptr, nullptr));
+}
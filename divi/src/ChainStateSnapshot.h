@@ -0,0 +1,40 @@
+#ifndef CHAIN_STATE_SNAPSHOT_H
+#define CHAIN_STATE_SNAPSHOT_H
+#include <memory>
+
+class CBlockIndex;
+
+/** Immutable view of the active chain as of one tip change.
+ *
+ *  A new snapshot is published (with cs_main held) whenever the tip or the best
+ *  header changes, so readers such as the RPC server can look at a consistent chain
+ *  without taking cs_main. Heights are resolved from the tip through the skip list;
+ *  this is safe because a block index entry is never modified in the fields that
+ *  walk uses once it is linked into the block tree.
+ */
+class ChainStateSnapshot
+{
+private:
+    const CBlockIndex* tip_;
+    const CBlockIndex* bestHeader_;
+
+public:
+    ChainStateSnapshot(const CBlockIndex* tip, const CBlockIndex* bestHeader);
+
+    const CBlockIndex* Tip() const;
+    /** -1 when there is no tip */
+    int Height() const;
+    /** The block at the given height on this chain, nullptr if out of range */
+    const CBlockIndex* operator[](int height) const;
+    bool Contains(const CBlockIndex* pindex) const;
+    const CBlockIndex* Next(const CBlockIndex* pindex) const;
+    const CBlockIndex* BestHeader() const;
+    int BestHeaderHeight() const;
+
+    static std::shared_ptr<const ChainStateSnapshot> Current();
+    static void PublishTip(const CBlockIndex* tip);
+    static void PublishBestHeader(const CBlockIndex* bestHeader);
+    /** Drops the published chain before the block index is unloaded */
+    static void Clear();
+};
+#endif// CHAIN_STATE_SNAPSHOT_H
@@ -3,6 +3,7 @@
 #include <chain.h>
 #include <BlockCheckingHelpers.h>
 #include <ChainstateManager.h>
+#include <ChainStateSnapshot.h>
 #include <sync.h>
 #include <utiltime.h>
 #include <Settings.h>
@@ -13,12 +14,14 @@ void InitializeBestHeaderBlockIndex()
 {
     if(pindexBestHeader == nullptr)
         pindexBestHeader = ChainstateManager::Reference()->ActiveChain().Tip();
+    ChainStateSnapshot::PublishBestHeader(pindexBestHeader);
 }
 void updateBestHeaderBlockIndex(const CBlockIndex* otherBlockIndex, bool compareByWorkOnly)
 {
     if(pindexBestHeader == nullptr || ( otherBlockIndex != nullptr && CBlockIndexWorkComparator(compareByWorkOnly)(pindexBestHeader,otherBlockIndex)))
     {
         pindexBestHeader = otherBlockIndex;
+        ChainStateSnapshot::PublishBestHeader(pindexBestHeader);
     }
 }
 int GetBestHeaderBlockHeight()
@@ -16,6 +16,7 @@
 #include <ChainstateManager.h>
 #include <ValidationState.h>
 #include <ChainSyncHelpers.h>
+#include <ChainStateSnapshot.h>
 #include <Logging.h>
 #include <alert.h>
 #include <Warnings.h>
@@ -32,6 +33,7 @@ void static UpdateTip(const CBlockIndex* pindexNew, CCriticalSection& mainCritic
     ChainstateManager::Reference chainstate;
     auto& chain = chainstate->ActiveChain();
     chain.SetTip(pindexNew);
+    ChainStateSnapshot::PublishTip(pindexNew);
 
     // New best block
     LogPrintf("%s: new best=%s  height=%d  log2_work=%.8g  tx=%lu  date=%s cache=%u\n", __func__,
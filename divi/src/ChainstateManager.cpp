@@ -57,11 +57,12 @@ bool CCoinsViewErrorCatcher::GetCoins(const uint256& txid, CCoins& coins) const
 
 } // anonymous namespace
 
-ChainstateManager::ChainstateManager (const size_t blockTreeCache, const size_t coinDbCache,size_t viewCacheSize,
+ChainstateManager::ChainstateManager (const size_t blockTreeCache, const size_t searchIndexCache, const size_t coinDbCache,size_t viewCacheSize,
                                       const bool fMemory, const bool fWipe)
   : blockMap(new BlockMap ()),
     activeChain(new CChain ()),
     blockTree(new CBlockTreeDB (blockTreeCache, fMemory, fWipe)),
+    searchIndexes(new CSearchIndexDB (searchIndexCache, fMemory, fWipe)),
     coinsDbView(new CCoinsViewDB (*blockMap, coinDbCache, fMemory, fWipe)),
     coinsCatcher(new CCoinsViewErrorCatcher (coinsDbView.get ())),
     coinsTip(new CCoinsViewCache (coinsCatcher.get ())),
@@ -6,6 +6,7 @@
 
 class BlockMap;
 class CBlockTreeDB;
+class CSearchIndexDB;
 class CChain;
 class CCoinsView;
 class CCoinsViewDB;
@@ -23,6 +24,7 @@ private:
   std::unique_ptr<BlockMap> blockMap;
   std::unique_ptr<CChain> activeChain;
   std::unique_ptr<CBlockTreeDB> blockTree;
+  std::unique_ptr<CSearchIndexDB> searchIndexes;
 
   std::unique_ptr<CCoinsViewDB> coinsDbView;
   std::unique_ptr<CCoinsView> coinsCatcher;
@@ -38,7 +40,7 @@ public:
 
   class Reference;
 
-  explicit ChainstateManager (size_t blockTreeCache, size_t coinDbCache,size_t viewCacheSize,
+  explicit ChainstateManager (size_t blockTreeCache, size_t searchIndexCache, size_t coinDbCache,size_t viewCacheSize,
                               bool fMemory, bool fWipe);
   ~ChainstateManager ();
 
@@ -83,6 +85,19 @@ public:
     return *blockTree;
   }
 
+  /** The address and spent indexes, which AsyncIndexBuilder keeps up to date.  */
+  inline CSearchIndexDB&
+  SearchIndexes ()
+  {
+    return *searchIndexes;
+  }
+
+  inline const CSearchIndexDB&
+  SearchIndexes () const
+  {
+    return *searchIndexes;
+  }
+
   inline CCoinsViewCache&
   CoinsTip ()
   {
@@ -0,0 +1,214 @@
+#include <CompactBlock.h>
+
+#include <crypto/common.h>
+#include <hash.h>
+#include <txmempool.h>
+#include <version.h>
+
+#include <unordered_map>
+
+/** Smallest serialized transaction that can appear in a block; bounds the transaction count of a compact block */
+constexpr size_t MIN_SERIALIZED_TRANSACTION_SIZE = 60;
+
+CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(
+    ): shortIdKey0_(0)
+    , shortIdKey1_(0)
+    , header()
+    , nonce(0)
+    , shortTxIds()
+    , prefilledTransactions()
+    , vchBlockSig()
+{
+}
+
+CBlockHeaderAndShortTxIDs::CBlockHeaderAndShortTxIDs(
+    const CBlock& block,
+    uint64_t nonceValue
+    ): shortIdKey0_(0)
+    , shortIdKey1_(0)
+    , header(block.GetBlockHeader())
+    , nonce(nonceValue)
+    , shortTxIds()
+    , prefilledTransactions()
+    , vchBlockSig(block.vchBlockSig)
+{
+    FillShortTxIDSelector();
+
+    // The coinbase, and the coinstake of a proof-of-stake block, never sit in a peer's mempool
+    const size_t numberOfPrefilledTransactions = std::min<size_t>(block.vtx.size(), block.IsProofOfStake() ? 2u : 1u);
+    shortTxIds.reserve(block.vtx.size() - numberOfPrefilledTransactions);
+    for (size_t txIndex = 0; txIndex < block.vtx.size(); ++txIndex)
+    {
+        if (txIndex < numberOfPrefilledTransactions)
+        {
+            prefilledTransactions.emplace_back(static_cast<uint16_t>(txIndex), block.vtx[txIndex]);
+        }
+        else
+        {
+            shortTxIds.push_back(GetShortID(block.vtx[txIndex].GetHash()));
+        }
+    }
+}
+
+void CBlockHeaderAndShortTxIDs::FillShortTxIDSelector() const
+{
+    CHashWriter hasher(SER_NETWORK, PROTOCOL_VERSION);
+    hasher << header << nonce;
+    const uint256 shortIdKey = hasher.GetHash();
+    shortIdKey0_ = ReadLE64(shortIdKey.begin());
+    shortIdKey1_ = ReadLE64(shortIdKey.begin() + 8);
+}
+
+uint64_t CBlockHeaderAndShortTxIDs::GetShortID(const uint256& txHash) const
+{
+    return SipHashUint256(shortIdKey0_, shortIdKey1_, txHash) & 0xffffffffffffULL;
+}
+
+size_t CBlockHeaderAndShortTxIDs::BlockTransactionCount() const
+{
+    return shortTxIds.size() + prefilledTransactions.size();
+}
+
+PartiallyDownloadedBlock::PartiallyDownloadedBlock(
+    ): transactions_()
+    , available_()
+    , header_()
+    , vchBlockSig_()
+    , prefilledCount_(0)
+    , mempoolCount_(0)
+{
+}
+
+CompactBlockReadStatus PartiallyDownloadedBlock::InitData(const CBlockHeaderAndShortTxIDs& compactBlock, const CTxMemPool& mempool)
+{
+    const size_t transactionCount = compactBlock.BlockTransactionCount();
+    if (compactBlock.header.IsNull() || transactionCount == 0)
+        return CompactBlockReadStatus::INVALID;
+    if (transactionCount > MAX_BLOCK_SIZE_CURRENT / MIN_SERIALIZED_TRANSACTION_SIZE)
+        return CompactBlockReadStatus::INVALID;
+
+    header_ = compactBlock.header;
+    vchBlockSig_ = compactBlock.vchBlockSig;
+    transactions_.assign(transactionCount, CTransaction());
+    available_.assign(transactionCount, false);
+    prefilledCount_ = 0;
+    mempoolCount_ = 0;
+
+    for (const PrefilledTransaction& prefilled: compactBlock.prefilledTransactions)
+    {
+        if (prefilled.index >= transactionCount || available_[prefilled.index])
+            return CompactBlockReadStatus::INVALID;
+        transactions_[prefilled.index] = prefilled.tx;
+        available_[prefilled.index] = true;
+        ++prefilledCount_;
+    }
+
+    // Short ids are assigned, in order, to the positions not taken by prefilled transactions
+    std::unordered_map<uint64_t, size_t> positionByShortId;
+    positionByShortId.reserve(compactBlock.shortTxIds.size());
+    size_t position = 0;
+    for (uint64_t shortTxId: compactBlock.shortTxIds)
+    {
+        while (available_[position]) ++position;
+        if (!positionByShortId.emplace(shortTxId, position).second)
+        {
+            // Two transactions of the block collide; only the full block can resolve that
+            return CompactBlockReadStatus::FAILED;
+        }
+        ++position;
+    }
+
+    std::vector<bool> filledFromMempool(transactionCount, false);
+    {
+        LOCK(mempool.cs);
+        for (const auto& mempoolEntryByHash: mempool.mapTx)
+        {
+            const auto it = positionByShortId.find(compactBlock.GetShortID(mempoolEntryByHash.first));
+            if (it == positionByShortId.end())
+                continue;
+
+            const size_t matchedPosition = it->second;
+            if (!filledFromMempool[matchedPosition])
+            {
+                transactions_[matchedPosition] = mempoolEntryByHash.second.GetTx();
+                available_[matchedPosition] = true;
+                filledFromMempool[matchedPosition] = true;
+                ++mempoolCount_;
+            }
+            else
+            {
+                // Ambiguous match; ask the peer for this one rather than guess
+                transactions_[matchedPosition] = CTransaction();
+                available_[matchedPosition] = false;
+                positionByShortId.erase(it);
+                --mempoolCount_;
+            }
+            if (mempoolCount_ == positionByShortId.size())
+                break;
+        }
+    }
+    return CompactBlockReadStatus::OK;
+}
+
+bool PartiallyDownloadedBlock::IsTxAvailable(size_t index) const
+{
+    return index < available_.size() && available_[index];
+}
+
+std::vector<uint16_t> PartiallyDownloadedBlock::GetMissingTransactionIndexes() const
+{
+    std::vector<uint16_t> missingIndexes;
+    for (size_t index = 0; index < available_.size(); ++index)
+    {
+        if (!available_[index])
+            missingIndexes.push_back(static_cast<uint16_t>(index));
+    }
+    return missingIndexes;
+}
+
+CompactBlockReadStatus PartiallyDownloadedBlock::FillBlock(CBlock& block, const std::vector<CTransaction>& missingTransactions) const
+{
+    if (!IsInitialized())
+        return CompactBlockReadStatus::INVALID;
+
+    block = CBlock(header_);
+    block.vtx = transactions_;
+    block.vchBlockSig = vchBlockSig_;
+    size_t nextMissingTransaction = 0;
+    for (size_t index = 0; index < available_.size(); ++index)
+    {
+        if (available_[index])
+            continue;
+        if (nextMissingTransaction >= missingTransactions.size())
+            return CompactBlockReadStatus::INVALID;
+        block.vtx[index] = missingTransactions[nextMissingTransaction++];
+    }
+    if (nextMissingTransaction != missingTransactions.size())
+        return CompactBlockReadStatus::INVALID;
+
+    // A mismatch is most likely a short id collision with an unrelated mempool transaction
+    bool mutated = false;
+    if (block.BuildMerkleTree(&mutated) != header_.hashMerkleRoot || mutated)
+        return CompactBlockReadStatus::FAILED;
+    return CompactBlockReadStatus::OK;
+}
+
+uint256 PartiallyDownloadedBlock::GetBlockHash() const
+{
+    return header_.GetHash();
+}
+
+bool PartiallyDownloadedBlock::IsInitialized() const
+{
+    return !header_.IsNull() && !transactions_.empty();
+}
+
+size_t PartiallyDownloadedBlock::PrefilledTransactionCount() const
+{
+    return prefilledCount_;
+}
+
+size_t PartiallyDownloadedBlock::MempoolTransactionCount() const
+{
+    return mempoolCount_;
+}
@@ -0,0 +1,200 @@
+#ifndef COMPACT_BLOCK_H
+#define COMPACT_BLOCK_H
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+#include <serialize.h>
+#include <uint256.h>
+
+#include <ios>
+#include <limits>
+#include <stdint.h>
+#include <vector>
+
+class CTxMemPool;
+
+/** Version of the compact block protocol negotiated through sendcmpct */
+constexpr uint64_t COMPACT_BLOCKS_VERSION = 1;
+/** Number of bytes of a SipHash-2-4 digest that are relayed per transaction */
+constexpr unsigned SHORT_TXID_LENGTH = 6;
+
+template <typename Stream>
+inline void SerReadWriteCompactSize(Stream& s, uint64_t& size, CSerActionSerialize)
+{
+    WriteCompactSize(s, size);
+}
+template <typename Stream>
+inline void SerReadWriteCompactSize(Stream& s, uint64_t& size, CSerActionUnserialize)
+{
+    size = ReadCompactSize(s);
+}
+
+/** A transaction sent along with the compact block, because the receiver cannot
+ *  be expected to have it (the coinbase, and for proof-of-stake blocks the coinstake).
+ */
+struct PrefilledTransaction
+{
+    //! Position of the transaction within the block
+    uint16_t index;
+    CTransaction tx;
+
+    PrefilledTransaction(): index(0), tx()
+    {
+    }
+    PrefilledTransaction(uint16_t indexValue, const CTransaction& txValue): index(indexValue), tx(txValue)
+    {
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        uint64_t compactIndex = index;
+        SerReadWriteCompactSize(s, compactIndex, ser_action);
+        if (compactIndex > std::numeric_limits<uint16_t>::max())
+            throw std::ios_base::failure("index overflowed 16 bits");
+        index = static_cast<uint16_t>(compactIndex);
+        READWRITE(tx);
+    }
+};
+
+/** The cmpctblock payload: the block header and signature, the transactions the
+ *  receiver is unlikely to have and a short id for every other transaction.
+ *  Short ids are keyed per block by a sender chosen nonce, so that collisions
+ *  cannot be precomputed against every peer at once.
+ */
+class CBlockHeaderAndShortTxIDs
+{
+private:
+    mutable uint64_t shortIdKey0_;
+    mutable uint64_t shortIdKey1_;
+
+    void FillShortTxIDSelector() const;
+public:
+    CBlockHeader header;
+    uint64_t nonce;
+    std::vector<uint64_t> shortTxIds;
+    std::vector<PrefilledTransaction> prefilledTransactions;
+    std::vector<unsigned char> vchBlockSig;
+
+    CBlockHeaderAndShortTxIDs();
+    CBlockHeaderAndShortTxIDs(const CBlock& block, uint64_t nonceValue);
+
+    uint64_t GetShortID(const uint256& txHash) const;
+    size_t BlockTransactionCount() const;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(header);
+        READWRITE(nonce);
+
+        uint64_t shortTxIdCount = shortTxIds.size();
+        SerReadWriteCompactSize(s, shortTxIdCount, ser_action);
+        if (ser_action.ForRead()) {
+            if (shortTxIdCount > MAX_BLOCK_SIZE_CURRENT / SHORT_TXID_LENGTH)
+                throw std::ios_base::failure("too many short transaction ids");
+            shortTxIds.resize(shortTxIdCount);
+        }
+        for (uint64_t& shortTxId: shortTxIds) {
+            uint32_t lowBits = static_cast<uint32_t>(shortTxId);
+            uint16_t highBits = static_cast<uint16_t>(shortTxId >> 32);
+            READWRITE(lowBits);
+            READWRITE(highBits);
+            shortTxId = (static_cast<uint64_t>(highBits) << 32) | lowBits;
+        }
+
+        READWRITE(prefilledTransactions);
+        READWRITE(vchBlockSig);
+        if (ser_action.ForRead())
+            FillShortTxIDSelector();
+    }
+};
+
+/** The getblocktxn payload: positions of the transactions a receiver could not
+ *  find while reconstructing a compact block.
+ */
+struct BlockTransactionsRequest
+{
+    uint256 blockhash;
+    std::vector<uint16_t> indexes;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(blockhash);
+        uint64_t indexCount = indexes.size();
+        SerReadWriteCompactSize(s, indexCount, ser_action);
+        if (ser_action.ForRead()) {
+            if (indexCount > MAX_BLOCK_SIZE_CURRENT / SHORT_TXID_LENGTH)
+                throw std::ios_base::failure("too many requested transactions");
+            indexes.resize(indexCount);
+        }
+        for (uint16_t& index: indexes) {
+            uint64_t compactIndex = index;
+            SerReadWriteCompactSize(s, compactIndex, ser_action);
+            if (compactIndex > std::numeric_limits<uint16_t>::max())
+                throw std::ios_base::failure("index overflowed 16 bits");
+            index = static_cast<uint16_t>(compactIndex);
+        }
+    }
+};
+
+/** The blocktxn payload answering a BlockTransactionsRequest, in request order */
+struct BlockTransactions
+{
+    uint256 blockhash;
+    std::vector<CTransaction> txn;
+
+    BlockTransactions(): blockhash(), txn()
+    {
+    }
+    explicit BlockTransactions(const BlockTransactionsRequest& request): blockhash(request.blockhash), txn(request.indexes.size())
+    {
+    }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(blockhash);
+        READWRITE(txn);
+    }
+};
+
+enum class CompactBlockReadStatus
+{
+    OK,
+    //! The compact block or the transactions supplied for it are malformed
+    INVALID,
+    //! Reconstruction did not work out (e.g. a short id collision); fetch the full block instead
+    FAILED,
+};
+
+/** Rebuilds a block from a compact block, the local mempool and, if
+ *  needed, the transactions sent in a blocktxn message.
+ */
+class PartiallyDownloadedBlock
+{
+private:
+    std::vector<CTransaction> transactions_;
+    std::vector<bool> available_;
+    CBlockHeader header_;
+    std::vector<unsigned char> vchBlockSig_;
+    size_t prefilledCount_;
+    size_t mempoolCount_;
+public:
+    PartiallyDownloadedBlock();
+
+    CompactBlockReadStatus InitData(const CBlockHeaderAndShortTxIDs& compactBlock, const CTxMemPool& mempool);
+    bool IsTxAvailable(size_t index) const;
+    std::vector<uint16_t> GetMissingTransactionIndexes() const;
+    /** Fills the remaining gaps in order from missingTransactions and checks the merkle root */
+    CompactBlockReadStatus FillBlock(CBlock& block, const std::vector<CTransaction>& missingTransactions) const;
+    uint256 GetBlockHash() const;
+    bool IsInitialized() const;
+    size_t PrefilledTransactionCount() const;
+    size_t MempoolTransactionCount() const;
+};
+#endif// COMPACT_BLOCK_H
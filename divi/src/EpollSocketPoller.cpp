@@ -0,0 +1,175 @@
+#include <EpollSocketPoller.h>
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <Logging.h>
+#include <netbase.h>
+#include <utiltime.h>
+
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr size_t INITIAL_EVENT_BATCH_SIZE = 64;
+constexpr size_t MAX_EVENT_BATCH_SIZE = 4096;
+}
+
+EpollSocketPoller::EpollSocketPoller(
+    ): epollFd_(epoll_create1(EPOLL_CLOEXEC))
+    , wakeupFd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , registeredEventsBySocket_()
+    , readyEventsBySocket_()
+    , readySockets_()
+    , events_(INITIAL_EVENT_BATCH_SIZE)
+{
+    if (epollFd_ < 0)
+        LogPrintf("%s: epoll_create1 failed: %s\n", __func__, NetworkErrorString(errno));
+    if (wakeupFd_ < 0)
+    {
+        LogPrintf("%s: eventfd failed: %s\n", __func__, NetworkErrorString(errno));
+    }
+    else if (epollFd_ >= 0)
+    {
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.fd = wakeupFd_;
+        if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeupFd_, &event) != 0)
+            LogPrintf("%s: epoll_ctl failed for the wake-up descriptor: %s\n", __func__, NetworkErrorString(errno));
+    }
+}
+EpollSocketPoller::~EpollSocketPoller()
+{
+    if (wakeupFd_ >= 0)
+        close(wakeupFd_);
+    if (epollFd_ >= 0)
+        close(epollFd_);
+}
+bool EpollSocketPoller::IsValid() const
+{
+    return epollFd_ >= 0;
+}
+
+void EpollSocketPoller::SetInterest(SOCKET hSocket, bool send, bool receive)
+{
+    // EPOLLERR and EPOLLHUP are always reported for registered sockets
+    const uint32_t events = (send? EPOLLOUT: 0u) | (receive? EPOLLIN: 0u);
+    const auto it = registeredEventsBySocket_.find(hSocket);
+    if (it != registeredEventsBySocket_.end() && it->second == events)
+        return;
+
+    struct epoll_event event;
+    event.events = events;
+    event.data.fd = hSocket;
+    const int operation = it != registeredEventsBySocket_.end()? EPOLL_CTL_MOD: EPOLL_CTL_ADD;
+    int result = epoll_ctl(epollFd_, operation, hSocket, &event);
+    if (result != 0 && operation == EPOLL_CTL_MOD && errno == ENOENT)
+    {
+        // The descriptor was closed (removing it from the epoll set) and has since been reused
+        result = epoll_ctl(epollFd_, EPOLL_CTL_ADD, hSocket, &event);
+    }
+    else if (result != 0 && operation == EPOLL_CTL_ADD && errno == EEXIST)
+    {
+        result = epoll_ctl(epollFd_, EPOLL_CTL_MOD, hSocket, &event);
+    }
+    if (result != 0)
+    {
+        LogPrint("net", "%s: epoll_ctl failed for socket %d: %s\n", __func__, hSocket, NetworkErrorString(errno));
+        registeredEventsBySocket_.erase(hSocket);
+        return;
+    }
+    registeredEventsBySocket_[hSocket] = events;
+}
+void EpollSocketPoller::RemoveSocket(SOCKET hSocket)
+{
+    if (registeredEventsBySocket_.erase(hSocket) == 0u)
+        return;
+    // Closed descriptors are dropped by the kernel already, so a failure here is expected and harmless
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, hSocket, nullptr);
+    readyEventsBySocket_.erase(hSocket);
+}
+const std::vector<SOCKET>& EpollSocketPoller::ReadySockets() const
+{
+    return readySockets_;
+}
+bool EpollSocketPoller::IsReadyFor(SOCKET hSocket, uint32_t events) const
+{
+    const auto it = readyEventsBySocket_.find(hSocket);
+    return it != readyEventsBySocket_.end() && (it->second & events) != 0u;
+}
+bool EpollSocketPoller::IsReadyForErrors(SOCKET hSocket) const
+{
+    return IsReadyFor(hSocket, EPOLLERR | EPOLLHUP);
+}
+bool EpollSocketPoller::IsReadyForSend(SOCKET hSocket) const
+{
+    return IsReadyFor(hSocket, EPOLLOUT);
+}
+bool EpollSocketPoller::IsReadyForReceive(SOCKET hSocket) const
+{
+    // A hang-up is reported as readable, matching select(), so the next recv sees the EOF
+    return IsReadyFor(hSocket, EPOLLIN | EPOLLHUP);
+}
+
+int EpollSocketPoller::PollSockets(int timeoutInMilliseconds)
+{
+    readyEventsBySocket_.clear();
+    readySockets_.clear();
+    const int numberOfEvents = epoll_wait(epollFd_, events_.data(), events_.size(), timeoutInMilliseconds);
+    if (numberOfEvents < 0)
+        return SOCKET_ERROR;
+
+    int numberOfReadySockets = numberOfEvents;
+    readyEventsBySocket_.reserve(numberOfEvents);
+    for (int eventIndex = 0; eventIndex < numberOfEvents; ++eventIndex)
+    {
+        const struct epoll_event& event = events_[eventIndex];
+        if (event.data.fd == wakeupFd_)
+        {
+            DrainWakeups();
+            --numberOfReadySockets;
+            continue;
+        }
+        uint32_t& readyEvents = readyEventsBySocket_[event.data.fd];
+        if (readyEvents == 0u)
+            readySockets_.push_back(event.data.fd);
+        readyEvents |= event.events;
+    }
+    // Sockets that did not fit into this batch remain ready and are reported next round
+    if (static_cast<size_t>(numberOfEvents) == events_.size() && events_.size() < MAX_EVENT_BATCH_SIZE)
+        events_.resize(events_.size() * 2);
+    return numberOfReadySockets;
+}
+void EpollSocketPoller::HandlePollingFailure(int timeoutInMilliseconds)
+{
+    int nErr = errno;
+    if (nErr == EINTR)
+        return;
+    LogPrintf("socket epoll_wait error %s\n", NetworkErrorString(nErr));
+    MilliSleep(timeoutInMilliseconds);
+}
+bool EpollSocketPoller::CanPollSocket(SOCKET hSocket) const
+{
+    return hSocket != INVALID_SOCKET;
+}
+std::string EpollSocketPoller::BackendName() const
+{
+    return "epoll";
+}
+void EpollSocketPoller::Wakeup()
+{
+    if (wakeupFd_ < 0)
+        return;
+    // Fails only when the counter is about to overflow, in which case a wake-up is pending anyway
+    const uint64_t increment = 1u;
+    if (write(wakeupFd_, &increment, sizeof(increment)) < 0 && errno != EAGAIN)
+        LogPrint("net", "%s: eventfd write failed: %s\n", __func__, NetworkErrorString(errno));
+}
+void EpollSocketPoller::DrainWakeups()
+{
+    // A single read resets the counter, however many wake-ups were requested
+    uint64_t counter = 0u;
+    if (read(wakeupFd_, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+        LogPrint("net", "%s: eventfd read failed: %s\n", __func__, NetworkErrorString(errno));
+}
+#endif// HAVE_SYS_EPOLL_H
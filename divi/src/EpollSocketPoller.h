@@ -0,0 +1,49 @@
+#ifndef EPOLL_SOCKET_POLLER_H
+#define EPOLL_SOCKET_POLLER_H
+#if defined(HAVE_CONFIG_H)
+#include "config/divi-config.h"
+#endif
+
+#ifdef HAVE_SYS_EPOLL_H
+#include <I_SocketPoller.h>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include <sys/epoll.h>
+
+/** Linux epoll based poller.
+ *  Sockets stay registered with the kernel across rounds; epoll_ctl is only issued
+ *  when the interest of a socket changes, and a round only reports ready sockets.
+ *  An eventfd registered alongside the sockets lets other threads cut a round short.
+ */
+class EpollSocketPoller final: public I_SocketPoller
+{
+private:
+    int epollFd_;
+    int wakeupFd_;
+    std::unordered_map<SOCKET, uint32_t> registeredEventsBySocket_;
+    std::unordered_map<SOCKET, uint32_t> readyEventsBySocket_;
+    std::vector<SOCKET> readySockets_;
+    std::vector<struct epoll_event> events_;
+
+    bool IsReadyFor(SOCKET hSocket, uint32_t events) const;
+    void DrainWakeups();
+public:
+    EpollSocketPoller();
+    ~EpollSocketPoller();
+    bool IsValid() const;
+
+    virtual void SetInterest(SOCKET hSocket, bool send, bool receive);
+    virtual void RemoveSocket(SOCKET hSocket);
+    virtual int PollSockets(int timeoutInMilliseconds);
+    virtual const std::vector<SOCKET>& ReadySockets() const;
+    virtual bool IsReadyForErrors(SOCKET hSocket) const;
+    virtual bool IsReadyForSend(SOCKET hSocket) const;
+    virtual bool IsReadyForReceive(SOCKET hSocket) const;
+    virtual void HandlePollingFailure(int timeoutInMilliseconds);
+    virtual bool CanPollSocket(SOCKET hSocket) const;
+    virtual std::string BackendName() const;
+    virtual void Wakeup();
+};
+#endif// HAVE_SYS_EPOLL_H
+#endif// EPOLL_SOCKET_POLLER_H
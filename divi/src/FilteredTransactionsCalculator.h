@@ -15,6 +15,21 @@ enum TxFlag
     CONFIRMED_AND_IMMATURE = CONFIRMED | IMMATURE,
 };
 
+/** Depth and maturity of a transaction at the given depth as a combination of TxFlags,
+ *  or 0 if it counts towards no balance: it is conflicted, or it is a block reward
+ *  outside the active chain. A transaction matches a filter if it carries all its flags. */
+inline int GetDepthAndMaturityFlags(
+    const I_MerkleTxConfirmationNumberCalculator& confsCalculator,
+    const CWalletTx& tx,
+    int depth)
+{
+    if(depth < 0) return 0;
+    if(depth < 1 && (tx.IsCoinStake() || tx.IsCoinBase())) return 0;
+    const int confirmationFlag = depth == 0? TxFlag::UNCONFIRMED: TxFlag::CONFIRMED;
+    const int maturityFlag = confsCalculator.GetBlocksToMaturity(tx) > 0? TxFlag::IMMATURE: TxFlag::MATURE;
+    return confirmationFlag | maturityFlag;
+}
+
 template<typename CalculationResult>
 class FilteredTransactionsCalculator
 {
@@ -23,6 +38,8 @@ private:
     const I_MerkleTxConfirmationNumberCalculator& confsCalculator_;
     const I_TransactionDetailCalculator<CalculationResult>& txDetailCalculator_;
 
+    bool transactionMatches(TxFlag flag, const CWalletTx& tx) const;
+
 public:
     FilteredTransactionsCalculator(
         const I_AppendOnlyTransactionRecord& txRecord,
@@ -35,6 +52,12 @@ public:
         TxFlag flag,
         const UtxoOwnershipFilter& ownershipFilter,
         CalculationResult& initialValue) const;
+    /** As above, but only looking at the given subset of the record's transactions */
+    void applyCalculationToMatchingTransactions(
+        TxFlag flag,
+        const UtxoOwnershipFilter& ownershipFilter,
+        const std::vector<const CWalletTx*>& candidateTransactions,
+        CalculationResult& initialValue) const;
 };
 
 template <typename CalculationResult>
@@ -54,10 +77,7 @@ FilteredTransactionsCalculator<CalculationResult>::~FilteredTransactionsCalculat
 }
 
 template <typename CalculationResult>
-void FilteredTransactionsCalculator<CalculationResult>::applyCalculationToMatchingTransactions(
-    TxFlag flag,
-    const UtxoOwnershipFilter& ownershipFilter,
-    CalculationResult& initialValue) const
+bool FilteredTransactionsCalculator<CalculationResult>::transactionMatches(TxFlag flag, const CWalletTx& tx) const
 {
     assert((flag & TxFlag::UNCONFIRMED & TxFlag::CONFIRMED) == 0);
     assert((flag & TxFlag::IMMATURE & TxFlag::MATURE) == 0);
@@ -65,19 +85,36 @@ void FilteredTransactionsCalculator<CalculationResult>::applyCalculationToMatchi
     assert((flag & TxFlag::UNCONFIRMED & TxFlag::IMMATURE) == 0);
     // Unconfirmed transactions that are not conflicted are mature.
     assert((flag & TxFlag::UNCONFIRMED & TxFlag::MATURE) == 0);
+    const int txFlags = GetDepthAndMaturityFlags(confsCalculator_, tx, confsCalculator_.GetNumberOfBlockConfirmations(tx));
+    return txFlags != 0 && (txFlags & flag) == flag;
+}
+
+template <typename CalculationResult>
+void FilteredTransactionsCalculator<CalculationResult>::applyCalculationToMatchingTransactions(
+    TxFlag flag,
+    const UtxoOwnershipFilter& ownershipFilter,
+    CalculationResult& initialValue) const
+{
     for(const auto& txidAndTransaction: txRecord_.GetWalletTransactions())
     {
         const CWalletTx& tx = txidAndTransaction.second;
-        const int depth = confsCalculator_.GetNumberOfBlockConfirmations(tx);
-        if(depth < 0) continue;
-        if(depth < 1 && (tx.IsCoinStake() || tx.IsCoinBase())) continue;
-        if( (flag & TxFlag::UNCONFIRMED) > 0 && depth != 0) continue;
-        if( (flag & TxFlag::CONFIRMED) > 0 && depth < 1) continue;
-        if( (flag & TxFlag::MATURE) > 0 && confsCalculator_.GetBlocksToMaturity(tx) > 0) continue;
-        if( (flag & TxFlag::IMMATURE) > 0 && confsCalculator_.GetBlocksToMaturity(tx) == 0) continue;
-
+        if(!transactionMatches(flag, tx)) continue;
         txDetailCalculator_.calculate(tx, ownershipFilter,initialValue);
     }
 }
 
+template <typename CalculationResult>
+void FilteredTransactionsCalculator<CalculationResult>::applyCalculationToMatchingTransactions(
+    TxFlag flag,
+    const UtxoOwnershipFilter& ownershipFilter,
+    const std::vector<const CWalletTx*>& candidateTransactions,
+    CalculationResult& initialValue) const
+{
+    for(const CWalletTx* tx: candidateTransactions)
+    {
+        if(!transactionMatches(flag, *tx)) continue;
+        txDetailCalculator_.calculate(*tx, ownershipFilter,initialValue);
+    }
+}
+
 #endif//FILTERED_TRANSACTION_CALCULATOR_H
\ No newline at end of file
@@ -1,14 +1,24 @@
 #ifndef I_COMMUNICATION_CHANNEL_H
 #define I_COMMUNICATION_CHANNEL_H
 #include <cstdlib>
+#include <vector>
+struct DataBufferView
+{
+    const void* data;
+    size_t len;
+};
 class I_CommunicationChannel
 {
 public:
     virtual ~I_CommunicationChannel(){}
     virtual int sendData(const void* buffer, size_t len) const = 0;
+    /** Sends the buffers back to back, returning the total number of bytes accepted */
+    virtual int sendDataBuffers(const std::vector<DataBufferView>& buffers) const = 0;
     virtual int receiveData(void* buffer, size_t len) const = 0;
     virtual void close() = 0;
     virtual bool isValid() const = 0;
     virtual bool hasErrors(bool logErrors) const = 0;
+    /** Called when a send left data queued, so that whoever polls the channel watches it for writability */
+    virtual void notifySendBacklog() const {}
 };
 #endif// I_COMMUNICATION_CHANNEL_H
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef I_JSON_WRITER_H
+#define I_JSON_WRITER_H
+#include <json/json_spirit_value.h>
+
+#include <string>
+
+#include <boost/function.hpp>
+
+/** Receives a JSON document piece by piece, so large documents can be produced
+ *  without first building the whole json_spirit tree.
+ */
+class I_JsonWriter
+{
+public:
+    virtual ~I_JsonWriter(){}
+
+    virtual void BeginObject() = 0;
+    virtual void EndObject() = 0;
+    virtual void BeginArray() = 0;
+    virtual void EndArray() = 0;
+    /** Names the next value written inside an object */
+    virtual void Key(const std::string& key) = 0;
+    /** Writes a complete value, which may itself be an object or array */
+    virtual void Write(const json_spirit::Value& value) = 0;
+    /** Writes a complete value that is already serialized as JSON */
+    virtual void WriteRaw(const std::string& serializedJson) = 0;
+
+    void WriteField(const std::string& key, const json_spirit::Value& value)
+    {
+        Key(key);
+        Write(value);
+    }
+};
+
+/** Writes one complete JSON value; must not throw once it has started writing */
+typedef boost::function<void(I_JsonWriter&)> JsonProducer;
+#endif// I_JSON_WRITER_H
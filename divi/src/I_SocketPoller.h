@@ -0,0 +1,29 @@
+#ifndef I_SOCKET_POLLER_H
+#define I_SOCKET_POLLER_H
+#include <compat.h>
+#include <string>
+#include <vector>
+
+/** Readiness notification backend for the socket handler thread.
+ *  A socket stays registered, with the interest last set for it, until it is removed;
+ *  errors and hang-ups are reported regardless of interest. After PollSockets,
+ *  ReadySockets lists the sockets that had events and the IsReadyFor* queries say which.
+ */
+class I_SocketPoller
+{
+public:
+    virtual ~I_SocketPoller(){}
+    virtual void SetInterest(SOCKET hSocket, bool send, bool receive) = 0;
+    virtual void RemoveSocket(SOCKET hSocket) = 0;
+    virtual int PollSockets(int timeoutInMilliseconds) = 0;
+    virtual const std::vector<SOCKET>& ReadySockets() const = 0;
+    virtual bool IsReadyForErrors(SOCKET hSocket) const = 0;
+    virtual bool IsReadyForSend(SOCKET hSocket) const = 0;
+    virtual bool IsReadyForReceive(SOCKET hSocket) const = 0;
+    virtual void HandlePollingFailure(int timeoutInMilliseconds) = 0;
+    virtual bool CanPollSocket(SOCKET socket) const = 0;
+    virtual std::string BackendName() const = 0;
+    /** Makes a PollSockets in progress, or else the next one, return early; safe to call from any thread */
+    virtual void Wakeup() = 0;
+};
+#endif// I_SOCKET_POLLER_H
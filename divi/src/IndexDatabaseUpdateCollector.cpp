@@ -5,7 +5,8 @@
 #include <spentindex.h>
 #include <primitives/transaction.h>
 #include <vector>
-#include <coins.h>
+#include <cassert>
+#include <undo.h>
 #include <script/StakingVaultScript.h>
 
 
@@ -40,16 +41,15 @@ namespace Spending
 void CollectUpdatesFromInputs(
     const CTransaction& tx,
     const TransactionLocationReference& txLocationRef,
-    const CCoinsViewCache& view,
+    const CTxUndo& txUndo,
     IndexDatabaseUpdates& indexDatabaseUpdates)
 {
-    if (tx.IsCoinBase()) return;
     if (indexDatabaseUpdates.addressIndexingEnabled_ || indexDatabaseUpdates.spentIndexingEnabled_)
     {
         for (size_t j = 0; j < tx.vin.size(); j++) {
 
             const CTxIn input = tx.vin[j];
-            const CTxOut &prevout = view.GetOutputFor(tx.vin[j]);
+            const CTxOut &prevout = txUndo.vprevout[j].txout;
             HashBytesAndAddressType hashbytesAndAddressType = ComputeHashbytesAndAddressTypeForScript(prevout.scriptPubKey);
             const uint160& hashBytes = hashbytesAndAddressType.first;
             const int& addressType = hashbytesAndAddressType.second;
@@ -101,16 +101,15 @@ namespace ReverseSpending
 static void CollectUpdatesFromInputs(
     const CTransaction& tx,
     const TransactionLocationReference& txLocationReference,
-    const CCoinsViewCache& view,
+    const CTxUndo& txUndo,
     IndexDatabaseUpdates& indexDBUpdates)
 {
-    if (tx.IsCoinBase()) return;
     for( unsigned int txInputIndex = tx.vin.size(); txInputIndex-- > 0;)
     {
         const CTxIn& input = tx.vin[txInputIndex];
         if (indexDBUpdates.addressIndexingEnabled_)
         {
-            const CTxOut &prevout = view.GetOutputFor(input);
+            const CTxOut &prevout = txUndo.vprevout[txInputIndex].txout;
 
             HashBytesAndAddressType hashbytesAndAddressType = ComputeHashbytesAndAddressTypeForScript(prevout.scriptPubKey);
             const uint160& hashBytes = hashbytesAndAddressType.first;
@@ -172,19 +171,27 @@ static void CollectUpdatesFromOutputs(
 void IndexDatabaseUpdateCollector::RecordTransaction(
         const CTransaction& tx,
         const TransactionLocationReference& txLocationRef,
-        const CCoinsViewCache& view,
+        const CTxUndo* txUndo,
         IndexDatabaseUpdates& indexDatabaseUpdates)
 {
-    Spending::CollectUpdatesFromInputs(tx,txLocationRef,view, indexDatabaseUpdates);
+    if (!tx.IsCoinBase())
+    {
+        assert(txUndo && txUndo->vprevout.size() == tx.vin.size());
+        Spending::CollectUpdatesFromInputs(tx,txLocationRef,*txUndo, indexDatabaseUpdates);
+    }
     Spending::CollectUpdatesFromOutputs(tx,txLocationRef,indexDatabaseUpdates);
 }
 
 void IndexDatabaseUpdateCollector::ReverseTransaction(
         const CTransaction& tx,
         const TransactionLocationReference& txLocationRef,
-        const CCoinsViewCache& view,
+        const CTxUndo* txUndo,
         IndexDatabaseUpdates& indexDatabaseUpdates)
 {
     ReverseSpending::CollectUpdatesFromOutputs(tx,txLocationRef,indexDatabaseUpdates);
-    ReverseSpending::CollectUpdatesFromInputs(tx,txLocationRef,view, indexDatabaseUpdates);
-}
\ No newline at end of file
+    if (!tx.IsCoinBase())
+    {
+        assert(txUndo && txUndo->vprevout.size() == tx.vin.size());
+        ReverseSpending::CollectUpdatesFromInputs(tx,txLocationRef,*txUndo, indexDatabaseUpdates);
+    }
+}
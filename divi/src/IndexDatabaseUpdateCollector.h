@@ -6,9 +6,12 @@
 class CScript;
 class CTransaction;
 struct TransactionLocationReference;
-class CCoinsViewCache;
+class CTxUndo;
 struct IndexDatabaseUpdates;
 
+/** Derives the address and spent index entries of a transaction.  The outputs
+ *  it spends are taken from its undo data (null for the coinbase), which is
+ *  what lets the indexes be built long after the block was connected.  */
 class IndexDatabaseUpdateCollector
 {
 private:
@@ -17,12 +20,12 @@ public:
     static void RecordTransaction(
         const CTransaction& tx,
         const TransactionLocationReference& txLocationRef,
-        const CCoinsViewCache& view,
+        const CTxUndo* txUndo,
         IndexDatabaseUpdates& indexDatabaseUpdates);
     static void ReverseTransaction(
         const CTransaction& tx,
         const TransactionLocationReference& txLocationReference,
-        const CCoinsViewCache& view,
+        const CTxUndo* txUndo,
         IndexDatabaseUpdates& indexDBUpdates);
 };
 typedef std::pair<uint160,int> HashBytesAndAddressType;
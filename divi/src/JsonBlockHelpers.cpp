@@ -1,21 +1,29 @@
 #include <JsonBlockHelpers.h>
 
 #include <primitives/block.h>
+#include <BlockDiskAccessor.h>
 #include <chain.h>
+#include <streams.h>
+#include <utilstrencodings.h>
+#include <ChainStateSnapshot.h>
 #include <version.h>
 
+#include <JsonStreamWriter.h>
 #include <JsonTxHelpers.h>
+#include <json/json_spirit_writer_template.h>
 
+#include <cassert>
 
-double GetDifficulty(const CChain& activeChain, const CBlockIndex* blockindex)
+
+namespace
+{
+
+double DifficultyOfBlock(const CBlockIndex* blockindex)
 {
     // Floating point number that is a multiple of the minimum difficulty,
     // minimum difficulty = 1.0.
-    if (blockindex == nullptr) {
-        blockindex = activeChain.Tip();
-        if (blockindex == nullptr)
-            return 1.0;
-    }
+    if (blockindex == nullptr)
+        return 1.0;
 
     int nShift = (blockindex->nBits >> 24) & 0xff;
 
@@ -34,46 +42,82 @@ double GetDifficulty(const CChain& activeChain, const CBlockIndex* blockindex)
     return dDiff;
 }
 
-
-json_spirit::Object blockToJSON(const CChain& activeChain, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+/** Shared by the CChain and ChainStateSnapshot overloads, which offer the same lookups */
+template <typename ChainView>
+void WriteBlockJSON(I_JsonWriter& writer, const ChainView& activeChain, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
 {
-    json_spirit::Object result;
-    result.push_back(json_spirit::Pair("hash", block.GetHash().GetHex()));
+    writer.BeginObject();
+    writer.WriteField("hash", block.GetHash().GetHex());
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (activeChain.Contains(blockindex))
         confirmations = activeChain.Height() - blockindex->nHeight + 1;
-    result.push_back(json_spirit::Pair("confirmations", confirmations));
-    result.push_back(json_spirit::Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(json_spirit::Pair("height", blockindex->nHeight));
-    result.push_back(json_spirit::Pair("version", block.nVersion));
-    result.push_back(json_spirit::Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    result.push_back(json_spirit::Pair("acc_checkpoint", block.nAccumulatorCheckpoint.GetHex()));
-    json_spirit::Array txs;
+    writer.WriteField("confirmations", confirmations);
+    writer.WriteField("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION));
+    writer.WriteField("height", blockindex->nHeight);
+    writer.WriteField("version", block.nVersion);
+    writer.WriteField("merkleroot", block.hashMerkleRoot.GetHex());
+    writer.WriteField("acc_checkpoint", block.nAccumulatorCheckpoint.GetHex());
+    writer.Key("tx");
+    writer.BeginArray();
     BOOST_FOREACH (const CTransaction& tx, block.vtx) {
         if (txDetails) {
             json_spirit::Object objTx;
             TxToJSON(tx, uint256(0), objTx);
-            txs.push_back(objTx);
+            writer.Write(objTx);
         } else
-            txs.push_back(tx.GetHash().GetHex());
+            writer.Write(tx.GetHash().GetHex());
     }
-    result.push_back(json_spirit::Pair("tx", txs));
-    result.push_back(json_spirit::Pair("time", block.GetBlockTime()));
-    result.push_back(json_spirit::Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(json_spirit::Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(json_spirit::Pair("difficulty", GetDifficulty(activeChain, blockindex)));
-    result.push_back(json_spirit::Pair("chainwork", blockindex->nChainWork.GetHex()));
+    writer.EndArray();
+    writer.WriteField("time", block.GetBlockTime());
+    writer.WriteField("nonce", (uint64_t)block.nNonce);
+    writer.WriteField("bits", strprintf("%08x", block.nBits));
+    writer.WriteField("difficulty", DifficultyOfBlock(blockindex));
+    writer.WriteField("chainwork", blockindex->nChainWork.GetHex());
 
     if (blockindex->pprev)
-        result.push_back(json_spirit::Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+        writer.WriteField("previousblockhash", blockindex->pprev->GetBlockHash().GetHex());
     const CBlockIndex* pnext = activeChain.Next(blockindex);
     if (pnext)
-        result.push_back(json_spirit::Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+        writer.WriteField("nextblockhash", pnext->GetBlockHash().GetHex());
 
-    result.push_back(json_spirit::Pair("moneysupply",ValueFromAmount(blockindex->nMoneySupply)));
+    writer.WriteField("moneysupply",ValueFromAmount(blockindex->nMoneySupply));
+    writer.EndObject();
+}
 
-    return result;
+template <typename ChainView>
+json_spirit::Object BlockToJSONForChain(const ChainView& activeChain, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    JsonValueBuilder builder;
+    WriteBlockJSON(builder, activeChain, block, blockindex, txDetails);
+    return builder.GetValue().get_obj();
+}
+
+} // anonymous namespace
+
+double GetDifficulty(const CChain& activeChain, const CBlockIndex* blockindex)
+{
+    return DifficultyOfBlock(blockindex? blockindex: activeChain.Tip());
+}
+
+double GetDifficulty(const ChainStateSnapshot& chainSnapshot, const CBlockIndex* blockindex)
+{
+    return DifficultyOfBlock(blockindex? blockindex: chainSnapshot.Tip());
+}
+
+json_spirit::Object blockToJSON(const CChain& activeChain, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    return BlockToJSONForChain(activeChain, block, blockindex, txDetails);
+}
+
+json_spirit::Object blockToJSON(const ChainStateSnapshot& chainSnapshot, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    return BlockToJSONForChain(chainSnapshot, block, blockindex, txDetails);
+}
+
+void blockToJSON(I_JsonWriter& writer, const ChainStateSnapshot& chainSnapshot, const CBlock& block, const CBlockIndex* blockindex, bool txDetails)
+{
+    WriteBlockJSON(writer, chainSnapshot, block, blockindex, txDetails);
 }
 
 
@@ -88,4 +132,48 @@ json_spirit::Object blockHeaderToJSON(const CBlock& block, const CBlockIndex* bl
     result.push_back(json_spirit::Pair("bits", strprintf("%08x", block.nBits)));
     result.push_back(json_spirit::Pair("nonce", (uint64_t)block.nNonce));
     return result;
-}
\ No newline at end of file
+}
+
+std::shared_ptr<const std::string> RenderBlockResponse(const ChainStateSnapshot& chainSnapshot, const CBlockIndex* blockindex, RenderedResponseCache::Format format)
+{
+    RenderedResponseCache& cache = GetRenderedResponseCache();
+    const uint256 blockHash = blockindex->GetBlockHash();
+    const uint256 chainTip = chainSnapshot.Tip()? chainSnapshot.Tip()->GetBlockHash(): uint256(0);
+    std::shared_ptr<const std::string> rendered = cache.Get(blockHash, format, chainTip);
+    if (rendered)
+        return rendered;
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, blockindex))
+        return nullptr;
+
+    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+    switch (format) {
+    case RenderedResponseCache::BLOCK_JSON:
+    case RenderedResponseCache::BLOCK_JSON_TX_DETAILS:
+        rendered = std::make_shared<const std::string>(RenderJson([&](I_JsonWriter& writer) {
+            WriteBlockJSON(writer, chainSnapshot, block, blockindex, format == RenderedResponseCache::BLOCK_JSON_TX_DETAILS);
+        }));
+        break;
+    case RenderedResponseCache::BLOCK_HEX:
+        ssBlock << block;
+        rendered = std::make_shared<const std::string>(HexStr(ssBlock.begin(), ssBlock.end()));
+        break;
+    case RenderedResponseCache::BLOCK_BINARY:
+        ssBlock << block;
+        rendered = std::make_shared<const std::string>(ssBlock.str());
+        break;
+    case RenderedResponseCache::BLOCK_HEADER_JSON:
+        rendered = std::make_shared<const std::string>(write_string(json_spirit::Value(blockHeaderToJSON(block, blockindex)), false));
+        break;
+    case RenderedResponseCache::BLOCK_HEADER_HEX:
+        ssBlock << block.GetBlockHeader();
+        rendered = std::make_shared<const std::string>(HexStr(ssBlock.begin(), ssBlock.end()));
+        break;
+    default:
+        assert(!"not a block format");
+        return nullptr;
+    }
+    cache.Insert(blockHash, format, chainTip, rendered);
+    return rendered;
+}
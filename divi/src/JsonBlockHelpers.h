@@ -1,10 +1,21 @@
 #ifndef JSON_BLOCK_HELPERS_H
 #define JSON_BLOCK_HELPERS_H
 #include <json/json_spirit.h>
+#include <RenderedResponseCache.h>
+#include <memory>
+#include <string>
 class CBlockIndex;
 class CBlock;
 class CChain;
+class ChainStateSnapshot;
+class I_JsonWriter;
 double GetDifficulty(const CChain& activeChain, const CBlockIndex* blockindex = nullptr);
+double GetDifficulty(const ChainStateSnapshot& chainSnapshot, const CBlockIndex* blockindex = nullptr);
 json_spirit::Object blockToJSON(const CChain& activeChain, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+json_spirit::Object blockToJSON(const ChainStateSnapshot& chainSnapshot, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+void blockToJSON(I_JsonWriter& writer, const ChainStateSnapshot& chainSnapshot, const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
 json_spirit::Object blockHeaderToJSON(const CBlock& block, const CBlockIndex* blockindex);
+/** A block or block header response in one of the block formats, from the response cache
+ *  when possible; nullptr if the block cannot be read from disk */
+std::shared_ptr<const std::string> RenderBlockResponse(const ChainStateSnapshot& chainSnapshot, const CBlockIndex* blockindex, RenderedResponseCache::Format format);
 #endif// JSON_BLOCK_HELPERS_H
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include <JsonStreamWriter.h>
+
+#include <cassert>
+#include <sstream>
+
+#include <json/json_spirit_reader_template.h>
+#include <json/json_spirit_writer_template.h>
+
+JsonStreamWriter::JsonStreamWriter(
+    std::ostream& stream
+    ): stream_(stream)
+    , containerIsEmpty_()
+    , valueFollowsKey_(false)
+{
+}
+
+void JsonStreamWriter::BeginValue()
+{
+    if (valueFollowsKey_)
+    {
+        valueFollowsKey_ = false;
+        return;
+    }
+    if (containerIsEmpty_.empty())
+        return;
+    if (!containerIsEmpty_.back())
+        stream_ << ',';
+    containerIsEmpty_.back() = false;
+}
+
+void JsonStreamWriter::BeginObject()
+{
+    BeginValue();
+    stream_ << '{';
+    containerIsEmpty_.push_back(true);
+}
+
+void JsonStreamWriter::EndObject()
+{
+    assert(!containerIsEmpty_.empty() && !valueFollowsKey_);
+    containerIsEmpty_.pop_back();
+    stream_ << '}';
+}
+
+void JsonStreamWriter::BeginArray()
+{
+    BeginValue();
+    stream_ << '[';
+    containerIsEmpty_.push_back(true);
+}
+
+void JsonStreamWriter::EndArray()
+{
+    assert(!containerIsEmpty_.empty() && !valueFollowsKey_);
+    containerIsEmpty_.pop_back();
+    stream_ << ']';
+}
+
+void JsonStreamWriter::Key(const std::string& key)
+{
+    BeginValue();
+    json_spirit::write_stream(json_spirit::Value(key), stream_, false);
+    stream_ << ':';
+    valueFollowsKey_ = true;
+}
+
+void JsonStreamWriter::Write(const json_spirit::Value& value)
+{
+    BeginValue();
+    json_spirit::write_stream(value, stream_, false);
+}
+
+void JsonStreamWriter::WriteRaw(const std::string& serializedJson)
+{
+    BeginValue();
+    stream_ << serializedJson;
+}
+
+JsonValueBuilder::JsonValueBuilder(
+    ): root_()
+    , openContainers_()
+    , pendingKey_()
+{
+}
+
+json_spirit::Value& JsonValueBuilder::Attach(const json_spirit::Value& value)
+{
+    if (openContainers_.empty())
+    {
+        root_ = value;
+        return root_;
+    }
+    // A container only grows while it is the innermost open one, so pointers to
+    // the enclosing containers stay valid
+    json_spirit::Value& container = *openContainers_.back();
+    if (container.type() == json_spirit::obj_type)
+    {
+        json_spirit::Object& object = container.get_obj();
+        object.push_back(json_spirit::Pair(pendingKey_, value));
+        return object.back().value_;
+    }
+    json_spirit::Array& array = container.get_array();
+    array.push_back(value);
+    return array.back();
+}
+
+void JsonValueBuilder::BeginObject()
+{
+    openContainers_.push_back(&Attach(json_spirit::Object()));
+}
+
+void JsonValueBuilder::EndObject()
+{
+    assert(!openContainers_.empty() && openContainers_.back()->type() == json_spirit::obj_type);
+    openContainers_.pop_back();
+}
+
+void JsonValueBuilder::BeginArray()
+{
+    openContainers_.push_back(&Attach(json_spirit::Array()));
+}
+
+void JsonValueBuilder::EndArray()
+{
+    assert(!openContainers_.empty() && openContainers_.back()->type() == json_spirit::array_type);
+    openContainers_.pop_back();
+}
+
+void JsonValueBuilder::Key(const std::string& key)
+{
+    pendingKey_ = key;
+}
+
+void JsonValueBuilder::Write(const json_spirit::Value& value)
+{
+    Attach(value);
+}
+
+void JsonValueBuilder::WriteRaw(const std::string& serializedJson)
+{
+    json_spirit::Value value;
+    if (!json_spirit::read_string(serializedJson, value))
+        assert(!"WriteRaw expects serialized JSON");
+    Attach(value);
+}
+
+const json_spirit::Value& JsonValueBuilder::GetValue() const
+{
+    return root_;
+}
+
+json_spirit::Value BuildJsonValue(const JsonProducer& producer)
+{
+    JsonValueBuilder builder;
+    producer(builder);
+    return builder.GetValue();
+}
+
+std::string RenderJson(const JsonProducer& producer)
+{
+    std::ostringstream stream;
+    JsonStreamWriter writer(stream);
+    producer(writer);
+    return stream.str();
+}
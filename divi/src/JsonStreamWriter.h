@@ -0,0 +1,59 @@
+#ifndef JSON_STREAM_WRITER_H
+#define JSON_STREAM_WRITER_H
+#include <I_JsonWriter.h>
+
+#include <ostream>
+#include <vector>
+
+/** Serializes straight to an output stream, in the same compact format as
+ *  json_spirit::write_string(value, false).
+ */
+class JsonStreamWriter final: public I_JsonWriter
+{
+private:
+    std::ostream& stream_;
+    std::vector<bool> containerIsEmpty_;
+    bool valueFollowsKey_;
+
+    void BeginValue();
+
+public:
+    explicit JsonStreamWriter(std::ostream& stream);
+
+    void BeginObject() override;
+    void EndObject() override;
+    void BeginArray() override;
+    void EndArray() override;
+    void Key(const std::string& key) override;
+    void Write(const json_spirit::Value& value) override;
+    void WriteRaw(const std::string& serializedJson) override;
+};
+
+/** Collects the pieces back into a json_spirit tree, for callers that need a Value */
+class JsonValueBuilder final: public I_JsonWriter
+{
+private:
+    json_spirit::Value root_;
+    std::vector<json_spirit::Value*> openContainers_;
+    std::string pendingKey_;
+
+    json_spirit::Value& Attach(const json_spirit::Value& value);
+
+public:
+    JsonValueBuilder();
+
+    void BeginObject() override;
+    void EndObject() override;
+    void BeginArray() override;
+    void EndArray() override;
+    void Key(const std::string& key) override;
+    void Write(const json_spirit::Value& value) override;
+    /** Parses the text back into a tree */
+    void WriteRaw(const std::string& serializedJson) override;
+
+    const json_spirit::Value& GetValue() const;
+};
+
+json_spirit::Value BuildJsonValue(const JsonProducer& producer);
+std::string RenderJson(const JsonProducer& producer);
+#endif// JSON_STREAM_WRITER_H
@@ -1,21 +1,15 @@
 #include <MerkleTxConfirmationNumberCalculator.h>
-#include <chain.h>
-#include <blockmap.h>
-#include <sync.h>
+#include <ChainStateSnapshot.h>
 #include <txmempool.h>
 #include <merkletx.h>
 
 MerkleTxConfirmationNumberCalculator::MerkleTxConfirmationNumberCalculator(
-    const CChain& activeChain,
     const BlockMap& blockIndices,
     const int coinbaseConfirmationsForMaturity,
-    const CTxMemPool& mempool,
-    CCriticalSection& mainCS
-    ): activeChain_(activeChain)
-    , blockIndices_(blockIndices)
-    , coinbaseConfirmationsForMaturity_(coinbaseConfirmationsForMaturity)
+    const CTxMemPool& mempool
+    ): coinbaseConfirmationsForMaturity_(coinbaseConfirmationsForMaturity)
     , mempool_(mempool)
-    , mainCS_(mainCS)
+    , activeChainHeights_(blockIndices)
 {
 }
 
@@ -26,23 +20,8 @@ std::pair<const CBlockIndex*,int> MerkleTxConfirmationNumberCalculator::FindConf
         return defaultValue;
 
     // Find the block it claims to be in
-    int depth;
-    CBlockIndex* pindex;
-    {
-        LOCK(mainCS_);
-        BlockMap::const_iterator mi = blockIndices_.find(merkleTx.hashBlock);
-        if (mi == blockIndices_.end())
-        {
-            return defaultValue;
-        }
-        pindex = (*mi).second;
-        if (!pindex || !activeChain_.Contains(pindex))
-        {
-            return defaultValue;
-        }
-        depth = activeChain_.Height() - pindex->nHeight + 1;
-    }
-    return std::make_pair(pindex,depth);
+    activeChainHeights_.updateTip(ChainStateSnapshot::Current()->Tip());
+    return activeChainHeights_.findBlockAndDepth(merkleTx.hashBlock);
 }
 
 int MerkleTxConfirmationNumberCalculator::GetNumberOfBlockConfirmations(const CMerkleTx& merkleTx) const
@@ -0,0 +1,97 @@
+#include <MessageCapture.h>
+
+#include <clientversion.h>
+#include <DataDirectory.h>
+#include <Logging.h>
+#include <protocol.h>
+#include <tinyformat.h>
+#include <version.h>
+
+#include <boost/filesystem.hpp>
+
+CapturedMessage::CapturedMessage(
+    ): nTimeMicros(0)
+    , frame()
+{
+}
+
+MessageCaptureWriter::MessageCaptureWriter(
+    const boost::filesystem::path& path
+    ): file_(fopen(path.string().c_str(), "ab"), SER_DISK, CLIENT_VERSION)
+{
+    if (file_.IsNull())
+        LogPrintf("%s : Failed to open message capture file %s\n", __func__, path.string());
+}
+
+bool MessageCaptureWriter::IsOpen() const
+{
+    return !file_.IsNull();
+}
+
+void MessageCaptureWriter::Write(int64_t nTimeMicros, const CMessageHeader& header, const CDataStream& payload)
+{
+    if (file_.IsNull())
+        return;
+
+    CDataStream frameStream(SER_NETWORK, PROTOCOL_VERSION);
+    frameStream << header;
+    CapturedMessage message;
+    message.nTimeMicros = nTimeMicros;
+    message.frame.reserve(frameStream.size() + payload.size());
+    message.frame.insert(message.frame.end(), frameStream.begin(), frameStream.end());
+    message.frame.insert(message.frame.end(), payload.begin(), payload.end());
+    try {
+        file_ << message;
+    } catch (const std::exception& e) {
+        LogPrintf("%s : Failed to write message capture - %s\n", __func__, e.what());
+        file_.fclose();
+    }
+}
+
+boost::filesystem::path MessageCaptureWriter::PathForPeer(NodeId id, const std::string& addrName)
+{
+    const boost::filesystem::path directory = GetDataDir() / "message_capture";
+    boost::filesystem::create_directories(directory);
+
+    std::string sanitizedAddress = addrName;
+    for (char& character: sanitizedAddress)
+    {
+        if (!isalnum(static_cast<unsigned char>(character)) && character != '.' && character != '-')
+            character = '_';
+    }
+    return directory / strprintf("%d_%s.dat", id, sanitizedAddress);
+}
+
+MessageCaptureReader::MessageCaptureReader(
+    const boost::filesystem::path& path
+    ): file_(fopen(path.string().c_str(), "rb"), SER_DISK, CLIENT_VERSION)
+{
+}
+
+bool MessageCaptureReader::IsOpen() const
+{
+    return !file_.IsNull();
+}
+
+bool MessageCaptureReader::ReadNext(CapturedMessage& message)
+{
+    if (file_.IsNull())
+        return false;
+    try {
+        file_ >> message;
+    } catch (const std::exception&) {
+        file_.fclose();
+        return false;
+    }
+    return true;
+}
+
+std::vector<CapturedMessage> MessageCaptureReader::ReadAll(const boost::filesystem::path& path)
+{
+    std::vector<CapturedMessage> messages;
+    MessageCaptureReader reader(path);
+    CapturedMessage message;
+    while (reader.ReadNext(message))
+        messages.push_back(message);
+    return messages;
+}
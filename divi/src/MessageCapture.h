@@ -0,0 +1,63 @@
+#ifndef MESSAGE_CAPTURE_H
+#define MESSAGE_CAPTURE_H
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <NodeId.h>
+#include <serialize.h>
+#include <streams.h>
+
+#include <boost/filesystem/path.hpp>
+
+class CMessageHeader;
+
+/** A network message as it arrived from a peer: the complete frame (header followed
+ *  by payload) together with the time it was received */
+struct CapturedMessage
+{
+    int64_t nTimeMicros;
+    std::vector<unsigned char> frame;
+
+    CapturedMessage();
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nTimeMicros);
+        READWRITE(frame);
+    }
+};
+
+/** Appends the messages received from one peer to a capture file (-capturemessages) */
+class MessageCaptureWriter
+{
+private:
+    CAutoFile file_;
+
+public:
+    explicit MessageCaptureWriter(const boost::filesystem::path& path);
+    bool IsOpen() const;
+    void Write(int64_t nTimeMicros, const CMessageHeader& header, const CDataStream& payload);
+
+    /** <datadir>/message_capture/<peer id>_<address>.dat; the directory is created if needed */
+    static boost::filesystem::path PathForPeer(NodeId id, const std::string& addrName);
+};
+
+/** Reads back a file written by MessageCaptureWriter */
+class MessageCaptureReader
+{
+private:
+    CAutoFile file_;
+
+public:
+    explicit MessageCaptureReader(const boost::filesystem::path& path);
+    bool IsOpen() const;
+    /** Returns false at the end of the file or at a truncated record */
+    bool ReadNext(CapturedMessage& message);
+
+    static std::vector<CapturedMessage> ReadAll(const boost::filesystem::path& path);
+};
+#endif// MESSAGE_CAPTURE_H
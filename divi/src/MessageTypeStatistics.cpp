@@ -0,0 +1,157 @@
+#include <MessageTypeStatistics.h>
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+/** Commands this node sends or handles; the last entry catches everything else */
+const std::vector<std::string>& TrackedCommands()
+{
+    static const std::vector<std::string> commands = {
+        "addr", "alert", "block", "blocktxn", "cmpctblock", "dseg", "dstx",
+        "filteradd", "filterclear", "filterload", "getaddr", "getblocks",
+        "getblocktxn", "getdata", "getheaders", "getsporks", "headers", "inv",
+        "mempool", "merkleblock", "mnb", "mnget", "mnp", "mnw", "notfound",
+        "ping", "pong", "reject", "sendcmpct", "spork", "sporkcount", "ssc",
+        "tx", "verack", "version",
+        MessageTypeStatistics::OTHER_COMMAND,
+    };
+    return commands;
+}
+
+void StoreMaximum(std::atomic<uint64_t>& maximum, uint64_t value)
+{
+    uint64_t current = maximum.load(std::memory_order_relaxed);
+    while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+    {
+    }
+}
+} // anonymous namespace
+
+const char* const MessageTypeStatistics::OTHER_COMMAND = "*other*";
+
+MessageTypeStatistics::Totals::Totals(
+    ): messagesReceived(0)
+    , bytesReceived(0)
+    , messagesSent(0)
+    , bytesSent(0)
+    , processingMicros(0)
+    , maxProcessingMicros(0)
+{
+    std::fill(processingHistogram, processingHistogram + NUMBER_OF_LATENCY_BUCKETS, 0u);
+}
+
+MessageTypeStatistics::Counters::Counters(
+    ): messagesReceived(0)
+    , bytesReceived(0)
+    , messagesSent(0)
+    , bytesSent(0)
+    , processingMicros(0)
+    , maxProcessingMicros(0)
+{
+    for (std::atomic<uint64_t>& bucket: processingHistogram)
+        bucket.store(0u, std::memory_order_relaxed);
+}
+
+MessageTypeStatistics::MessageTypeStatistics(
+    MessageTypeStatistics* aggregate
+    ): aggregate_(aggregate)
+    , counters_()
+{
+    assert(TrackedCommands().size() <= NUMBER_OF_COMMANDS);
+}
+
+unsigned MessageTypeStatistics::IndexOfCommand(const std::string& command)
+{
+    static const std::unordered_map<std::string, unsigned> indexByCommand = []() {
+        std::unordered_map<std::string, unsigned> index;
+        const std::vector<std::string>& commands = TrackedCommands();
+        for (unsigned position = 0; position < commands.size(); ++position)
+            index[commands[position]] = position;
+        return index;
+    }();
+    const auto it = indexByCommand.find(command);
+    return it != indexByCommand.end()? it->second: TrackedCommands().size() - 1;
+}
+
+const std::string& MessageTypeStatistics::CommandAtIndex(unsigned index)
+{
+    return TrackedCommands()[index];
+}
+
+void MessageTypeStatistics::RecordReceived(const std::string& command, uint64_t bytes)
+{
+    Counters& counters = counters_[IndexOfCommand(command)];
+    counters.messagesReceived.fetch_add(1, std::memory_order_relaxed);
+    counters.bytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+    if (aggregate_)
+        aggregate_->RecordReceived(command, bytes);
+}
+
+void MessageTypeStatistics::RecordSent(const std::string& command, uint64_t bytes)
+{
+    Counters& counters = counters_[IndexOfCommand(command)];
+    counters.messagesSent.fetch_add(1, std::memory_order_relaxed);
+    counters.bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+    if (aggregate_)
+        aggregate_->RecordSent(command, bytes);
+}
+
+void MessageTypeStatistics::RecordProcessingTime(const std::string& command, int64_t micros)
+{
+    const uint64_t elapsed = micros > 0? static_cast<uint64_t>(micros): 0u;
+    Counters& counters = counters_[IndexOfCommand(command)];
+    counters.processingMicros.fetch_add(elapsed, std::memory_order_relaxed);
+    StoreMaximum(counters.maxProcessingMicros, elapsed);
+    counters.processingHistogram[LatencyBucket(elapsed)].fetch_add(1, std::memory_order_relaxed);
+    if (aggregate_)
+        aggregate_->RecordProcessingTime(command, micros);
+}
+
+std::map<std::string, MessageTypeStatistics::Totals> MessageTypeStatistics::GetTotals() const
+{
+    std::map<std::string, Totals> totalsByCommand;
+    for (unsigned index = 0; index < TrackedCommands().size(); ++index)
+    {
+        const Counters& counters = counters_[index];
+        Totals totals;
+        totals.messagesReceived = counters.messagesReceived.load(std::memory_order_relaxed);
+        totals.bytesReceived = counters.bytesReceived.load(std::memory_order_relaxed);
+        totals.messagesSent = counters.messagesSent.load(std::memory_order_relaxed);
+        totals.bytesSent = counters.bytesSent.load(std::memory_order_relaxed);
+        totals.processingMicros = counters.processingMicros.load(std::memory_order_relaxed);
+        totals.maxProcessingMicros = counters.maxProcessingMicros.load(std::memory_order_relaxed);
+        for (unsigned bucket = 0; bucket < NUMBER_OF_LATENCY_BUCKETS; ++bucket)
+            totals.processingHistogram[bucket] = counters.processingHistogram[bucket].load(std::memory_order_relaxed);
+        if (totals.messagesReceived > 0 || totals.messagesSent > 0)
+            totalsByCommand[CommandAtIndex(index)] = totals;
+    }
+    return totalsByCommand;
+}
+
+unsigned MessageTypeStatistics::LatencyBucket(uint64_t micros)
+{
+    unsigned bucket = 0;
+    for (uint64_t upperBound = 10; bucket + 1 < NUMBER_OF_LATENCY_BUCKETS && micros >= upperBound; upperBound *= 10)
+        ++bucket;
+    return bucket;
+}
+
+uint64_t MessageTypeStatistics::LatencyBucketUpperBound(unsigned bucket)
+{
+    if (bucket + 1 >= NUMBER_OF_LATENCY_BUCKETS)
+        return 0u;
+    uint64_t upperBound = 10;
+    for (unsigned exponent = 0; exponent < bucket; ++exponent)
+        upperBound *= 10;
+    return upperBound;
+}
+
+MessageTypeStatistics& MessageTypeStatistics::Global()
+{
+    static MessageTypeStatistics globalStatistics;
+    return globalStatistics;
+}
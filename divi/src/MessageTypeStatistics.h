@@ -0,0 +1,78 @@
+#ifndef MESSAGE_TYPE_STATISTICS_H
+#define MESSAGE_TYPE_STATISTICS_H
+#include <atomic>
+#include <map>
+#include <stdint.h>
+#include <string>
+
+/** Counts of messages, bytes and handler time per network command, kept for each
+ *  peer and summed up over all peers.
+ *
+ *  Every counter is a relaxed atomic so that recording never takes a lock and the
+ *  statistics can stay enabled on busy nodes. Commands outside the protocol's known
+ *  set are counted together under OTHER_COMMAND, so a peer sending random command
+ *  names cannot grow the tables.
+ */
+class MessageTypeStatistics
+{
+public:
+    /** Handler times are also counted in decade buckets: <10us, <100us, ... <1s and the rest */
+    static const unsigned NUMBER_OF_LATENCY_BUCKETS = 7;
+
+    struct Totals
+    {
+        uint64_t messagesReceived;
+        uint64_t bytesReceived;
+        uint64_t messagesSent;
+        uint64_t bytesSent;
+        uint64_t processingMicros;
+        uint64_t maxProcessingMicros;
+        uint64_t processingHistogram[NUMBER_OF_LATENCY_BUCKETS];
+
+        Totals();
+    };
+    static const char* const OTHER_COMMAND;
+
+    /** Everything recorded is also added to aggregate, if given */
+    explicit MessageTypeStatistics(MessageTypeStatistics* aggregate = nullptr);
+
+    /** bytes include the message header */
+    void RecordReceived(const std::string& command, uint64_t bytes);
+    void RecordSent(const std::string& command, uint64_t bytes);
+    void RecordProcessingTime(const std::string& command, int64_t micros);
+
+    /** Totals of every command seen so far, keyed by command */
+    std::map<std::string, Totals> GetTotals() const;
+
+    static unsigned LatencyBucket(uint64_t micros);
+    /** Exclusive upper bound of a bucket, zero for the open-ended last one */
+    static uint64_t LatencyBucketUpperBound(unsigned bucket);
+
+    /** The statistics summed up over all peers */
+    static MessageTypeStatistics& Global();
+
+private:
+    struct Counters
+    {
+        std::atomic<uint64_t> messagesReceived;
+        std::atomic<uint64_t> bytesReceived;
+        std::atomic<uint64_t> messagesSent;
+        std::atomic<uint64_t> bytesSent;
+        std::atomic<uint64_t> processingMicros;
+        std::atomic<uint64_t> maxProcessingMicros;
+        std::atomic<uint64_t> processingHistogram[NUMBER_OF_LATENCY_BUCKETS];
+
+        Counters();
+    };
+    static const unsigned NUMBER_OF_COMMANDS = 40;
+
+    MessageTypeStatistics* const aggregate_;
+    Counters counters_[NUMBER_OF_COMMANDS];
+
+    MessageTypeStatistics(const MessageTypeStatistics&) = delete;
+    MessageTypeStatistics& operator=(const MessageTypeStatistics&) = delete;
+
+    static unsigned IndexOfCommand(const std::string& command);
+    static const std::string& CommandAtIndex(unsigned index);
+};
+#endif// MESSAGE_TYPE_STATISTICS_H
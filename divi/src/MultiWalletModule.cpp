@@ -53,18 +53,15 @@ MultiWalletModule::MultiWalletModule(
     const ChainstateManager& chainstate,
     Settings& settings,
     CTxMemPool& transactionMemoryPool,
-    CCriticalSection& mmainCriticalSection,
     const int coinbaseConfirmationsForMaturity
     ): chainstate_(chainstate)
     , settings_(settings)
     , walletIsDisabled_( settings_.GetBoolArg("-disablewallet", false) )
     , confirmationCalculator_(
         new MerkleTxConfirmationNumberCalculator(
-            chainstate_.ActiveChain(),
             chainstate_.GetBlockMap(),
             coinbaseConfirmationsForMaturity,
-            transactionMemoryPool,
-            mmainCriticalSection) )
+            transactionMemoryPool) )
     , backedWalletsByName_()
     , activeWallet_(nullptr)
 {
@@ -56,7 +56,6 @@ public:
         const ChainstateManager& chainstate,
         Settings& settings,
         CTxMemPool& transactionMemoryPool,
-        CCriticalSection& mmainCriticalSection,
         const int coinbaseConfirmationsForMaturity);
     ~MultiWalletModule();
 
@@ -228,4 +228,20 @@ void EnableBloomFilters()
 bool BloomFiltersAreEnabled()
 {
     return static_cast<bool>(nLocalServices & NODE_BLOOM);
+}
+void EnableCompactBlocks()
+{
+    nLocalServices |= NODE_COMPACT_BLOCKS;
+}
+bool CompactBlocksAreEnabled()
+{
+    return static_cast<bool>(nLocalServices & NODE_COMPACT_BLOCKS);
+}
+void EnableHeadersFirstSync()
+{
+    nLocalServices |= NODE_HEADERS_FIRST;
+}
+bool HeadersFirstSyncIsEnabled()
+{
+    return static_cast<bool>(nLocalServices & NODE_HEADERS_FIRST);
 }
\ No newline at end of file
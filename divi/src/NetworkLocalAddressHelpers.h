@@ -35,6 +35,10 @@ unsigned short GetListenPort();
 const uint64_t& GetLocalServices();
 void EnableBloomFilters();
 bool BloomFiltersAreEnabled();
+void EnableCompactBlocks();
+bool CompactBlocksAreEnabled();
+void EnableHeadersFirstSync();
+bool HeadersFirstSyncIsEnabled();
 bool IsListening();
 void setListeningFlag(bool updatedListenFlag);
 bool isDiscoverEnabled();
@@ -1,6 +1,7 @@
 #include <Node.h>
 
 #include <bloom.h>
+#include <chainparams.h>
 #include <clientversion.h>
 #include <defaultValues.h>
 #include <hash.h>
@@ -22,6 +23,9 @@ uint64_t nLocalHostNonce = 0;
 unsigned int MaxSendBufferSize() { return 1000 * settings.GetArg("-maxsendbuffer", 1 * 1000); }
 unsigned int MaxReceiveBufferSize() { return 1000 * settings.GetArg("-maxreceivebuffer", 5 * 1000); }
 
+/** Number of most recent inventory hashes remembered per peer (about 54kB at a 1e-6 false positive rate) */
+static const unsigned int INVENTORY_KNOWN_FILTER_ELEMENTS = 5000;
+
 CNetMessage::CNetMessage(int nTypeIn, int nVersionIn) : hdrbuf(nTypeIn, nVersionIn), vRecv(nTypeIn, nVersionIn)
 {
     hdrbuf.resize(24);
@@ -242,26 +246,25 @@ void QueuedMessageConnection::CloseCommsChannel()
 void QueuedMessageConnection::SendData()
 {
     AssertLockHeld(cs_vSend);
-    std::deque<CSerializeData>::iterator it = vSendMsg.begin();
-
-    while (it != vSendMsg.end()) {
-        const CSerializeData& data = *it;
-        assert(data.size() > nSendOffset);
-        int nBytes = channel_.sendData(&data[nSendOffset], data.size() - nSendOffset);
-        if (nBytes > 0) {
-            dataLogger_.RecordSentBytes(nBytes);
-            nSendOffset += nBytes;
-            if (nSendOffset == data.size()) {
-                nSendOffset = 0;
-                nSendSize -= data.size();
-                it++;
-            } else {
-                // could not send full message; stop sending more
-                break;
-            }
+    /** Queued messages handed to the channel in one vectored send */
+    constexpr size_t MAX_BUFFERS_PER_SEND = 64;
+
+    std::vector<DataBufferView> buffers;
+    buffers.reserve(std::min(vSendMsg.size(), MAX_BUFFERS_PER_SEND));
+    while (!vSendMsg.empty()) {
+        buffers.clear();
+        size_t bytesToSend = 0;
+        size_t offset = nSendOffset;
+        for (auto it = vSendMsg.begin(); it != vSendMsg.end() && buffers.size() < MAX_BUFFERS_PER_SEND; ++it) {
+            const CSerializeData& data = **it;
+            assert(data.size() > offset);
+            buffers.push_back(DataBufferView{&data[offset], data.size() - offset});
+            bytesToSend += data.size() - offset;
+            offset = 0;
         }
-        else
-        {
+
+        int nBytes = channel_.sendDataBuffers(buffers);
+        if (nBytes <= 0) {
             if (nBytes < 0 && channel_.hasErrors(true))
             {
                 // error
@@ -270,13 +273,29 @@ void QueuedMessageConnection::SendData()
             // couldn't send anything at all
             break;
         }
+
+        dataLogger_.RecordSentBytes(nBytes);
+        size_t bytesSent = static_cast<size_t>(nBytes);
+        while (bytesSent > 0) {
+            const size_t messageSize = vSendMsg.front()->size();
+            const size_t sentOfMessage = std::min(bytesSent, messageSize - nSendOffset);
+            nSendOffset += sentOfMessage;
+            bytesSent -= sentOfMessage;
+            if (nSendOffset == messageSize) {
+                nSendOffset = 0;
+                nSendSize -= messageSize;
+                vSendMsg.pop_front();
+            }
+        }
+        // could not send everything we offered; stop sending more
+        if (static_cast<size_t>(nBytes) < bytesToSend)
+            break;
     }
 
-    if (it == vSendMsg.end()) {
+    if (vSendMsg.empty()) {
         assert(nSendOffset == 0);
         assert(nSendSize == 0);
     }
-    vSendMsg.erase(vSendMsg.begin(), it);
 }
 
 // Requires LOCK(cs_vRecvMsg)
@@ -490,15 +509,36 @@ void QueuedMessageConnection::EndMessage(unsigned int& messageDataSize) UNLOCK_F
     // Set the size
     NetworkMessageSerializer::EndMessage(ssSend,messageDataSize);
 
-    std::deque<CSerializeData>::iterator it = vSendMsg.insert(vSendMsg.end(), CSerializeData());
-    ssSend.GetAndClear(*it);
-    nSendSize += (*it).size();
+    std::shared_ptr<CSerializeData> message = std::make_shared<CSerializeData>();
+    ssSend.GetAndClear(*message);
+    QueueMessageForSending(message);
+
+    LEAVE_CRITICAL_SECTION(cs_vSend);
+}
+
+// requires LOCK(cs_vSend)
+void QueuedMessageConnection::QueueMessageForSending(const SharedSerializedMessage& message)
+{
+    AssertLockHeld(cs_vSend);
+    vSendMsg.push_back(message);
+    nSendSize += message->size();
 
     // If write queue empty, attempt "optimistic write"
-    if (it == vSendMsg.begin())
+    if (vSendMsg.size() == 1u)
+    {
         SendData();
+        if (!vSendMsg.empty())
+            channel_.notifySendBacklog();
+    }
+}
 
-    LEAVE_CRITICAL_SECTION(cs_vSend);
+void QueuedMessageConnection::PushSerializedMessage(const SharedSerializedMessage& message)
+{
+    // The -*messagestest options are not applied here since the buffer may be shared with other peers
+    if (!message || message->empty())
+        return;
+    LOCK(cs_vSend);
+    QueueMessageForSending(message);
 }
 
 std::deque<CNetMessage>& QueuedMessageConnection::GetReceivedMessageQueue()
@@ -533,6 +573,8 @@ CNode::CNode(
     ConnectionFlagBitmask connectionFlags
     ) : fSuccessfullyConnected(false)
     , dataLogger()
+    , messageStatistics_(&MessageTypeStatistics::Global())
+    , messageCapture_()
     , channel_(channel)
     , messageConnection_(channel_,fSuccessfullyConnected,dataLogger)
     , vRecvGetData()
@@ -559,14 +601,15 @@ CNode::CNode(
     , nSporksCount(-1)
     , hashContinue(0)
     , nStartingHeight(-1)
+    , cs_addrRelay()
     , vAddrToSend()
     , setAddrKnown(5000)
     , fGetAddr(false)
     , setKnown()
-    , setInventoryKnown(MaxSendBufferSize() / 1000)
+    , filterInventoryKnown(INVENTORY_KNOWN_FILTER_ELEMENTS, 0.000001)
     , vInventoryToSend()
     , cs_inventory()
-    , mapAskFor()
+    , queueAskFor()
     , vBlockRequested()
     , nPingNonceSent(0)
     , nPingUsecStart(0)
@@ -585,6 +628,9 @@ CNode::CNode(
     nodeState_->name = addrName;
     nodeState_->address = addr;
     nodeSignals_->InitializeNode(*nodeState_);
+
+    if (settings.GetBoolArg("-capturemessages", false))
+        messageCapture_.reset(new MessageCaptureWriter(MessageCaptureWriter::PathForPeer(id, addrName)));
 }
 
 CNode::~CNode()
@@ -597,7 +643,6 @@ CNode::~CNode()
     // Network connections can be unused (nRefCount=0), connected (nRefCount=1), in-use (nRefCount > 1)
     assert(nRefCount<2);
     nodeSignals_->FinalizeNode(id);
-    nodeState_->Finalize();
     nodeState_.reset();
 }
 
@@ -624,6 +669,22 @@ const CommunicationLogger& CNode::GetCommunicationLogger() const
     return dataLogger;
 }
 
+void CNode::CaptureReceivedMessage(const CNetMessage& message)
+{
+    if (messageCapture_)
+        messageCapture_->Write(message.nTime, message.hdr, message.vRecv);
+}
+
+MessageTypeStatistics& CNode::GetMessageStatistics()
+{
+    return messageStatistics_;
+}
+
+const MessageTypeStatistics& CNode::GetMessageStatistics() const
+{
+    return messageStatistics_;
+}
+
 bool CNode::CommunicationChannelIsValid() const
 {
     return channel_.isValid();
@@ -669,17 +730,44 @@ std::deque<CNetMessage>& CNode::GetReceivedMessageQueue()
     return messageConnection_.GetReceivedMessageQueue();
 }
 
-void CNode::LogMessageSize(unsigned int messageDataSize) const
+void CNode::RecordSentMessage(const char* pszCommand, unsigned int messageDataSize)
 {
     LogPrint("net", "(%d bytes) peer=%d\n", messageDataSize, id);
+    messageStatistics_.RecordSent(pszCommand, messageDataSize + CMessageHeader::HEADER_SIZE);
+}
+void CNode::PushSerializedMessage(const SharedSerializedMessage& message)
+{
+    if (!message || message->size() < CMessageHeader::HEADER_SIZE)
+        return;
+    CMessageHeader hdr;
+    CDataStream(message->begin(), message->begin() + CMessageHeader::HEADER_SIZE, SER_NETWORK, PROTOCOL_VERSION) >> hdr;
+    LogPrint("net", "sending: %s (%d bytes, shared) peer=%d\n", SanitizeString(hdr.GetCommand()), hdr.nMessageSize, id);
+    messageStatistics_.RecordSent(hdr.GetCommand(), message->size());
+    messageConnection_.PushSerializedMessage(message);
 }
 
-void CNode::ProcessReceiveMessages(bool& shouldSleep)
+bool CNode::ProcessRequestsAndReceivedMessages()
+{
+    return (!RespondToRequestForData())? true: *(nodeSignals_->ProcessReceivedMessages(this));
+}
+void CNode::ProcessReceiveMessages(bool& shouldSleep, CCriticalSection& sharedMessageStateLock)
 {
     TRY_LOCK(messageConnection_.GetReceiveLock(), lockRecv);
     if (lockRecv)
     {
-        bool result = (!RespondToRequestForData())? true: *(nodeSignals_->ProcessReceivedMessages(this));
+        // Work that only touches this peer (or data guarded by its own locks) may
+        // run alongside other peers; everything else is serialized on the shared lock
+        boost::optional<bool> canProcessConcurrently = nodeSignals_->MessagesCanBeProcessedConcurrently(this);
+        bool result = true;
+        if (canProcessConcurrently && *canProcessConcurrently)
+        {
+            result = ProcessRequestsAndReceivedMessages();
+        }
+        else
+        {
+            LOCK(sharedMessageStateLock);
+            result = ProcessRequestsAndReceivedMessages();
+        }
         if (!result)
             CloseCommsAndDisconnect();
 
@@ -722,8 +810,9 @@ void CNode::RecordRequestForData(std::vector<CInv>& inventoryRequested)
 
 void CNode::HandleRequestForData(std::vector<CInv>& inventoryRequested)
 {
+    // Responses are sent on the next call to ProcessReceiveMessages, which
+    // decides whether the requested items can be served concurrently
     RecordRequestForData(inventoryRequested);
-    RespondToRequestForData();
 }
 
 std::deque<CInv>& CNode::GetRequestForDataQueue()
@@ -840,7 +929,10 @@ void CNode::AdvertizeLocalAddress(int64_t rebroadcastTimestamp)
 
     // Periodically clear setAddrKnown to allow refresh broadcasts
     if (rebroadcastTimestamp > 0)
+    {
+        LOCK(cs_addrRelay);
         setAddrKnown.clear();
+    }
 
     // Rebroadcast our address
     nodeSignals_->AdvertizeLocalAddress(this);
@@ -900,19 +992,20 @@ int CNode::GetRefCount() const
 
 void CNode::AddAddressKnown(const CAddress& addr)
 {
+    LOCK(cs_addrRelay);
     setAddrKnown.insert(addr);
 }
 void CNode::AddInventoryKnown(const CInv& inv)
 {
     {
         LOCK(cs_inventory);
-        setInventoryKnown.insert(inv);
+        filterInventoryKnown.insert(inv.GetHash());
     }
 }
 void CNode::PushInventory(const CInv& inv)
 {
     LOCK(cs_inventory);
-    if (setInventoryKnown.count(inv) == 0)
+    if (!filterInventoryKnown.contains(inv.GetHash()))
         vInventoryToSend.push_back(inv);
 }
 
@@ -923,6 +1016,7 @@ void CNode::PushAddress(const CAddress& addr)
     // Known checking here is only to save space from duplicates.
     // SendMessages will filter it again for knowns that were added
     // after addresses were pushed.
+    LOCK(cs_addrRelay);
     if (addr.IsValid() && !setAddrKnown.count(addr)) {
         if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
             vAddrToSend[FastRandomContext()(vAddrToSend.size())] = addr;
@@ -934,12 +1028,11 @@ void CNode::PushAddress(const CAddress& addr)
 
 void CNode::AskFor(const CInv& inv)
 {
-    /** The maximum number of entries in mapAskFor */
+    /** The maximum number of entries in queueAskFor */
     static const size_t MAPASKFOR_MAX_SZ = MAX_INV_SZ;
-    if (mapAskFor.size() > MAPASKFOR_MAX_SZ)
+    if (queueAskFor.size() > MAPASKFOR_MAX_SZ)
         return;
-    // We're using mapAskFor as a priority queue,
-    // the key is the earliest time the request can be sent
+    // Requests are ordered by the earliest time they can be sent
     int64_t nRequestTime;
     limitedmap<CInv, int64_t>::const_iterator it = mapAlreadyAskedFor.find(inv);
     if (it != mapAlreadyAskedFor.end())
@@ -961,7 +1054,7 @@ void CNode::AskFor(const CInv& inv)
         mapAlreadyAskedFor.update(it, nRequestTime);
     else
         mapAlreadyAskedFor.insert(std::make_pair(inv, nRequestTime));
-    mapAskFor.insert(std::make_pair(nRequestTime, inv));
+    queueAskFor.push(std::make_pair(nRequestTime, inv));
 }
 
 void CNode::SetVersionAndServices(int nodeVersionNumber, uint64_t bitmaskOfNodeServices)
@@ -1082,6 +1175,10 @@ void CNode::ClearInventoryItem(const CInv& inv)
 
 uint64_t NetworkUsageStats::nTotalBytesRecv = 0;
 uint64_t NetworkUsageStats::nTotalBytesSent = 0;
+uint64_t NetworkUsageStats::nMaxOutboundTotalBytesSentInCycle = 0;
+uint64_t NetworkUsageStats::nMaxOutboundCycleStartTime = 0;
+uint64_t NetworkUsageStats::nMaxOutboundLimit = 0;
+uint64_t NetworkUsageStats::nMaxOutboundTimeframe = MAX_UPLOAD_TIMEFRAME;
 CCriticalSection NetworkUsageStats::cs_totalBytesRecv;
 CCriticalSection NetworkUsageStats::cs_totalBytesSent;
 void NetworkUsageStats::RecordBytesRecv(uint64_t bytes)
@@ -1094,6 +1191,15 @@ void NetworkUsageStats::RecordBytesSent(uint64_t bytes)
 {
     LOCK(cs_totalBytesSent);
     nTotalBytesSent += bytes;
+
+    uint64_t now = GetTime();
+    if (nMaxOutboundCycleStartTime + nMaxOutboundTimeframe < now)
+    {
+        // timeframe expired, reset cycle
+        nMaxOutboundCycleStartTime = now;
+        nMaxOutboundTotalBytesSentInCycle = 0;
+    }
+    nMaxOutboundTotalBytesSentInCycle += bytes;
 }
 
 uint64_t NetworkUsageStats::GetTotalBytesRecv()
@@ -1106,4 +1212,78 @@ uint64_t NetworkUsageStats::GetTotalBytesSent()
 {
     LOCK(cs_totalBytesSent);
     return nTotalBytesSent;
+}
+
+void NetworkUsageStats::SetMaxOutboundTarget(uint64_t limit)
+{
+    LOCK(cs_totalBytesSent);
+    nMaxOutboundLimit = limit;
+}
+
+uint64_t NetworkUsageStats::GetMaxOutboundTarget()
+{
+    LOCK(cs_totalBytesSent);
+    return nMaxOutboundLimit;
+}
+
+void NetworkUsageStats::SetMaxOutboundTimeframe(uint64_t timeframe)
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundTimeframe != timeframe)
+    {
+        // start a new measure-cycle in case of changing
+        // the timeframe
+        nMaxOutboundCycleStartTime = GetTime();
+        nMaxOutboundTotalBytesSentInCycle = 0;
+    }
+    nMaxOutboundTimeframe = timeframe;
+}
+
+uint64_t NetworkUsageStats::GetMaxOutboundTimeframe()
+{
+    LOCK(cs_totalBytesSent);
+    return nMaxOutboundTimeframe;
+}
+
+bool NetworkUsageStats::OutboundTargetReached(bool historicalBlockServingLimit)
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundLimit == 0)
+        return false;
+
+    if (historicalBlockServingLimit)
+    {
+        // keep a large enough buffer to at least relay each new block once
+        uint64_t timeLeftInCycle = GetMaxOutboundTimeLeftInCycle();
+        uint64_t buffer = timeLeftInCycle / Params().TargetSpacing() * UPLOAD_TARGET_RESERVE_PER_BLOCK;
+        if (buffer >= nMaxOutboundLimit || nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit - buffer)
+            return true;
+    }
+    else if (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit)
+        return true;
+
+    return false;
+}
+
+uint64_t NetworkUsageStats::GetOutboundTargetBytesLeft()
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundLimit == 0)
+        return 0;
+
+    return (nMaxOutboundTotalBytesSentInCycle >= nMaxOutboundLimit) ? 0 : nMaxOutboundLimit - nMaxOutboundTotalBytesSentInCycle;
+}
+
+uint64_t NetworkUsageStats::GetMaxOutboundTimeLeftInCycle()
+{
+    LOCK(cs_totalBytesSent);
+    if (nMaxOutboundLimit == 0)
+        return 0;
+
+    if (nMaxOutboundCycleStartTime == 0)
+        return nMaxOutboundTimeframe;
+
+    uint64_t cycleEndTime = nMaxOutboundCycleStartTime + nMaxOutboundTimeframe;
+    uint64_t now = GetTime();
+    return (cycleEndTime < now) ? 0 : cycleEndTime - now;
 }
\ No newline at end of file
@@ -10,15 +10,19 @@
 #include <netbase.h>
 #include <uint256.h>
 #include <mruset.h>
+#include <bloom.h>
 #include <stdint.h>
 #include <NodeId.h>
 #include <memory>
 #include <atomic>
+#include <functional>
+#include <queue>
 #include <I_CommunicationChannel.h>
+#include <MessageTypeStatistics.h>
+#include <MessageCapture.h>
 
 #include <boost/thread/condition_variable.hpp>
 
-class CBloomFilter;
 class CNodeSignals;
 class CNodeState;
 class CAddrMan;
@@ -26,6 +30,10 @@ class CAddrMan;
 /** The maximum number of entries in an 'inv' protocol message */
 constexpr unsigned int MAX_INV_SZ = 50000;
 
+/** A fully framed (header and payload) network message. Queued messages are never
+ *  modified, so the same buffer can sit in the send queues of many peers at once. */
+typedef std::shared_ptr<const CSerializeData> SharedSerializedMessage;
+
 enum NodeBufferStatus
 {
     HAS_SPACE,
@@ -74,6 +82,21 @@ public:
         SUCCESS,
     };
     static DeserializationStatus DeserializeNetworkMessageFromBuffer(const char*& buffer,unsigned& bytes,CNetMessage& msg);
+
+    /** Serializes a complete message once, for pushing to any number of peers. Only use this
+     *  for payloads whose encoding does not depend on the peer's protocol version. */
+    template <typename ...Args>
+    static SharedSerializedMessage SerializeMessage(int serializationVersion, const char* pszCommand, Args&&... args)
+    {
+        CDataStream dataStream(SER_NETWORK, serializationVersion);
+        BeginMessage(dataStream,pszCommand);
+        SerializeNextArgument(dataStream,std::forward<Args>(args)...);
+        unsigned dataSize = 0u;
+        EndMessage(dataStream,dataSize);
+        std::shared_ptr<CSerializeData> message = std::make_shared<CSerializeData>();
+        dataStream.GetAndClear(*message);
+        return message;
+    }
 };
 
 class CommunicationLogger
@@ -112,7 +135,7 @@ private:
     CommsMode commsMode_;
 
     CDataStream ssSend;
-    std::deque<CSerializeData> vSendMsg;
+    std::deque<SharedSerializedMessage> vSendMsg;
     CCriticalSection cs_vSend;
 
     std::deque<CNetMessage> vRecvMsg;
@@ -134,6 +157,7 @@ private:
 
     size_t GetSendBufferSize() const;
 
+    void QueueMessageForSending(const SharedSerializedMessage& message);
     void SendData();
     void ReceiveData(boost::condition_variable& messageHandlerCondition);
     bool ConvertDataBufferToNetworkMessage(const char* pch, unsigned int nBytes,boost::condition_variable& messageHandlerCondition);
@@ -153,6 +177,8 @@ public:
         }
     }
 
+    void PushSerializedMessage(const SharedSerializedMessage& message);
+
     QueuedMessageConnection(
         I_CommunicationChannel& channel,
         const bool& fSuccessfullyConnected,
@@ -191,6 +217,8 @@ class CNode
 private:
     bool fSuccessfullyConnected;
     CommunicationLogger dataLogger;
+    MessageTypeStatistics messageStatistics_;
+    std::unique_ptr<MessageCaptureWriter> messageCapture_;
     I_CommunicationChannel& channel_;
     QueuedMessageConnection messageConnection_;
     std::deque<CInv> vRecvGetData;
@@ -202,6 +230,7 @@ private:
 
     bool RespondToRequestForData();
     void RecordRequestForData(std::vector<CInv>& inventoryRequested);
+    bool ProcessRequestsAndReceivedMessages();
 
     CNode(
         I_CommunicationChannel& channel,
@@ -211,7 +240,7 @@ private:
         std::string addrNameIn,
         ConnectionFlagBitmask connectionFlags);
 
-    void LogMessageSize(unsigned int messageDataSize) const;
+    void RecordSentMessage(const char* pszCommand, unsigned int messageDataSize);
 
 protected:
     CNodeSignals* nodeSignals_;
@@ -221,6 +250,10 @@ public:
     bool IsSuccessfullyConnected() const;
     void RecordSuccessfullConnection();
     const CommunicationLogger& GetCommunicationLogger() const;
+    MessageTypeStatistics& GetMessageStatistics();
+    const MessageTypeStatistics& GetMessageStatistics() const;
+    /** Appends the message to this peer's capture file when -capturemessages is set */
+    void CaptureReceivedMessage(const CNetMessage& message);
     bool CommunicationChannelIsValid() const;
     void CloseCommsAndDisconnect();
     CommsMode SelectCommunicationMode();
@@ -272,16 +305,21 @@ public:
     int nStartingHeight;
 
     // flood relay
+    // cs_addrRelay guards vAddrToSend and setAddrKnown, which other peers' handlers push addresses into
+    CCriticalSection cs_addrRelay;
     std::vector<CAddress> vAddrToSend;
     mruset<CAddress> setAddrKnown;
     bool fGetAddr;
     std::set<uint256> setKnown;
 
     // inventory based relay
-    mruset<CInv> setInventoryKnown;
+    // filterInventoryKnown holds the hashes of inventory the peer already has or was told about
+    CRollingBloomFilter filterInventoryKnown;
     std::vector<CInv> vInventoryToSend;
     CCriticalSection cs_inventory;
-    std::multimap<int64_t, CInv> mapAskFor;
+    // Requests to send, earliest request time first
+    typedef std::pair<int64_t, CInv> AskForRequest;
+    std::priority_queue<AskForRequest, std::vector<AskForRequest>, std::greater<AskForRequest>> queueAskFor;
     std::vector<uint256> vBlockRequested;
 
     // Ping time measurement:
@@ -309,10 +347,12 @@ public:
     {
         unsigned int messageDataSize = 0u;
         messageConnection_.PushMessageAndRecordDataSize(messageDataSize,pszCommand,std::forward<Args>(args)...);
-        LogMessageSize(messageDataSize);
+        RecordSentMessage(pszCommand,messageDataSize);
     }
+    /** Queues a message built by NetworkMessageSerializer::SerializeMessage without copying it */
+    void PushSerializedMessage(const SharedSerializedMessage& message);
 
-    void ProcessReceiveMessages(bool& shouldSleep);
+    void ProcessReceiveMessages(bool& shouldSleep, CCriticalSection& sharedMessageStateLock);
     void ProcessSendMessages(bool trickle);
     void AdvertizeLocalAddress(int64_t rebroadcastTimestamp);
     bool IsInUse();
@@ -363,6 +403,12 @@ private:
     static CCriticalSection cs_totalBytesSent;
     static uint64_t nTotalBytesRecv;
     static uint64_t nTotalBytesSent;
+
+    // Outbound limit, guarded by cs_totalBytesSent
+    static uint64_t nMaxOutboundTotalBytesSentInCycle;
+    static uint64_t nMaxOutboundCycleStartTime;
+    static uint64_t nMaxOutboundLimit;
+    static uint64_t nMaxOutboundTimeframe;
 public:
     // Network stats
     static void RecordBytesRecv(uint64_t bytes);
@@ -370,5 +416,23 @@ public:
 
     static uint64_t GetTotalBytesRecv();
     static uint64_t GetTotalBytesSent();
+
+    /** Bytes that may be sent per timeframe, 0 for no limit */
+    static void SetMaxOutboundTarget(uint64_t limit);
+    static uint64_t GetMaxOutboundTarget();
+
+    /** Length of the outbound target cycle, in seconds */
+    static void SetMaxOutboundTimeframe(uint64_t timeframe);
+    static uint64_t GetMaxOutboundTimeframe();
+
+    /** Whether this cycle's outbound target is used up; with historicalBlockServingLimit, whether
+     *  what is left is too little to keep serving historical blocks */
+    static bool OutboundTargetReached(bool historicalBlockServingLimit);
+
+    /** Bytes left in the current cycle, 0 if there is no target */
+    static uint64_t GetOutboundTargetBytesLeft();
+
+    /** Seconds left in the current cycle, 0 if there is no target */
+    static uint64_t GetMaxOutboundTimeLeftInCycle();
 };
 #endif// NODE_H
\ No newline at end of file
@@ -10,6 +10,7 @@ struct CNodeSignals {
     boost::signals2::signal<int()> GetHeight;
     boost::signals2::signal<void(CNodeState&)> InitializeNode;
     boost::signals2::signal<void(NodeId)> FinalizeNode;
+    boost::signals2::signal<bool(CNode*)> MessagesCanBeProcessedConcurrently;
     boost::signals2::signal<bool(CNode*)> ProcessReceivedMessages;
     boost::signals2::signal<bool(CNode*,bool)> SendMessages;
     boost::signals2::signal<void(CNode*)> RespondToRequestForDataFrom;
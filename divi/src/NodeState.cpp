@@ -4,6 +4,7 @@
 #include <addrman.h>
 #include <Logging.h>
 #include <chain.h>
+#include <CompactBlock.h>
 
 /** Number of nodes with fSyncStarted. */
 int CNodeState::countOfNodesAlreadySyncing = 0;
@@ -23,7 +24,10 @@ CNodeState::CNodeState(
     , pindexBestKnownBlock(nullptr)
     , hashLastUnknownBlock(uint256(0))
     , pindexLastCommonBlock(nullptr)
+    , nBestHeaderHeight(-1)
     , fPreferredDownload(false)
+    , fSupportsCompactBlocks(false)
+    , partiallyDownloadedBlock()
 {
 }
 
@@ -3,12 +3,14 @@
 #include <vector>
 #include <string>
 #include <list>
+#include <memory>
 #include <NodeId.h>
 #include <uint256.h>
 #include <netbase.h>
 
 class CBlockIndex;
 class CAddrMan;
+class PartiallyDownloadedBlock;
 /**
  * Maintain validation-specific state about nodes, protected by cs_main, instead
  * by CNode's own locks. This simplifies asynchronous operation, where
@@ -42,8 +44,14 @@ public:
     uint256 hashLastUnknownBlock;
     //! The last full block we both have.
     const CBlockIndex* pindexLastCommonBlock;
+    //! Height of the best header this peer is known to have during headers-first sync, -1 if unknown.
+    int nBestHeaderHeight;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload;
+    //! Whether the peer sent sendcmpct, i.e. new blocks can be fetched from it as compact blocks.
+    bool fSupportsCompactBlocks;
+    //! Block being rebuilt from this peer's cmpctblock while its missing transactions are requested.
+    std::unique_ptr<PartiallyDownloadedBlock> partiallyDownloadedBlock;
 
     CNodeState(NodeId nodeIdValue,CAddrMan& addressManager);
     ~CNodeState();
@@ -10,12 +10,15 @@
 #include <blockmap.h>
 #include <Settings.h>
 #include <BlocksInFlightRegistry.h>
+#include <BlockDownloadScheduler.h>
 
 extern Settings& settings;
 extern CCriticalSection cs_main;
 
 /** Number of blocks in flight with validated headers. */
 BlocksInFlightRegistry blocksInFlightRegistry;
+/** Header chain ahead of the block index and the blocks still to be fetched for it. Requires cs_main. */
+BlockDownloadScheduler blockDownloadScheduler;
 
 /** Map maintaining per-node state. Requires cs_main. */
 std::map<NodeId, CNodeState*> mapNodeState;
@@ -40,6 +43,9 @@ void InitializeNode(CNodeState& nodeState)
 void FinalizeNode(NodeId nodeId)
 {
     LOCK(cs_main);
+    CNodeState* state = State(nodeId);
+    if (state != NULL)
+        state->Finalize();
     blocksInFlightRegistry.UnregisterNodeId(nodeId);
     mapNodeState.erase(nodeId);
 }
@@ -52,6 +58,8 @@ bool Misbehaving(CNodeState* state, int howmuch, std::string cause)
     if (howmuch == 0)
         return true;
 
+    // Peers are handled on several threads, and may be punished while another peer is being handled
+    LOCK(cs_main);
     state->ApplyMisbehavingPenalty(howmuch,cause);
     return true;
 }
@@ -111,6 +119,16 @@ NodeId GetSourceOfInFlightBlock(const uint256& blockhash)
     AssertLockHeld(cs_main);
     return blocksInFlightRegistry.GetSourceOfInFlightBlock(blockhash);
 }
+void ReleaseBlocksInFlight(NodeId nodeId)
+{
+    AssertLockHeld(cs_main);
+    blocksInFlightRegistry.ReleaseBlocksInFlight(nodeId);
+}
+BlockDownloadScheduler& GetBlockDownloadScheduler()
+{
+    AssertLockHeld(cs_main);
+    return blockDownloadScheduler;
+}
 
 /** Check whether the last unknown block a peer advertized is not yet known. */
 void ProcessBlockAvailability(const BlockMap& blockIndicesByHash, CNodeState* state)
@@ -233,3 +251,14 @@ void FindNextBlocksToDownload(
         }
     }
 }
+
+void FindNextHeaderChainBlocksToDownload(
+    NodeId nodeId,
+    int peerBestHeight,
+    unsigned int count,
+    std::vector<uint256>& vBlocks,
+    NodeId& nodeStaller)
+{
+    AssertLockHeld(cs_main);
+    blockDownloadScheduler.FindNextBlocksToDownload(blocksInFlightRegistry, nodeId, peerBestHeight, count, vBlocks, nodeStaller);
+}
@@ -13,6 +13,7 @@ class BlockMap;
 class CAddress;
 class CAddrMan;
 class CBlockReject;
+class BlockDownloadScheduler;
 
 // Requires cs_main.
 void InitializeNode(CNodeState& nodeState);
@@ -28,14 +29,26 @@ void FindNextBlocksToDownload(
     unsigned int count,
     std::vector<const CBlockIndex*>& vBlocks,
     NodeId& nodeStaller);
+/** Headers-first counterpart of FindNextBlocksToDownload, fetching blocks of the header chain
+ *  that are not in the block index yet. */
+void FindNextHeaderChainBlocksToDownload(
+    NodeId nodeId,
+    int peerBestHeight,
+    unsigned int count,
+    std::vector<uint256>& vBlocks,
+    NodeId& nodeStaller);
+BlockDownloadScheduler& GetBlockDownloadScheduler();
+void ReleaseBlocksInFlight(NodeId nodeId);
 
 bool BlockDownloadHasTimedOut(NodeId nodeId, int64_t nNow, int64_t targetSpacing);
 bool BlockDownloadHasStalled(NodeId nodeId, int64_t nNow, int64_t stallingWindow);
 void RecordWhenStallingBegan(NodeId nodeId, int64_t currentTimestamp);
 std::vector<int> GetBlockHeightsInFlight(NodeId nodeId);
 int GetNumberOfBlocksInFlight(NodeId nodeId);
+NodeId GetSourceOfInFlightBlock(const uint256& blockhash);
 // Requires cs_main.
 /** Increase a node's misbehavior score. */
 bool Misbehaving(NodeId nodeId, int howmuch, std::string cause);
+/** Increase the misbehavior score of a node's state; takes cs_main itself. */
 bool Misbehaving(CNodeState* state, int howmuch, std::string cause);
 #endif// NODE_STATE_REGISTRY_H
@@ -38,5 +38,7 @@ CNodeStats::CNodeStats(const CNode* pnode)
 
     // Leave string empty if addrLocal invalid (not filled in yet)
     addrLocal = pnode->addrLocal.IsValid() ? pnode->addrLocal.ToString() : "";
+
+    messageTotals = pnode->GetMessageStatistics().GetTotals();
 }
 #undef X
\ No newline at end of file
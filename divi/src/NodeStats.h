@@ -2,6 +2,8 @@
 #define NODE_STATS_H
 #include <stdint.h>
 #include <string>
+#include <map>
+#include <MessageTypeStatistics.h>
 class CNode;
 class CNodeStats
 {
@@ -22,6 +24,7 @@ public:
     double dPingTime;
     double dPingWait;
     std::string addrLocal;
+    std::map<std::string, MessageTypeStatistics::Totals> messageTotals;
 
     CNodeStats(const CNode*);
 };
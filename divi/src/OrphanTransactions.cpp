@@ -1,12 +1,17 @@
 #include <OrphanTransactions.h>
 
 #include <Logging.h>
+#include <OutPoint.h>
 #include <uint256.h>
+#include <deque>
 #include <set>
 #include <map>
 #include <random.h>
-#include <boost/foreach.hpp>
+#include <utiltime.h>
 #include <primitives/transaction.h>
+#include <sync.h>
+
+extern CCriticalSection cs_main;
 //////////////////////////////////////////////////////////////////////////////
 //
 // mapOrphanTransactions
@@ -15,27 +20,31 @@
 struct COrphanTx {
     CTransaction tx;
     NodeId fromPeer;
+    int64_t nTimeExpire;
+    unsigned int nTxSize;
+};
+struct COrphanPeerUsage {
+    std::set<uint256> orphanHashes;
+    size_t nBytes;
+    COrphanPeerUsage(): orphanHashes(), nBytes(0u) {}
 };
 std::map<uint256, COrphanTx> mapOrphanTransactions;
-std::map<uint256, std::set<uint256> > mapOrphanTransactionsByPrev;
+std::map<COutPoint, std::set<uint256> > mapOrphanTransactionsByPrev;
+std::map<NodeId, COrphanPeerUsage> mapOrphanUsageByPeer;
+std::deque<uint256> orphanWorkQueue;
+std::set<uint256> orphanWorkQueueContents;
+size_t nOrphanTotalBytes = 0u;
+int64_t nNextOrphanSweep = 0;
 
 
 //////////////////////////////////////////////////////////////////////////////
 //
 // mapOrphanTransactions
 //
-const std::set<uint256>& GetOrphanSpendingTransactionIds(const uint256& txHash)
-{
-    static std::set<uint256> emptySet;
-    const auto it = mapOrphanTransactionsByPrev.find(txHash);
-    if(it == mapOrphanTransactionsByPrev.end()) return emptySet;
-
-    return it->second;
-}
 const CTransaction& GetOrphanTransaction(const uint256& txHash, NodeId& peer)
 {
     peer = mapOrphanTransactions[txHash].fromPeer;
-    return mapOrphanTransactions[txHash].tx;;
+    return mapOrphanTransactions[txHash].tx;
 }
 bool OrphanTransactionIsKnown(const uint256& hash)
 {
@@ -52,21 +61,35 @@ bool AddOrphanTx(const CTransaction& tx, NodeId peer)
     // large transaction with a missing parent then we assume
     // it will rebroadcast it later, after the parent transaction(s)
     // have been mined or received.
-    // 10,000 orphans, each of which is at most 5,000 bytes big is
-    // at most 500 megabytes of orphans:
     unsigned int sz = tx.GetSerializeSize(SER_NETWORK, CTransaction::CURRENT_VERSION);
-    if (sz > 5000) {
+    if (sz > MAX_ORPHAN_TRANSACTION_SIZE) {
         LogPrint("mempool", "ignoring large orphan tx (size: %u, hash: %s)\n", sz, hash);
         return false;
     }
 
-    mapOrphanTransactions[hash].tx = tx;
-    mapOrphanTransactions[hash].fromPeer = peer;
-    BOOST_FOREACH (const CTxIn& txin, tx.vin)
-            mapOrphanTransactionsByPrev[txin.prevout.hash].insert(hash);
+    // A single peer cannot crowd out everyone else's orphans
+    COrphanPeerUsage& peerUsage = mapOrphanUsageByPeer[peer];
+    if (peerUsage.nBytes + sz > MAX_ORPHAN_BYTES_PER_PEER) {
+        LogPrint("mempool", "ignoring orphan tx %s, peer=%d exceeds its orphan quota (%u bytes)\n", hash, peer, peerUsage.nBytes);
+        if (peerUsage.orphanHashes.empty())
+            mapOrphanUsageByPeer.erase(peer);
+        return false;
+    }
+
+    COrphanTx& orphan = mapOrphanTransactions[hash];
+    orphan.tx = tx;
+    orphan.fromPeer = peer;
+    orphan.nTimeExpire = GetTime() + ORPHAN_TX_EXPIRE_TIME;
+    orphan.nTxSize = sz;
+    for (const CTxIn& txin: tx.vin)
+        mapOrphanTransactionsByPrev[txin.prevout].insert(hash);
+
+    peerUsage.orphanHashes.insert(hash);
+    peerUsage.nBytes += sz;
+    nOrphanTotalBytes += sz;
 
-    LogPrint("mempool", "stored orphan tx %s (mapsz %u prevsz %u)\n", hash,
-             mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size());
+    LogPrint("mempool", "stored orphan tx %s (mapsz %u prevsz %u bytes %u)\n", hash,
+             mapOrphanTransactions.size(), mapOrphanTransactionsByPrev.size(), nOrphanTotalBytes);
     return true;
 }
 
@@ -75,36 +98,68 @@ void EraseOrphanTx(uint256 hash)
     std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.find(hash);
     if (it == mapOrphanTransactions.end())
         return;
-    BOOST_FOREACH (const CTxIn& txin, it->second.tx.vin) {
-        const auto itPrev = mapOrphanTransactionsByPrev.find(txin.prevout.hash);
+    for (const CTxIn& txin: it->second.tx.vin) {
+        const auto itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
         if (itPrev == mapOrphanTransactionsByPrev.end())
             continue;
         itPrev->second.erase(hash);
         if (itPrev->second.empty())
             mapOrphanTransactionsByPrev.erase(itPrev);
     }
+
+    const auto itPeer = mapOrphanUsageByPeer.find(it->second.fromPeer);
+    if (itPeer != mapOrphanUsageByPeer.end()) {
+        itPeer->second.orphanHashes.erase(hash);
+        itPeer->second.nBytes -= it->second.nTxSize;
+        if (itPeer->second.orphanHashes.empty())
+            mapOrphanUsageByPeer.erase(itPeer);
+    }
+    nOrphanTotalBytes -= it->second.nTxSize;
     mapOrphanTransactions.erase(it);
 }
 
 void EraseOrphansFor(NodeId peer)
 {
-    int nErased = 0;
+    const auto itPeer = mapOrphanUsageByPeer.find(peer);
+    if (itPeer == mapOrphanUsageByPeer.end())
+        return;
+
+    // Copy, since erasing the last orphan of a peer removes its usage entry
+    const std::set<uint256> orphansFromPeer = itPeer->second.orphanHashes;
+    for (const uint256& hash: orphansFromPeer)
+        EraseOrphanTx(hash);
+
+    if (!orphansFromPeer.empty()) LogPrint("mempool", "Erased %d orphan tx from peer %d\n", orphansFromPeer.size(), peer);
+}
+
+static unsigned int EraseExpiredOrphans(int64_t nNow)
+{
+    unsigned int nErased = 0;
+    int64_t nMinExpireTime = nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
     std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
     while (iter != mapOrphanTransactions.end()) {
         std::map<uint256, COrphanTx>::iterator maybeErase = iter++; // increment to avoid iterator becoming invalid
-        if (maybeErase->second.fromPeer == peer) {
-            EraseOrphanTx(maybeErase->second.tx.GetHash());
+        if (maybeErase->second.nTimeExpire <= nNow) {
+            EraseOrphanTx(maybeErase->first);
             ++nErased;
+        } else {
+            nMinExpireTime = std::min(maybeErase->second.nTimeExpire, nMinExpireTime);
         }
     }
-    if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx from peer %d\n", nErased, peer);
+    // Sweep again 5 minutes after the next entry that expires in order to batch the linear scan.
+    nNextOrphanSweep = nMinExpireTime + ORPHAN_TX_EXPIRE_INTERVAL;
+    if (nErased > 0) LogPrint("mempool", "Erased %d orphan tx due to expiration\n", nErased);
+    return nErased;
 }
 
-
-unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans)
+unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans, size_t nMaxOrphanBytes)
 {
     unsigned int nEvicted = 0;
-    while (mapOrphanTransactions.size() > nMaxOrphans) {
+    const int64_t nNow = GetTime();
+    if (nNextOrphanSweep <= nNow)
+        nEvicted += EraseExpiredOrphans(nNow);
+
+    while (mapOrphanTransactions.size() > nMaxOrphans || nOrphanTotalBytes > nMaxOrphanBytes) {
         // Evict a random orphan:
         uint256 randomhash = GetRandHash();
         std::map<uint256, COrphanTx>::iterator it = mapOrphanTransactions.lower_bound(randomhash);
@@ -129,7 +184,48 @@ size_t OrphanTotalCount()
 {
     return mapOrphanTransactions.size();
 }
+size_t OrphanTotalBytes()
+{
+    return nOrphanTotalBytes;
+}
+size_t OrphanBytesFromPeer(NodeId peer)
+{
+    const auto itPeer = mapOrphanUsageByPeer.find(peer);
+    return itPeer == mapOrphanUsageByPeer.end()? 0u: itPeer->second.nBytes;
+}
 bool OrphanMapsAreEmpty()
 {
-    return mapOrphanTransactions.empty() && mapOrphanTransactionsByPrev.empty();
+    return mapOrphanTransactions.empty() && mapOrphanTransactionsByPrev.empty() && mapOrphanUsageByPeer.empty();
+}
+
+void AddOrphansSpendingTransactionToWorkQueue(const CTransaction& tx)
+{
+    AssertLockHeld(cs_main);
+    const uint256 txHash = tx.GetHash();
+    for (uint32_t outputIndex = 0; outputIndex < tx.vout.size(); ++outputIndex) {
+        const auto itPrev = mapOrphanTransactionsByPrev.find(COutPoint(txHash, outputIndex));
+        if (itPrev == mapOrphanTransactionsByPrev.end())
+            continue;
+        for (const uint256& orphanHash: itPrev->second) {
+            if (orphanWorkQueueContents.insert(orphanHash).second)
+                orphanWorkQueue.push_back(orphanHash);
+        }
+    }
+}
+bool PopOrphanFromWorkQueue(uint256& orphanHash)
+{
+    AssertLockHeld(cs_main);
+    while (!orphanWorkQueue.empty()) {
+        orphanHash = orphanWorkQueue.front();
+        orphanWorkQueue.pop_front();
+        orphanWorkQueueContents.erase(orphanHash);
+        if (OrphanTransactionIsKnown(orphanHash))
+            return true;
+    }
+    return false;
+}
+size_t OrphanWorkQueueSize()
+{
+    AssertLockHeld(cs_main);
+    return orphanWorkQueue.size();
 }
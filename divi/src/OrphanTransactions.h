@@ -3,15 +3,35 @@
 #include <NodeId.h>
 #include <uint256.h>
 #include <set>
+#include <stddef.h>
+#include <stdint.h>
 class CTransaction;
-const std::set<uint256>& GetOrphanSpendingTransactionIds(const uint256& txHash);
+
+/** Orphans larger than this are ignored outright */
+constexpr unsigned int MAX_ORPHAN_TRANSACTION_SIZE = 5000;
+/** Maximum number of orphan bytes a single peer may have in the pool at once */
+constexpr size_t MAX_ORPHAN_BYTES_PER_PEER = 20 * MAX_ORPHAN_TRANSACTION_SIZE;
+/** Time in seconds after which an orphan is dropped from the pool */
+constexpr int64_t ORPHAN_TX_EXPIRE_TIME = 20 * 60;
+/** Minimum time in seconds between two sweeps for expired orphans */
+constexpr int64_t ORPHAN_TX_EXPIRE_INTERVAL = 5 * 60;
+
 const CTransaction& GetOrphanTransaction(const uint256& txHash, NodeId& peer);
 bool OrphanTransactionIsKnown(const uint256& hash);
 bool AddOrphanTx(const CTransaction& tx, NodeId peer);
 void EraseOrphanTx(uint256 hash);
 void EraseOrphansFor(NodeId peer);
-unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
+unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans, size_t nMaxOrphanBytes);
 const CTransaction& SelectRandomOrphan();
 size_t OrphanTotalCount();
+size_t OrphanTotalBytes();
+size_t OrphanBytesFromPeer(NodeId peer);
 bool OrphanMapsAreEmpty();
+
+// Orphan work queue; all of these require LOCK(cs_main)
+/** Queue every orphan spending an output of the given (newly accepted) transaction for reprocessing */
+void AddOrphansSpendingTransactionToWorkQueue(const CTransaction& tx);
+/** Pops the next queued orphan that is still in the pool; returns false once the queue is drained */
+bool PopOrphanFromWorkQueue(uint256& orphanHash);
+size_t OrphanWorkQueueSize();
 #endif// ORPHAN_TRANSACTIONS_H
@@ -0,0 +1,120 @@
+#include <PeerMessageScheduler.h>
+
+#include <ThreadManagementHelpers.h>
+
+PeerMessageScheduler::PeerMessageScheduler(
+    unsigned numberOfThreads
+    ): mutex_()
+    , turnAvailable_()
+    , readyTurns_()
+    , scheduledPeers_()
+    , workers_()
+    , stopped_(false)
+{
+    for(unsigned threadIndex = 0; threadIndex < std::max(numberOfThreads, 1u); ++threadIndex)
+    {
+        workers_.create_thread([this](){ TraceThread("msgproc", [this](){ ProcessTurns(); }); });
+    }
+}
+
+PeerMessageScheduler::~PeerMessageScheduler()
+{
+    Stop();
+}
+
+bool PeerMessageScheduler::SchedulePeer(NodeId peerId, PeerTurn turn)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        if(stopped_ || !scheduledPeers_.insert(peerId).second) return false;
+        readyTurns_.emplace_back(peerId, std::move(turn));
+    }
+    turnAvailable_.notify_one();
+    return true;
+}
+
+bool PeerMessageScheduler::PeerIsScheduled(NodeId peerId) const
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return scheduledPeers_.count(peerId) > 0;
+}
+
+size_t PeerMessageScheduler::NumberOfScheduledPeers() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return scheduledPeers_.size();
+}
+
+unsigned PeerMessageScheduler::NumberOfThreads() const
+{
+    return static_cast<unsigned>(workers_.size());
+}
+
+void PeerMessageScheduler::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        if(stopped_) return;
+        stopped_ = true;
+    }
+    workers_.interrupt_all();
+    workers_.join_all();
+
+    // Dropping the queued turns releases whatever they hold on to (e.g. node references)
+    std::deque<ScheduledTurn> droppedTurns;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        droppedTurns.swap(readyTurns_);
+        scheduledPeers_.clear();
+    }
+}
+
+bool PeerMessageScheduler::WaitForTurn(ScheduledTurn& turn)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while(readyTurns_.empty() && !stopped_)
+    {
+        turnAvailable_.wait(lock);
+    }
+    if(stopped_) return false;
+
+    turn = std::move(readyTurns_.front());
+    readyTurns_.pop_front();
+    return true;
+}
+
+void PeerMessageScheduler::FinishTurn(ScheduledTurn& turn, bool morePending)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        if(!morePending || stopped_)
+        {
+            scheduledPeers_.erase(turn.first);
+            return;
+        }
+        // Back of the queue, so every other ready peer gets its turn first
+        readyTurns_.push_back(std::move(turn));
+    }
+    turnAvailable_.notify_one();
+}
+
+void PeerMessageScheduler::ProcessTurns()
+{
+    ScheduledTurn turn;
+    while(WaitForTurn(turn))
+    {
+        bool morePending = false;
+        try
+        {
+            morePending = turn.second();
+        }
+        catch(...)
+        {
+            FinishTurn(turn, false);
+            throw;
+        }
+        FinishTurn(turn, morePending);
+        turn = ScheduledTurn();
+        boost::this_thread::interruption_point();
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef PEER_MESSAGE_SCHEDULER_H
+#define PEER_MESSAGE_SCHEDULER_H
+#include <NodeId.h>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <deque>
+#include <functional>
+#include <set>
+#include <utility>
+
+/** Runs per-peer message processing turns on a pool of handler threads.
+ *  A peer has at most one turn queued or running at any time, so its messages
+ *  are still handled strictly in order, and peers that keep having work are
+ *  re-queued at the back so that busy peers cannot starve the others.
+ */
+class PeerMessageScheduler
+{
+public:
+    /** Processes a bounded amount of a peer's work; returns true if the peer has more work pending */
+    typedef std::function<bool()> PeerTurn;
+private:
+    typedef std::pair<NodeId, PeerTurn> ScheduledTurn;
+
+    mutable boost::mutex mutex_;
+    boost::condition_variable turnAvailable_;
+    std::deque<ScheduledTurn> readyTurns_;
+    std::set<NodeId> scheduledPeers_;
+    boost::thread_group workers_;
+    bool stopped_;
+
+    bool WaitForTurn(ScheduledTurn& turn);
+    void FinishTurn(ScheduledTurn& turn, bool morePending);
+    void ProcessTurns();
+public:
+    explicit PeerMessageScheduler(unsigned numberOfThreads);
+    ~PeerMessageScheduler();
+
+    /** Queues a turn for the peer; returns false if the peer already has one queued or running */
+    bool SchedulePeer(NodeId peerId, PeerTurn turn);
+    bool PeerIsScheduled(NodeId peerId) const;
+    size_t NumberOfScheduledPeers() const;
+    unsigned NumberOfThreads() const;
+    /** Interrupts and joins the handler threads; turns still queued are dropped */
+    void Stop();
+};
+#endif// PEER_MESSAGE_SCHEDULER_H
@@ -0,0 +1,114 @@
+#include <PipelinedBlockScanner.h>
+
+#include <algorithm>
+
+#include <I_BlockDataReader.h>
+#include <Logging.h>
+#include <ThreadManagementHelpers.h>
+
+PipelinedBlockScanner::PipelinedBlockScanner(
+    const I_BlockDataReader& blockReader,
+    TransactionFilter filter,
+    unsigned numberOfThreads,
+    unsigned maximumBlocksAhead
+    ): blockReader_(blockReader)
+    , filter_(std::move(filter))
+    , maximumBlocksAhead_(std::max(maximumBlocksAhead, 1u))
+    , mutex_()
+    , workAvailable_()
+    , blockScanned_()
+    , blocks_()
+    , generation_(0u)
+    , nextToDispatch_(0u)
+    , nextToTake_(0u)
+    , scannedBlocks_()
+    , workers_()
+{
+    for(unsigned threadIndex = 0u; threadIndex < std::max(numberOfThreads, 1u); ++threadIndex)
+    {
+        workers_.create_thread([this](){ TraceThread("rescan", [this](){ ScanBlocks(); }); });
+    }
+}
+
+PipelinedBlockScanner::~PipelinedBlockScanner()
+{
+    workers_.interrupt_all();
+    workers_.join_all();
+}
+
+void PipelinedBlockScanner::ScanBlocks()
+{
+    while(true)
+    {
+        size_t position;
+        unsigned generation;
+        std::unique_ptr<ScannedBlock> scannedBlock(new ScannedBlock());
+        {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            while(nextToDispatch_ >= blocks_.size() || nextToDispatch_ >= nextToTake_ + maximumBlocksAhead_)
+            {
+                workAvailable_.wait(lock);
+            }
+            position = nextToDispatch_++;
+            generation = generation_;
+            scannedBlock->blockIndex = blocks_[position];
+        }
+
+        try
+        {
+            scannedBlock->readSucceeded = blockReader_.ReadBlock(scannedBlock->blockIndex, scannedBlock->block);
+            const std::vector<CTransaction>& transactions = scannedBlock->block.vtx;
+            for(unsigned transactionIndex = 0u; scannedBlock->readSucceeded && transactionIndex < transactions.size(); ++transactionIndex)
+            {
+                if(filter_(transactions[transactionIndex])) scannedBlock->matchingTransactions.push_back(transactionIndex);
+            }
+        }
+        catch(const std::exception& e)
+        {
+            // Reported as a failed read, instead of leaving the consumer waiting for the block
+            LogPrintf("%s: %s\n", __func__, e.what());
+            scannedBlock->readSucceeded = false;
+        }
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            // The run was replaced while the block was being scanned
+            if(generation != generation_) continue;
+            scannedBlocks_.emplace(position, std::move(scannedBlock));
+        }
+        blockScanned_.notify_all();
+    }
+}
+
+void PipelinedBlockScanner::scan(const std::vector<const CBlockIndex*>& blocks)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        blocks_ = blocks;
+        ++generation_;
+        nextToDispatch_ = 0u;
+        nextToTake_ = 0u;
+        scannedBlocks_.clear();
+    }
+    workAvailable_.notify_all();
+}
+
+std::unique_ptr<PipelinedBlockScanner::ScannedBlock> PipelinedBlockScanner::nextBlock()
+{
+    std::unique_ptr<ScannedBlock> scannedBlock;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        if(nextToTake_ >= blocks_.size()) return scannedBlock;
+        auto it = scannedBlocks_.find(nextToTake_);
+        while(it == scannedBlocks_.end())
+        {
+            blockScanned_.wait(lock);
+            it = scannedBlocks_.find(nextToTake_);
+        }
+        scannedBlock = std::move(it->second);
+        scannedBlocks_.erase(it);
+        ++nextToTake_;
+    }
+    workAvailable_.notify_all();
+    return scannedBlock;
+}
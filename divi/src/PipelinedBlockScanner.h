@@ -0,0 +1,68 @@
+#ifndef PIPELINED_BLOCK_SCANNER_H
+#define PIPELINED_BLOCK_SCANNER_H
+#include <primitives/block.h>
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+class CBlockIndex;
+class CTransaction;
+class I_BlockDataReader;
+
+/** Reads a run of blocks and tests their transactions on a pool of worker threads,
+ *  handing the results back in chain order.
+ *
+ *  Workers stay at most a bounded number of blocks ahead of the consumer, so the
+ *  memory used does not depend on the length of the run. The filter is called from
+ *  all workers at once and must not take locks the consumer may be holding.
+ */
+class PipelinedBlockScanner
+{
+public:
+    static const unsigned DEFAULT_MAXIMUM_BLOCKS_AHEAD = 128;
+    using TransactionFilter = std::function<bool(const CTransaction&)>;
+
+    struct ScannedBlock
+    {
+        const CBlockIndex* blockIndex;
+        bool readSucceeded;
+        CBlock block;
+        /** Positions in block.vtx of the transactions the filter accepted, ascending */
+        std::vector<unsigned> matchingTransactions;
+    };
+
+private:
+    const I_BlockDataReader& blockReader_;
+    const TransactionFilter filter_;
+    const unsigned maximumBlocksAhead_;
+
+    boost::mutex mutex_;
+    boost::condition_variable workAvailable_;
+    boost::condition_variable blockScanned_;
+    std::vector<const CBlockIndex*> blocks_;
+    unsigned generation_;
+    size_t nextToDispatch_;
+    size_t nextToTake_;
+    std::map<size_t, std::unique_ptr<ScannedBlock>> scannedBlocks_;
+    boost::thread_group workers_;
+
+    void ScanBlocks();
+
+public:
+    PipelinedBlockScanner(
+        const I_BlockDataReader& blockReader,
+        TransactionFilter filter,
+        unsigned numberOfThreads,
+        unsigned maximumBlocksAhead = DEFAULT_MAXIMUM_BLOCKS_AHEAD);
+    ~PipelinedBlockScanner();
+
+    /** Starts scanning the given blocks, dropping whatever is left of the previous run */
+    void scan(const std::vector<const CBlockIndex*>& blocks);
+    /** Waits for the next block of the run; nullptr once the run is exhausted */
+    std::unique_ptr<ScannedBlock> nextBlock();
+};
+#endif// PIPELINED_BLOCK_SCANNER_H
@@ -0,0 +1,158 @@
+#include <RenderedResponseCache.h>
+
+#include <chain.h>
+#include <primitives/block.h>
+#include <primitives/transaction.h>
+
+RenderedResponseCache::RenderedResponseCache(
+    size_t maxBytes
+    ): cs_cache()
+    , maxBytes_(maxBytes)
+    , totalBytes_(0u)
+    , entriesByRecency_()
+    , entryByKey_()
+    , lastSeenTip_(nullptr)
+    , hits_(0u)
+    , misses_(0u)
+    , evictions_(0u)
+    , invalidations_(0u)
+{
+}
+
+bool RenderedResponseCache::DependsOnChainTip(Format format)
+{
+    return format == BLOCK_JSON || format == BLOCK_JSON_TX_DETAILS || format == TRANSACTION_JSON;
+}
+
+std::shared_ptr<const std::string> RenderedResponseCache::Get(const uint256& hash, Format format, const uint256& chainTip)
+{
+    LOCK(cs_cache);
+    const auto it = entryByKey_.find(Key(hash, format));
+    if (it == entryByKey_.end())
+    {
+        ++misses_;
+        return nullptr;
+    }
+    if (DependsOnChainTip(format) && it->second->renderedAtTip != chainTip)
+    {
+        Erase(it);
+        ++misses_;
+        return nullptr;
+    }
+    entriesByRecency_.splice(entriesByRecency_.begin(), entriesByRecency_, it->second);
+    ++hits_;
+    return it->second->rendered;
+}
+
+void RenderedResponseCache::Insert(const uint256& hash, Format format, const uint256& chainTip, const std::shared_ptr<const std::string>& rendered)
+{
+    LOCK(cs_cache);
+    if (!rendered || rendered->size() > maxBytes_)
+        return;
+
+    const Key key(hash, format);
+    const auto existing = entryByKey_.find(key);
+    if (existing != entryByKey_.end())
+        Erase(existing);
+
+    Entry entry;
+    entry.key = key;
+    entry.renderedAtTip = DependsOnChainTip(format)? chainTip: uint256(0);
+    entry.rendered = rendered;
+    entriesByRecency_.push_front(entry);
+    entryByKey_[key] = entriesByRecency_.begin();
+    totalBytes_ += rendered->size();
+    while (totalBytes_ > maxBytes_)
+        EvictLeastRecentlyUsed();
+}
+
+// requires LOCK(cs_cache)
+void RenderedResponseCache::Erase(std::map<Key, RecencyList::iterator>::iterator it)
+{
+    AssertLockHeld(cs_cache);
+    totalBytes_ -= it->second->rendered->size();
+    entriesByRecency_.erase(it->second);
+    entryByKey_.erase(it);
+}
+
+// requires LOCK(cs_cache)
+void RenderedResponseCache::EvictLeastRecentlyUsed()
+{
+    AssertLockHeld(cs_cache);
+    Erase(entryByKey_.find(entriesByRecency_.back().key));
+    ++evictions_;
+}
+
+void RenderedResponseCache::Invalidate(const uint256& hash)
+{
+    LOCK(cs_cache);
+    auto it = entryByKey_.lower_bound(Key(hash, BLOCK_JSON));
+    while (it != entryByKey_.end() && it->first.first == hash)
+    {
+        Erase(it++);
+        ++invalidations_;
+    }
+}
+
+void RenderedResponseCache::SetMaxBytes(size_t maxBytes)
+{
+    LOCK(cs_cache);
+    maxBytes_ = maxBytes;
+    while (totalBytes_ > maxBytes_)
+        EvictLeastRecentlyUsed();
+}
+
+bool RenderedResponseCache::IsEnabled() const
+{
+    LOCK(cs_cache);
+    return maxBytes_ > 0u;
+}
+
+RenderedResponseCache::Statistics RenderedResponseCache::GetStatistics() const
+{
+    LOCK(cs_cache);
+    Statistics statistics;
+    statistics.entries = entryByKey_.size();
+    statistics.bytes = totalBytes_;
+    statistics.maxBytes = maxBytes_;
+    statistics.hits = hits_;
+    statistics.misses = misses_;
+    statistics.evictions = evictions_;
+    statistics.invalidations = invalidations_;
+    return statistics;
+}
+
+void RenderedResponseCache::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    const CBlockIndex* previousTip = nullptr;
+    {
+        LOCK(cs_cache);
+        previousTip = lastSeenTip_;
+        lastSeenTip_ = pindex;
+    }
+    if (previousTip == nullptr || pindex == nullptr)
+        return;
+
+    // Blocks between the old tip and the fork point have left the active chain
+    const CBlockIndex* forkPoint = LastCommonAncestor(previousTip, pindex);
+    for (const CBlockIndex* disconnected = previousTip; disconnected && disconnected != forkPoint; disconnected = disconnected->pprev)
+        Invalidate(disconnected->GetBlockHash());
+}
+
+void RenderedResponseCache::SyncTransactions(const TransactionVector& txs, const CBlock* pblock, const TransactionSyncType syncType)
+{
+    if (syncType != TransactionSyncType::BLOCK_DISCONNECT)
+        return;
+    // getrawtransaction caches under whichever id it was asked for
+    for (const CTransaction& tx: txs)
+    {
+        Invalidate(tx.GetHash());
+        Invalidate(tx.GetBareTxid());
+    }
+}
+
+RenderedResponseCache& GetRenderedResponseCache()
+{
+    static RenderedResponseCache renderedResponseCache(0u);
+    return renderedResponseCache;
+}
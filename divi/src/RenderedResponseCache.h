@@ -0,0 +1,92 @@
+#ifndef RENDERED_RESPONSE_CACHE_H
+#define RENDERED_RESPONSE_CACHE_H
+#include <NotificationInterface.h>
+#include <sync.h>
+#include <uint256.h>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <string>
+
+/** Keeps recently rendered RPC and REST responses for blocks and confirmed transactions,
+ *  so that repeated requests for the same object skip the disk read, deserialization
+ *  and rendering. Bounded by the total size of the cached responses.
+ *
+ *  Serialized forms never change for a given hash. The JSON forms report confirmations
+ *  and the next block, so they are only served while the chain tip they were rendered
+ *  against is still the tip. Entries for blocks and transactions that a reorg
+ *  disconnects are dropped.
+ */
+class RenderedResponseCache final: public NotificationInterface
+{
+public:
+    enum Format
+    {
+        BLOCK_JSON,
+        BLOCK_JSON_TX_DETAILS,
+        BLOCK_HEX,
+        BLOCK_BINARY,
+        BLOCK_HEADER_JSON,
+        BLOCK_HEADER_HEX,
+        TRANSACTION_JSON,
+        TRANSACTION_HEX,
+    };
+
+    struct Statistics
+    {
+        size_t entries;
+        size_t bytes;
+        size_t maxBytes;
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;
+        uint64_t invalidations;
+    };
+
+private:
+    typedef std::pair<uint256, Format> Key;
+    struct Entry
+    {
+        Key key;
+        uint256 renderedAtTip;
+        std::shared_ptr<const std::string> rendered;
+    };
+    typedef std::list<Entry> RecencyList;
+
+    mutable CCriticalSection cs_cache;
+    size_t maxBytes_;
+    size_t totalBytes_;
+    RecencyList entriesByRecency_;
+    std::map<Key, RecencyList::iterator> entryByKey_;
+    const CBlockIndex* lastSeenTip_;
+    uint64_t hits_;
+    uint64_t misses_;
+    uint64_t evictions_;
+    uint64_t invalidations_;
+
+    static bool DependsOnChainTip(Format format);
+    void Erase(std::map<Key, RecencyList::iterator>::iterator it);
+    void EvictLeastRecentlyUsed();
+
+protected:
+    void UpdatedBlockTip(const CBlockIndex* pindex) override;
+    void SyncTransactions(const TransactionVector& txs, const CBlock* pblock, const TransactionSyncType syncType) override;
+
+public:
+    explicit RenderedResponseCache(size_t maxBytes);
+
+    /** The response rendered for hash in the given format, or nullptr; chainTip is the tip the caller renders against */
+    std::shared_ptr<const std::string> Get(const uint256& hash, Format format, const uint256& chainTip);
+    void Insert(const uint256& hash, Format format, const uint256& chainTip, const std::shared_ptr<const std::string>& rendered);
+    /** Drops every format cached for the block or transaction with this hash */
+    void Invalidate(const uint256& hash);
+    /** Changing the bound drops whatever no longer fits; zero disables the cache */
+    void SetMaxBytes(size_t maxBytes);
+    bool IsEnabled() const;
+    Statistics GetStatistics() const;
+};
+
+RenderedResponseCache& GetRenderedResponseCache();
+#endif// RENDERED_RESPONSE_CACHE_H
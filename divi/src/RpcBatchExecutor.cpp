@@ -0,0 +1,124 @@
+#include <RpcBatchExecutor.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace
+{
+/** Shared between the caller and its helpers; helpers scheduled late may outlive the call */
+struct ConcurrentRun
+{
+    const RpcBatchExecutor::RequestHandler handleRequest;
+    const std::vector<json_spirit::Value> requests;
+    std::vector<json_spirit::Object> replies;
+    std::atomic<unsigned> nextRequest;
+
+    boost::mutex mutex;
+    boost::condition_variable finished;
+    unsigned completedRequests;
+    std::exception_ptr failure;
+
+    ConcurrentRun(
+        const RpcBatchExecutor::RequestHandler& handler,
+        std::vector<json_spirit::Value>&& runRequests
+        ): handleRequest(handler)
+        , requests(std::move(runRequests))
+        , replies(requests.size())
+        , nextRequest(0u)
+        , mutex()
+        , finished()
+        , completedRequests(0u)
+        , failure()
+    {
+    }
+
+    void Work()
+    {
+        for (unsigned index = nextRequest.fetch_add(1u); index < requests.size(); index = nextRequest.fetch_add(1u))
+        {
+            std::exception_ptr error;
+            try {
+                replies[index] = handleRequest(requests[index]);
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (error && !failure)
+                failure = error;
+            if (++completedRequests == requests.size())
+                finished.notify_all();
+        }
+    }
+
+    void WaitUntilFinished()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (completedRequests < requests.size())
+            finished.wait(lock);
+        if (failure)
+            std::rethrow_exception(failure);
+    }
+};
+} // anonymous namespace
+
+RpcBatchExecutor::RpcBatchExecutor(
+    RequestHandler handleRequest,
+    ConcurrencyPredicate canRunConcurrently,
+    TaskPoster postTask,
+    unsigned maxConcurrency
+    ): handleRequest_(handleRequest)
+    , canRunConcurrently_(canRunConcurrently)
+    , postTask_(postTask)
+    , maxConcurrency_(std::max(maxConcurrency, 1u))
+{
+}
+
+void RpcBatchExecutor::ExecuteConcurrently(
+    const json_spirit::Array& requests,
+    unsigned begin,
+    unsigned end,
+    json_spirit::Array& replies) const
+{
+    std::vector<json_spirit::Value> runRequests(requests.begin() + begin, requests.begin() + end);
+    const std::shared_ptr<ConcurrentRun> run = std::make_shared<ConcurrentRun>(handleRequest_, std::move(runRequests));
+
+    const unsigned helpers = std::min<unsigned>(maxConcurrency_, end - begin) - 1u;
+    for (unsigned helper = 0; helper < helpers; ++helper)
+        postTask_([run]() { run->Work(); });
+    run->Work();
+    run->WaitUntilFinished();
+
+    for (json_spirit::Object& reply: run->replies)
+        replies.push_back(std::move(reply));
+}
+
+json_spirit::Array RpcBatchExecutor::Execute(const json_spirit::Array& requests) const
+{
+    json_spirit::Array replies;
+    replies.reserve(requests.size());
+
+    unsigned index = 0;
+    while (index < requests.size())
+    {
+        unsigned runEnd = index;
+        while (runEnd < requests.size() && canRunConcurrently_(requests[runEnd]))
+            ++runEnd;
+
+        if (runEnd - index > 1u && maxConcurrency_ > 1u)
+        {
+            ExecuteConcurrently(requests, index, runEnd, replies);
+            index = runEnd;
+            continue;
+        }
+        for (runEnd = std::max(runEnd, index + 1u); index < runEnd; ++index)
+            replies.push_back(handleRequest_(requests[index]));
+    }
+    return replies;
+}
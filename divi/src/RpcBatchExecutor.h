@@ -0,0 +1,46 @@
+#ifndef RPC_BATCH_EXECUTOR_H
+#define RPC_BATCH_EXECUTOR_H
+#include <json/json_spirit_value.h>
+
+#include <boost/function.hpp>
+
+/** Runs the calls of a JSON-RPC batch, fanning calls that may run concurrently out to worker threads.
+ *
+ *  The batch is cut into runs of consecutive calls that may run concurrently; every other
+ *  call is executed on its own, in order, after the preceding run has finished. Calls
+ *  within a run execute in no particular order, so canRunConcurrently must only admit
+ *  calls without side effects that others in the batch could observe. Within a run the
+ *  calling thread works through the calls together with up to maxConcurrency - 1 helper
+ *  tasks handed to the task poster. Helpers that are only scheduled once the caller has
+ *  finished the run find nothing left to do, so a busy worker pool delays a batch but
+ *  can never deadlock it. Replies come back in request order.
+ */
+class RpcBatchExecutor
+{
+public:
+    typedef boost::function<json_spirit::Object(const json_spirit::Value&)> RequestHandler;
+    typedef boost::function<bool(const json_spirit::Value&)> ConcurrencyPredicate;
+    typedef boost::function<void(const boost::function<void()>&)> TaskPoster;
+
+private:
+    const RequestHandler handleRequest_;
+    const ConcurrencyPredicate canRunConcurrently_;
+    const TaskPoster postTask_;
+    const unsigned maxConcurrency_;
+
+    void ExecuteConcurrently(
+        const json_spirit::Array& requests,
+        unsigned begin,
+        unsigned end,
+        json_spirit::Array& replies) const;
+
+public:
+    RpcBatchExecutor(
+        RequestHandler handleRequest,
+        ConcurrencyPredicate canRunConcurrently,
+        TaskPoster postTask,
+        unsigned maxConcurrency);
+
+    json_spirit::Array Execute(const json_spirit::Array& requests) const;
+};
+#endif// RPC_BATCH_EXECUTOR_H
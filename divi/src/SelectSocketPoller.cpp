@@ -0,0 +1,174 @@
+#include <SelectSocketPoller.h>
+
+#include <Logging.h>
+#include <netbase.h>
+#include <utiltime.h>
+
+#ifndef WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+SelectSocketPoller::SelectSocketPoller(
+    ): interestBySocket_()
+    , readySockets_()
+    , wakeupReadEnd_(-1)
+    , wakeupWriteEnd_(-1)
+{
+    ClearReadiness();
+#ifndef WIN32
+    int pipeEnds[2];
+    if (pipe(pipeEnds) != 0)
+    {
+        LogPrintf("%s: pipe failed: %s\n", __func__, NetworkErrorString(errno));
+        return;
+    }
+    for (int pipeEnd: pipeEnds)
+    {
+        fcntl(pipeEnd, F_SETFL, fcntl(pipeEnd, F_GETFL) | O_NONBLOCK);
+        fcntl(pipeEnd, F_SETFD, FD_CLOEXEC);
+    }
+    if (!CanPollSocket(pipeEnds[0]))
+    {
+        close(pipeEnds[0]);
+        close(pipeEnds[1]);
+        return;
+    }
+    wakeupReadEnd_ = pipeEnds[0];
+    wakeupWriteEnd_ = pipeEnds[1];
+#endif
+}
+SelectSocketPoller::~SelectSocketPoller()
+{
+#ifndef WIN32
+    if (wakeupReadEnd_ >= 0)
+    {
+        close(wakeupReadEnd_);
+        close(wakeupWriteEnd_);
+    }
+#endif
+}
+
+void SelectSocketPoller::ClearReadiness()
+{
+    FD_ZERO(&fdsetRecv);
+    FD_ZERO(&fdsetSend);
+    FD_ZERO(&fdsetError);
+    readySockets_.clear();
+}
+void SelectSocketPoller::SetInterest(SOCKET hSocket, bool send, bool receive)
+{
+    SocketInterest& interest = interestBySocket_[hSocket];
+    interest.send = send;
+    interest.receive = receive;
+}
+void SelectSocketPoller::RemoveSocket(SOCKET hSocket)
+{
+    interestBySocket_.erase(hSocket);
+}
+const std::vector<SOCKET>& SelectSocketPoller::ReadySockets() const
+{
+    return readySockets_;
+}
+bool SelectSocketPoller::IsReadyForErrors(SOCKET hSocket) const
+{
+    return CanPollSocket(hSocket) && FD_ISSET(hSocket, &fdsetError);
+}
+bool SelectSocketPoller::IsReadyForSend(SOCKET hSocket) const
+{
+    return CanPollSocket(hSocket) && FD_ISSET(hSocket, &fdsetSend);
+}
+bool SelectSocketPoller::IsReadyForReceive(SOCKET hSocket) const
+{
+    return CanPollSocket(hSocket) && FD_ISSET(hSocket, &fdsetRecv);
+}
+
+int SelectSocketPoller::PollSockets(int timeoutInMilliseconds)
+{
+    ClearReadiness();
+    SOCKET hSocketMax = 0;
+    bool anythingToPoll = !interestBySocket_.empty();
+    if (wakeupReadEnd_ >= 0)
+    {
+        FD_SET(wakeupReadEnd_, &fdsetRecv);
+        hSocketMax = wakeupReadEnd_;
+        anythingToPoll = true;
+    }
+    for (const auto& socketAndInterest: interestBySocket_)
+    {
+        const SOCKET hSocket = socketAndInterest.first;
+        FD_SET(hSocket, &fdsetError);
+        if (socketAndInterest.second.send)
+            FD_SET(hSocket, &fdsetSend);
+        if (socketAndInterest.second.receive)
+            FD_SET(hSocket, &fdsetRecv);
+        hSocketMax = std::max(hSocketMax, hSocket);
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = timeoutInMilliseconds / 1000;
+    timeout.tv_usec = (timeoutInMilliseconds % 1000) * 1000;
+    int numberOfReadySockets = select(anythingToPoll ? hSocketMax + 1 : 0,
+        &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+    if (numberOfReadySockets <= 0)
+        return numberOfReadySockets;
+    if (wakeupReadEnd_ >= 0 && FD_ISSET(wakeupReadEnd_, &fdsetRecv))
+    {
+        DrainWakeups();
+        FD_CLR(wakeupReadEnd_, &fdsetRecv);
+        --numberOfReadySockets;
+    }
+
+    for (const auto& socketAndInterest: interestBySocket_)
+    {
+        const SOCKET hSocket = socketAndInterest.first;
+        if (FD_ISSET(hSocket, &fdsetRecv) || FD_ISSET(hSocket, &fdsetSend) || FD_ISSET(hSocket, &fdsetError))
+            readySockets_.push_back(hSocket);
+    }
+    return numberOfReadySockets;
+}
+void SelectSocketPoller::HandlePollingFailure(int timeoutInMilliseconds)
+{
+    ClearReadiness();
+    if (!interestBySocket_.empty())
+    {
+        int nErr = WSAGetLastError();
+        LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
+        // Have every socket try to receive, so that the ones that went bad are found
+        for (const auto& socketAndInterest: interestBySocket_)
+        {
+            FD_SET(socketAndInterest.first, &fdsetRecv);
+            readySockets_.push_back(socketAndInterest.first);
+        }
+    }
+    MilliSleep(timeoutInMilliseconds);
+}
+bool SelectSocketPoller::CanPollSocket(SOCKET hSocket) const
+{
+    return IsSelectableSocket(hSocket);
+}
+std::string SelectSocketPoller::BackendName() const
+{
+    return "select";
+}
+void SelectSocketPoller::Wakeup()
+{
+#ifndef WIN32
+    if (wakeupWriteEnd_ < 0)
+        return;
+    // A full pipe already holds a pending wake-up
+    const char byte = 0;
+    if (write(wakeupWriteEnd_, &byte, 1) < 0 && errno != EAGAIN)
+        LogPrint("net", "%s: pipe write failed: %s\n", __func__, NetworkErrorString(errno));
+#endif
+}
+void SelectSocketPoller::DrainWakeups()
+{
+#ifndef WIN32
+    char buffer[64];
+    while (read(wakeupReadEnd_, buffer, sizeof(buffer)) > 0)
+    {
+    }
+#endif
+}
@@ -0,0 +1,44 @@
+#ifndef SELECT_SOCKET_POLLER_H
+#define SELECT_SOCKET_POLLER_H
+#include <I_SocketPoller.h>
+#include <map>
+
+/** Portable select() based poller; fd_sets are built from the registered sockets every round.
+ *  Wake-ups go through a self-pipe, which Windows cannot select on, so there they are a no-op
+ *  and a round lasts until its timeout.
+ */
+class SelectSocketPoller final: public I_SocketPoller
+{
+private:
+    struct SocketInterest
+    {
+        bool send;
+        bool receive;
+    };
+    std::map<SOCKET, SocketInterest> interestBySocket_;
+    std::vector<SOCKET> readySockets_;
+    fd_set fdsetRecv;
+    fd_set fdsetSend;
+    fd_set fdsetError;
+    int wakeupReadEnd_;
+    int wakeupWriteEnd_;
+
+    void ClearReadiness();
+    void DrainWakeups();
+public:
+    SelectSocketPoller();
+    ~SelectSocketPoller();
+
+    virtual void SetInterest(SOCKET hSocket, bool send, bool receive);
+    virtual void RemoveSocket(SOCKET hSocket);
+    virtual int PollSockets(int timeoutInMilliseconds);
+    virtual const std::vector<SOCKET>& ReadySockets() const;
+    virtual bool IsReadyForErrors(SOCKET hSocket) const;
+    virtual bool IsReadyForSend(SOCKET hSocket) const;
+    virtual bool IsReadyForReceive(SOCKET hSocket) const;
+    virtual void HandlePollingFailure(int timeoutInMilliseconds);
+    virtual bool CanPollSocket(SOCKET hSocket) const;
+    virtual std::string BackendName() const;
+    virtual void Wakeup();
+};
+#endif// SELECT_SOCKET_POLLER_H
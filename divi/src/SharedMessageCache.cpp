@@ -0,0 +1,58 @@
+#include <SharedMessageCache.h>
+
+SharedMessageCache::SharedMessageCache(
+    size_t maxBytes
+    ): cs_cache()
+    , maxBytes_(maxBytes)
+    , totalBytes_(0u)
+    , messagesByRecency_()
+    , messageByHash_()
+{
+}
+
+SharedSerializedMessage SharedMessageCache::Get(const uint256& hash)
+{
+    LOCK(cs_cache);
+    const auto it = messageByHash_.find(hash);
+    if (it == messageByHash_.end())
+        return SharedSerializedMessage();
+    messagesByRecency_.splice(messagesByRecency_.begin(), messagesByRecency_, it->second);
+    return it->second->second;
+}
+
+void SharedMessageCache::Insert(const uint256& hash, const SharedSerializedMessage& message)
+{
+    if (!message || message->size() > maxBytes_)
+        return;
+
+    LOCK(cs_cache);
+    if (messageByHash_.count(hash) > 0)
+        return;
+    messagesByRecency_.emplace_front(hash, message);
+    messageByHash_[hash] = messagesByRecency_.begin();
+    totalBytes_ += message->size();
+    while (totalBytes_ > maxBytes_)
+        EvictLeastRecentlyUsed();
+}
+
+// requires LOCK(cs_cache)
+void SharedMessageCache::EvictLeastRecentlyUsed()
+{
+    AssertLockHeld(cs_cache);
+    const auto& leastRecentlyUsed = messagesByRecency_.back();
+    totalBytes_ -= leastRecentlyUsed.second->size();
+    messageByHash_.erase(leastRecentlyUsed.first);
+    messagesByRecency_.pop_back();
+}
+
+size_t SharedMessageCache::Size() const
+{
+    LOCK(cs_cache);
+    return messageByHash_.size();
+}
+
+size_t SharedMessageCache::TotalBytes() const
+{
+    LOCK(cs_cache);
+    return totalBytes_;
+}
@@ -0,0 +1,32 @@
+#ifndef SHARED_MESSAGE_CACHE_H
+#define SHARED_MESSAGE_CACHE_H
+#include <Node.h>
+#include <sync.h>
+#include <uint256.h>
+#include <list>
+#include <map>
+
+/** Keeps the most recently used serialized messages (e.g. 'block' responses) around,
+ *  keyed by the hash of their payload, so that serving the same data to several peers
+ *  shares a single buffer. Bounded by the total size of the cached messages. */
+class SharedMessageCache
+{
+private:
+    typedef std::list<std::pair<uint256, SharedSerializedMessage>> RecencyList;
+
+    mutable CCriticalSection cs_cache;
+    const size_t maxBytes_;
+    size_t totalBytes_;
+    RecencyList messagesByRecency_;
+    std::map<uint256, RecencyList::iterator> messageByHash_;
+
+    void EvictLeastRecentlyUsed();
+public:
+    explicit SharedMessageCache(size_t maxBytes);
+
+    SharedSerializedMessage Get(const uint256& hash);
+    void Insert(const uint256& hash, const SharedSerializedMessage& message);
+    size_t Size() const;
+    size_t TotalBytes() const;
+};
+#endif// SHARED_MESSAGE_CACHE_H
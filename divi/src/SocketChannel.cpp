@@ -1,8 +1,16 @@
 #include <SocketChannel.h>
 #include <netbase.h>
 #include <Logging.h>
+#include <string.h>
+#ifndef WIN32
+#include <sys/uio.h>
+#endif
 
-SocketChannel::SocketChannel(SOCKET socket): socket_(socket)
+SocketChannel::SocketChannel(
+    SOCKET socket,
+    SendBacklogListener sendBacklogListener
+    ): socket_(socket)
+    , sendBacklogListener_(std::move(sendBacklogListener))
 {
 }
 int SocketChannel::sendData(const void* buffer, size_t len) const
@@ -13,6 +21,41 @@ int SocketChannel::sendData(const void* buffer, size_t len) const
     return send(socket_, buffer, len, MSG_NOSIGNAL | MSG_DONTWAIT);
 #endif
 }
+int SocketChannel::sendDataBuffers(const std::vector<DataBufferView>& buffers) const
+{
+    if (buffers.empty()) return 0;
+#ifdef WIN32
+    std::vector<WSABUF> wsaBuffers;
+    wsaBuffers.reserve(buffers.size());
+    for (const DataBufferView& buffer: buffers)
+    {
+        WSABUF wsaBuffer;
+        wsaBuffer.buf = static_cast<CHAR*>(const_cast<void*>(buffer.data));
+        wsaBuffer.len = static_cast<ULONG>(buffer.len);
+        wsaBuffers.push_back(wsaBuffer);
+    }
+    // The socket is non-blocking, so this returns at once with what could be queued
+    DWORD bytesSent = 0;
+    if (WSASend(socket_, wsaBuffers.data(), static_cast<DWORD>(wsaBuffers.size()), &bytesSent, 0, NULL, NULL) == SOCKET_ERROR)
+        return SOCKET_ERROR;
+    return static_cast<int>(bytesSent);
+#else
+    std::vector<struct iovec> ioBuffers;
+    ioBuffers.reserve(buffers.size());
+    for (const DataBufferView& buffer: buffers)
+    {
+        struct iovec ioBuffer;
+        ioBuffer.iov_base = const_cast<void*>(buffer.data);
+        ioBuffer.iov_len = buffer.len;
+        ioBuffers.push_back(ioBuffer);
+    }
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = ioBuffers.data();
+    message.msg_iovlen = ioBuffers.size();
+    return sendmsg(socket_, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
+}
 int SocketChannel::receiveData(void* buffer, size_t len) const
 {
 #ifdef WIN32
@@ -43,4 +86,9 @@ bool SocketChannel::hasErrors(bool logErrors) const
         return true;
     }
     return false;
-}
\ No newline at end of file
+}
+void SocketChannel::notifySendBacklog() const
+{
+    if (sendBacklogListener_ && socket_ != INVALID_SOCKET)
+        sendBacklogListener_(socket_);
+}
@@ -2,17 +2,23 @@
 #define SOCKET_CHANNEl_H
 #include <I_CommunicationChannel.h>
 #include <compat.h>
+#include <functional>
 class SocketChannel final: public I_CommunicationChannel
 {
+public:
+    typedef std::function<void(SOCKET)> SendBacklogListener;
 private:
     SOCKET socket_;
+    const SendBacklogListener sendBacklogListener_;
 public:
-    SocketChannel(SOCKET socket);
+    SocketChannel(SOCKET socket, SendBacklogListener sendBacklogListener = SendBacklogListener());
     virtual int sendData(const void* buffer, size_t len) const;
+    virtual int sendDataBuffers(const std::vector<DataBufferView>& buffers) const;
     virtual int receiveData(void* buffer, size_t len) const;
     virtual void close();
     virtual bool isValid() const;
     virtual bool hasErrors(bool logErrors) const;
+    virtual void notifySendBacklog() const;
 
     SOCKET getSocket() const;
 };
@@ -52,7 +52,8 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
 
     const CBlockIndex* pindexSlow = NULL;
     {
-        LOCK(dependencies->getMainCriticalSection());
+        // The mempool and the transaction index have locks of their own, only the
+        // fallback through the coins view needs cs_main
         {
             CTxMemPool& mempool = dependencies->getMemoryPool();
             if (mempool.lookup(hash, txOut) || mempool.lookupBareTxid(hash, txOut)) {
@@ -86,6 +87,7 @@ bool GetTransaction(const uint256& hash, CTransaction& txOut, uint256& hashBlock
         }
 
         if (fAllowSlow) { // use coin database to locate block that contains transaction, and scan it
+            LOCK(dependencies->getMainCriticalSection());
             int nHeight = -1;
             {
                 const CCoins* coins = chainstate->CoinsTip().AccessCoins(hash);
@@ -2,48 +2,246 @@
 
 #include <txdb.h>
 #include <Logging.h>
+#include <clientversion.h>
+#include <streams.h>
+
+#include <algorithm>
+#include <map>
+
+namespace
+{
+typedef std::pair<uint160, int> AddressHashAndType;
+
+std::vector<AddressHashAndType> DistinctAddresses(const std::vector<AddressHashAndType>& addresses)
+{
+    std::vector<AddressHashAndType> distinctAddresses(addresses);
+    std::sort(distinctAddresses.begin(), distinctAddresses.end(),
+        [](const AddressHashAndType& a, const AddressHashAndType& b) {
+            return std::make_pair(a.second, a.first) < std::make_pair(b.second, b.first);
+        });
+    distinctAddresses.erase(std::unique(distinctAddresses.begin(), distinctAddresses.end()), distinctAddresses.end());
+    return distinctAddresses;
+}
+
+template <typename Key>
+std::string SerializedKey(const Key& key)
+{
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << key;
+    return stream.str();
+}
+
+/** Orders the entries of several addresses by height and position in the block, and
+ *  otherwise like the database keys, which is the order a scan of one address follows */
+bool PrecedesInHeightOrder(const CAddressIndexKey& a, const CAddressIndexKey& b)
+{
+    if (a.blockHeight != b.blockHeight)
+        return a.blockHeight < b.blockHeight;
+    if (a.txindex != b.txindex)
+        return a.txindex < b.txindex;
+    return SerializedKey(a) < SerializedKey(b);
+}
+
+CAddressIndexKey FirstKeyOfAddress(const AddressHashAndType& address, int start)
+{
+    CAddressIndexKey from;
+    from.type = address.second;
+    from.hashBytes = address.first;
+    from.blockHeight = start > 0 ? start : 0;
+    return from;
+}
+} // anonymous namespace
 
 bool TransactionSearchIndexes::GetAddressIndex(
-    const CBlockTreeDB* pblocktree,
+    const CSearchIndexDB* searchIndexes,
     uint160 addressHash,
     int type,
     std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
     int start,
     int end)
 {
-    if (!pblocktree->GetAddressIndexing())
+    if (!searchIndexes->GetAddressIndexing())
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressIndex(addressHash, type, addressIndex, start, end))
+    if (!searchIndexes->ReadAddressIndex(addressHash, type, addressIndex, start, end))
         return error("unable to get txids for address");
 
     return true;
 }
 
 bool TransactionSearchIndexes::GetAddressUnspent(
-    const CBlockTreeDB* pblocktree,
+    const CSearchIndexDB* searchIndexes,
     uint160 addressHash,
     int type,
     std::vector<std::pair<CAddressUnspentKey,CAddressUnspentValue> > &unspentOutputs)
 {
-    if (!pblocktree->GetAddressIndexing())
+    if (!searchIndexes->GetAddressIndexing())
         return error("address index not enabled");
 
-    if (!pblocktree->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
+    if (!searchIndexes->ReadAddressUnspentIndex(addressHash, type, unspentOutputs))
         return error("unable to get txids for address");
 
     return true;
 }
 
+bool TransactionSearchIndexes::GetAddressIndexPage(
+    const CSearchIndexDB* searchIndexes,
+    const std::vector<std::pair<uint160, int> >& addresses,
+    int start,
+    int end,
+    const CAddressIndexKey* after,
+    size_t limit,
+    std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+    bool& more)
+{
+    if (!searchIndexes->GetAddressIndexing())
+        return error("address index not enabled");
+
+    // The page is among the first limit + 1 entries of each address
+    std::vector<std::pair<CAddressIndexKey, CAmount> > candidates;
+    for (const AddressHashAndType& address: DistinctAddresses(addresses)) {
+        CAddressIndexKey from = FirstKeyOfAddress(address, start);
+        if (after) {
+            from.blockHeight = after->blockHeight;
+            from.txindex = after->txindex;
+        }
+        size_t entriesOfAddress = 0;
+        const bool scanned = searchIndexes->ScanAddressIndex(from, end,
+            [&](const CAddressIndexKey& key, CAmount value) {
+                if (after && !PrecedesInHeightOrder(*after, key))
+                    return true;
+                candidates.push_back(std::make_pair(key, value));
+                return ++entriesOfAddress <= limit;
+            });
+        if (!scanned)
+            return error("unable to get txids for address");
+    }
+
+    std::sort(candidates.begin(), candidates.end(),
+        [](const std::pair<CAddressIndexKey, CAmount>& a, const std::pair<CAddressIndexKey, CAmount>& b) {
+            return PrecedesInHeightOrder(a.first, b.first);
+        });
+    more = candidates.size() > limit;
+    if (more)
+        candidates.resize(limit);
+    addressIndex.insert(addressIndex.end(), candidates.begin(), candidates.end());
+    return true;
+}
+
+bool TransactionSearchIndexes::GetAddressTransactionPage(
+    const CSearchIndexDB* searchIndexes,
+    const std::vector<std::pair<uint160, int> >& addresses,
+    int start,
+    int end,
+    const CAddressIndexKey* after,
+    size_t limit,
+    std::vector<CAddressIndexKey>& transactions,
+    bool& more)
+{
+    if (!searchIndexes->GetAddressIndexing())
+        return error("address index not enabled");
+
+    // The page is among the first limit + 1 transactions of each address
+    std::map<std::pair<int, unsigned int>, CAddressIndexKey> candidates;
+    for (const AddressHashAndType& address: DistinctAddresses(addresses)) {
+        CAddressIndexKey from = FirstKeyOfAddress(address, start);
+        if (after) {
+            from.blockHeight = after->blockHeight;
+            from.txindex = after->txindex + 1;
+        }
+        size_t transactionsOfAddress = 0;
+        std::pair<int, unsigned int> lastPosition(-1, 0);
+        const bool scanned = searchIndexes->ScanAddressIndex(from, end,
+            [&](const CAddressIndexKey& key, CAmount) {
+                const std::pair<int, unsigned int> position(key.blockHeight, key.txindex);
+                if (position == lastPosition)
+                    return true;
+                if (transactionsOfAddress++ == limit + 1)
+                    return false;
+                lastPosition = position;
+                candidates.insert(std::make_pair(position, key));
+                return true;
+            });
+        if (!scanned)
+            return error("unable to get txids for address");
+    }
+
+    more = candidates.size() > limit;
+    for (const auto& positionAndKey: candidates) {
+        if (transactions.size() == limit)
+            break;
+        transactions.push_back(positionAndKey.second);
+    }
+    return true;
+}
+
+bool TransactionSearchIndexes::GetAddressUnspentPage(
+    const CSearchIndexDB* searchIndexes,
+    const std::vector<std::pair<uint160, int> >& addresses,
+    const CAddressUnspentKey* after,
+    size_t limit,
+    std::vector<std::pair<CAddressUnspentKey,CAddressUnspentValue> >& unspentOutputs,
+    bool& more)
+{
+    if (!searchIndexes->GetAddressIndexing())
+        return error("address index not enabled");
+
+    std::vector<std::pair<CAddressUnspentKey,CAddressUnspentValue> > page;
+    for (const AddressHashAndType& address: DistinctAddresses(addresses)) {
+        CAddressUnspentKey from;
+        from.type = address.second;
+        from.hashBytes = address.first;
+        const bool resumesInAddress = after && after->type == from.type && after->hashBytes == from.hashBytes;
+        if (after && !resumesInAddress &&
+            std::make_pair(static_cast<int>(from.type), from.hashBytes) < std::make_pair(static_cast<int>(after->type), after->hashBytes))
+            continue;
+        if (resumesInAddress)
+            from = *after;
+
+        const bool scanned = searchIndexes->ScanAddressUnspentIndex(from,
+            [&](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+                if (resumesInAddress && key.txhash == after->txhash && key.index == after->index)
+                    return true;
+                page.push_back(std::make_pair(key, value));
+                return page.size() <= limit;
+            });
+        if (!scanned)
+            return error("unable to get txids for address");
+        if (page.size() > limit)
+            break;
+    }
+
+    more = page.size() > limit;
+    if (more)
+        page.resize(limit);
+    unspentOutputs.insert(unspentOutputs.end(), page.begin(), page.end());
+    return true;
+}
+
+bool TransactionSearchIndexes::GetAddressBalance(
+    const CSearchIndexDB* searchIndexes,
+    uint160 addressHash,
+    int type,
+    CAddressBalance& balance)
+{
+    if (!searchIndexes->GetAddressIndexing())
+        return error("address index not enabled");
+
+    if (!searchIndexes->ReadAddressBalance(addressHash, type, balance))
+        return error("unable to get balance for address");
+
+    return true;
+}
+
 bool TransactionSearchIndexes::GetSpentIndex(
-    const CBlockTreeDB* pblocktree,
+    const CSearchIndexDB* searchIndexes,
     const CSpentIndexKey &key,
     CSpentIndexValue &value)
 {
-    if (!pblocktree->GetSpentIndexing())
+    if (!searchIndexes->GetSpentIndexing())
         return false;
 
-    if (!pblocktree->ReadSpentIndex(key, value))
+    if (!searchIndexes->ReadSpentIndex(key, value))
         return false;
 
     return true;
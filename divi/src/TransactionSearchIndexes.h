@@ -3,23 +3,64 @@
 #include <uint256.h>
 #include <addressindex.h>
 #include <spentindex.h>
-class CBlockTreeDB;
+#include <utility>
+#include <vector>
+class CSearchIndexDB;
 namespace TransactionSearchIndexes
 {
     bool GetAddressIndex(
-        const CBlockTreeDB* pblocktree,
+        const CSearchIndexDB* searchIndexes,
         uint160 addressHash,
         int type,
         std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
         int start = 0,
         int end = 0);
     bool GetAddressUnspent(
-        const CBlockTreeDB* pblocktree,
+        const CSearchIndexDB* searchIndexes,
         uint160 addressHash,
         int type,
         std::vector<std::pair<CAddressUnspentKey,CAddressUnspentValue> > &unspentOutputs);
+
+    /** One page of the address index entries of the addresses, ordered by height and
+     *  position in the block, resuming strictly after the entry after points to; more
+     *  is set when further entries follow the page */
+    bool GetAddressIndexPage(
+        const CSearchIndexDB* searchIndexes,
+        const std::vector<std::pair<uint160, int> >& addresses,
+        int start,
+        int end,
+        const CAddressIndexKey* after,
+        size_t limit,
+        std::vector<std::pair<CAddressIndexKey, CAmount> >& addressIndex,
+        bool& more);
+    /** One page of the transactions of the addresses, ordered like GetAddressIndexPage,
+     *  as the first index entry of each transaction; resumes after the transaction of
+     *  the entry after points to */
+    bool GetAddressTransactionPage(
+        const CSearchIndexDB* searchIndexes,
+        const std::vector<std::pair<uint160, int> >& addresses,
+        int start,
+        int end,
+        const CAddressIndexKey* after,
+        size_t limit,
+        std::vector<CAddressIndexKey>& transactions,
+        bool& more);
+    /** One page of the unspent outputs of the addresses, in index key order, resuming
+     *  strictly after the output after points to */
+    bool GetAddressUnspentPage(
+        const CSearchIndexDB* searchIndexes,
+        const std::vector<std::pair<uint160, int> >& addresses,
+        const CAddressUnspentKey* after,
+        size_t limit,
+        std::vector<std::pair<CAddressUnspentKey,CAddressUnspentValue> >& unspentOutputs,
+        bool& more);
+    bool GetAddressBalance(
+        const CSearchIndexDB* searchIndexes,
+        uint160 addressHash,
+        int type,
+        CAddressBalance& balance);
     bool GetSpentIndex(
-        const CBlockTreeDB* pblocktree,
+        const CSearchIndexDB* searchIndexes,
         const CSpentIndexKey &key,
         CSpentIndexValue &value);
 }
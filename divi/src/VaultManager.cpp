@@ -7,10 +7,38 @@
 #include <SpentOutputTracker.h>
 #include <I_VaultManagerDatabase.h>
 #include <I_MerkleTxConfirmationNumberCalculator.h>
+#include <I_UtxoOwnershipDetector.h>
+#include <WalletUtxoIndex.h>
 #include <Logging.h>
+#include <chainparams.h>
 
 constexpr const char* VAULT_DEPOSIT_DESCRIPTION = "isVaultDeposit";
 
+namespace
+{
+/** Lets the UTXO index pick out outputs paying to managed scripts. Deposit
+ *  descriptions narrow this down further, which is checked per transaction. */
+class ManagedScriptDetector final: public I_UtxoOwnershipDetector
+{
+private:
+    const ManagedScripts& managedScripts_;
+public:
+    explicit ManagedScriptDetector(
+        const ManagedScripts& managedScripts
+        ): managedScripts_(managedScripts)
+    {
+    }
+    isminetype isMine(const CTxOut& output) const override
+    {
+        return managedScripts_.count(output.scriptPubKey) > 0? isminetype::ISMINE_MANAGED_VAULT: isminetype::ISMINE_NO;
+    }
+    bool isChange(const CTxOut&) const override
+    {
+        return false;
+    }
+};
+} // anonymous namespace
+
 VaultManager::VaultManager(
     const I_MerkleTxConfirmationNumberCalculator& confirmationsCalculator,
     I_VaultManagerDatabase& vaultManagerDB
@@ -21,6 +49,8 @@ VaultManager::VaultManager(
     , outputTracker_(new SpentOutputTracker(*walletTxRecord_,confirmationsCalculator_))
     , managedScripts_()
     , whiteListedScripts_()
+    , managedScriptDetector_(new ManagedScriptDetector(managedScripts_))
+    , utxoIndex_(new WalletUtxoIndex(*managedScriptDetector_,*outputTracker_,*walletTxRecord_,confirmationsCalculator_,Params().MaxReorganizationDepth()))
 {
     LOCK(cs_vaultManager_);
     vaultManagerDB_.ReadManagedScripts(managedScripts_);
@@ -41,6 +71,8 @@ VaultManager::VaultManager(
 
 VaultManager::~VaultManager()
 {
+    utxoIndex_.reset();
+    managedScriptDetector_.reset();
     outputTracker_.reset();
     walletTxRecord_.reset();
 }
@@ -165,6 +197,12 @@ void VaultManager::addSingleTransaction(const CTransaction& tx, const CBlock *pb
         CWalletTx walletTx(tx);
         if(!blockIsNull) walletTx.SetMerkleBranch(*pblock);
         std::pair<CWalletTx*, bool> walletTxAndRecordStatus = outputTracker_->UpdateSpends(walletTx,false);
+        utxoIndex_->recomputeCachedTxEntries(*walletTxAndRecordStatus.first);
+        for(const CTxIn& input: tx.vin)
+        {
+            const CWalletTx* spentTx = walletTxRecord_->GetWalletTx(input.prevout.hash);
+            if(spentTx) utxoIndex_->recomputeCachedTxEntries(*spentTx);
+        }
 
         if(deposit || txIsWhiteListed || (tx.IsCoinStake() && !allInputsAreKnown(tx)) )
         {
@@ -196,6 +234,7 @@ void VaultManager::addManagedScript(const CScript& script)
     if(managedScripts_.count(script) == 0)
     {
         managedScripts_.insert(script);
+        utxoIndex_->invalidate();
         vaultManagerDB_.WriteManagedScript(script);
     }
 }
@@ -214,6 +253,7 @@ void VaultManager::removeManagedScript(const CScript& script)
     if(managedScripts_.count(script) > 0)
     {
         managedScripts_.erase(script);
+        utxoIndex_->invalidate();
         vaultManagerDB_.EraseManagedScript(script);
     }
 }
@@ -222,11 +262,10 @@ UnspentOutputs VaultManager::getManagedUTXOs(VaultUTXOFilters filter) const
 {
     LOCK(cs_vaultManager_);
     UnspentOutputs outputs;
-    auto managedScriptsLimitsCopy = managedScripts_;
-    for(const auto& hashAndTransaction: walletTxRecord_->GetWalletTransactions())
+    for(const CWalletTx* candidateTx: utxoIndex_->GetTransactionsWithUnspentOutputs(isminetype::ISMINE_MANAGED_VAULT))
     {
-        uint256 hash = hashAndTransaction.first;
-        const CWalletTx& tx = hashAndTransaction.second;
+        const uint256 hash = candidateTx->GetHash();
+        const CWalletTx& tx = *candidateTx;
         if(!( (allInputsAreKnown(tx) && tx.IsCoinStake()) || tx.mapValue.count(VAULT_DEPOSIT_DESCRIPTION) > 0 )) continue;
 
         const int depth = confirmationsCalculator_.GetNumberOfBlockConfirmations(tx);
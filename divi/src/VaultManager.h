@@ -22,6 +22,8 @@ class I_VaultManagerDatabase;
 class WalletTransactionRecord;
 class I_SpentOutputTracker;
 class I_MerkleTxConfirmationNumberCalculator;
+class I_UtxoOwnershipDetector;
+class WalletUtxoIndex;
 
 enum VaultUTXOFilters
 {
@@ -42,6 +44,8 @@ private:
     std::unique_ptr<I_SpentOutputTracker> outputTracker_;
     ManagedScripts managedScripts_;
     ManagedScripts whiteListedScripts_;
+    std::unique_ptr<I_UtxoOwnershipDetector> managedScriptDetector_;
+    std::unique_ptr<WalletUtxoIndex> utxoIndex_;
 
     bool isManagedScript(const CScript& script) const;
     bool transactionIsWhitelisted(const CTransaction& tx) const;
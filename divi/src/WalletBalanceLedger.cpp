@@ -0,0 +1,231 @@
+#include <WalletBalanceLedger.h>
+
+#include <I_AppendOnlyTransactionRecord.h>
+#include <I_MerkleTxConfirmationNumberCalculator.h>
+#include <I_SpentOutputTracker.h>
+#include <I_UtxoOwnershipDetector.h>
+#include <Logging.h>
+#include <WalletTx.h>
+#include <utilmoneystr.h>
+
+#include <cassert>
+
+WalletBalanceLedger::WalletBalanceLedger(
+    const I_UtxoOwnershipDetector& ownershipDetector,
+    const I_SpentOutputTracker& spentOutputTracker,
+    const I_AppendOnlyTransactionRecord& txRecord,
+    const I_MerkleTxConfirmationNumberCalculator& confsCalculator,
+    const I_WalletBalanceCalculator* fullScanCalculator
+    ): ownershipDetector_(ownershipDetector)
+    , spentOutputTracker_(spentOutputTracker)
+    , txRecord_(txRecord)
+    , confsCalculator_(confsCalculator)
+    , fullScanCalculator_(fullScanCalculator)
+    , entries_()
+    , volatileTransactions_()
+    , changedTransactions_()
+    , balances_()
+    , rebuildRequired_(false)
+{
+}
+
+void WalletBalanceLedger::recomputeCachedTxEntries(const CWalletTx& transaction) const
+{
+    changedTransactions_.insert(transaction.GetHash());
+}
+
+void WalletBalanceLedger::invalidate() const
+{
+    rebuildRequired_ = true;
+}
+
+// Mirrors the TxFlag filtering of FilteredTransactionsCalculator
+void WalletBalanceLedger::classify(const CWalletTx& transaction, Bucket& bucket, bool& countsAsSpend) const
+{
+    const int depth = confsCalculator_.GetNumberOfBlockConfirmations(transaction);
+    countsAsSpend = depth >= 0;
+    // Buckets line up with the filters the balance queries pass to FilteredTransactionsCalculator
+    const int txFlags = GetDepthAndMaturityFlags(confsCalculator_, transaction, depth);
+    if(txFlags == 0)
+    {
+        bucket = NOT_COUNTED;
+    }
+    else if((txFlags & TxFlag::UNCONFIRMED) > 0)
+    {
+        bucket = UNCONFIRMED;
+    }
+    else
+    {
+        bucket = (txFlags & TxFlag::IMMATURE) > 0? CONFIRMED_AND_IMMATURE: CONFIRMED_AND_MATURE;
+    }
+}
+
+void WalletBalanceLedger::applyToBalances(const LedgerEntry& entry, int sign) const
+{
+    BalanceByOwnership& bucketBalances = balances_[entry.bucket];
+    for(const auto& ownershipAndAmount: entry.unspentByOwnership)
+    {
+        bucketBalances[ownershipAndAmount.first] += sign * ownershipAndAmount.second;
+    }
+}
+
+void WalletBalanceLedger::reevaluate(const uint256& txid) const
+{
+    const CWalletTx* transaction = txRecord_.GetWalletTx(txid);
+    auto it = entries_.find(txid);
+    const bool previouslyCountedAsSpend = it != entries_.end() && it->second.countsAsSpend;
+    if(it != entries_.end())
+    {
+        applyToBalances(it->second, -1);
+        entries_.erase(it);
+    }
+    volatileTransactions_.erase(txid);
+    if(!transaction) return;
+
+    LedgerEntry entry;
+    classify(*transaction, entry.bucket, entry.countsAsSpend);
+    if(entry.bucket != NOT_COUNTED)
+    {
+        for(unsigned outputIndex = 0u; outputIndex < transaction->vout.size(); ++outputIndex)
+        {
+            const CTxOut& output = transaction->vout[outputIndex];
+            const isminetype ownership = ownershipDetector_.isMine(output);
+            if(ownership != isminetype::ISMINE_NO && !spentOutputTracker_.IsSpent(txid, outputIndex, 0))
+            {
+                entry.unspentByOwnership[static_cast<uint8_t>(ownership)] += output.nValue;
+            }
+        }
+    }
+    applyToBalances(entry, 1);
+    if(entry.bucket == UNCONFIRMED || entry.bucket == CONFIRMED_AND_IMMATURE ||
+        (entry.bucket == NOT_COUNTED && entry.countsAsSpend))
+    {
+        volatileTransactions_.insert(txid);
+    }
+    if(entry.countsAsSpend != previouslyCountedAsSpend)
+    {
+        for(const CTxIn& input: transaction->vin)
+        {
+            if(entries_.count(input.prevout.hash) > 0) changedTransactions_.insert(input.prevout.hash);
+        }
+    }
+    entries_.emplace(txid, std::move(entry));
+}
+
+void WalletBalanceLedger::rebuild() const
+{
+    entries_.clear();
+    volatileTransactions_.clear();
+    changedTransactions_.clear();
+    for(BalanceByOwnership& bucketBalances: balances_) bucketBalances.clear();
+    for(const auto& txidAndTransaction: txRecord_.GetWalletTransactions())
+    {
+        reevaluate(txidAndTransaction.first);
+    }
+    // Spent states only depend on the spending transactions, which are all up to date now
+    changedTransactions_.clear();
+    rebuildRequired_ = false;
+}
+
+void WalletBalanceLedger::refresh() const
+{
+    for(const uint256& txid: volatileTransactions_)
+    {
+        const CWalletTx* transaction = txRecord_.GetWalletTx(txid);
+        const LedgerEntry& entry = entries_.at(txid);
+        Bucket bucket = NOT_COUNTED;
+        bool countsAsSpend = false;
+        if(transaction) classify(*transaction, bucket, countsAsSpend);
+        if(!transaction || bucket != entry.bucket || countsAsSpend != entry.countsAsSpend)
+            changedTransactions_.insert(txid);
+    }
+    while(!changedTransactions_.empty())
+    {
+        const uint256 txid = *changedTransactions_.begin();
+        changedTransactions_.erase(changedTransactions_.begin());
+        reevaluate(txid);
+    }
+    // Transactions loaded from disk (or re-loaded after pruning) are recorded without being reported
+    if(rebuildRequired_ || entries_.size() != txRecord_.GetWalletTransactions().size())
+    {
+        rebuild();
+    }
+}
+
+CAmount WalletBalanceLedger::sumOfBucket(Bucket bucket, const UtxoOwnershipFilter& ownershipFilter) const
+{
+    CAmount total = 0;
+    for(const auto& ownershipAndAmount: balances_[bucket])
+    {
+        if(ownershipFilter.hasRequested(static_cast<isminetype>(ownershipAndAmount.first)))
+            total += ownershipAndAmount.second;
+    }
+    return total;
+}
+
+bool WalletBalanceLedger::allInputsAreOwned(const CWalletTx& transaction, const UtxoOwnershipFilter& ownershipFilter) const
+{
+    for(const CTxIn& input: transaction.vin)
+    {
+        const CWalletTx* spentTransaction = txRecord_.GetWalletTx(input.prevout.hash);
+        if(!spentTransaction) return false;
+        if(!ownershipFilter.hasRequested(ownershipDetector_.isMine(spentTransaction->vout[input.prevout.n]))) return false;
+    }
+    return true;
+}
+
+CAmount WalletBalanceLedger::checkedAgainstFullScan(const char* balanceName, CAmount ledgerBalance, CAmount fullScanBalance) const
+{
+    if(ledgerBalance != fullScanBalance)
+    {
+        LogPrintf("ERROR: %s balance ledger is at %s, a full wallet scan gives %s\n",
+            balanceName, FormatMoney(ledgerBalance), FormatMoney(fullScanBalance));
+        assert(ledgerBalance == fullScanBalance);
+    }
+    return ledgerBalance;
+}
+
+CAmount WalletBalanceLedger::getBalance(UtxoOwnershipFilter ownershipFilter) const
+{
+    refresh();
+    const CAmount balance = sumOfBucket(CONFIRMED_AND_MATURE, ownershipFilter);
+    if(!fullScanCalculator_) return balance;
+    return checkedAgainstFullScan("confirmed", balance, fullScanCalculator_->getBalance(ownershipFilter));
+}
+
+CAmount WalletBalanceLedger::getUnconfirmedBalance(UtxoOwnershipFilter ownershipFilter) const
+{
+    refresh();
+    const CAmount balance = sumOfBucket(UNCONFIRMED, ownershipFilter);
+    if(!fullScanCalculator_) return balance;
+    return checkedAgainstFullScan("unconfirmed", balance, fullScanCalculator_->getUnconfirmedBalance(ownershipFilter));
+}
+
+CAmount WalletBalanceLedger::getImmatureBalance(UtxoOwnershipFilter ownershipFilter) const
+{
+    refresh();
+    const CAmount balance = sumOfBucket(CONFIRMED_AND_IMMATURE, ownershipFilter);
+    if(!fullScanCalculator_) return balance;
+    return checkedAgainstFullScan("immature", balance, fullScanCalculator_->getImmatureBalance(ownershipFilter));
+}
+
+CAmount WalletBalanceLedger::getSpendableBalance(UtxoOwnershipFilter ownershipFilter) const
+{
+    refresh();
+    CAmount balance = sumOfBucket(CONFIRMED_AND_MATURE, ownershipFilter);
+    // Unconfirmed outputs only count once the wallet funded all of their transaction
+    for(const uint256& txid: volatileTransactions_)
+    {
+        const LedgerEntry& entry = entries_.at(txid);
+        if(entry.bucket != UNCONFIRMED) continue;
+        const CWalletTx* transaction = txRecord_.GetWalletTx(txid);
+        if(!allInputsAreOwned(*transaction, ownershipFilter)) continue;
+        for(const auto& ownershipAndAmount: entry.unspentByOwnership)
+        {
+            if(ownershipFilter.hasRequested(static_cast<isminetype>(ownershipAndAmount.first)))
+                balance += ownershipAndAmount.second;
+        }
+    }
+    if(!fullScanCalculator_) return balance;
+    return checkedAgainstFullScan("spendable", balance, fullScanCalculator_->getSpendableBalance(ownershipFilter));
+}
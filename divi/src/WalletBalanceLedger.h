@@ -0,0 +1,85 @@
+#ifndef WALLET_BALANCE_LEDGER_H
+#define WALLET_BALANCE_LEDGER_H
+#include <WalletBalanceCalculator.h>
+#include <uint256.h>
+#include <map>
+#include <set>
+
+class I_AppendOnlyTransactionRecord;
+class I_MerkleTxConfirmationNumberCalculator;
+class I_SpentOutputTracker;
+class I_UtxoOwnershipDetector;
+class CWalletTx;
+
+/** Keeps the wallet balances per ownership type and maturity bucket up to date as
+ *  transactions change, instead of going over every wallet transaction per query.
+ *
+ *  A transaction is re-evaluated when the wallet reports it changed (recorded, updated,
+ *  spent from, disconnected). Without such a report only two kinds can move to another
+ *  bucket: unconfirmed transactions, which count as conflicted once they leave the
+ *  mempool, and immature rewards, which mature as the chain grows. Those are re-checked
+ *  on each query, and when one stops or starts counting as a spend, the wallet
+ *  transactions it spends from are re-evaluated as well.
+ *
+ *  Given a full-scan calculator (-checkwalletbalances), every result is also computed
+ *  the old way and the two must agree.
+ */
+class WalletBalanceLedger final: public I_WalletBalanceCalculator
+{
+private:
+    enum Bucket
+    {
+        NOT_COUNTED,
+        UNCONFIRMED,
+        CONFIRMED_AND_IMMATURE,
+        CONFIRMED_AND_MATURE,
+        NUMBER_OF_BUCKETS,
+    };
+    typedef std::map<uint8_t, CAmount> BalanceByOwnership;
+    struct LedgerEntry
+    {
+        Bucket bucket;
+        bool countsAsSpend;
+        BalanceByOwnership unspentByOwnership;
+    };
+
+    const I_UtxoOwnershipDetector& ownershipDetector_;
+    const I_SpentOutputTracker& spentOutputTracker_;
+    const I_AppendOnlyTransactionRecord& txRecord_;
+    const I_MerkleTxConfirmationNumberCalculator& confsCalculator_;
+    const I_WalletBalanceCalculator* const fullScanCalculator_;
+
+    mutable std::map<uint256, LedgerEntry> entries_;
+    mutable std::set<uint256> volatileTransactions_;
+    mutable std::set<uint256> changedTransactions_;
+    mutable BalanceByOwnership balances_[NUMBER_OF_BUCKETS];
+    mutable bool rebuildRequired_;
+
+    void classify(const CWalletTx& transaction, Bucket& bucket, bool& countsAsSpend) const;
+    void applyToBalances(const LedgerEntry& entry, int sign) const;
+    void reevaluate(const uint256& txid) const;
+    void rebuild() const;
+    void refresh() const;
+    CAmount sumOfBucket(Bucket bucket, const UtxoOwnershipFilter& ownershipFilter) const;
+    bool allInputsAreOwned(const CWalletTx& transaction, const UtxoOwnershipFilter& ownershipFilter) const;
+    CAmount checkedAgainstFullScan(const char* balanceName, CAmount ledgerBalance, CAmount fullScanBalance) const;
+
+public:
+    WalletBalanceLedger(
+        const I_UtxoOwnershipDetector& ownershipDetector,
+        const I_SpentOutputTracker& spentOutputTracker,
+        const I_AppendOnlyTransactionRecord& txRecord,
+        const I_MerkleTxConfirmationNumberCalculator& confsCalculator,
+        const I_WalletBalanceCalculator* fullScanCalculator = nullptr);
+
+    /** Re-evaluates the transaction on the next query */
+    void recomputeCachedTxEntries(const CWalletTx& transaction) const;
+    /** Re-evaluates everything on the next query, e.g. after the ownership rules changed */
+    void invalidate() const;
+
+    CAmount getBalance(UtxoOwnershipFilter ownershipFilter = isminetype::ISMINE_SPENDABLE) const override;
+    CAmount getUnconfirmedBalance(UtxoOwnershipFilter ownershipFilter = isminetype::ISMINE_SPENDABLE) const override;
+    CAmount getImmatureBalance(UtxoOwnershipFilter ownershipFilter = isminetype::ISMINE_SPENDABLE) const override;
+    CAmount getSpendableBalance(UtxoOwnershipFilter ownershipFilter = isminetype::ISMINE_SPENDABLE) const override;
+};
+#endif// WALLET_BALANCE_LEDGER_H
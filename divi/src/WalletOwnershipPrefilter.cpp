@@ -0,0 +1,100 @@
+#include <WalletOwnershipPrefilter.h>
+
+#include <hash.h>
+#include <primitives/transaction.h>
+#include <random.h>
+#include <script/standard.h>
+
+#include <limits>
+
+namespace
+{
+uint64_t RandomSalt()
+{
+    return GetRand(std::numeric_limits<uint64_t>::max());
+}
+} // anonymous namespace
+
+size_t WalletOwnershipPrefilter::SaltedHasher::operator()(const CScript& script) const
+{
+    return CSipHasher(k0, k1).Write(script.data(), script.size()).Finalize();
+}
+
+size_t WalletOwnershipPrefilter::SaltedHasher::operator()(const CKeyID& keyID) const
+{
+    return CSipHasher(k0, k1).Write(keyID.begin(), keyID.size()).Finalize();
+}
+
+size_t WalletOwnershipPrefilter::SaltedHasher::operator()(const uint256& txid) const
+{
+    return SipHashUint256(k0, k1, txid);
+}
+
+WalletOwnershipPrefilter::WalletOwnershipPrefilter(
+    ): scripts_(0u, SaltedHasher{RandomSalt(), RandomSalt()})
+    , keyIDs_(0u, scripts_.hash_function())
+    , transactionIDs_(0u, scripts_.hash_function())
+{
+}
+
+void WalletOwnershipPrefilter::addKey(const CKeyID& keyID)
+{
+    keyIDs_.insert(keyID);
+    scripts_.insert(GetScriptForDestination(keyID));
+}
+
+void WalletOwnershipPrefilter::addRedeemScript(const CScript& redeemScript)
+{
+    scripts_.insert(GetScriptForDestination(CScriptID(redeemScript)));
+}
+
+void WalletOwnershipPrefilter::addScript(const CScript& scriptPubKey)
+{
+    scripts_.insert(scriptPubKey);
+}
+
+void WalletOwnershipPrefilter::addTransaction(const uint256& txid)
+{
+    transactionIDs_.insert(txid);
+}
+
+bool WalletOwnershipPrefilter::mightOwn(const CScript& scriptPubKey) const
+{
+    if(scripts_.count(scriptPubKey) > 0) return true;
+    // Owned only through a known key or redeem script, whose scripts are all listed
+    if(scriptPubKey.IsPayToPublicKeyHash() || scriptPubKey.IsPayToScriptHash()) return false;
+
+    txnouttype whichType;
+    std::vector<valtype> solutions;
+    if(!ExtractScriptPubKeyFormat(scriptPubKey, whichType, solutions)) return false;
+    switch(whichType)
+    {
+    case TX_PUBKEY:
+        return keyIDs_.count(CPubKey(solutions[0]).GetID()) > 0;
+    case TX_VAULT:
+        return keyIDs_.count(CKeyID(uint160(solutions[0]))) > 0 || keyIDs_.count(CKeyID(uint160(solutions[1]))) > 0;
+    case TX_MULTISIG:
+        // Only recognized when all of the keys are the wallet's
+        for(auto it = solutions.begin() + 1; it + 1 < solutions.end(); ++it)
+        {
+            if(keyIDs_.count(CPubKey(*it).GetID()) == 0) return false;
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool WalletOwnershipPrefilter::mightConcern(const CTransaction& tx) const
+{
+    if(transactionIDs_.count(tx.GetHash()) > 0) return true;
+    for(const CTxIn& input: tx.vin)
+    {
+        if(transactionIDs_.count(input.prevout.hash) > 0) return true;
+    }
+    for(const CTxOut& output: tx.vout)
+    {
+        if(mightOwn(output.scriptPubKey)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,54 @@
+#ifndef WALLET_OWNERSHIP_PREFILTER_H
+#define WALLET_OWNERSHIP_PREFILTER_H
+#include <pubkey.h>
+#include <script/script.h>
+#include <stdint.h>
+#include <uint256.h>
+#include <unordered_set>
+
+class CTransaction;
+
+/** Conservative stand-in for the wallet's ownership checks that does not consult the key store.
+ *
+ *  It keeps the exact scripts that pay to the wallet's keys and redeem scripts, its
+ *  watch-only and multisig scripts, and the key IDs for the script types that name
+ *  keys in other ways (bare public keys, vaults and bare multisig). Outputs it rejects
+ *  are never recognized by the wallet, while the ones it accepts still have to go
+ *  through the full check. Pay-to-pubkey-hash and pay-to-script-hash outputs, i.e.
+ *  almost all of them, are decided by a single hash probe without solving the script.
+ *
+ *  The outputs a wallet owns are tracked by the IDs of its transactions, which also
+ *  lets through transactions the wallet already has. Nothing is ever removed, so
+ *  entries the wallet dropped only cost a full check.
+ */
+class WalletOwnershipPrefilter
+{
+private:
+    /** Salted so that scripts chosen by others cannot be made to share buckets */
+    struct SaltedHasher
+    {
+        uint64_t k0;
+        uint64_t k1;
+        size_t operator()(const CScript& script) const;
+        size_t operator()(const CKeyID& keyID) const;
+        size_t operator()(const uint256& txid) const;
+    };
+
+    std::unordered_set<CScript, SaltedHasher> scripts_;
+    std::unordered_set<CKeyID, SaltedHasher> keyIDs_;
+    std::unordered_set<uint256, SaltedHasher> transactionIDs_;
+
+public:
+    WalletOwnershipPrefilter();
+
+    void addKey(const CKeyID& keyID);
+    void addRedeemScript(const CScript& redeemScript);
+    /** Scripts recognized as a whole, i.e. watch-only and multisig scripts */
+    void addScript(const CScript& scriptPubKey);
+    void addTransaction(const uint256& txid);
+
+    bool mightOwn(const CScript& scriptPubKey) const;
+    /** Whether the transaction may be the wallet's, spend from it or pay to it */
+    bool mightConcern(const CTransaction& tx) const;
+};
+#endif// WALLET_OWNERSHIP_PREFILTER_H
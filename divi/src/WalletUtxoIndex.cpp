@@ -0,0 +1,162 @@
+#include <WalletUtxoIndex.h>
+
+#include <I_AppendOnlyTransactionRecord.h>
+#include <I_MerkleTxConfirmationNumberCalculator.h>
+#include <I_SpentOutputTracker.h>
+#include <I_UtxoOwnershipDetector.h>
+#include <WalletTx.h>
+
+#include <iterator>
+
+WalletUtxoIndex::WalletUtxoIndex(
+    const I_UtxoOwnershipDetector& ownershipDetector,
+    const I_SpentOutputTracker& spentOutputTracker,
+    const I_AppendOnlyTransactionRecord& txRecord,
+    const I_MerkleTxConfirmationNumberCalculator& confsCalculator,
+    int maximumReorgDepth
+    ): ownershipDetector_(ownershipDetector)
+    , spentOutputTracker_(spentOutputTracker)
+    , txRecord_(txRecord)
+    , confsCalculator_(confsCalculator)
+    , maximumReorgDepth_(maximumReorgDepth)
+    , entries_()
+    , outpointsByOwnership_()
+    , revertibleSpenders_()
+    , changedTransactions_()
+    , rebuildRequired_(true)
+{
+}
+
+void WalletUtxoIndex::recomputeCachedTxEntries(const CWalletTx& transaction) const
+{
+    changedTransactions_.insert(transaction.GetHash());
+}
+
+void WalletUtxoIndex::invalidate() const
+{
+    rebuildRequired_ = true;
+}
+
+void WalletUtxoIndex::indexOutputs(const TransactionEntry& entry, bool add) const
+{
+    for(const IndexedOutput& output: entry.unspentOutputs)
+    {
+        std::set<COutPoint>& outpoints = outpointsByOwnership_[static_cast<uint8_t>(output.ownership)];
+        if(add)
+        {
+            outpoints.insert(output.outpoint);
+        }
+        else
+        {
+            outpoints.erase(output.outpoint);
+        }
+    }
+}
+
+void WalletUtxoIndex::reevaluate(const uint256& txid) const
+{
+    const CWalletTx* transaction = txRecord_.GetWalletTx(txid);
+    auto it = entries_.find(txid);
+    const bool previouslyCountedAsSpend = it != entries_.end() && it->second.countsAsSpend;
+    if(it != entries_.end())
+    {
+        indexOutputs(it->second, false);
+        entries_.erase(it);
+    }
+    revertibleSpenders_.erase(txid);
+    if(!transaction) return;
+
+    const int depth = confsCalculator_.GetNumberOfBlockConfirmations(*transaction);
+    TransactionEntry entry;
+    entry.countsAsSpend = depth >= 0;
+    for(unsigned outputIndex = 0u; outputIndex < transaction->vout.size(); ++outputIndex)
+    {
+        const CTxOut& output = transaction->vout[outputIndex];
+        if(output.nValue <= 0) continue;
+        const isminetype ownership = ownershipDetector_.isMine(output);
+        if(ownership != isminetype::ISMINE_NO && !spentOutputTracker_.IsSpent(txid, outputIndex, 0))
+        {
+            entry.unspentOutputs.push_back(IndexedOutput{COutPoint(txid, outputIndex), ownership});
+        }
+    }
+    indexOutputs(entry, true);
+    bool spendsRecordedOutputs = false;
+    for(const CTxIn& input: transaction->vin)
+    {
+        if(txRecord_.GetWalletTx(input.prevout.hash) == nullptr) continue;
+        spendsRecordedOutputs = true;
+        if(entry.countsAsSpend != previouslyCountedAsSpend && entries_.count(input.prevout.hash) > 0)
+            changedTransactions_.insert(input.prevout.hash);
+    }
+    if(spendsRecordedOutputs && entry.countsAsSpend && depth < maximumReorgDepth_) revertibleSpenders_.insert(txid);
+    entries_.emplace(txid, std::move(entry));
+}
+
+void WalletUtxoIndex::rebuild() const
+{
+    entries_.clear();
+    outpointsByOwnership_.clear();
+    revertibleSpenders_.clear();
+    changedTransactions_.clear();
+    for(const auto& txidAndTransaction: txRecord_.GetWalletTransactions())
+    {
+        reevaluate(txidAndTransaction.first);
+    }
+    changedTransactions_.clear();
+    rebuildRequired_ = false;
+}
+
+void WalletUtxoIndex::refresh() const
+{
+    for(auto it = revertibleSpenders_.begin(); it != revertibleSpenders_.end();)
+    {
+        const CWalletTx* transaction = txRecord_.GetWalletTx(*it);
+        const int depth = transaction? confsCalculator_.GetNumberOfBlockConfirmations(*transaction): -1;
+        if(depth < 0) changedTransactions_.insert(*it);
+        // Deeper spends can no longer be reorganized away
+        it = depth >= maximumReorgDepth_? revertibleSpenders_.erase(it): std::next(it);
+    }
+    while(!changedTransactions_.empty())
+    {
+        const uint256 txid = *changedTransactions_.begin();
+        changedTransactions_.erase(changedTransactions_.begin());
+        reevaluate(txid);
+    }
+    // Transactions loaded from disk are recorded without being reported
+    if(rebuildRequired_ || entries_.size() != txRecord_.GetWalletTransactions().size())
+    {
+        rebuild();
+    }
+}
+
+std::vector<const CWalletTx*> WalletUtxoIndex::GetTransactionsWithUnspentOutputs(const UtxoOwnershipFilter& ownershipFilter) const
+{
+    refresh();
+    std::set<uint256> txids;
+    for(const auto& ownershipAndOutpoints: outpointsByOwnership_)
+    {
+        if(!ownershipFilter.hasRequested(static_cast<isminetype>(ownershipAndOutpoints.first))) continue;
+        for(const COutPoint& outpoint: ownershipAndOutpoints.second)
+        {
+            txids.insert(outpoint.hash);
+        }
+    }
+    std::vector<const CWalletTx*> transactions;
+    transactions.reserve(txids.size());
+    for(const uint256& txid: txids)
+    {
+        transactions.push_back(txRecord_.GetWalletTx(txid));
+    }
+    return transactions;
+}
+
+size_t WalletUtxoIndex::NumberOfUnspentOutputs() const
+{
+    refresh();
+    size_t numberOfOutputs = 0u;
+    for(const auto& ownershipAndOutpoints: outpointsByOwnership_)
+    {
+        numberOfOutputs += ownershipAndOutpoints.second.size();
+    }
+    return numberOfOutputs;
+}
@@ -0,0 +1,76 @@
+#ifndef WALLET_UTXO_INDEX_H
+#define WALLET_UTXO_INDEX_H
+#include <IsMineType.h>
+#include <primitives/transaction.h>
+#include <uint256.h>
+#include <map>
+#include <set>
+#include <vector>
+
+class I_AppendOnlyTransactionRecord;
+class I_MerkleTxConfirmationNumberCalculator;
+class I_SpentOutputTracker;
+class I_UtxoOwnershipDetector;
+class CWalletTx;
+
+/** Keeps the unspent outputs of a transaction record that the ownership detector
+ *  recognizes, per ownership type, so that coin selection, staking and the vault
+ *  code only look at transactions that still have something to spend instead of
+ *  going over the whole history.
+ *
+ *  Outputs are indexed regardless of the depth of their transaction: depth and
+ *  maturity move with the chain and are left to the queries. Whether an output is
+ *  spent changes when a spending transaction is recorded, which the owner reports,
+ *  or when a spend stops counting because it left the mempool or its block was
+ *  reorganized away. Spends less than a maximal reorg deep are re-checked on each
+ *  query for the latter.
+ */
+class WalletUtxoIndex
+{
+private:
+    struct IndexedOutput
+    {
+        COutPoint outpoint;
+        isminetype ownership;
+    };
+    struct TransactionEntry
+    {
+        bool countsAsSpend;
+        std::vector<IndexedOutput> unspentOutputs;
+    };
+
+    const I_UtxoOwnershipDetector& ownershipDetector_;
+    const I_SpentOutputTracker& spentOutputTracker_;
+    const I_AppendOnlyTransactionRecord& txRecord_;
+    const I_MerkleTxConfirmationNumberCalculator& confsCalculator_;
+    const int maximumReorgDepth_;
+
+    mutable std::map<uint256, TransactionEntry> entries_;
+    mutable std::map<uint8_t, std::set<COutPoint>> outpointsByOwnership_;
+    mutable std::set<uint256> revertibleSpenders_;
+    mutable std::set<uint256> changedTransactions_;
+    mutable bool rebuildRequired_;
+
+    void indexOutputs(const TransactionEntry& entry, bool add) const;
+    void reevaluate(const uint256& txid) const;
+    void rebuild() const;
+    void refresh() const;
+
+public:
+    WalletUtxoIndex(
+        const I_UtxoOwnershipDetector& ownershipDetector,
+        const I_SpentOutputTracker& spentOutputTracker,
+        const I_AppendOnlyTransactionRecord& txRecord,
+        const I_MerkleTxConfirmationNumberCalculator& confsCalculator,
+        int maximumReorgDepth);
+
+    /** Re-evaluates the transaction on the next query */
+    void recomputeCachedTxEntries(const CWalletTx& transaction) const;
+    /** Re-evaluates everything on the next query, e.g. after the ownership rules changed */
+    void invalidate() const;
+
+    /** Transactions with unspent outputs of the requested ownership types, by txid */
+    std::vector<const CWalletTx*> GetTransactionsWithUnspentOutputs(const UtxoOwnershipFilter& ownershipFilter) const;
+    size_t NumberOfUnspentOutputs() const;
+};
+#endif// WALLET_UTXO_INDEX_H
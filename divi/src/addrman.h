@@ -5,6 +5,7 @@
 #ifndef BITCOIN_ADDRMAN_H
 #define BITCOIN_ADDRMAN_H
 
+#include "hash.h"
 #include "netbase.h"
 #include "protocol.h"
 #include "random.h"
@@ -12,9 +13,12 @@
 #include "timedata.h"
 #include "Logging.h"
 
+#include <algorithm>
+#include <limits>
 #include <map>
 #include <set>
 #include <stdint.h>
+#include <unordered_map>
 #include <vector>
 
 /** 
@@ -100,6 +104,25 @@ public:
     double GetChance(int64_t nNow = GetAdjustedTime()) const;
 };
 
+/** Salted hash of the IP part of an address, for CAddrMan's lookup table */
+class CNetAddrHasher
+{
+private:
+    uint64_t k0;
+    uint64_t k1;
+
+public:
+    CNetAddrHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max())) {}
+
+    size_t operator()(const CNetAddr& addr) const
+    {
+        unsigned char ip[16];
+        for (int n = 0; n < 16; n++)
+            ip[n] = addr.GetByte(15 - n);
+        return CSipHasher(k0, k1).Write(ip, sizeof(ip)).Finalize();
+    }
+};
+
 /** Stochastic address manager
  *
  * Design goals:
@@ -124,6 +147,7 @@ public:
  *      be observable by adversaries.
  *    * Several indexes are kept for high performance. Defining DEBUG_ADDRMAN will introduce frequent (and expensive)
  *      consistency checks for the entire data structure.
+ *    * Entries live in a flat vector indexed by nId; the ids of deleted entries are reused.
  */
 
 //! total number of buckets for tried addresses
@@ -174,14 +198,14 @@ private:
     //! secret key to randomize bucket select with
     uint256 nKey;
 
-    //! last used nId
-    int nIdCount;
+    //! table with information about all nIds, indexed by nId (unused slots have nRandomPos == -1)
+    std::vector<CAddrInfo> vInfo;
 
-    //! table with information about all nIds
-    std::map<int, CAddrInfo> mapInfo;
+    //! unused slots in vInfo
+    std::vector<int> vFreeIds;
 
     //! find an nId based on its network address
-    std::map<CNetAddr, int> mapAddr;
+    std::unordered_map<CNetAddr, int, CNetAddrHasher> mapAddr;
 
     //! randomly-ordered vector of all nIds
     std::vector<int> vRandom;
@@ -198,7 +222,69 @@ private:
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! Write the tables in the peers.dat format, see Serialize
+    template <typename Stream>
+    static void SerializeTables(
+        Stream& s,
+        const uint256& nKey,
+        int nNew,
+        int nTried,
+        const std::vector<CAddrInfo>& vInfo,
+        const int (&vvNew)[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE])
+    {
+        unsigned char nVersion = 1;
+        s << nVersion;
+        s << ((unsigned char)32);
+        s << nKey;
+        s << nNew;
+        s << nTried;
+
+        int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
+        s << nUBuckets;
+        // position of each nId among the serialized new entries
+        std::vector<int> vUnkIds(vInfo.size(), -1);
+        int nIds = 0;
+        for (size_t nId = 0; nId < vInfo.size(); nId++) {
+            const CAddrInfo& info = vInfo[nId];
+            if (info.nRefCount) {
+                assert(nIds != nNew); // this means nNew was wrong, oh ow
+                vUnkIds[nId] = nIds;
+                s << info;
+                nIds++;
+            }
+        }
+        nIds = 0;
+        for (size_t nId = 0; nId < vInfo.size(); nId++) {
+            const CAddrInfo& info = vInfo[nId];
+            if (info.fInTried) {
+                assert(nIds != nTried); // this means nTried was wrong, oh ow
+                s << info;
+                nIds++;
+            }
+        }
+        for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
+            int nSize = 0;
+            for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+                if (vvNew[bucket][i] != -1)
+                    nSize++;
+            }
+            s << nSize;
+            for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
+                if (vvNew[bucket][i] != -1) {
+                    int nIndex = vUnkIds[vvNew[bucket][i]];
+                    s << nIndex;
+                }
+            }
+        }
+    }
+
 protected:
+    //! Whether nId refers to an entry
+    bool IsInUse(int nId) const
+    {
+        return nId >= 0 && nId < (int)vInfo.size() && vInfo[nId].nRandomPos != -1;
+    }
+
     //! Find an entry.
     CAddrInfo* Find(const CNetAddr& addr, int* pnId = NULL);
 
@@ -276,50 +362,7 @@ public:
     void Serialize(Stream& s, int nType, int nVersionDummy) const
     {
         LOCK(cs);
-
-        unsigned char nVersion = 1;
-        s << nVersion;
-        s << ((unsigned char)32);
-        s << nKey;
-        s << nNew;
-        s << nTried;
-
-        int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
-        s << nUBuckets;
-        std::map<int, int> mapUnkIds;
-        int nIds = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
-            mapUnkIds[(*it).first] = nIds;
-            const CAddrInfo& info = (*it).second;
-            if (info.nRefCount) {
-                assert(nIds != nNew); // this means nNew was wrong, oh ow
-                s << info;
-                nIds++;
-            }
-        }
-        nIds = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
-            const CAddrInfo& info = (*it).second;
-            if (info.fInTried) {
-                assert(nIds != nTried); // this means nTried was wrong, oh ow
-                s << info;
-                nIds++;
-            }
-        }
-        for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
-            int nSize = 0;
-            for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
-                if (vvNew[bucket][i] != -1)
-                    nSize++;
-            }
-            s << nSize;
-            for (int i = 0; i < ADDRMAN_BUCKET_SIZE; i++) {
-                if (vvNew[bucket][i] != -1) {
-                    int nIndex = mapUnkIds[vvNew[bucket][i]];
-                    s << nIndex;
-                }
-            }
-        }
+        SerializeTables(s, nKey, nNew, nTried, vInfo, vvNew);
     }
 
     template <typename Stream>
@@ -343,9 +386,21 @@ public:
             nUBuckets ^= (1 << 30);
         }
 
+        // The counts come from disk and are only covered by the checksum once everything is read
+        if (nNew > ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE || nNew < 0)
+            throw std::ios_base::failure(strprintf("Corrupt CAddrMan serialization: nNew=%d, should be in [0, %d]",
+                nNew, ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE));
+        if (nTried > ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE || nTried < 0)
+            throw std::ios_base::failure(strprintf("Corrupt CAddrMan serialization: nTried=%d, should be in [0, %d]",
+                nTried, ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE));
+
+        vInfo.reserve(nNew + nTried);
+        mapAddr.reserve(nNew + nTried);
+
         // Deserialize entries from the new table.
         for (int n = 0; n < nNew; n++) {
-            CAddrInfo& info = mapInfo[n];
+            vInfo.push_back(CAddrInfo());
+            CAddrInfo& info = vInfo.back();
             s >> info;
             mapAddr[info] = n;
             info.nRandomPos = vRandom.size();
@@ -361,7 +416,6 @@ public:
                 }
             }
         }
-        nIdCount = nNew;
 
         // Deserialize entries from the tried table.
         int nLost = 0;
@@ -371,13 +425,13 @@ public:
             int nKBucket = info.GetTriedBucket(nKey);
             int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
             if (vvTried[nKBucket][nKBucketPos] == -1) {
+                const int nId = vInfo.size();
                 info.nRandomPos = vRandom.size();
                 info.fInTried = true;
-                vRandom.push_back(nIdCount);
-                mapInfo[nIdCount] = info;
-                mapAddr[info] = nIdCount;
-                vvTried[nKBucket][nKBucketPos] = nIdCount;
-                nIdCount++;
+                vRandom.push_back(nId);
+                vInfo.push_back(info);
+                mapAddr[info] = nId;
+                vvTried[nKBucket][nKBucketPos] = nId;
             } else {
                 nLost++;
             }
@@ -392,7 +446,7 @@ public:
                 int nIndex = 0;
                 s >> nIndex;
                 if (nIndex >= 0 && nIndex < nNew) {
-                    CAddrInfo& info = mapInfo[nIndex];
+                    CAddrInfo& info = vInfo[nIndex];
                     int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
                     if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
                         info.nRefCount++;
@@ -404,13 +458,10 @@ public:
 
         // Prune new entries with refcount 0 (as a result of collisions).
         int nLostUnk = 0;
-        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end();) {
-            if (it->second.fInTried == false && it->second.nRefCount == 0) {
-                std::map<int, CAddrInfo>::const_iterator itCopy = it++;
-                Delete(itCopy->first);
+        for (int nId = 0; nId < (int)vInfo.size(); nId++) {
+            if (IsInUse(nId) && vInfo[nId].fInTried == false && vInfo[nId].nRefCount == 0) {
+                Delete(nId);
                 nLostUnk++;
-            } else {
-                it++;
             }
         }
         if (nLost + nLostUnk > 0) {
@@ -425,9 +476,51 @@ public:
         return (CSizeComputer(nType, nVersion) << *this).size();
     }
 
+    /**
+     * Copy of the tables that make up peers.dat. Taking one only holds cs for as long as
+     * the copy takes, so that writing the file does not block the network threads.
+     */
+    class Snapshot
+    {
+    private:
+        uint256 nKey;
+        int nNew;
+        int nTried;
+        std::vector<CAddrInfo> vInfo;
+        int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
+
+        friend class CAddrMan;
+
+    public:
+        template <typename Stream>
+        void Serialize(Stream& s, int nType, int nVersionDummy) const
+        {
+            SerializeTables(s, nKey, nNew, nTried, vInfo, vvNew);
+        }
+
+        unsigned int GetSerializeSize(int nType, int nVersion) const
+        {
+            return (CSizeComputer(nType, nVersion) << *this).size();
+        }
+    };
+
+    void GetSnapshot(Snapshot& snapshot) const
+    {
+        LOCK(cs);
+        snapshot.nKey = nKey;
+        snapshot.nNew = nNew;
+        snapshot.nTried = nTried;
+        snapshot.vInfo = vInfo;
+        std::copy(&vvNew[0][0], &vvNew[0][0] + ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE, &snapshot.vvNew[0][0]);
+    }
+
     void Clear()
     {
+        LOCK(cs);
         std::vector<int>().swap(vRandom);
+        std::vector<CAddrInfo>().swap(vInfo);
+        std::vector<int>().swap(vFreeIds);
+        mapAddr.clear();
         nKey = GetRandHash();
         for (size_t bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
             for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
@@ -440,7 +533,6 @@ public:
             }
         }
 
-        nIdCount = 0;
         nTried = 0;
         nNew = 0;
     }
@@ -14,7 +14,20 @@ CBlockIndex* BlockMap::GetUniqueBlockIndexForHash(uint256 blockHash)
     CBlockIndex* pindexNew = new CBlockIndex();
     if (!pindexNew)
         throw std::runtime_error("LoadBlockIndex() : new CBlockIndex failed");
+    LOCK(cs_insertion);
     mi = insert(std::make_pair(blockHash, pindexNew)).first;
     pindexNew->phashBlock = &((*mi).first);
     return pindexNew;
+}
+
+CCriticalSection& BlockMap::GetInsertionLock() const
+{
+    return cs_insertion;
+}
+
+const CBlockIndex* BlockMap::FindWithoutMainLock(const uint256& blockHash) const
+{
+    LOCK(cs_insertion);
+    const_iterator mi = find(blockHash);
+    return mi != end()? mi->second: nullptr;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef BLOCK_MAP_H
 #define BLOCK_MAP_H
 #include "chain.h"
+#include <sync.h>
 #include <boost/unordered_map.hpp>
 #include <stdexcept>
 
@@ -9,7 +10,15 @@ struct BlockHasher {
 };
 class BlockMap: public boost::unordered_map<uint256, CBlockIndex*, BlockHasher>
 {
+private:
+    mutable CCriticalSection cs_insertion;
+
 public:
     CBlockIndex* GetUniqueBlockIndexForHash(uint256 blockHash);
+
+    /** Taken (besides cs_main) while an entry is inserted and linked into the block tree */
+    CCriticalSection& GetInsertionLock() const;
+    /** Lookup for readers that do not hold cs_main, such as RPCs served from a ChainStateSnapshot */
+    const CBlockIndex* FindWithoutMainLock(const uint256& blockHash) const;
 };
 #endif // BLOCK_MAP_H
\ No newline at end of file
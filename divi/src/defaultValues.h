@@ -29,6 +29,10 @@ constexpr int64_t DEFAULT_DB_CACHE_SIZE = 100;
 constexpr int64_t MAX_DB_CACHE_SIZE = sizeof(void*) > 4 ? 4096 : 1024;
 //! min. -dbcache in (MiB)
 constexpr int64_t MIN_DB_CACHE_SIZE = 4;
+//! -rpccachesize default (MiB)
+constexpr int64_t DEFAULT_RPC_RESPONSE_CACHE_SIZE = 32;
+//! -zmqqueuesize default (messages waiting for the ZMQ publisher thread)
+constexpr int64_t DEFAULT_ZMQ_QUEUE_SIZE = 1000;
 
 //! -maxtxfee default
 constexpr CAmount DEFAULT_TRANSACTION_MAXFEE = 100 * COIN;
@@ -62,6 +66,8 @@ constexpr unsigned int MAX_TX_SIGOPS_CURRENT = MAX_BLOCK_SIGOPS_CURRENT / 5;
 constexpr unsigned int MAX_TX_SIGOPS_LEGACY = MAX_BLOCK_SIGOPS_LEGACY / 5;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 constexpr unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/** Default for -maxorphantxsize, maximum size in kilobytes of all orphan transactions kept in memory */
+constexpr unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE = 500;
 /** The maximum size of a blk?????.dat file (since 0.8) */
 constexpr unsigned int MAX_BLOCKFILE_SIZE = 0x8000000; // 128 MiB
 /** The pre-allocation chunk size for blk?????.dat files (since 0.8) */
@@ -76,6 +82,10 @@ constexpr unsigned int LOCKTIME_THRESHOLD = 500000000; // Tue Nov  5 00:53:20 19
 constexpr int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 constexpr int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of threads reading and filtering blocks during a wallet rescan */
+constexpr int MAX_RESCAN_THREADS = 16;
+/** -rescanthreads default (number of wallet rescan threads, 0 = auto) */
+constexpr int DEFAULT_RESCAN_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 constexpr int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -83,6 +93,9 @@ constexpr unsigned int BLOCK_STALLING_TIMEOUT = 2;
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
  *  less than this number, we reached their tip. Changing this value is a protocol upgrade. */
 constexpr unsigned int MAX_HEADERS_RESULTS = 2000;
+/** How far (in seconds) a header may be ahead of adjusted time. Whether a block is proof-of-stake is only
+ *  known from its body, which is then held to the stricter proof-of-stake limit. */
+constexpr int64_t MAX_HEADER_FUTURE_DRIFT = 2 * 60 * 60;
 /** Size of the "block download window": how far ahead of our current height do we fetch?
  *  Larger windows tolerate larger download speed differences between peer, but increase the potential
  *  degree of disordering of blocks on disk (which make reindexing and in the future perhaps pruning
@@ -99,6 +112,19 @@ constexpr bool DEFAULT_SPENTINDEX = false;
 /** Enable bloom filter */
  constexpr bool DEFAULT_PEERBLOOMFILTERS = true;
 
+/** Relay new blocks to and from supporting peers as compact blocks */
+constexpr bool DEFAULT_COMPACT_BLOCKS = true;
+
+/** Default for -maxuploadtarget, the outbound traffic budget per MAX_UPLOAD_TIMEFRAME in MiB (0 = no limit) */
+constexpr uint64_t DEFAULT_MAX_UPLOAD_TARGET = 0;
+/** Length (in seconds) of the window over which -maxuploadtarget is measured */
+constexpr uint64_t MAX_UPLOAD_TIMEFRAME = 60 * 60 * 24;
+/** Upload budget kept back per expected block for relaying new blocks. Divi blocks are far below
+ *  MAX_BLOCK_SIZE_CURRENT in practice, and reserving that much per minute would use up any sensible target. */
+constexpr uint64_t UPLOAD_TARGET_RESERVE_PER_BLOCK = 100 * 1000;
+/** Blocks this much (in seconds) older than the tip are not served once the upload target is reached */
+constexpr int64_t HISTORICAL_BLOCK_AGE = 7 * 24 * 60 * 60;
+
 /** "reject" message codes */
 constexpr unsigned char REJECT_MALFORMED = 0x01;
 constexpr unsigned char REJECT_INVALID = 0x10;
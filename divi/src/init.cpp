@@ -16,6 +16,7 @@
 #include <base58.h>
 #include "BlockFileOpener.h"
 #include <BlockDiskAccessor.h>
+#include <AsyncIndexBuilder.h>
 #include <BlockDiskDataReader.h>
 #include <BlockIndexLoading.h>
 #include <chain.h>
@@ -57,6 +58,7 @@
 #include <ChainExtensionModule.h>
 #include <BlockInvalidationHelpers.h>
 #include <FlushChainState.h>
+#include <RenderedResponseCache.h>
 
 #ifdef ENABLE_WALLET
 #include "wallet.h"
@@ -119,6 +121,7 @@ public:
     }
 };
 std::unique_ptr<P2PNotifications> p2pNotifications;
+std::unique_ptr<AsyncIndexBuilder> asyncIndexBuilder;
 
 #ifdef ENABLE_WALLET
 constexpr int nWalletBackups = 20;
@@ -144,7 +147,6 @@ void InitializeMultiWalletModule()
             *chainstateInstance,
             settings,
             GetTransactionMemoryPool(),
-            cs_main,
             Params().COINBASE_MATURITY()));
 }
 void FinalizeMultiWalletModule()
@@ -204,6 +206,15 @@ const I_BlockSubmitter& GetBlockSubmitter()
 {
     return chainExtensionModule->getBlockSubmitter();
 }
+const I_DifficultyAdjuster& GetDifficultyAdjuster()
+{
+    return chainExtensionModule->getDifficultyAdjuster();
+}
+
+const AsyncIndexBuilder* GetAsyncIndexBuilder()
+{
+    return asyncIndexBuilder.get();
+}
 
 bool ManualBackupWallet(const std::string& strDest)
 {
@@ -375,12 +386,15 @@ void PrepareShutdown()
     StopTorControl();
     SaveMasternodeDataToDisk();
     FinalizeP2PNetwork();
+    if (asyncIndexBuilder)
+        asyncIndexBuilder->Stop();
 
     {
         LOCK(cs_main);
         FlushStateToDisk();
         UnregisterAllMainNotificationInterfaces();
         p2pNotifications.reset();
+        asyncIndexBuilder.reset();
 
         //record that client took the proper shutdown procedure
         FinalizeMainBlockchainModules();
@@ -1024,11 +1038,13 @@ struct CoinCacheSizes
 {
     size_t nTotalCache;
     size_t nBlockTreeDBCache;
+    size_t nSearchIndexDBCache;
     size_t nCoinDBCache;
     unsigned int nCoinCacheSize;
     CoinCacheSizes(
         ): nTotalCache(settings.GetArg("-dbcache", DEFAULT_DB_CACHE_SIZE) << 20)
         , nBlockTreeDBCache(0)
+        , nSearchIndexDBCache(0)
         , nCoinDBCache(0)
         , nCoinCacheSize(5000)
     {
@@ -1040,6 +1056,7 @@ CoinCacheSizes CalculateDBCacheSizes()
     CoinCacheSizes cacheSizes;
     size_t& nTotalCache = cacheSizes.nTotalCache;
     size_t& nBlockTreeDBCache = cacheSizes.nBlockTreeDBCache;
+    size_t& nSearchIndexDBCache = cacheSizes.nSearchIndexDBCache;
     size_t& nCoinDBCache = cacheSizes.nCoinDBCache;
     unsigned int& nCoinCacheSize = cacheSizes.nCoinCacheSize;
 
@@ -1051,6 +1068,9 @@ CoinCacheSizes CalculateDBCacheSizes()
     if (nBlockTreeDBCache > (1 << 21) && !settings.GetBoolArg("-txindex", true))
         nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
     nTotalCache -= nBlockTreeDBCache;
+    const bool searchIndexing = settings.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX) || settings.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX);
+    nSearchIndexDBCache = searchIndexing? nTotalCache / 8 : (1 << 20); // the indexes are only written in the background
+    nTotalCache -= nSearchIndexDBCache;
     nCoinDBCache = nTotalCache / 2; // use half of the remaining cache for coindb cache
     nTotalCache -= nCoinDBCache;
     nCoinCacheSize = nTotalCache / 300; // coins in memory require around 300 bytes
@@ -1324,6 +1344,7 @@ void InitializeMainBlockchainModules()
     chainstateInstance.reset(
         new ChainstateManager (
             unitTestMode? (1 << 20) : cacheSizes.nBlockTreeDBCache,
+            unitTestMode? (1 << 20) : cacheSizes.nSearchIndexDBCache,
             unitTestMode? (1 << 23) : cacheSizes.nCoinDBCache,
             unitTestMode? (  5000 ) : cacheSizes.nCoinCacheSize,
             unitTestMode?      true : false,
@@ -1489,6 +1510,8 @@ bool InitializeDivi(boost::thread_group& threadGroup)
     }
     p2pNotifications.reset(new P2PNotifications());
     RegisterMainNotificationInterface(p2pNotifications.get());
+    GetRenderedResponseCache().SetMaxBytes(std::max<int64_t>(0, settings.GetArg("-rpccachesize", DEFAULT_RPC_RESPONSE_CACHE_SIZE)) << 20);
+    RegisterMainNotificationInterface(&GetRenderedResponseCache());
 
     PruneHDSeedParameterInteraction();
 
@@ -1577,6 +1600,23 @@ bool InitializeDivi(boost::thread_group& threadGroup)
     }
 #endif
 
+    static const BlockDiskDataReader searchIndexBlockReader;
+    asyncIndexBuilder.reset(
+        new AsyncIndexBuilder(
+            chainstateInstance->SearchIndexes(),
+            chainstateInstance->GetBlockMap(),
+            searchIndexBlockReader,
+            settings.GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX),
+            settings.GetBoolArg("-spentindex", DEFAULT_SPENTINDEX)));
+    if (!asyncIndexBuilder->Initialize())
+        return InitError(translate("Error opening search index database"));
+    const AsyncIndexBuilder::Status searchIndexStatus = asyncIndexBuilder->GetStatus();
+    if (searchIndexStatus.addressIndexing || searchIndexStatus.spentIndexing)
+    {
+        RegisterMainNotificationInterface(asyncIndexBuilder.get());
+        asyncIndexBuilder->Start();
+    }
+
     threadGroup.create_thread(boost::bind(&ReindexAndImportBlockFiles, chainstateInstance.get(), settings));
 
     if (chainActive.Tip() == NULL) {
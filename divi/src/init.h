@@ -17,7 +17,9 @@ class CChainParams;
 class CChain;
 class BlockMap;
 class I_BlockSubmitter;
+class I_DifficultyAdjuster;
 class I_ChainExtensionService;
+class AsyncIndexBuilder;
 
 namespace boost
 {
@@ -40,6 +42,9 @@ void FlushStateToDisk();
 
 const I_ChainExtensionService& GetChainExtensionService();
 const I_BlockSubmitter& GetBlockSubmitter();
+const I_DifficultyAdjuster& GetDifficultyAdjuster();
+/** Null until the block index is loaded */
+const AsyncIndexBuilder* GetAsyncIndexBuilder();
 
 bool VerifyChain(int nCheckLevel, int nCheckDepth, bool useCoinTip);
 CTxMemPool& GetTransactionMemoryPool();
@@ -22,6 +22,8 @@
 #include <ChainstateManager.h>
 #include <ChainSyncHelpers.h>
 #include <coins.h>
+#include <CompactBlock.h>
+#include <BlockDownloadScheduler.h>
 #include <I_BlockSubmitter.h>
 #include <defaultValues.h>
 #include <init.h>
@@ -34,7 +36,9 @@
 #include <NodeStateRegistry.h>
 #include <OrphanTransactions.h>
 #include <PeerBanningService.h>
+#include <random.h>
 #include <Settings.h>
+#include <SharedMessageCache.h>
 #include <spork.h>
 #include <sync.h>
 #include <ThreadManagementHelpers.h>
@@ -225,7 +229,7 @@ static std::pair<const CBlockIndex*, bool> GetBlockIndexOfRequestedBlock(
         const auto& chain = chainstate->ActiveChain();
 
         const auto mi = blockMap.find(blockHash);
-        if (mi != blockMap.end())
+        if (mi != blockMap.end() && (mi->second->nStatus & BLOCK_HAVE_DATA))
         {
             pindex = mi->second;
             if (chain.Contains(mi->second)) {
@@ -246,17 +250,79 @@ static std::pair<const CBlockIndex*, bool> GetBlockIndexOfRequestedBlock(
     return std::make_pair(pindex,send);
 }
 
-static void PushCorrespondingBlockToPeer(CNode* pfrom, const CBlockIndex* blockToPush,bool isBlock)
+static bool IsRequestForBlock(const CInv& inv)
 {
+    return inv.GetType() == MSG_BLOCK || inv.GetType() == MSG_FILTERED_BLOCK || inv.GetType() == MSG_CMPCT_BLOCK;
+}
+
+/** Deeper blocks are served in full, as the requester cannot still have their transactions in its mempool */
+constexpr int MAX_COMPACT_BLOCK_DEPTH = 5;
+/** Deepest block whose transactions are handed out individually in answer to getblocktxn */
+constexpr int MAX_BLOCK_TRANSACTIONS_DEPTH = 10;
+
+static bool BlockIsWithinDepth(CCriticalSection& mainCriticalSection, const CBlockIndex* pindex, int maximumDepth)
+{
+    LOCK(mainCriticalSection);
+    const ChainstateManager::Reference chainstate;
+    return chainstate->ActiveChain().Height() - pindex->nHeight < maximumDepth;
+}
+
+static bool IsHistoricalBlock(CCriticalSection& mainCriticalSection, const CBlockIndex* pindex)
+{
+    LOCK(mainCriticalSection);
+    const ChainstateManager::Reference chainstate;
+    const CBlockIndex* tip = chainstate->ActiveChain().Tip();
+    return tip != nullptr && tip->GetBlockTime() - pindex->GetBlockTime() > HISTORICAL_BLOCK_AGE;
+}
+
+/** Upper bound on the serialized 'block' messages kept around for serving further peers */
+constexpr size_t MAX_SHARED_BLOCK_MESSAGE_BYTES = 8 * 1000 * 1000;
+static SharedMessageCache recentlyServedBlockMessages(MAX_SHARED_BLOCK_MESSAGE_BYTES);
+/** Upper bound on the serialized 'cmpctblock' messages kept around; every peer asking for a block gets the same nonce */
+constexpr size_t MAX_SHARED_COMPACT_BLOCK_MESSAGE_BYTES = 1000 * 1000;
+static SharedMessageCache recentlyServedCompactBlockMessages(MAX_SHARED_COMPACT_BLOCK_MESSAGE_BYTES);
+
+static void PushCorrespondingBlockToPeer(CNode* pfrom, const CBlockIndex* blockToPush, int inventoryType)
+{
+    if (inventoryType == MSG_CMPCT_BLOCK)
+    {
+        const uint256 blockHash = blockToPush->GetBlockHash();
+        SharedSerializedMessage compactBlockMessage = recentlyServedCompactBlockMessages.Get(blockHash);
+        if (!compactBlockMessage)
+        {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, blockToPush))
+                assert(!"cannot load block from disk");
+            const CBlockHeaderAndShortTxIDs compactBlock(block, GetRand(std::numeric_limits<uint64_t>::max()));
+            compactBlockMessage = NetworkMessageSerializer::SerializeMessage(PROTOCOL_VERSION, "cmpctblock", compactBlock);
+            recentlyServedCompactBlockMessages.Insert(blockHash, compactBlockMessage);
+        }
+        pfrom->PushSerializedMessage(compactBlockMessage);
+        return;
+    }
+
+    if (inventoryType == MSG_BLOCK)
+    {
+        // Peers requesting the same block share a single serialized copy of it
+        const uint256 blockHash = blockToPush->GetBlockHash();
+        SharedSerializedMessage blockMessage = recentlyServedBlockMessages.Get(blockHash);
+        if (!blockMessage)
+        {
+            CBlock block;
+            if (!ReadBlockFromDisk(block, blockToPush))
+                assert(!"cannot load block from disk");
+            blockMessage = NetworkMessageSerializer::SerializeMessage(PROTOCOL_VERSION, "block", block);
+            recentlyServedBlockMessages.Insert(blockHash, blockMessage);
+        }
+        pfrom->PushSerializedMessage(blockMessage);
+        return;
+    }
+
     // Send block from disk
     CBlock block;
     if (!ReadBlockFromDisk(block, blockToPush))
         assert(!"cannot load block from disk");
-    if (isBlock)
-    {
-        pfrom->PushMessage("block", block);
-    }
-    else // MSG_FILTERED_BLOCK)
+    // MSG_FILTERED_BLOCK
     {
         LOCK(pfrom->cs_filter);
         if (pfrom->pfilter) {
@@ -271,7 +337,12 @@ static void PushCorrespondingBlockToPeer(CNode* pfrom, const CBlockIndex* blockT
             typedef std::pair<unsigned int, uint256> PairType;
             for(PairType& pair: merkleBlock.vMatchedTxn)
             {
-                if (!pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
+                bool transactionIsKnown = false;
+                {
+                    LOCK(pfrom->cs_inventory);
+                    transactionIsKnown = pfrom->filterInventoryKnown.contains(pair.second);
+                }
+                if (!transactionIsKnown)
                     pfrom->PushMessage("tx", block.vtx[pair.first]);
             }
         }
@@ -297,14 +368,28 @@ void static ProcessGetData(CCriticalSection& mainCriticalSection, CNode* pfrom,
             boost::this_thread::interruption_point();
             it++;
 
-            if (inv.GetType() == MSG_BLOCK || inv.GetType() == MSG_FILTERED_BLOCK)
+            if (IsRequestForBlock(inv))
             {
                 std::pair<const CBlockIndex*, bool> blockIndexAndSendStatus = GetBlockIndexOfRequestedBlock(mainCriticalSection, pfrom->GetId(),inv.GetHash());
-                // Don't send not-validated blocks
-                if (blockIndexAndSendStatus.second &&
-                    (blockIndexAndSendStatus.first->nStatus & BLOCK_HAVE_DATA))
+                // Don't send not-validated blocks; the block itself is read and pushed without holding the main lock
+                bool send = blockIndexAndSendStatus.second;
+                // Once the upload target is reached, whitelisted peers are the only ones still served historical blocks
+                if (send && !pfrom->fWhitelisted && NetworkUsageStats::OutboundTargetReached(true) &&
+                    (inv.GetType() == MSG_FILTERED_BLOCK || IsHistoricalBlock(mainCriticalSection, blockIndexAndSendStatus.first)))
+                {
+                    LogPrint("net", "historical block serving limit reached, disconnect peer=%d\n", pfrom->GetId());
+                    pfrom->FlagForDisconnection();
+                    send = false;
+                }
+                if (send)
                 {
-                    PushCorrespondingBlockToPeer(pfrom, blockIndexAndSendStatus.first,inv.GetType() == MSG_BLOCK);
+                    int inventoryType = inv.GetType();
+                    if (inventoryType == MSG_CMPCT_BLOCK &&
+                        (!CompactBlocksAreEnabled() || !BlockIsWithinDepth(mainCriticalSection, blockIndexAndSendStatus.first, MAX_COMPACT_BLOCK_DEPTH)))
+                    {
+                        inventoryType = MSG_BLOCK;
+                    }
+                    PushCorrespondingBlockToPeer(pfrom, blockIndexAndSendStatus.first, inventoryType);
 
                     // Trigger them to send a getblocks request for the next batch of inventory
                     if (inv.GetHash() == pfrom->hashContinue) {
@@ -312,7 +397,10 @@ void static ProcessGetData(CCriticalSection& mainCriticalSection, CNode* pfrom,
                         // and we want it right after the last block so they don't
                         // wait for other stuff first.
                         std::vector<CInv> vInv;
-                        vInv.push_back(CInv(MSG_BLOCK, chainstate->ActiveChain().Tip()->GetBlockHash()));
+                        {
+                            LOCK(mainCriticalSection);
+                            vInv.push_back(CInv(MSG_BLOCK, chainstate->ActiveChain().Tip()->GetBlockHash()));
+                        }
                         pfrom->PushMessage("inv", vInv);
                         pfrom->hashContinue = 0;
                     }
@@ -327,7 +415,7 @@ void static ProcessGetData(CCriticalSection& mainCriticalSection, CNode* pfrom,
                 }
             }
 
-            if (inv.GetType() == MSG_BLOCK || inv.GetType() == MSG_FILTERED_BLOCK)
+            if (IsRequestForBlock(inv))
                 break;
         }
     }
@@ -410,11 +498,19 @@ static bool SetPeerVersionAndServices(CCriticalSection& mainCriticalSection, CNo
     pfrom->fClient = !(pfrom->GetServices() & NODE_NETWORK);
 
     // Potentially mark this peer as a preferred download peer.
-    pfrom->UpdatePreferredDownloadStatus();
+    {
+        LOCK(mainCriticalSection);
+        pfrom->UpdatePreferredDownloadStatus();
+    }
 
     // Change version
     pfrom->PushMessage("verack");
 
+    // Only the low bandwidth mode is offered: new blocks are still announced by inv, and
+    // requested as compact blocks from peers that answered with sendcmpct of their own
+    if (CompactBlocksAreEnabled() && (pfrom->GetServices() & NODE_COMPACT_BLOCKS))
+        pfrom->PushMessage("sendcmpct", false, COMPACT_BLOCKS_VERSION);
+
     if(pfrom->fInbound) {
         pfrom->PushMessage("sporkcount", GetSporkManager().GetActiveSporkCount());
     }
@@ -466,6 +562,469 @@ static bool SetPeerVersionAndServices(CCriticalSection& mainCriticalSection, CNo
     return true;
 }
 
+/** Maximum number of queued orphans reconsidered per processed message */
+constexpr unsigned int MAX_ORPHAN_WORK_UNITS_PER_MESSAGE = 100;
+
+// requires LOCK(cs_main)
+static void ProcessOrphanWorkQueue(CTxMemPool& mempool, unsigned int maxWorkUnits)
+{
+    const ChainstateManager::Reference chainstate;
+    const auto& coinsTip = chainstate->CoinsTip();
+    const auto& blockMap = chainstate->GetBlockMap();
+
+    std::set<NodeId> setMisbehaving;
+    uint256 orphanHash;
+    unsigned int workUnitsDone = 0;
+    while (workUnitsDone < maxWorkUnits && PopOrphanFromWorkQueue(orphanHash))
+    {
+        ++workUnitsDone;
+        NodeId fromPeer;
+        const CTransaction orphanTx = GetOrphanTransaction(orphanHash,fromPeer);
+        bool fMissingInputs2 = false;
+        // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
+        // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
+        // anyone relaying LegitTxX banned)
+        CValidationState stateDummy;
+
+        if(setMisbehaving.count(fromPeer))
+            continue;
+        if(MempoolConsensus::AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2)) {
+            LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash);
+            RelayTransactionToAllPeers(orphanTx);
+            AddOrphansSpendingTransactionToWorkQueue(orphanTx);
+            EraseOrphanTx(orphanHash);
+        } else if(!fMissingInputs2) {
+            int nDos = 0;
+            if(stateDummy.IsInvalid(nDos) && nDos > 0) {
+                // Punish peer that gave us an invalid orphan tx
+                Misbehaving(fromPeer, nDos, "Invalid orphan transaction required by mempool transaction");
+                setMisbehaving.insert(fromPeer);
+                LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash);
+            }
+            // Has inputs but not accepted to mempool
+            // Probably non-standard or insufficient fee/priority
+            LogPrint("mempool", "   removed orphan tx %s\n", orphanHash);
+            EraseOrphanTx(orphanHash);
+        }
+        mempool.check(&coinsTip, blockMap);
+    }
+    if (OrphanWorkQueueSize() > 0)
+        LogPrint("mempool", "%s: deferring %u queued orphans\n", __func__, OrphanWorkQueueSize());
+}
+
+static bool PeerSupportsHeadersFirstSync(const CNode* pfrom)
+{
+    return HeadersFirstSyncIsEnabled() && (pfrom->GetServices() & NODE_HEADERS_FIRST);
+}
+
+// requires LOCK(cs_main)
+static void RemoveAcceptedBlocksFromHeaderChain(const BlockMap& blockMap)
+{
+    GetBlockDownloadScheduler().RemoveAcceptedBlocks(
+        [&blockMap](const uint256& blockHash) -> const CBlockIndex*
+        {
+            const auto it = blockMap.find(blockHash);
+            return it != blockMap.end()? it->second: nullptr;
+        });
+}
+
+// requires LOCK(cs_main)
+static CBlockLocator GetHeaderChainLocator(const CChain& chain)
+{
+    // Start one block below our tip so that even a peer with nothing new answers with a header
+    const CBlockIndex* tip = chain.Tip();
+    std::vector<uint256> locatorHashes = GetBlockDownloadScheduler().GetLocatorHashes();
+    const CBlockLocator chainLocator = chain.GetLocator(locatorHashes.empty() && tip->pprev ? tip->pprev : tip);
+    locatorHashes.insert(locatorHashes.end(), chainLocator.vHave.begin(), chainLocator.vHave.end());
+    return CBlockLocator(locatorHashes);
+}
+
+// requires LOCK(cs_main)
+static void DiscardHeaderChainFromInvalidBlock(const uint256& blockHash, const CValidationState& state, NodeId blockSource)
+{
+    int nDoS = 0;
+    if (!state.IsInvalid(nDoS) || state.CorruptionPossible())
+        return;
+    const NodeId headerSource = GetBlockDownloadScheduler().DiscardFrom(blockHash);
+    if (headerSource != -1 && headerSource != blockSource && nDoS > 0)
+        Misbehaving(headerSource, nDoS, "Sent headers of an invalid block");
+}
+
+/** How long the first block of the header chain may be awaited before its header is taken to have no block */
+constexpr int64_t HEADER_CHAIN_BLOCK_TIMEOUT = 5 * 60 * 1000000;
+
+// requires LOCK(cs_main)
+static void DiscardHeaderChainWithoutBlocks(int64_t nNow)
+{
+    std::vector<uint256> discardedHashes;
+    const NodeId headerSource = GetBlockDownloadScheduler().DiscardIfFirstBlockNeverArrives(nNow, HEADER_CHAIN_BLOCK_TIMEOUT, discardedHashes);
+    if (headerSource == -1)
+        return;
+    // The peers these blocks were requested from are not to blame for them never arriving
+    for (const uint256& blockHash: discardedHashes)
+        MarkBlockAsReceived(blockHash);
+    Misbehaving(headerSource, 50, "Sent headers of blocks that never arrived");
+}
+
+/** Hands the blocks of the header chain that arrived ahead of their parent over to
+ *  validation, in chain order, once the block they build on has been accepted. */
+static void ProcessBufferedSuccessors(CCriticalSection& mainCriticalSection, const BlockMap& blockMap, uint256 parentHash)
+{
+    while (true)
+    {
+        CBlock block;
+        NodeId blockSource = -1;
+        {
+            LOCK(mainCriticalSection);
+            RemoveAcceptedBlocksFromHeaderChain(blockMap);
+            if (!blockMap.count(parentHash) || !GetBlockDownloadScheduler().TakeBufferedChild(parentHash, block, blockSource))
+                return;
+        }
+
+        CValidationState state;
+        GetBlockSubmitter().acceptBlockForChainExtension(state, block, static_cast<CNode*>(nullptr));
+        int nDoS = 0;
+        if (state.IsInvalid(nDoS))
+        {
+            LOCK(mainCriticalSection);
+            if (nDoS > 0)
+                Misbehaving(blockSource, nDoS, "Bad block processed");
+            DiscardHeaderChainFromInvalidBlock(block.GetHash(), state, blockSource);
+            return;
+        }
+        parentHash = block.GetHash();
+    }
+}
+
+static void ProcessReceivedBlock(CCriticalSection& mainCriticalSection, CNode* pfrom, const std::string& strCommand, CBlock& block)
+{
+    const ChainstateManager::Reference chainstate;
+    const auto& blockMap = chainstate->GetBlockMap();
+    const auto& chain = chainstate->ActiveChain();
+
+    uint256 hashBlock = block.GetHash();
+    CInv inv(MSG_BLOCK, hashBlock);
+
+    bool parentIsKnown = false;
+    {
+        LOCK(mainCriticalSection);
+        parentIsKnown = blockMap.count(block.hashPrevBlock) > 0;
+        BlockDownloadScheduler& blockDownloadScheduler = GetBlockDownloadScheduler();
+        if (!parentIsKnown && blockDownloadScheduler.IsPending(hashBlock))
+        {
+            // Blocks of the header chain are fetched out of order; this one waits for its parent
+            pfrom->AddInventoryKnown(inv);
+            MarkBlockAsReceived(hashBlock);
+            if (!blockDownloadScheduler.BufferBlock(block, pfrom->GetId()))
+                LogPrint("net", "%s : no room to buffer block %s from peer=%d, it will be fetched again\n", __func__, hashBlock, pfrom->id);
+            return;
+        }
+        if (!parentIsKnown && PeerSupportsHeadersFirstSync(pfrom))
+        {
+            // Fetch the headers leading up to it; the block is requested again once they are in
+            pfrom->PushMessage("getheaders", GetHeaderChainLocator(chain), uint256(0));
+            return;
+        }
+    }
+
+    //sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
+    if (!parentIsKnown) {
+        if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
+            //we already asked for this block, so lets work backwards and ask for the previous block
+            pfrom->PushMessage("getblocks", chain.GetLocator(), block.hashPrevBlock);
+            pfrom->vBlockRequested.push_back(block.hashPrevBlock);
+        } else {
+            //ask to sync to this block
+            pfrom->PushMessage("getblocks", chain.GetLocator(), hashBlock);
+            pfrom->vBlockRequested.push_back(hashBlock);
+        }
+    } else {
+        pfrom->AddInventoryKnown(inv);
+
+        CValidationState state;
+        if (!blockMap.count(block.GetHash())) {
+            GetBlockSubmitter().acceptBlockForChainExtension(state,block,pfrom);
+            int nDoS;
+            if(state.IsInvalid(nDoS)) {
+                pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
+                                   state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.GetHash());
+                TRY_LOCK(mainCriticalSection, lockMain);
+                if(lockMain) {
+                    if(nDoS > 0) Misbehaving(pfrom->GetNodeState(), nDoS, "Bad block processed");
+                    DiscardHeaderChainFromInvalidBlock(hashBlock, state, pfrom->GetId());
+                }
+            }
+            //disconnect this node if its old protocol version
+            if(pfrom->DisconnectOldProtocol(ActiveProtocol(), strCommand))
+            {
+                PeerBanningService::Ban(GetTime(),pfrom->GetCAddress());
+            }
+        } else {
+            LogPrint("net", "%s : Already processed block %s, skipping block processing()\n", __func__, block.GetHash());
+        }
+        ProcessBufferedSuccessors(mainCriticalSection, blockMap, hashBlock);
+    }
+}
+
+static void ProcessReceivedHeaders(CCriticalSection& mainCriticalSection, CNode* pfrom, const std::vector<CBlockHeader>& headers)
+{
+    if (headers.empty())
+        return;
+
+    const ChainstateManager::Reference chainstate;
+    const auto& blockMap = chainstate->GetBlockMap();
+    const auto& chain = chainstate->ActiveChain();
+
+    LOCK(mainCriticalSection);
+    CNodeState* state = pfrom->GetNodeState();
+    BlockDownloadScheduler& blockDownloadScheduler = GetBlockDownloadScheduler();
+    RemoveAcceptedBlocksFromHeaderChain(blockMap);
+
+    // Leading headers of blocks we already have only tell us how far the peer has got
+    size_t firstUnknownHeader = 0;
+    const CBlockIndex* parentIndex = nullptr;
+    for (; firstUnknownHeader < headers.size(); ++firstUnknownHeader)
+    {
+        const auto it = blockMap.find(headers[firstUnknownHeader].GetHash());
+        if (it == blockMap.end())
+            break;
+        parentIndex = it->second;
+    }
+    if (firstUnknownHeader > 0)
+    {
+        UpdateBlockAvailability(blockMap, state, parentIndex->GetBlockHash());
+        state->nBestHeaderHeight = std::max(state->nBestHeaderHeight, parentIndex->nHeight);
+    }
+
+    bool extendedHeaderChain = false;
+    if (firstUnknownHeader < headers.size())
+    {
+        const std::vector<CBlockHeader> unknownHeaders(headers.begin() + firstUnknownHeader, headers.end());
+        if (firstUnknownHeader == 0)
+        {
+            const auto parentIt = blockMap.find(unknownHeaders.front().hashPrevBlock);
+            if (parentIt != blockMap.end())
+            {
+                parentIndex = parentIt->second;
+            }
+            else if (!blockDownloadScheduler.IsPending(unknownHeaders.front().hashPrevBlock))
+            {
+                LogPrint("net", "%s : headers from peer=%d do not connect, asking for the headers before them\n", __func__, pfrom->id);
+                pfrom->PushMessage("getheaders", GetHeaderChainLocator(chain), uint256(0));
+                return;
+            }
+        }
+
+        CValidationState validationState;
+        if (!blockDownloadScheduler.AcceptHeaders(
+                unknownHeaders,
+                parentIndex,
+                pfrom->GetId(),
+                Params(),
+                GetDifficultyAdjuster(),
+                GetAdjustedTime() + MAX_HEADER_FUTURE_DRIFT,
+                Params().Checkpoints().mapCheckpoints,
+                chain.Tip()->nChainWork,
+                validationState))
+        {
+            int nDoS = 0;
+            if (validationState.IsInvalid(nDoS) && nDoS > 0)
+                Misbehaving(state, nDoS, "Sent invalid headers");
+            return;
+        }
+
+        const int lastHeaderHeight = blockDownloadScheduler.GetPendingHeight(unknownHeaders.back().GetHash());
+        extendedHeaderChain = lastHeaderHeight >= 0;
+        state->nBestHeaderHeight = std::max(state->nBestHeaderHeight, lastHeaderHeight);
+        LogPrint("net", "%s : %u headers from peer=%d, header chain reaches height %d\n", __func__,
+                 headers.size(), pfrom->id, blockDownloadScheduler.BestHeaderHeight());
+    }
+
+    // A full batch means the peer has more; only follow up while it keeps extending the header chain
+    if (headers.size() == MAX_HEADERS_RESULTS && (extendedHeaderChain || firstUnknownHeader == headers.size()))
+        pfrom->PushMessage("getheaders", GetHeaderChainLocator(chain), uint256(0));
+}
+
+/** How long a block dropped after a peer sent invalid compact block data may be fetched from the other peers that announced it */
+constexpr int64_t REFETCH_DROPPED_BLOCK_WINDOW = 10 * 60 * 1000000;
+/** Blocks dropped after invalid compact block data, with the peer that sent it and when. Requires cs_main. */
+static std::map<uint256, std::pair<NodeId, int64_t>> blocksToFetchFromOtherPeers;
+
+static void FetchBlockFromOtherPeers(CCriticalSection& mainCriticalSection, CNode* misbehavingPeer, const uint256& blockHash)
+{
+    LOCK(mainCriticalSection);
+    if (GetSourceOfInFlightBlock(blockHash) == misbehavingPeer->GetId())
+        MarkBlockAsReceived(blockHash);
+    blocksToFetchFromOtherPeers[blockHash] = std::make_pair(misbehavingPeer->GetId(), GetTimeMicros());
+}
+
+// requires LOCK(cs_main)
+static void CollectDroppedBlocksToRequest(int64_t nNow, CNode* pto, std::vector<CInv>& vGetData)
+{
+    const ChainstateManager::Reference chainstate;
+    const auto& blockMap = chainstate->GetBlockMap();
+    const CNodeState* state = pto->GetNodeState();
+    for (auto it = blocksToFetchFromOtherPeers.begin(); it != blocksToFetchFromOtherPeers.end();)
+    {
+        const uint256& blockHash = it->first;
+        if (blockMap.count(blockHash) || it->second.second + REFETCH_DROPPED_BLOCK_WINDOW < nNow)
+        {
+            it = blocksToFetchFromOtherPeers.erase(it);
+            continue;
+        }
+        // Only ask peers that announced the block; whoever announces it from now on fetches it as usual
+        if (pto->IsFlaggedForDisconnection() || pto->GetId() == it->second.first ||
+            state->hashLastUnknownBlock != blockHash || BlockIsInFlight(blockHash))
+        {
+            ++it;
+            continue;
+        }
+        vGetData.push_back(CInv(MSG_BLOCK, blockHash));
+        MarkBlockAsInFlight(pto->GetId(), blockHash);
+        LogPrint("net", "Requesting block %s dropped by peer=%d from peer=%d\n", blockHash, it->second.first, pto->id);
+        it = blocksToFetchFromOtherPeers.erase(it);
+    }
+}
+
+static void RequestFullBlockInstead(CCriticalSection& mainCriticalSection, CNode* pfrom, const uint256& blockHash)
+{
+    {
+        LOCK(mainCriticalSection);
+        pfrom->GetNodeState()->partiallyDownloadedBlock.reset();
+        MarkBlockAsInFlight(pfrom->GetId(), blockHash);
+    }
+    std::vector<CInv> vGetData(1, CInv(MSG_BLOCK, blockHash));
+    pfrom->PushMessage("getdata", vGetData);
+}
+
+static void ProcessReceivedCompactBlock(CCriticalSection& mainCriticalSection, CNode* pfrom, const CBlockHeaderAndShortTxIDs& compactBlock)
+{
+    const ChainstateManager::Reference chainstate;
+    const auto& blockMap = chainstate->GetBlockMap();
+    const uint256 blockHash = compactBlock.header.GetHash();
+    bool parentIsKnown = false;
+    {
+        LOCK(mainCriticalSection);
+        if (blockMap.count(blockHash))
+        {
+            LogPrint("net", "%s : Already processed block %s, skipping compact block\n", __func__, blockHash);
+            return;
+        }
+        parentIsKnown = blockMap.count(compactBlock.header.hashPrevBlock) > 0;
+    }
+    if (!parentIsKnown)
+    {
+        // The full block goes through the usual getblocks catch-up when its parent is unknown
+        LogPrint("net", "compact block %s from peer=%d does not connect, requesting full block\n", blockHash, pfrom->id);
+        RequestFullBlockInstead(mainCriticalSection, pfrom, blockHash);
+        return;
+    }
+
+    std::unique_ptr<PartiallyDownloadedBlock> partialBlock(new PartiallyDownloadedBlock());
+    const CompactBlockReadStatus status = partialBlock->InitData(compactBlock, GetTransactionMemoryPool());
+    if (status == CompactBlockReadStatus::INVALID)
+    {
+        Misbehaving(pfrom->GetNodeState(), 100, "Sent malformed compact block");
+        FetchBlockFromOtherPeers(mainCriticalSection, pfrom, blockHash);
+        return;
+    }
+    if (status == CompactBlockReadStatus::FAILED)
+    {
+        LogPrint("net", "compact block %s from peer=%d has colliding short ids, requesting full block\n", blockHash, pfrom->id);
+        RequestFullBlockInstead(mainCriticalSection, pfrom, blockHash);
+        return;
+    }
+
+    const std::vector<uint16_t> missingIndexes = partialBlock->GetMissingTransactionIndexes();
+    LogPrint("net", "received compact block %s peer=%d: %u txs, %u prefilled, %u from mempool, %u missing\n",
+        blockHash, pfrom->id, compactBlock.BlockTransactionCount(),
+        partialBlock->PrefilledTransactionCount(), partialBlock->MempoolTransactionCount(), missingIndexes.size());
+    if (!missingIndexes.empty())
+    {
+        BlockTransactionsRequest request;
+        request.blockhash = blockHash;
+        request.indexes = missingIndexes;
+        {
+            LOCK(mainCriticalSection);
+            pfrom->GetNodeState()->partiallyDownloadedBlock = std::move(partialBlock);
+        }
+        pfrom->PushMessage("getblocktxn", request);
+        return;
+    }
+
+    CBlock block;
+    if (partialBlock->FillBlock(block, std::vector<CTransaction>()) != CompactBlockReadStatus::OK)
+    {
+        RequestFullBlockInstead(mainCriticalSection, pfrom, blockHash);
+        return;
+    }
+    ProcessReceivedBlock(mainCriticalSection, pfrom, "cmpctblock", block);
+}
+
+static void ProcessReceivedBlockTransactions(CCriticalSection& mainCriticalSection, CNode* pfrom, const BlockTransactions& blockTransactions)
+{
+    std::unique_ptr<PartiallyDownloadedBlock> partialBlock;
+    {
+        LOCK(mainCriticalSection);
+        std::unique_ptr<PartiallyDownloadedBlock>& pendingBlock = pfrom->GetNodeState()->partiallyDownloadedBlock;
+        if (!pendingBlock || pendingBlock->GetBlockHash() != blockTransactions.blockhash)
+        {
+            LogPrint("net", "peer=%d sent blocktxn for %s that was not requested\n", pfrom->id, blockTransactions.blockhash);
+            return;
+        }
+        partialBlock = std::move(pendingBlock);
+    }
+
+    CBlock block;
+    const CompactBlockReadStatus status = partialBlock->FillBlock(block, blockTransactions.txn);
+    if (status == CompactBlockReadStatus::INVALID)
+    {
+        // The block is not asked of this peer again
+        Misbehaving(pfrom->GetNodeState(), 100, "Sent invalid transactions for compact block");
+        FetchBlockFromOtherPeers(mainCriticalSection, pfrom, blockTransactions.blockhash);
+        return;
+    }
+    if (status == CompactBlockReadStatus::FAILED)
+    {
+        RequestFullBlockInstead(mainCriticalSection, pfrom, blockTransactions.blockhash);
+        return;
+    }
+    LogPrint("net", "reconstructed block %s peer=%d with %u transactions from blocktxn\n", blockTransactions.blockhash, pfrom->id, blockTransactions.txn.size());
+    ProcessReceivedBlock(mainCriticalSection, pfrom, "blocktxn", block);
+}
+
+static void SendRequestedBlockTransactions(CCriticalSection& mainCriticalSection, CNode* pfrom, const BlockTransactionsRequest& request)
+{
+    std::pair<const CBlockIndex*, bool> blockIndexAndSendStatus = GetBlockIndexOfRequestedBlock(mainCriticalSection, pfrom->GetId(), request.blockhash);
+    if (!blockIndexAndSendStatus.second)
+        return;
+    if (!BlockIsWithinDepth(mainCriticalSection, blockIndexAndSendStatus.first, MAX_BLOCK_TRANSACTIONS_DEPTH))
+    {
+        // Too old to be part of a reconstruction; let the peer have the whole block
+        LogPrint("net", "peer=%d asked for transactions of old block %s, sending full block\n", pfrom->id, request.blockhash);
+        PushCorrespondingBlockToPeer(pfrom, blockIndexAndSendStatus.first, MSG_BLOCK);
+        return;
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, blockIndexAndSendStatus.first))
+        assert(!"cannot load block from disk");
+
+    BlockTransactions response(request);
+    for (size_t requestIndex = 0; requestIndex < request.indexes.size(); ++requestIndex)
+    {
+        const uint16_t txIndex = request.indexes[requestIndex];
+        if (txIndex >= block.vtx.size())
+        {
+            LOCK(mainCriticalSection);
+            Misbehaving(pfrom->GetNodeState(), 100, "Requested out of range transactions of a block");
+            return;
+        }
+        response.txn[requestIndex] = block.vtx[txIndex];
+    }
+    pfrom->PushMessage("blocktxn", response);
+}
+
 bool static ProcessMessage(CCriticalSection& mainCriticalSection, CNode* pfrom, std::string strCommand, CDataStream& vRecv, int64_t nTimeReceived)
 {
     static CAddrMan& addrman = GetNetworkAddressManager();
@@ -597,11 +1156,33 @@ bool static ProcessMessage(CCriticalSection& mainCriticalSection, CNode* pfrom,
         }
         {
             LOCK(mainCriticalSection);
+            // Freshly announced blocks are mostly made of transactions already in our mempool
+            const bool requestCompactBlocks =
+                !blockInventory.empty() &&
+                pfrom->GetNodeState()->fSupportsCompactBlocks &&
+                !IsInitialBlockDownload(mainCriticalSection,settings);
+            const BlockDownloadScheduler& blockDownloadScheduler = GetBlockDownloadScheduler();
             for(const CInv* blockInventoryReference: blockInventory)
             {
+                const int pendingHeight = blockDownloadScheduler.GetPendingHeight(blockInventoryReference->GetHash());
+                if(pendingHeight >= 0)
+                {
+                    // Already part of the header chain, and fetched by the download scheduler
+                    CNodeState* state = pfrom->GetNodeState();
+                    state->nBestHeaderHeight = std::max(state->nBestHeaderHeight, pendingHeight);
+                    continue;
+                }
                 if(!BlockIsInFlight(blockInventoryReference->GetHash()))
                 {
-                    vToFetch.push_back(*blockInventoryReference);
+                    if(requestCompactBlocks)
+                    {
+                        vToFetch.emplace_back(MSG_CMPCT_BLOCK, blockInventoryReference->GetHash());
+                        MarkBlockAsInFlight(pfrom->GetId(), blockInventoryReference->GetHash());
+                    }
+                    else
+                    {
+                        vToFetch.push_back(*blockInventoryReference);
+                    }
                     LogPrint("net", "getblocks (%d) %s to peer=%d\n", GetBestHeaderBlockHeight(), blockInventoryReference->GetHash(), pfrom->id);
                 }
             }
@@ -621,7 +1202,7 @@ bool static ProcessMessage(CCriticalSection& mainCriticalSection, CNode* pfrom,
 
         pfrom->HandleRequestForData(vInv);
     }
-    else if (strCommand == "getblocks" || strCommand == "getheaders")
+    else if (strCommand == "getblocks")
     {
         CBlockLocator locator;
         uint256 hashStop;
@@ -666,17 +1247,16 @@ bool static ProcessMessage(CCriticalSection& mainCriticalSection, CNode* pfrom,
         if (!vInv.empty())
             pfrom->PushMessage("inv", vInv);
     }
-    else if (strCommand == "headers" && Params().HeadersFirstSyncingActive())
+    else if (strCommand == "getheaders")
     {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
 
+        // Only headers of our active chain are served, all of which we have fully validated,
+        // so there is no need to hold back while we are still catching up ourselves
         LOCK(mainCriticalSection);
 
-        if (IsInitialBlockDownload(mainCriticalSection,settings))
-            return true;
-
         const CBlockIndex* pindex = nullptr;
         if (locator.IsNull()) {
             // If locator is null, return the hashStop block
@@ -702,10 +1282,22 @@ bool static ProcessMessage(CCriticalSection& mainCriticalSection, CNode* pfrom,
         }
         pfrom->PushMessage("headers", vHeaders);
     }
+    else if (strCommand == "headers" && Params().HeadersFirstSyncingActive())
+    {
+        const unsigned int nCount = ReadCompactSize(vRecv);
+        if (nCount > MAX_HEADERS_RESULTS) {
+            Misbehaving(pfrom->GetNodeState(), 20, "Sent too many headers");
+            return error("headers message size = %u", nCount);
+        }
+        std::vector<CBlockHeader> headers(nCount);
+        for (CBlockHeader& header: headers) {
+            vRecv >> header;
+            ReadCompactSize(vRecv); // ignore tx count; assume it is 0.
+        }
+        ProcessReceivedHeaders(mainCriticalSection, pfrom, headers);
+    }
     else if (strCommand == "tx" || strCommand == "dstx")
     {
-        std::vector<uint256> vWorkQueue;
-        std::vector<uint256> vEraseQueue;
         CTransaction tx;
 
         //masternode signed transaction
@@ -732,7 +1324,6 @@ bool static ProcessMessage(CCriticalSection& mainCriticalSection, CNode* pfrom,
         {
             mempool.check(&coinsTip, blockMap);
             RelayTransactionToAllPeers(tx);
-            vWorkQueue.push_back(inv.GetHash());
 
             LogPrint("mempool", "%s: peer=%d %s : accepted %s (poolsz %u)\n",
                     __func__,
@@ -740,47 +1331,9 @@ bool static ProcessMessage(CCriticalSection& mainCriticalSection, CNode* pfrom,
                      tx.ToStringShort(),
                      mempool.mapTx.size());
 
-            // Recursively process any orphan transactions that depended on this one
-            std::set<NodeId> setMisbehaving;
-            for(unsigned int i = 0; i < vWorkQueue.size(); i++)
-            {
-                const std::set<uint256>& spendingTransactionIds = GetOrphanSpendingTransactionIds(vWorkQueue[i]);
-                for(const uint256 &orphanHash: spendingTransactionIds)
-                {
-                    NodeId fromPeer;
-                    const CTransaction &orphanTx = GetOrphanTransaction(orphanHash,fromPeer);
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes to counter-DoS based on orphan
-                    // resolution (that is, feeding people an invalid transaction based on LegitTxX in order to get
-                    // anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-
-                    if(setMisbehaving.count(fromPeer))
-                        continue;
-                    if(MempoolConsensus::AcceptToMemoryPool(mempool, stateDummy, orphanTx, true, &fMissingInputs2)) {
-                        LogPrint("mempool", "   accepted orphan tx %s\n", orphanHash);
-                        RelayTransactionToAllPeers(orphanTx);
-                        vWorkQueue.push_back(orphanHash);
-                        vEraseQueue.push_back(orphanHash);
-                    } else if(!fMissingInputs2) {
-                        int nDos = 0;
-                        if(stateDummy.IsInvalid(nDos) && nDos > 0) {
-                            // Punish peer that gave us an invalid orphan tx
-                            Misbehaving(fromPeer, nDos, "Invalid orphan transaction required by mempool transaction");
-                            setMisbehaving.insert(fromPeer);
-                            LogPrint("mempool", "   invalid orphan tx %s\n", orphanHash);
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee/priority
-                        LogPrint("mempool", "   removed orphan tx %s\n", orphanHash);
-                        vEraseQueue.push_back(orphanHash);
-                    }
-                    mempool.check(&coinsTip, blockMap);
-                }
-            }
-
-            for(uint256 hash: vEraseQueue)EraseOrphanTx(hash);
+            // Queue up any orphan transactions that depended on this one and work off a bounded batch
+            AddOrphansSpendingTransactionToWorkQueue(tx);
+            ProcessOrphanWorkQueue(mempool, MAX_ORPHAN_WORK_UNITS_PER_MESSAGE);
         }
         else if (fMissingInputs)
         {
@@ -788,7 +1341,8 @@ bool static ProcessMessage(CCriticalSection& mainCriticalSection, CNode* pfrom,
 
             // DoS prevention: do not allow mapOrphanTransactions to grow unbounded
             unsigned int nMaxOrphanTx = (unsigned int)std::max((int64_t)0, settings.GetArg("-maxorphantx", DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+            size_t nMaxOrphanTxBytes = (size_t)std::max((int64_t)0, settings.GetArg("-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE)) * 1000;
+            unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx, nMaxOrphanTxBytes);
             if (nEvicted > 0)
                 LogPrint("mempool", "mapOrphan overflow, removed %u tx\n", nEvicted);
         } else if (pfrom->fWhitelisted) {
@@ -815,46 +1369,38 @@ bool static ProcessMessage(CCriticalSection& mainCriticalSection, CNode* pfrom,
     {
         CBlock block;
         vRecv >> block;
-        uint256 hashBlock = block.GetHash();
-        CInv inv(MSG_BLOCK, hashBlock);
-        LogPrint("net", "received block %s peer=%d\n", inv.GetHash(), pfrom->id);
-
-        //sometimes we will be sent their most recent block and its not the one we want, in that case tell where we are
-        if (!blockMap.count(block.hashPrevBlock)) {
-            if (find(pfrom->vBlockRequested.begin(), pfrom->vBlockRequested.end(), hashBlock) != pfrom->vBlockRequested.end()) {
-                //we already asked for this block, so lets work backwards and ask for the previous block
-                pfrom->PushMessage("getblocks", chain.GetLocator(), block.hashPrevBlock);
-                pfrom->vBlockRequested.push_back(block.hashPrevBlock);
-            } else {
-                //ask to sync to this block
-                pfrom->PushMessage("getblocks", chain.GetLocator(), hashBlock);
-                pfrom->vBlockRequested.push_back(hashBlock);
-            }
-        } else {
-            pfrom->AddInventoryKnown(inv);
-
-            CValidationState state;
-            if (!blockMap.count(block.GetHash())) {
-                GetBlockSubmitter().acceptBlockForChainExtension(state,block,pfrom);
-                int nDoS;
-                if(state.IsInvalid(nDoS)) {
-                    pfrom->PushMessage("reject", strCommand, state.GetRejectCode(),
-                                       state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.GetHash());
-                    if(nDoS > 0) {
-                        TRY_LOCK(mainCriticalSection, lockMain);
-                        if(lockMain) Misbehaving(pfrom->GetNodeState(), nDoS, "Bad block processed");
-                    }
-                }
-                //disconnect this node if its old protocol version
-                if(pfrom->DisconnectOldProtocol(ActiveProtocol(), strCommand))
-                {
-                    PeerBanningService::Ban(GetTime(),pfrom->GetCAddress());
-                }
-            } else {
-                LogPrint("net", "%s : Already processed block %s, skipping block processing()\n", __func__, block.GetHash());
-            }
+        LogPrint("net", "received block %s peer=%d\n", block.GetHash(), pfrom->id);
+        ProcessReceivedBlock(mainCriticalSection, pfrom, strCommand, block);
+    }
+    else if (strCommand == "sendcmpct")
+    {
+        bool highBandwidthMode = false;
+        uint64_t compactBlocksVersion = 0;
+        vRecv >> highBandwidthMode >> compactBlocksVersion;
+        if (compactBlocksVersion == COMPACT_BLOCKS_VERSION && CompactBlocksAreEnabled())
+        {
+            LOCK(mainCriticalSection);
+            pfrom->GetNodeState()->fSupportsCompactBlocks = true;
         }
     }
+    else if (strCommand == "cmpctblock" && !settings.isImportingFiles() && !settings.isReindexingBlocks())
+    {
+        CBlockHeaderAndShortTxIDs compactBlock;
+        vRecv >> compactBlock;
+        ProcessReceivedCompactBlock(mainCriticalSection, pfrom, compactBlock);
+    }
+    else if (strCommand == "getblocktxn")
+    {
+        BlockTransactionsRequest request;
+        vRecv >> request;
+        SendRequestedBlockTransactions(mainCriticalSection, pfrom, request);
+    }
+    else if (strCommand == "blocktxn" && !settings.isImportingFiles() && !settings.isReindexingBlocks())
+    {
+        BlockTransactions blockTransactions;
+        vRecv >> blockTransactions;
+        ProcessReceivedBlockTransactions(mainCriticalSection, pfrom, blockTransactions);
+    }
     // This asymmetric behavior for inbound and outbound connections was introduced
     // to prevent a fingerprinting attack: an attacker can send specific fake addresses
     // to users' AddrMan and later request them by sending getaddr messages.
@@ -862,7 +1408,10 @@ bool static ProcessMessage(CCriticalSection& mainCriticalSection, CNode* pfrom,
     // getaddr message mitigates the attack.
     else if ((strCommand == "getaddr") && (pfrom->fInbound))
     {
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_addrRelay);
+            pfrom->vAddrToSend.clear();
+        }
         std::vector<CAddress> vAddr = addrman.GetAddr();
         for(const CAddress& addr: vAddr)
                 pfrom->PushAddress(addr);
@@ -1009,6 +1558,46 @@ static NetworkMessageState CheckNetworkMessageHeader(
     return NetworkMessageState::VALID;
 }
 
+static bool RequestsForDataCanBeServedConcurrently(const std::deque<CInv>& requestsForData)
+{
+    // Blocks (read from disk after a short lookup under the main lock) and relayed
+    // transactions are served from data that carries its own locks; a single
+    // ProcessGetData call stops after the first block it serves
+    for(const CInv& inv: requestsForData)
+    {
+        if (IsRequestForBlock(inv))
+            return true;
+        if (inv.GetType() != MSG_TX)
+            return false;
+    }
+    return true;
+}
+
+static bool MessageCanBeProcessedConcurrently(const CNode* pfrom, const std::string& strCommand)
+{
+    // Requests that are answered from this peer's own state or from structures that
+    // do their own locking; anything that mutates shared state stays serialized
+    return strCommand == "getdata" ||
+        strCommand == "getblocks" ||
+        strCommand == "getheaders" ||
+        (strCommand == "getaddr" && pfrom->fInbound) ||
+        strCommand == "addr" ||
+        strCommand == "ping" ||
+        strCommand == "pong";
+}
+
+// requires LOCK(cs_vRecvMsg)
+bool MessagesCanBeProcessedConcurrently(CNode* pfrom)
+{
+    if (!RequestsForDataCanBeServedConcurrently(pfrom->GetRequestForDataQueue()))
+        return false;
+
+    const std::deque<CNetMessage>& receivedMessageQueue = pfrom->GetReceivedMessageQueue();
+    if (receivedMessageQueue.empty() || !receivedMessageQueue.front().complete())
+        return true;
+    return MessageCanBeProcessedConcurrently(pfrom, receivedMessageQueue.front().hdr.GetCommand());
+}
+
 // requires LOCK(cs_vRecvMsg)
 bool ProcessReceivedMessages(CNode* pfrom)
 {
@@ -1040,13 +1629,19 @@ bool ProcessReceivedMessages(CNode* pfrom)
         }
         else if(messageStatus == NetworkMessageState::SKIP_MESSAGE)
         {
-            continue;
+            // The skipped message uses up this call, so that MessagesCanBeProcessedConcurrently
+            // only ever has to look at the message at the front of the queue
+            break;
         }
         const CMessageHeader& hdr = msg.hdr;
         std::string strCommand = msg.hdr.GetCommand();
+        MessageTypeStatistics& messageStatistics = pfrom->GetMessageStatistics();
+        messageStatistics.RecordReceived(strCommand, hdr.nMessageSize + CMessageHeader::HEADER_SIZE);
+        pfrom->CaptureReceivedMessage(msg);
 
         // Process message
         bool fRet = false;
+        const int64_t nProcessingStart = GetTimeMicros();
         try {
             fRet = ProcessMessage(cs_main, pfrom, strCommand, msg.vRecv, msg.nTime);
             boost::this_thread::interruption_point();
@@ -1068,6 +1663,7 @@ bool ProcessReceivedMessages(CNode* pfrom)
         } catch (...) {
             PrintExceptionContinue(NULL, __func__);
         }
+        messageStatistics.RecordProcessingTime(strCommand, GetTimeMicros() - nProcessingStart);
 
         if (!fRet)
             LogPrintf("%s(%s, %u bytes) FAILED peer=%d\n",__func__, SanitizeString(strCommand), hdr.nMessageSize, pfrom->id);
@@ -1086,6 +1682,7 @@ bool ProcessReceivedMessages(CNode* pfrom)
 
 static void SendAddresses(CNode* pto)
 {
+    LOCK(pto->cs_addrRelay);
     std::vector<CAddress> vAddr;
     vAddr.reserve(pto->vAddrToSend.size());
     for(const CAddress& addr: pto->vAddrToSend) {
@@ -1104,6 +1701,7 @@ static void SendAddresses(CNode* pto)
         pto->PushMessage("addr", vAddr);
 }
 
+// requires LOCK(cs_main)
 static void CheckForBanAndDisconnectIfNotWhitelisted(CNode* pto)
 {
     CNodeState* nodeState = pto->GetNodeState();
@@ -1127,8 +1725,10 @@ static void CheckForBanAndDisconnectIfNotWhitelisted(CNode* pto)
     nodeState->fShouldBan = false;
 }
 
-static void BeginSyncingWithPeer(CNode* pto)
+static void BeginSyncingWithPeer(CCriticalSection& mainCriticalSection, CNode* pto)
 {
+    // The count of syncing peers is shared with peers being finalized on the socket thread
+    LOCK(mainCriticalSection);
     CNodeState* state = pto->GetNodeState();
     if (!state->Syncing() && !pto->fClient && !settings.isReindexingBlocks()) {
         const ChainstateManager::Reference chainstate;
@@ -1137,21 +1737,33 @@ static void BeginSyncingWithPeer(CNode* pto)
         // Only actively request headers from a single peer, unless we're close to end of initial download.
         if ( !CNodeState::NodeSyncStarted() || GetBestHeaderBlocktime() > GetAdjustedTime() - 6 * 60 * 60) { // NOTE: was "close to today" and 24h in Bitcoin
             state->RecordNodeStartedToSync();
-            pto->PushMessage("getblocks", chain.GetLocator(chain.Tip()), uint256(0));
+            if (PeerSupportsHeadersFirstSync(pto)) {
+                // The blocks themselves are then fetched from all download peers, see CollectBlockDataToRequest
+                const CBlockLocator locator = GetHeaderChainLocator(chain);
+                pto->PushMessage("getheaders", locator, uint256(0));
+            } else {
+                pto->PushMessage("getblocks", chain.GetLocator(chain.Tip()), uint256(0));
+            }
         }
     }
 }
 static void SendInventoryToPeer(CNode* pto, bool fSendTrickle)
 {
-    std::vector<CInv> vInv;
+    // Batches of at most MAX_INV_TO_SEND_PER_MESSAGE entries, pushed once cs_inventory is released
+    static const size_t MAX_INV_TO_SEND_PER_MESSAGE = 1000;
+    std::vector<std::vector<CInv>> vInvBatches;
     {
         std::vector<CInv> vInvWait;
 
         LOCK(pto->cs_inventory);
-        vInv.reserve(pto->vInventoryToSend.size());
+        if (pto->vInventoryToSend.empty())
+            return;
         vInvWait.reserve(pto->vInventoryToSend.size());
+        vInvBatches.emplace_back();
+        vInvBatches.back().reserve(std::min(pto->vInventoryToSend.size(), MAX_INV_TO_SEND_PER_MESSAGE));
         for (const auto& inv : pto->vInventoryToSend) {
-            if (pto->setInventoryKnown.count(inv) > 0)
+            const uint256 hash = inv.GetHash();
+            if (pto->filterInventoryKnown.contains(hash))
                 continue;
 
             // trickle out tx inv to protect privacy
@@ -1160,7 +1772,7 @@ static void SendInventoryToPeer(CNode* pto, bool fSendTrickle)
                 static uint256 hashSalt;
                 if (hashSalt == 0)
                     hashSalt = GetRandHash();
-                uint256 hashRand = inv.GetHash() ^ hashSalt;
+                uint256 hashRand = hash ^ hashSalt;
                 hashRand = Hash(BEGIN(hashRand), END(hashRand));
                 bool fTrickleWait = ((hashRand & 3) != 0);
 
@@ -1170,19 +1782,18 @@ static void SendInventoryToPeer(CNode* pto, bool fSendTrickle)
                 }
             }
 
-            // returns true if wasn't already contained in the set
-            if (pto->setInventoryKnown.insert(inv).second) {
-                vInv.push_back(inv);
-                if (vInv.size() >= 1000) {
-                    pto->PushMessage("inv", vInv);
-                    vInv.clear();
-                }
-            }
+            // Also catches duplicates within vInventoryToSend
+            pto->filterInventoryKnown.insert(hash);
+            if (vInvBatches.back().size() >= MAX_INV_TO_SEND_PER_MESSAGE)
+                vInvBatches.emplace_back();
+            vInvBatches.back().push_back(inv);
         }
         pto->vInventoryToSend = std::move(vInvWait);
     }
-    if (!vInv.empty())
-        pto->PushMessage("inv", vInv);
+    for (const std::vector<CInv>& vInv : vInvBatches) {
+        if (!vInv.empty())
+            pto->PushMessage("inv", vInv);
+    }
 }
 static void RequestDisconnectionFromNodeIfStalling(int64_t nNow, CNode* pto)
 {
@@ -1201,6 +1812,11 @@ static void RequestDisconnectionFromNodeIfStalling(int64_t nNow, CNode* pto)
     if (!pto->IsFlaggedForDisconnection() && BlockDownloadHasTimedOut(pto->GetId(),nNow,Params().TargetSpacing()) ) {
         pto->FlagForDisconnection();
     }
+    // Hand whatever the peer still owes us to the other peers right away, rather than once it is gone
+    if (pto->IsFlaggedForDisconnection() && GetNumberOfBlocksInFlight(pto->GetId()) > 0) {
+        LogPrint("net", "Reassigning %d blocks in flight from peer=%d\n", GetNumberOfBlocksInFlight(pto->GetId()), pto->id);
+        ReleaseBlocksInFlight(pto->GetId());
+    }
 }
 static void CollectBlockDataToRequest(int64_t nNow, CNode* pto, std::vector<CInv>& vGetData)
 {
@@ -1218,6 +1834,25 @@ static void CollectBlockDataToRequest(int64_t nNow, CNode* pto, std::vector<CInv
             LogPrintf("Requesting block %s (%d) peer=%d\n", pindex->GetBlockHash(),
                         pindex->nHeight, pto->id);
         }
+        if (HeadersFirstSyncIsEnabled() && GetNumberOfBlocksInFlight(pto->GetId()) < MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+            // Spread the blocks of the header chain over every download peer that has them
+            RemoveAcceptedBlocksFromHeaderChain(blockMap);
+            DiscardHeaderChainWithoutBlocks(nNow);
+            BlockDownloadScheduler& blockDownloadScheduler = GetBlockDownloadScheduler();
+            if (PeerSupportsHeadersFirstSync(pto) && blockDownloadScheduler.NeedsMoreHeaders()) {
+                // The header chain has drained enough to take the headers that did not fit in earlier
+                blockDownloadScheduler.RecordMoreHeadersRequested();
+                pto->PushMessage("getheaders", GetHeaderChainLocator(chain), uint256(0));
+            }
+            const int peerBestHeight = std::max(pto->nStartingHeight, pto->GetNodeState()->nBestHeaderHeight);
+            std::vector<uint256> vHeaderChainBlocks;
+            FindNextHeaderChainBlocksToDownload(pto->GetId(), peerBestHeight, MAX_BLOCKS_IN_TRANSIT_PER_PEER - GetNumberOfBlocksInFlight(pto->GetId()), vHeaderChainBlocks, staller);
+            for(const uint256& blockHash: vHeaderChainBlocks) {
+                vGetData.push_back(CInv(MSG_BLOCK, blockHash));
+                MarkBlockAsInFlight(pto->GetId(), blockHash);
+                LogPrint("net", "Requesting block %s of the header chain peer=%d\n", blockHash, pto->id);
+            }
+        }
         if (GetNumberOfBlocksInFlight(pto->GetId()) == 0 && staller != -1) {
             RecordWhenStallingBegan(staller,nNow);
         }
@@ -1225,9 +1860,9 @@ static void CollectBlockDataToRequest(int64_t nNow, CNode* pto, std::vector<CInv
 }
 void CollectNonBlockDataToRequestAndRequestIt(const CTxMemPool& mempool, CNode* pto, int64_t nNow, std::vector<CInv>& vGetData)
 {
-    while (!pto->IsFlaggedForDisconnection() && !pto->mapAskFor.empty() && (*pto->mapAskFor.begin()).first <= nNow)
+    while (!pto->IsFlaggedForDisconnection() && !pto->queueAskFor.empty() && pto->queueAskFor.top().first <= nNow)
     {
-        const CInv& inv = (*pto->mapAskFor.begin()).second;
+        const CInv& inv = pto->queueAskFor.top().second;
         if (!AlreadyHave(mempool, inv)) {
             LogPrint("net", "Requesting %s peer=%d\n", inv, pto->id);
             vGetData.push_back(inv);
@@ -1236,7 +1871,7 @@ void CollectNonBlockDataToRequestAndRequestIt(const CTxMemPool& mempool, CNode*
                 vGetData.clear();
             }
         }
-        pto->mapAskFor.erase(pto->mapAskFor.begin());
+        pto->queueAskFor.pop();
     }
     if (!vGetData.empty())
         pto->PushMessage("getdata", vGetData);
@@ -1296,18 +1931,30 @@ void PeriodicallyRebroadcastMempoolTxs(CCriticalSection& mainCriticalSection, CT
 bool SendMessages(CNode* pto, bool fSendTrickle)
 {
     {
+        {
+            // Orphans left over from earlier messages are worked off in bounded batches; when
+            // cs_main is busy they wait for the next round rather than stalling this peer's sends
+            TRY_LOCK(cs_main, lockMain);
+            if (lockMain && OrphanWorkQueueSize() > 0)
+                ProcessOrphanWorkQueue(GetTransactionMemoryPool(), MAX_ORPHAN_WORK_UNITS_PER_MESSAGE);
+        }
+
         if (fSendTrickle) {
             SendAddresses(pto);
         }
 
-        CheckForBanAndDisconnectIfNotWhitelisted(pto);
-
         // Start block sync
-        const CNodeState* state = pto->GetNodeState();
-        bool fFetch = state->fPreferredDownload || (!CNodeState::HavePreferredDownloadPeers() && !pto->fClient && !pto->fOneShot); // Download if this is a nice peer, or we have no nice peers and this one might do.
+        bool fFetch = false;
+        {
+            // Misbehaving may set fShouldBan from any handler thread
+            LOCK(cs_main);
+            CheckForBanAndDisconnectIfNotWhitelisted(pto);
+            const CNodeState* state = pto->GetNodeState();
+            fFetch = state->fPreferredDownload || (!CNodeState::HavePreferredDownloadPeers() && !pto->fClient && !pto->fOneShot); // Download if this is a nice peer, or we have no nice peers and this one might do.
+        }
         if(fFetch)
         {
-            BeginSyncingWithPeer(pto);
+            BeginSyncingWithPeer(cs_main, pto);
         }
         CTxMemPool& mempool = GetTransactionMemoryPool();
         if(!settings.isReindexingBlocks()) PeriodicallyRebroadcastMempoolTxs(cs_main, mempool);
@@ -1317,6 +1964,7 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         {
             LOCK(cs_main);
             RequestDisconnectionFromNodeIfStalling(nNow,pto);
+            CollectDroppedBlocksToRequest(nNow,pto,vGetData);
             if(fFetch) CollectBlockDataToRequest(nNow,pto,vGetData);
         }
         CollectNonBlockDataToRequestAndRequestIt(mempool, pto,nNow,vGetData);
@@ -1330,6 +1978,7 @@ void RegisterNodeSignals()
     nodeSignals.GetHeight.connect(&GetHeight);
     nodeSignals.InitializeNode.connect(&InitializeNode);
     nodeSignals.FinalizeNode.connect(&FinalizeNode);
+    nodeSignals.MessagesCanBeProcessedConcurrently.connect(&MessagesCanBeProcessedConcurrently);
     nodeSignals.ProcessReceivedMessages.connect(&ProcessReceivedMessages);
     nodeSignals.SendMessages.connect(&SendMessages);
     nodeSignals.RespondToRequestForDataFrom.connect(&RespondToRequestForDataFrom);
@@ -1342,6 +1991,7 @@ void UnregisterNodeSignals()
     nodeSignals.GetHeight.disconnect(&GetHeight);
     nodeSignals.InitializeNode.disconnect(&InitializeNode);
     nodeSignals.FinalizeNode.disconnect(&FinalizeNode);
+    nodeSignals.MessagesCanBeProcessedConcurrently.disconnect(&MessagesCanBeProcessedConcurrently);
     nodeSignals.ProcessReceivedMessages.disconnect(&ProcessReceivedMessages);
     nodeSignals.SendMessages.disconnect(&SendMessages);
     nodeSignals.RespondToRequestForDataFrom.disconnect(&RespondToRequestForDataFrom);
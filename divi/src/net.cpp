@@ -41,10 +41,16 @@
 #include <NodeStats.h>
 #include <NodeStateRegistry.h>
 #include <Node.h>
-#include <I_CommunicationRegistrar.h>
 #include <NodeState.h>
 #include <SocketChannel.h>
 #include <ChainSyncHelpers.h>
+#include <I_SocketPoller.h>
+#include <SelectSocketPoller.h>
+#include <EpollSocketPoller.h>
+#include <PeerMessageScheduler.h>
+
+#include <set>
+#include <unordered_map>
 
 #ifdef WIN32
 #include <string.h>
@@ -70,6 +76,9 @@ constexpr bool DEFAULT_UPNP = USE_UPNP;
 #else
 constexpr bool DEFAULT_UPNP = false;
 #endif
+/** -msghandlerthreads default and upper bound */
+constexpr int64_t DEFAULT_MESSAGE_HANDLER_THREADS = 4;
+constexpr int64_t MAX_MESSAGE_HANDLER_THREADS = 16;
 
 #ifdef WIN32
 // Win32 LevelDB doesn't use filedescriptors, and the ones used for
@@ -149,9 +158,43 @@ public:
 //
 int nMaxConnections = 125;
 bool fAddressesInitialized = false;
+
+#ifdef HAVE_SYS_EPOLL_H
+constexpr const char* DEFAULT_SOCKET_EVENTS_MODE = "epoll";
+#else
+constexpr const char* DEFAULT_SOCKET_EVENTS_MODE = "select";
+#endif
+static std::unique_ptr<I_SocketPoller> socketPoller;
+static std::unique_ptr<I_SocketPoller> CreateSocketPoller(const std::string& requestedMode)
+{
+#ifdef HAVE_SYS_EPOLL_H
+    if (requestedMode == "epoll")
+    {
+        EpollSocketPoller* epollPoller = new EpollSocketPoller();
+        if (epollPoller->IsValid())
+            return std::unique_ptr<I_SocketPoller>(epollPoller);
+        delete epollPoller;
+        LogPrintf("%s: epoll unavailable, falling back to select\n", __func__);
+    }
+#endif
+    if (requestedMode != "select" && requestedMode != DEFAULT_SOCKET_EVENTS_MODE)
+        LogPrintf("%s: unsupported -socketevents=%s, using select\n", __func__, requestedMode);
+    return std::unique_ptr<I_SocketPoller>(new SelectSocketPoller());
+}
+static bool SocketCanBePolled(SOCKET hSocket)
+{
+    return socketPoller? socketPoller->CanPollSocket(hSocket) : IsSelectableSocket(hSocket);
+}
+static void WakeSocketPoller()
+{
+    if (socketPoller)
+        socketPoller->Wakeup();
+}
+static void RequestSocketInterestRefresh(SOCKET socket);
 class NodeWithSocket
 {
 private:
+    const SOCKET polledSocket_;
     std::unique_ptr<SocketChannel> channel_;
     std::unique_ptr<CNode> node_;
 public:
@@ -159,7 +202,8 @@ public:
     NodeWithSocket(
         SOCKET socket,
         Args&&... args
-        ): channel_(new SocketChannel(socket))
+        ): polledSocket_(socket)
+        , channel_(new SocketChannel(socket, &RequestSocketInterestRefresh))
         , node_(CNode::CreateNode(*channel_,std::forward<Args>(args)...))
     {
     }
@@ -176,6 +220,19 @@ public:
     {
         return channel_->getSocket();
     }
+    /** The socket as registered with the poller, which stays known after the channel is closed */
+    SOCKET getPolledSocket() const
+    {
+        return polledSocket_;
+    }
+};
+
+/** Changes to the set of polled sockets and to what they wait for, handed to the socket handler thread */
+struct SocketRegistrationChanges
+{
+    std::vector<SOCKET> removedSockets;
+    std::vector<SOCKET> addedSockets;
+    std::vector<SOCKET> socketsToRefresh;
 };
 
 class NodeManager
@@ -186,18 +243,58 @@ private:
     std::list<std::unique_ptr<NodeWithSocket>> disconnectedNodes_;
     std::vector<ListenSocket> listeningSockets_;
     std::map<NodeId,std::unique_ptr<NodeWithSocket>> socketChannelsByNodeId_;
-    NodeManager(): cs_vNodes(), vNodes_(), disconnectedNodes_(), listeningSockets_(), socketChannelsByNodeId_()
+    std::unordered_map<SOCKET,CNode*> nodesBySocket_;
+    CCriticalSection cs_socketRegistrations;
+    SocketRegistrationChanges socketRegistrationChanges_;
+    bool socketHandlerWakeupPending_;
+    NodeManager(
+        ): cs_vNodes()
+        , vNodes_()
+        , disconnectedNodes_()
+        , listeningSockets_()
+        , socketChannelsByNodeId_()
+        , nodesBySocket_()
+        , cs_socketRegistrations()
+        , socketRegistrationChanges_()
+        , socketHandlerWakeupPending_(false)
     {
     }
+    /** Have the socket handler thread pick up the recorded changes now rather than after its polling timeout */
+    void wakeSocketHandler()
+    {
+        AssertLockHeld(cs_socketRegistrations);
+        if (socketHandlerWakeupPending_)
+            return;
+        socketHandlerWakeupPending_ = true;
+        WakeSocketPoller();
+    }
+    void stopPollingSocketOf(CNode* pnode)
+    {
+        AssertLockHeld(cs_vNodes);
+        auto channelIt = socketChannelsByNodeId_.find(pnode->GetId());
+        if (channelIt == socketChannelsByNodeId_.end())
+            return;
+        // The descriptor may already have been closed and handed to a newer connection
+        const SOCKET polledSocket = channelIt->second->getPolledSocket();
+        auto it = nodesBySocket_.find(polledSocket);
+        if (it == nodesBySocket_.end() || it->second != pnode)
+            return;
+        nodesBySocket_.erase(it);
+        LOCK(cs_socketRegistrations);
+        socketRegistrationChanges_.removedSockets.push_back(polledSocket);
+        wakeSocketHandler();
+    }
     void deleteNode(CNode* pnode)
     {
         AssertLockHeld(cs_vNodes);
+        stopPollingSocketOf(pnode);
         NodeId id = pnode->GetId();
         socketChannelsByNodeId_.erase(id);
     }
     void queueForDisconnection(CNode* pnode)
     {
         AssertLockHeld(cs_vNodes);
+        stopPollingSocketOf(pnode);
         NodeId id = pnode->GetId();
         disconnectedNodes_.emplace_back(socketChannelsByNodeId_[id].release());
         socketChannelsByNodeId_.erase(id);
@@ -217,6 +314,51 @@ public:
         vNodes_.push_back(pnode->node());
         socketChannelsByNodeId_[pnode->node()->GetId()].reset(pnode);
         vNodes_.back()->AddRef();
+        if (pnode->getPolledSocket() != INVALID_SOCKET)
+        {
+            nodesBySocket_[pnode->getPolledSocket()] = pnode->node();
+            LOCK(cs_socketRegistrations);
+            socketRegistrationChanges_.addedSockets.push_back(pnode->getPolledSocket());
+            wakeSocketHandler();
+        }
+    }
+    void requestInterestRefresh(SOCKET socket)
+    {
+        LOCK(cs_socketRegistrations);
+        socketRegistrationChanges_.socketsToRefresh.push_back(socket);
+        wakeSocketHandler();
+    }
+    SocketRegistrationChanges takeSocketRegistrationChanges()
+    {
+        SocketRegistrationChanges changes;
+        LOCK(cs_socketRegistrations);
+        std::swap(changes, socketRegistrationChanges_);
+        socketHandlerWakeupPending_ = false;
+        return changes;
+    }
+    /** Calls back with the node behind each of the sockets that is still connected */
+    template <typename NodeHandler>
+    void forEachNodeWithSocket(const std::set<SOCKET>& sockets, NodeHandler handleNode)
+    {
+        LOCK(cs_vNodes);
+        for(SOCKET socket: sockets)
+        {
+            auto it = nodesBySocket_.find(socket);
+            if (it != nodesBySocket_.end())
+                handleNode(socket, *it->second);
+        }
+    }
+    std::vector<std::pair<SOCKET,NodeRef>> referencesToNodesWithSockets(const std::vector<SOCKET>& sockets)
+    {
+        std::vector<std::pair<SOCKET,NodeRef>> nodeReferences;
+        LOCK(cs_vNodes);
+        for(SOCKET socket: sockets)
+        {
+            auto it = nodesBySocket_.find(socket);
+            if (it != nodesBySocket_.end())
+                nodeReferences.emplace_back(socket, NodeReferenceFactory::makeUniqueNodeReference(it->second));
+        }
+        return nodeReferences;
     }
     CCriticalSection& nodesLock()
     {
@@ -292,18 +434,6 @@ public:
         WSACleanup();
     #endif
     }
-    SOCKET getSocketByNodeId(NodeId id) const
-    {
-        auto it = socketChannelsByNodeId_.find(id);
-        if(it != socketChannelsByNodeId_.end())
-        {
-            return it->second->getSocket();
-        }
-        else
-        {
-            return INVALID_SOCKET;
-        }
-    }
 };
 
 static CCriticalSection& cs_vNodes = NodeManager::Instance().nodesLock();
@@ -521,7 +651,7 @@ NodeRef ConnectNode(CAddress addrConnect, const char* pszDest = NULL, const bool
     bool proxyConnectionFailed = false;
     if (pszDest ? ConnectSocketByName(addrConnect, hSocket, pszDest, Params().GetDefaultPort(), getConnectionTimeoutDuration(), &proxyConnectionFailed) :
                   ConnectSocket(addrConnect, hSocket, getConnectionTimeoutDuration(), &proxyConnectionFailed)) {
-        if (!IsSelectableSocket(hSocket)) {
+        if (!SocketCanBePolled(hSocket)) {
             LogPrintf("Cannot create connection: non-selectable socket created (fd >= FD_SETSIZE ?)\n");
             CloseSocket(hSocket);
             return NodeReferenceFactory::makeUniqueNodeReference(nullptr);
@@ -604,73 +734,66 @@ public:
     }
 };
 
-class SocketsProcessor final: public I_CommunicationRegistrar<SOCKET>
+static void RequestSocketInterestRefresh(SOCKET socket)
+{
+    NodeManager::Instance().requestInterestRefresh(socket);
+}
+
+class SocketsProcessor final
 {
 private:
-    struct timeval timeout;
-    fd_set fdsetRecv;
-    fd_set fdsetSend;
-    fd_set fdsetError;
-    SOCKET hSocketMax;
-    bool have_fds;
+    static constexpr int pollingTimeoutInMilliseconds = 50; // frequency of the housekeeping over all peers
+    I_SocketPoller& poller_;
+    NodeManager& nodeManager_;
     std::vector<ListenSocket>& listeningSockets_;
+    std::set<SOCKET> socketsToRefresh_;
+    std::set<SOCKET> busySockets_;
 public:
     SocketsProcessor(
-        std::vector<ListenSocket>& listeningSockets
-        ): hSocketMax(0)
-        , have_fds(false)
-        , listeningSockets_(listeningSockets)
+        I_SocketPoller& poller,
+        NodeManager& nodeManager
+        ): poller_(poller)
+        , nodeManager_(nodeManager)
+        , listeningSockets_(nodeManager.listeningSockets())
+        , socketsToRefresh_()
+        , busySockets_()
     {
-        timeout.tv_sec = 0;
-        timeout.tv_usec = 50000; // frequency to poll pnode->vSend
-        FD_ZERO(&fdsetRecv);
-        FD_ZERO(&fdsetSend);
-        FD_ZERO(&fdsetError);
+        for (const ListenSocket& hListenSocket: listeningSockets_)
+        {
+            if (hListenSocket.socket != INVALID_SOCKET)
+                poller_.SetInterest(hListenSocket.socket, false, true);
+        }
     }
 
-    virtual void RegisterForErrors(SOCKET hSocket)
-    {
-        FD_SET(hSocket, &fdsetError);
-        hSocketMax = std::max(hSocketMax, hSocket);
-    }
-    virtual void RegisterForSend(SOCKET hSocket)
-    {
-        FD_SET(hSocket, &fdsetSend);
-    }
-    virtual void RegisterForReceive(SOCKET hSocket)
+    static int PollingTimeout()
     {
-        FD_SET(hSocket, &fdsetRecv);
+        return pollingTimeoutInMilliseconds;
     }
-    virtual bool IsRegisteredForErrors(SOCKET hSocket) const
+    void ApplyRegistrationChanges()
     {
-        return FD_ISSET(hSocket, &fdsetError);
-    }
-    virtual bool IsRegisteredForSend(SOCKET hSocket) const
-    {
-        return FD_ISSET(hSocket, &fdsetSend);
-    }
-    virtual bool IsRegisteredForReceive(SOCKET hSocket) const
-    {
-        return FD_ISSET(hSocket, &fdsetRecv);
-    }
-
-    void ProcessListeningSockets()
-    {
-        for (const ListenSocket& hListenSocket: listeningSockets_)
+        SocketRegistrationChanges changes = nodeManager_.takeSocketRegistrationChanges();
+        for (SOCKET removedSocket: changes.removedSockets)
+        {
+            poller_.RemoveSocket(removedSocket);
+            socketsToRefresh_.erase(removedSocket);
+            busySockets_.erase(removedSocket);
+        }
+        for (SOCKET addedSocket: changes.addedSockets)
         {
-            FD_SET(hListenSocket.socket, &fdsetRecv);
-            hSocketMax = max(hSocketMax, hListenSocket.socket);
-            have_fds = true;
+            // Drops what was left over from an earlier connection that had the same descriptor
+            poller_.RemoveSocket(addedSocket);
+            socketsToRefresh_.insert(addedSocket);
         }
+        socketsToRefresh_.insert(changes.socketsToRefresh.begin(), changes.socketsToRefresh.end());
     }
-    // Implement the following logic in AssignNodesToSendOrReceiveTasks:
-    // * If there is data to send, select() for sending data. As this only
+    // Implement the following logic in RefreshSocketInterest:
+    // * If there is data to send, poll for sending data. As this only
     //   happens when optimistic write failed, we choose to first drain the
     //   write buffer in this case before receiving more. This avoids
     //   needlessly queueing received data, if the remote peer is not themselves
     //   receiving data. This means properly utilizing TCP flow control signalling.
     // * Otherwise, if there is no (complete) message in the receive buffer,
-    //   or there is space left in the buffer, select() for receiving data.
+    //   or there is space left in the buffer, poll for receiving data.
     // * (if neither of the above applies, there is certainly one message
     //   in the receiver buffer ready to be processed).
     // Together, that means that at least one of the following is always possible,
@@ -678,56 +801,47 @@ public:
     // * We send some data.
     // * We wait for data to be received (and disconnect after timeout).
     // * We process a message in the buffer (message handler thread).
-    void AssignNodesToSendOrReceiveTasks(CCriticalSection& nodesLock, std::vector<CNode*>& nodes)
+    //
+    // Registrations persist between rounds. Only the sockets whose wait can have changed
+    // are looked at again: the ones serviced in the previous round, the ones whose
+    // connection queued data that could not be sent right away, and the busy ones, whose
+    // receive buffer is drained by the message handler threads.
+    void RefreshSocketInterest()
     {
-        LOCK(nodesLock);
-        for(CNode* pnode: nodes)
+        socketsToRefresh_.insert(busySockets_.begin(), busySockets_.end());
+        nodeManager_.forEachNodeWithSocket(socketsToRefresh_, [this](SOCKET nodeSocket, CNode& node)
         {
-            if (!pnode->CommunicationChannelIsValid())
-                continue;
-            have_fds = true;
-            SOCKET nodeSocket = NodeManager::Instance().getSocketByNodeId(pnode->GetId());
-            RegisterForErrors(nodeSocket);
-            CommsMode mode = pnode->SelectCommunicationMode();
-            switch (mode)
+            if (!node.CommunicationChannelIsValid())
             {
-            case SEND:
-                RegisterForSend(nodeSocket);
-                break;
-            case RECEIVE:
-                RegisterForReceive(nodeSocket);
-                break;
-            case BUSY:
-                break;
+                busySockets_.erase(nodeSocket);
+                poller_.SetInterest(nodeSocket, false, false);
+                return;
             }
-        }
+            const CommsMode mode = node.SelectCommunicationMode();
+            if (mode == BUSY)
+                busySockets_.insert(nodeSocket);
+            else
+                busySockets_.erase(nodeSocket);
+            poller_.SetInterest(nodeSocket, mode == SEND, mode == RECEIVE);
+        });
+        socketsToRefresh_.clear();
     }
-    int CheckSocketCanBeSelected()
+    int WaitForReadySockets()
     {
-        return select(have_fds ? hSocketMax + 1 : 0,
-            &fdsetRecv, &fdsetSend, &fdsetError, &timeout);
+        return poller_.PollSockets(pollingTimeoutInMilliseconds);
     }
     void ProcessSocketErrorCode(int socketErrorCode)
     {
         if (socketErrorCode == SOCKET_ERROR)
         {
-            if (have_fds)
-            {
-                int nErr = WSAGetLastError();
-                LogPrintf("socket select error %s\n", NetworkErrorString(nErr));
-                for (unsigned int i = 0; i <= hSocketMax; i++)
-                    FD_SET(i, &fdsetRecv);
-            }
-            FD_ZERO(&fdsetSend);
-            FD_ZERO(&fdsetError);
-            MilliSleep(timeout.tv_usec / 1000);
+            poller_.HandlePollingFailure(pollingTimeoutInMilliseconds);
         }
     }
     void AcceptNewConnections(CCriticalSection& nodesLock, std::vector<CNode*>& nodes)
     {
         for(const ListenSocket& hListenSocket: listeningSockets_)
         {
-            if (hListenSocket.socket != INVALID_SOCKET && FD_ISSET(hListenSocket.socket, &fdsetRecv))
+            if (hListenSocket.socket != INVALID_SOCKET && poller_.IsReadyForReceive(hListenSocket.socket))
             {
                 struct sockaddr_storage sockaddr;
                 socklen_t len = sizeof(sockaddr);
@@ -751,7 +865,7 @@ public:
                     int nErr = WSAGetLastError();
                     if (nErr != WSAEWOULDBLOCK)
                         LogPrintf("socket error accept failed: %s\n", NetworkErrorString(nErr));
-                } else if (!IsSelectableSocket(hSocket)) {
+                } else if (!poller_.CanPollSocket(hSocket)) {
                     LogPrintf("connection from %s dropped: non-selectable socket\n", addr);
                     CloseSocket(hSocket);
                 } else if (nInbound >= nMaxConnections - MAX_OUTBOUND_CONNECTIONS) {
@@ -768,68 +882,77 @@ public:
         }
     }
 
-    bool SocketReceiveDataFromPeer(CNode* pnode, boost::condition_variable& messageHandlerCondition)
-    {
-        if (!pnode->CommunicationChannelIsValid())
-            return false;
-        SOCKET nodeSocket = NodeManager::Instance().getSocketByNodeId(pnode->GetId());
-        if (IsRegisteredForReceive(nodeSocket) || IsRegisteredForErrors(nodeSocket))
-            return pnode->TryReceiveData(messageHandlerCondition);
-        return true;
-    }
-    bool SocketSendDataToPeer(CNode* pnode)
+    /** Receives from and sends to the peers whose sockets were reported ready, and only those */
+    void ServiceReadySockets(boost::condition_variable& messageHandlerCondition)
     {
-        if (!pnode->CommunicationChannelIsValid())
-            return false;
-        SOCKET nodeSocket = NodeManager::Instance().getSocketByNodeId(pnode->GetId());
-        if (IsRegisteredForSend(nodeSocket))
-            return pnode->TrySendData();
-
-        return true;
+        std::vector<std::pair<SOCKET,NodeRef>> readyNodes = nodeManager_.referencesToNodesWithSockets(poller_.ReadySockets());
+        for(const std::pair<SOCKET,NodeRef>& socketAndNode: readyNodes)
+        {
+            boost::this_thread::interruption_point();
+            const SOCKET nodeSocket = socketAndNode.first;
+            CNode* pnode = socketAndNode.second.get();
+            socketsToRefresh_.insert(nodeSocket);
+            if (!pnode->CommunicationChannelIsValid())
+                continue;
+            if (poller_.IsReadyForReceive(nodeSocket) || poller_.IsReadyForErrors(nodeSocket))
+                pnode->TryReceiveData(messageHandlerCondition);
+            if (pnode->CommunicationChannelIsValid() && poller_.IsReadyForSend(nodeSocket))
+                pnode->TrySendData();
+        }
     }
 };
 
 void ThreadSocketHandler()
 {
     unsigned int nPrevNodeCount = 0;
+    int64_t nLastHousekeeping = 0;
+    SocketsProcessor socketsProcessor(*socketPoller, NodeManager::Instance());
     while (true) {
-        //
-        // Disconnect nodes
-        //
-        NodeManager::Instance().disconnectUnusedNodes();
-        NodeManager::Instance().deleteDisconnectedNodes();
-        size_t vNodesSize = GetPeerCount();
-        if(vNodesSize != nPrevNodeCount) {
-            nPrevNodeCount = vNodesSize;
-            uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
+        // Work that involves every peer is done at the polling frequency rather than
+        // on every wake-up, so that a busy round only costs as much as the ready sockets
+        const int64_t nNow = GetTimeMillis();
+        const bool doHousekeeping = nNow - nLastHousekeeping >= SocketsProcessor::PollingTimeout();
+        if (doHousekeeping)
+        {
+            nLastHousekeeping = nNow;
+            //
+            // Disconnect nodes
+            //
+            NodeManager::Instance().disconnectUnusedNodes();
+            NodeManager::Instance().deleteDisconnectedNodes();
+            size_t vNodesSize = GetPeerCount();
+            if(vNodesSize != nPrevNodeCount) {
+                nPrevNodeCount = vNodesSize;
+                uiInterface.NotifyNumConnectionsChanged(nPrevNodeCount);
+            }
         }
 
-        SocketsProcessor socketsProcessor(NodeManager::Instance().listeningSockets());
-        socketsProcessor.ProcessListeningSockets();
-        socketsProcessor.AssignNodesToSendOrReceiveTasks(cs_vNodes,vNodes);
+        socketsProcessor.ApplyRegistrationChanges();
+        socketsProcessor.RefreshSocketInterest();
 
-        int nSelect = socketsProcessor.CheckSocketCanBeSelected();
+        int nSelect = socketsProcessor.WaitForReadySockets();
         boost::this_thread::interruption_point();
         socketsProcessor.ProcessSocketErrorCode(nSelect);
         socketsProcessor.AcceptNewConnections(cs_vNodes,vNodes);
 
         //
-        // Service each socket
+        // Service each ready socket
         //
-        ThreadSafeNodesCopy safeNodesCopy(cs_vNodes,vNodes);
-        for(const NodeRef& pnode: safeNodesCopy.Nodes())
-        {
-            boost::this_thread::interruption_point();
-
-            if(!socketsProcessor.SocketReceiveDataFromPeer(pnode.get(),messageHandlerCondition) || !socketsProcessor.SocketSendDataToPeer(pnode.get()))
-                continue;
+        socketsProcessor.ServiceReadySockets(messageHandlerCondition);
 
-            //
-            // Inactivity checking
-            //
-            pnode->CheckForInnactivity();
+        //
+        // Inactivity checking
+        //
+        if (doHousekeeping)
+        {
+            ThreadSafeNodesCopy safeNodesCopy(cs_vNodes,vNodes);
+            for(const NodeRef& pnode: safeNodesCopy.Nodes())
+            {
+                if (pnode->CommunicationChannelIsValid())
+                    pnode->CheckForInnactivity();
+            }
+            safeNodesCopy.ClearCopy();
         }
-        safeNodesCopy.ClearCopy();
     }
 }
 
@@ -838,6 +961,51 @@ struct MessageHandlerDependencies
     const Settings& settings_;
     CCriticalSection& mainCriticalSection_;
 };
+
+/** Messages a peer may have handled in one turn before the other ready peers get to go */
+static const unsigned MAX_MESSAGES_PER_PEER_TURN = 8;
+
+static unsigned GetNumberOfMessageHandlerThreads(const Settings& settings)
+{
+    const int64_t requestedThreads = settings.GetArg("-msghandlerthreads", DEFAULT_MESSAGE_HANDLER_THREADS);
+    return static_cast<unsigned>(std::max<int64_t>(1, std::min<int64_t>(requestedThreads, MAX_MESSAGE_HANDLER_THREADS)));
+}
+
+// Returns true if the peer has more work pending
+static bool ProcessPeerMessagesForOneTurn(CNode& node, bool trickle, CCriticalSection& sharedMessageStateLock)
+{
+    if (node.IsFlaggedForDisconnection())
+        return false;
+
+    // Receive messages
+    bool fSleep = true;
+    for (unsigned messagesProcessed = 0; messagesProcessed < MAX_MESSAGES_PER_PEER_TURN; ++messagesProcessed)
+    {
+        fSleep = true;
+        node.ProcessReceiveMessages(fSleep, sharedMessageStateLock);
+        boost::this_thread::interruption_point();
+        if (fSleep || node.IsFlaggedForDisconnection())
+            break;
+    }
+
+    // Handle potential ping messages first.
+    if (node.CanSendMessagesToPeer())
+    {
+        node.MaybeSendPing();
+    }
+    boost::this_thread::interruption_point();
+
+    // Send messages; the shared lock has to be taken before the node's send lock
+    if (node.CanSendMessagesToPeer())
+    {
+        LOCK(sharedMessageStateLock);
+        node.ProcessSendMessages(trickle);
+    }
+    boost::this_thread::interruption_point();
+
+    return !fSleep && !node.IsFlaggedForDisconnection();
+}
+
 void ThreadMessageHandler(MessageHandlerDependencies& dependencies)
 {
     boost::mutex condition_mutex;
@@ -847,60 +1015,50 @@ void ThreadMessageHandler(MessageHandlerDependencies& dependencies)
        we did a broadcast.  */
     int64_t nLastRebroadcast = 0;
 
+    /* Serializes the handling of everything that is not safe to process for
+       several peers at once (see MessagesCanBeProcessedConcurrently) */
+    CCriticalSection sharedMessageStateLock;
+    PeerMessageScheduler scheduler(GetNumberOfMessageHandlerThreads(dependencies.settings_));
+    LogPrintf("Processing peer messages on %u threads\n", scheduler.NumberOfThreads());
+
     SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
     while (true) {
         ThreadSafeNodesCopy safeNodesCopy(cs_vNodes,vNodes);
         const std::vector<NodeRef>& vNodesCopy = safeNodesCopy.Nodes();
 
-        bool rebroadcast = (!IsInitialBlockDownload(dependencies.mainCriticalSection_,dependencies.settings_) && (GetTime() > nLastRebroadcast + 24 * 60 * 60));
+        if (!IsInitialBlockDownload(dependencies.mainCriticalSection_,dependencies.settings_) && (GetTime() > nLastRebroadcast + 24 * 60 * 60))
+        {
+            for (const NodeRef& nodeRef : vNodesCopy)
+            {
+                nodeRef->AdvertizeLocalAddress(nLastRebroadcast);
+                boost::this_thread::interruption_point();
+            }
+            nLastRebroadcast = GetTime();
+        }
 
-        // Poll the connected nodes for messages
+        // Hand every idle peer to the scheduler; peers whose previous turn is still
+        // queued or running keep their place and are not scheduled twice
         CNode* pnodeTrickle = vNodesCopy.empty()? nullptr: vNodesCopy[GetRand(vNodesCopy.size())].get();
-        bool fSleep = true;
-
         for(const NodeRef& pnode: vNodesCopy)
         {
-            if (pnode->IsFlaggedForDisconnection())
+            if (pnode->IsFlaggedForDisconnection() || scheduler.PeerIsScheduled(pnode->GetId()))
                 continue;
 
-            // Receive messages
-            pnode->ProcessReceiveMessages(fSleep);
-            boost::this_thread::interruption_point();
-
-            // Handle potential ping messages first.
-            if (pnode->CanSendMessagesToPeer())
-            {
-                pnode->MaybeSendPing();
-            }
-            boost::this_thread::interruption_point();
-
-            // Rebroadcasting is done for all nodes after the ping
-            // of the first; this is to mimic previous behaviour.
-            if (rebroadcast)
-            {
-                for (const NodeRef& nodeRef : vNodesCopy)
+            std::shared_ptr<CNode> node(pnode->AddRef(), NodeRefDeleter());
+            bool trickle = pnode.get() == pnodeTrickle;
+            scheduler.SchedulePeer(
+                node->GetId(),
+                [node, trickle, &sharedMessageStateLock]() mutable
                 {
-                    NodeRef nodeToAdvertiseAddressTo = NodeReferenceFactory::makeUniqueNodeReference(nodeRef.get());
-                    nodeToAdvertiseAddressTo->AdvertizeLocalAddress(nLastRebroadcast);
-                    boost::this_thread::interruption_point();
-                }
-
-                nLastRebroadcast = GetTime();
-                rebroadcast = false;
-            }
-
-            // Send messages
-            if (pnode->CanSendMessagesToPeer())
-            {
-                pnode->ProcessSendMessages(pnode.get() == pnodeTrickle);
-            }
-            boost::this_thread::interruption_point();
+                    const bool morePending = ProcessPeerMessagesForOneTurn(*node, trickle, sharedMessageStateLock);
+                    trickle = false;
+                    return morePending;
+                });
         }
 
         safeNodesCopy.ClearCopy();
 
-        if (fSleep)
-            messageHandlerCondition.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(100));
+        messageHandlerCondition.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(100));
     }
 }
 
@@ -1721,11 +1879,22 @@ void SetNetworkingParameters()
     EnableAlertsAccordingToSettings(settings);
     if (settings.GetBoolArg("-peerbloomfilters", DEFAULT_PEERBLOOMFILTERS))
         EnableBloomFilters();
+    if (settings.GetBoolArg("-compactblocks", DEFAULT_COMPACT_BLOCKS))
+        EnableCompactBlocks();
+    if (Params().HeadersFirstSyncingActive())
+        EnableHeadersFirstSync();
+    if (settings.ParameterIsSet("-maxuploadtarget"))
+        NetworkUsageStats::SetMaxOutboundTarget(settings.GetArg("-maxuploadtarget", DEFAULT_MAX_UPLOAD_TARGET) * 1024 * 1024);
+
+    socketPoller = CreateSocketPoller(settings.GetArg("-socketevents", DEFAULT_SOCKET_EVENTS_MODE));
+    LogPrintf("Using %s for socket event notification\n", socketPoller->BackendName());
 
     const int reservedFileDescriptors = MIN_CORE_FILEDESCRIPTORS;
     int nBind = std::max((int)settings.ParameterIsSet("-bind") + (int)settings.ParameterIsSet("-whitebind"), 1);
     nMaxConnections = settings.GetArg("-maxconnections", 125);
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - reservedFileDescriptors)), 0);
+    if (!socketPoller->CanPollSocket(FD_SETSIZE))
+        nMaxConnections = std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - reservedFileDescriptors));
+    nMaxConnections = std::max(nMaxConnections, 0);
 }
 
 bool InitializeP2PNetwork(UIMessenger& uiMessenger)
@@ -40,7 +40,8 @@ inventoryTypeByName = {
     {"mn budget finalized vote",MSG_BUDGET_FINALIZED_VOTE},
     {"mn quorum",MSG_MASTERNODE_QUORUM},
     {"mn announce",MSG_MASTERNODE_ANNOUNCE},
-    {"mn ping",MSG_MASTERNODE_PING}};
+    {"mn ping",MSG_MASTERNODE_PING},
+    {"compact block",MSG_CMPCT_BLOCK}};
 static const std::map<int,std::string> inventoryNameByType = ReverseMap(inventoryTypeByName);
 
 static const int maxInventoryId = (int)inventoryTypeByName.size();
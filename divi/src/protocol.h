@@ -77,6 +77,14 @@ enum {
 
 	 NODE_BLOOM_WITHOUT_MN = (1 << 4),
 
+    // NODE_COMPACT_BLOCKS means the node can serve blocks as short transaction ids
+    // (cmpctblock) and fill in the transactions a peer is missing (getblocktxn/blocktxn).
+    NODE_COMPACT_BLOCKS = (1 << 5),
+
+    // NODE_HEADERS_FIRST means the node answers getheaders with headers, so that block
+    // headers can be synced ahead of the blocks and the blocks fetched from several peers.
+    NODE_HEADERS_FIRST = (1 << 6),
+
     // Bits 24-31 are reserved for temporary experiments. Just pick a bit that
     // isn't getting used, or one not being used much, and notify the
     // bitcoin-development mailing list. Remember that service bits are just
@@ -141,7 +149,9 @@ enum InventoryType {
     MSG_BUDGET_FINALIZED_VOTE,
     MSG_MASTERNODE_QUORUM,
     MSG_MASTERNODE_ANNOUNCE,
-    MSG_MASTERNODE_PING
+    MSG_MASTERNODE_PING,
+    // Only requested in a getdata from peers that signalled sendcmpct; answered with a cmpctblock.
+    MSG_CMPCT_BLOCK
 };
 class CInv
 {
@@ -20,6 +20,12 @@
 
 #include <JsonTxHelpers.h>
 #include <JsonBlockHelpers.h>
+#include <JsonStreamWriter.h>
+#include <ChainStateSnapshot.h>
+#include <coins.h>
+#include <init.h>
+#include <txmempool.h>
+#include <Logging.h>
 
 #include <boost/algorithm/string.hpp>
 
@@ -30,6 +36,10 @@ using namespace json_spirit;
 
 extern CCriticalSection cs_main;
 
+static const size_t MAX_REST_HEADERS_RESULTS = 2000;
+static const size_t MAX_REST_BLOCKS_RESULTS = 500;
+static const size_t MAX_GETUTXOS_OUTPOINTS = 500;
+
 enum RetFormat {
     RF_UNDEF,
     RF_BINARY,
@@ -103,6 +113,7 @@ static bool rest_block(AcceptedConnection* conn,
     string& strReq,
     map<string, string>& mapHeaders,
     bool fRun,
+    bool fChunked,
     bool showTxDetails)
 {
     std::vector<std::string> params;
@@ -113,7 +124,6 @@ static bool rest_block(AcceptedConnection* conn,
     if (!ParseHashStr(hashStr, hash))
         throw RESTERR(HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
@@ -125,32 +135,54 @@ static bool rest_block(AcceptedConnection* conn,
             throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
 
         pblockindex = mit->second;
+    }
+    const std::shared_ptr<const ChainStateSnapshot> chainSnapshot = ChainStateSnapshot::Current();
+
+    if (rf == RF_JSON && !GetRenderedResponseCache().IsEnabled()) {
+        CBlock block;
         if (!ReadBlockFromDisk(block, pblockindex))
             throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
+
+        HTTPStreamedReply reply(conn->stream(), HTTP_OK, fRun, fChunked);
+        JsonStreamWriter writer(reply.Body());
+        blockToJSON(writer, *chainSnapshot, block, pblockindex, showTxDetails);
+        reply.Body() << "\n";
+        return reply.Finish();
+    }
+
+    RenderedResponseCache::Format format = RenderedResponseCache::BLOCK_BINARY;
+    switch (rf) {
+    case RF_BINARY:
+        break;
+    case RF_HEX:
+        format = RenderedResponseCache::BLOCK_HEX;
+        break;
+    case RF_JSON:
+        format = showTxDetails? RenderedResponseCache::BLOCK_JSON_TX_DETAILS: RenderedResponseCache::BLOCK_JSON;
+        break;
+    default:
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
+    const std::shared_ptr<const std::string> rendered = RenderBlockResponse(*chainSnapshot, pblockindex, format);
+    if (!rendered)
+        throw RESTERR(HTTP_NOT_FOUND, hashStr + " not found");
 
     switch (rf) {
     case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
-        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, binaryBlock.size(), "application/octet-stream") << binaryBlock << std::flush;
+        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, rendered->size(), "application/octet-stream") << *rendered << std::flush;
         return true;
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
-        conn->stream() << HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain") << std::flush;
+        conn->stream() << HTTPReply(HTTP_OK, *rendered + "\n", fRun, false, "text/plain") << std::flush;
         return true;
     }
 
     case RF_JSON: {
-        const ChainstateManager::Reference chainstate;
-        Object objBlock = blockToJSON(chainstate->ActiveChain(),block, pblockindex, showTxDetails);
-        string strJSON = write_string(Value(objBlock), false) + "\n";
-        conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
-        return true;
+        HTTPStreamedReply reply(conn->stream(), HTTP_OK, fRun, fChunked);
+        reply.Body() << *rendered << "\n";
+        return reply.Finish();
     }
 
     default: {
@@ -165,23 +197,26 @@ static bool rest_block(AcceptedConnection* conn,
 static bool rest_block_extended(AcceptedConnection* conn,
     string& strReq,
     map<string, string>& mapHeaders,
-    bool fRun)
+    bool fRun,
+    bool fChunked)
 {
-    return rest_block(conn, strReq, mapHeaders, fRun, true);
+    return rest_block(conn, strReq, mapHeaders, fRun, fChunked, true);
 }
 
 static bool rest_block_notxdetails(AcceptedConnection* conn,
     string& strReq,
     map<string, string>& mapHeaders,
-    bool fRun)
+    bool fRun,
+    bool fChunked)
 {
-    return rest_block(conn, strReq, mapHeaders, fRun, false);
+    return rest_block(conn, strReq, mapHeaders, fRun, fChunked, false);
 }
 
 static bool rest_tx(AcceptedConnection* conn,
     std::string& strReq,
     std::map<std::string, std::string>& mapHeaders,
-    bool fRun)
+    bool fRun,
+    bool fChunked)
 {
     std::vector<std::string> params;
     enum RetFormat rf = ParseDataFormat(params, strReq);
@@ -215,11 +250,352 @@ static bool rest_tx(AcceptedConnection* conn,
     case RF_JSON: {
         Object objTx;
         TxToJSON(tx, hashBlock, objTx);
-        string strJSON = write_string(Value(objTx), false) + "\n";
-        conn->stream() << HTTPReply(HTTP_OK, strJSON, fRun) << std::flush;
+        HTTPStreamedReply reply(conn->stream(), HTTP_OK, fRun, fChunked);
+        JsonStreamWriter writer(reply.Body());
+        writer.Write(objTx);
+        reply.Body() << "\n";
+        return reply.Finish();
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool ParseCount(const string& strCount, size_t maxCount, size_t& count)
+{
+    int64_t parsed = 0;
+    if (!ParseInt64(strCount, &parsed) || parsed < 1 || static_cast<uint64_t>(parsed) > maxCount)
+        return false;
+
+    count = static_cast<size_t>(parsed);
+    return true;
+}
+
+static bool rest_headers(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& mapHeaders,
+    bool fRun,
+    bool fChunked)
+{
+    std::vector<std::string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+
+    std::vector<std::string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    if (path.size() != 2)
+        throw RESTERR(HTTP_BAD_REQUEST, "No header count specified. Use /rest/headers/<count>/<hash>.<ext>.");
+
+    size_t count = 0;
+    if (!ParseCount(path[0], MAX_REST_HEADERS_RESULTS, count))
+        throw RESTERR(HTTP_BAD_REQUEST, strprintf("Header count out of range: %s (1 to %u)", path[0], MAX_REST_HEADERS_RESULTS));
+
+    const string& hashStr = path[1];
+    uint256 hash;
+    if (!ParseHashStr(hashStr, hash))
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
+
+    const CBlockIndex* pindex = NULL;
+    {
+        LOCK(cs_main);
+        const ChainstateManager::Reference chainstate;
+        const auto& blockMap = chainstate->GetBlockMap();
+        const auto mit = blockMap.find(hash);
+        if (mit != blockMap.end())
+            pindex = mit->second;
+    }
+
+    // Headers come from the block index, so none of them has to be read from disk
+    const std::shared_ptr<const ChainStateSnapshot> chainSnapshot = ChainStateSnapshot::Current();
+    std::vector<const CBlockIndex*> headers;
+    headers.reserve(count);
+    for (; pindex && chainSnapshot->Contains(pindex) && headers.size() < count; pindex = (*chainSnapshot)[pindex->nHeight + 1])
+        headers.push_back(pindex);
+
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    for (const CBlockIndex* header: headers)
+        ssHeader << header->GetBlockHeader();
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryHeaders = ssHeader.str();
+        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, binaryHeaders.size(), "application/octet-stream") << binaryHeaders << std::flush;
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
+        conn->stream() << HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain") << std::flush;
+        return true;
+    }
+
+    case RF_JSON: {
+        HTTPStreamedReply reply(conn->stream(), HTTP_OK, fRun, fChunked);
+        JsonStreamWriter writer(reply.Body());
+        writer.BeginArray();
+        for (const CBlockIndex* header: headers) {
+            Object objHeader = blockHeaderToJSON(CBlock(header->GetBlockHeader()), header);
+            objHeader.insert(objHeader.begin(), Pair("height", header->nHeight));
+            objHeader.insert(objHeader.begin(), Pair("hash", header->GetBlockHash().GetHex()));
+            writer.Write(objHeader);
+        }
+        writer.EndArray();
+        reply.Body() << "\n";
+        return reply.Finish();
+    }
+
+    default: {
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_blocks(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& mapHeaders,
+    bool fRun,
+    bool fChunked)
+{
+    std::vector<std::string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+
+    std::vector<std::string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+    if (path.size() != 2)
+        throw RESTERR(HTTP_BAD_REQUEST, "No block range specified. Use /rest/blocks/<height>/<count>.<ext>.");
+
+    int32_t startHeight = 0;
+    if (!ParseInt32(path[0], &startHeight) || startHeight < 0)
+        throw RESTERR(HTTP_BAD_REQUEST, "Invalid height: " + path[0]);
+    size_t count = 0;
+    if (!ParseCount(path[1], MAX_REST_BLOCKS_RESULTS, count))
+        throw RESTERR(HTTP_BAD_REQUEST, strprintf("Block count out of range: %s (1 to %u)", path[1], MAX_REST_BLOCKS_RESULTS));
+
+    RenderedResponseCache::Format format = RenderedResponseCache::BLOCK_BINARY;
+    const char* contentType = "application/octet-stream";
+    switch (rf) {
+    case RF_BINARY:
+        break;
+    case RF_HEX:
+        format = RenderedResponseCache::BLOCK_HEX;
+        contentType = "text/plain";
+        break;
+    case RF_JSON:
+        format = RenderedResponseCache::BLOCK_JSON;
+        contentType = "application/json";
+        break;
+    default:
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+
+    // All blocks of the range are taken from one snapshot, so a reorg while streaming cannot mix chains
+    const std::shared_ptr<const ChainStateSnapshot> chainSnapshot = ChainStateSnapshot::Current();
+    if (startHeight > chainSnapshot->Height())
+        throw RESTERR(HTTP_NOT_FOUND, strprintf("Block height out of range: %d", startHeight));
+
+    const CBlockIndex* pindex = (*chainSnapshot)[startHeight];
+    std::shared_ptr<const std::string> rendered = RenderBlockResponse(*chainSnapshot, pindex, format);
+    if (!rendered)
+        throw RESTERR(HTTP_NOT_FOUND, pindex->GetBlockHash().GetHex() + " not found");
+
+    // Blocks go out one at a time as they are rendered (or found in the response cache),
+    // so that a range never has to be held in memory as a whole
+    HTTPStreamedReply reply(conn->stream(), HTTP_OK, fRun, fChunked, contentType);
+    if (rf == RF_JSON)
+        reply.Body() << "[";
+    for (size_t blockNumber = 0;;) {
+        if (rf == RF_JSON && blockNumber > 0)
+            reply.Body() << ",";
+        reply.Body() << *rendered;
+        if (rf == RF_HEX)
+            reply.Body() << "\n";
+
+        pindex = (*chainSnapshot)[pindex->nHeight + 1];
+        if (++blockNumber == count || !pindex)
+            break;
+        rendered = RenderBlockResponse(*chainSnapshot, pindex, format);
+        if (!rendered) {
+            // The reply has started, so dropping the connection is the only way left to report the error
+            LogPrintf("%s: block %s not found\n", __func__, pindex->GetBlockHash());
+            return false;
+        }
+    }
+    if (rf == RF_JSON)
+        reply.Body() << "]\n";
+    return reply.Finish();
+}
+
+namespace
+{
+struct CCoin {
+    uint32_t nTxVer; // Don't call this nVersion, that name has a special meaning inside IMPLEMENT_SERIALIZE
+    uint32_t nHeight;
+    CTxOut out;
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion)
+    {
+        READWRITE(nTxVer);
+        READWRITE(nHeight);
+        READWRITE(out);
+    }
+};
+} // anonymous namespace
+
+static bool ParseOutPoint(const string& strOutPoint, COutPoint& outPoint)
+{
+    const size_t separator = strOutPoint.find('-');
+    if (separator == string::npos)
+        return false;
+
+    uint256 txid;
+    int32_t n = 0;
+    if (!ParseHashStr(strOutPoint.substr(0, separator), txid) || !ParseInt32(strOutPoint.substr(separator + 1), &n) || n < 0)
+        return false;
+
+    outPoint = COutPoint(txid, static_cast<uint32_t>(n));
+    return true;
+}
+
+static bool rest_getutxos(AcceptedConnection* conn,
+    string& strReq,
+    map<string, string>& mapHeaders,
+    bool fRun,
+    bool fChunked)
+{
+    std::vector<std::string> params;
+    enum RetFormat rf = ParseDataFormat(params, strReq);
+
+    std::vector<std::string> uriParts;
+    boost::split(uriParts, params[0], boost::is_any_of("/"));
+    bool fCheckMemPool = false;
+    size_t firstOutPoint = 0;
+    if (!uriParts.empty() && uriParts[0] == "checkmempool") {
+        fCheckMemPool = true;
+        firstOutPoint = 1;
+    }
+
+    std::vector<COutPoint> outPoints;
+    for (size_t part = firstOutPoint; part < uriParts.size(); ++part) {
+        COutPoint outPoint;
+        if (!ParseOutPoint(uriParts[part], outPoint))
+            throw RESTERR(HTTP_BAD_REQUEST, "Parse error: " + uriParts[part]);
+        outPoints.push_back(outPoint);
+    }
+    if (outPoints.empty())
+        throw RESTERR(HTTP_BAD_REQUEST, "Error: empty request");
+    if (outPoints.size() > MAX_GETUTXOS_OUTPOINTS)
+        throw RESTERR(HTTP_BAD_REQUEST, strprintf("Error: max outpoints exceeded (max: %u, tried: %u)", MAX_GETUTXOS_OUTPOINTS, outPoints.size()));
+
+    switch (rf) {
+    case RF_BINARY:
+    case RF_HEX:
+    case RF_JSON:
+        break;
+    default:
+        throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+
+    std::vector<unsigned char> bitmap((outPoints.size() + 7) / 8, 0);
+    std::vector<bool> hits;
+    std::vector<CCoin> outs;
+    int chainHeight = -1;
+    uint256 chainTipHash;
+    {
+        LOCK(cs_main);
+        const ChainstateManager::Reference chainstate;
+        const CCoinsViewCache& coinsTip = chainstate->CoinsTip();
+        const auto& blockMap = chainstate->GetBlockMap();
+        const auto mit = blockMap.find(coinsTip.GetBestBlock());
+        if (mit != blockMap.end()) {
+            chainHeight = mit->second->nHeight;
+            chainTipHash = mit->second->GetBlockHash();
+        }
+
+        // Outpoints of the same transaction share one coins lookup
+        std::map<uint256, CCoins> coinsByTxid;
+        for (size_t index = 0; index < outPoints.size(); ++index) {
+            const COutPoint& outPoint = outPoints[index];
+            auto it = coinsByTxid.find(outPoint.hash);
+            if (it == coinsByTxid.end()) {
+                CCoins coins;
+                const bool found = fCheckMemPool
+                    ? CCoinsViewMemPool(&coinsTip, GetTransactionMemoryPool()).GetCoinsAndPruneSpent(outPoint.hash, coins)
+                    : coinsTip.GetCoins(outPoint.hash, coins);
+                if (!found)
+                    coins = CCoins();
+                it = coinsByTxid.insert(std::make_pair(outPoint.hash, coins)).first;
+            }
+
+            const CCoins& coins = it->second;
+            const bool hit = outPoint.n < coins.vout.size() && !coins.vout[outPoint.n].IsNull();
+            hits.push_back(hit);
+            if (hit) {
+                bitmap[index / 8] |= (1 << (index % 8));
+                CCoin coin;
+                coin.nTxVer = coins.nVersion;
+                coin.nHeight = coins.nHeight;
+                coin.out = coins.vout[outPoint.n];
+                outs.push_back(coin);
+            }
+        }
+    }
+
+    switch (rf) {
+    case RF_BINARY: {
+        CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
+        ssGetUTXOResponse << chainHeight << chainTipHash << bitmap << outs;
+        string binaryUTXOs = ssGetUTXOResponse.str();
+        conn->stream() << HTTPReplyHeader(HTTP_OK, fRun, binaryUTXOs.size(), "application/octet-stream") << binaryUTXOs << std::flush;
+        return true;
+    }
+
+    case RF_HEX: {
+        CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
+        ssGetUTXOResponse << chainHeight << chainTipHash << bitmap << outs;
+        string strHex = HexStr(ssGetUTXOResponse.begin(), ssGetUTXOResponse.end()) + "\n";
+        conn->stream() << HTTPReply(HTTP_OK, strHex, fRun, false, "text/plain") << std::flush;
         return true;
     }
 
+    case RF_JSON: {
+        string bitmapString;
+        for (bool hit: hits)
+            bitmapString += hit ? "1" : "0";
+
+        HTTPStreamedReply reply(conn->stream(), HTTP_OK, fRun, fChunked);
+        JsonStreamWriter writer(reply.Body());
+        writer.BeginObject();
+        writer.WriteField("chainHeight", chainHeight);
+        writer.WriteField("chaintipHash", chainTipHash.GetHex());
+        writer.WriteField("bitmap", bitmapString);
+        writer.Key("utxos");
+        writer.BeginArray();
+        for (const CCoin& coin: outs) {
+            Object utxo;
+            utxo.push_back(Pair("txvers", static_cast<int64_t>(coin.nTxVer)));
+            utxo.push_back(Pair("height", static_cast<int64_t>(coin.nHeight)));
+            utxo.push_back(Pair("value", ValueFromAmount(coin.out.nValue)));
+            Object scriptPubKey;
+            ScriptPubKeyToJSON(coin.out.scriptPubKey, scriptPubKey, true);
+            utxo.push_back(Pair("scriptPubKey", scriptPubKey));
+            writer.Write(utxo);
+        }
+        writer.EndArray();
+        writer.EndObject();
+        reply.Body() << "\n";
+        return reply.Finish();
+    }
+
     default: {
         throw RESTERR(HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
     }
@@ -234,9 +610,13 @@ static const struct {
     bool (*handler)(AcceptedConnection* conn,
         string& strURI,
         map<string, string>& mapHeaders,
-        bool fRun);
+        bool fRun,
+        bool fChunked);
 } uri_prefixes[] = {
     {"/rest/tx/", rest_tx},
+    {"/rest/headers/", rest_headers},
+    {"/rest/blocks/", rest_blocks},
+    {"/rest/getutxos/", rest_getutxos},
     {"/rest/block/notxdetails/", rest_block_notxdetails},
     {"/rest/block/", rest_block_extended},
 };
@@ -246,7 +626,8 @@ bool HTTPReq_REST(
     AcceptedConnection* conn,
     std::string& strURI,
     std::map<std::string, std::string>& mapHeaders,
-    bool fRun)
+    bool fRun,
+    bool fChunked)
 {
     try {
         std::string statusmessage;
@@ -257,7 +638,7 @@ bool HTTPReq_REST(
             unsigned int plen = strlen(uri_prefixes[i].prefix);
             if (strURI.substr(0, plen) == uri_prefixes[i].prefix) {
                 string strReq = strURI.substr(plen);
-                return uri_prefixes[i].handler(conn, strReq, mapHeaders, fRun);
+                return uri_prefixes[i].handler(conn, strReq, mapHeaders, fRun, fChunked);
             }
         }
     } catch (RestErr& re) {
@@ -8,5 +8,6 @@ bool HTTPReq_REST(
     AcceptedConnection* conn,
     std::string& strURI,
     std::map<std::string, std::string>& mapHeaders,
-    bool fRun);
+    bool fRun,
+    bool fChunked);
 #endif// REST_H
\ No newline at end of file
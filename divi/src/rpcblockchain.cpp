@@ -27,6 +27,10 @@
 #include <spork.h>
 #include <I_ChainExtensionService.h>
 #include <ChainSyncHelpers.h>
+#include <ChainStateSnapshot.h>
+#include <JsonStreamWriter.h>
+#include <RenderedResponseCache.h>
+#include <AsyncIndexBuilder.h>
 
 using namespace json_spirit;
 using namespace std;
@@ -42,8 +46,7 @@ Value getblockcount(const Array& params, bool fHelp, CWallet* pwallet)
             "\nExamples:\n" +
             HelpExampleCli("getblockcount", "") + HelpExampleRpc("getblockcount", ""));
 
-    const ChainstateManager::Reference chainstate;
-    return chainstate->ActiveChain().Height();
+    return ChainStateSnapshot::Current()->Height();
 }
 
 Value getbestblockhash(const Array& params, bool fHelp, CWallet* pwallet)
@@ -57,8 +60,7 @@ Value getbestblockhash(const Array& params, bool fHelp, CWallet* pwallet)
             "\nExamples\n" +
             HelpExampleCli("getbestblockhash", "") + HelpExampleRpc("getbestblockhash", ""));
 
-    const ChainstateManager::Reference chainstate;
-    return chainstate->ActiveChain().Tip()->GetBlockHash().GetHex();
+    return ChainStateSnapshot::Current()->Tip()->GetBlockHash().GetHex();
 }
 
 Value getdifficulty(const Array& params, bool fHelp, CWallet* pwallet)
@@ -72,12 +74,27 @@ Value getdifficulty(const Array& params, bool fHelp, CWallet* pwallet)
             "\nExamples:\n" +
             HelpExampleCli("getdifficulty", "") + HelpExampleRpc("getdifficulty", ""));
 
-    const ChainstateManager::Reference chainstate;
-    return GetDifficulty(chainstate->ActiveChain());
+    return GetDifficulty(*ChainStateSnapshot::Current());
 }
 
 
-Value getrawmempool(const Array& params, bool fHelp, CWallet* pwallet)
+namespace
+{
+/** What getrawmempool reports for one entry, copied out so the reply is written without mempool.cs */
+struct MempoolEntrySummary
+{
+    uint256 hash;
+    unsigned int size;
+    CAmount fee;
+    int64_t time;
+    unsigned int height;
+    double startingPriority;
+    double currentPriority;
+    set<string> depends;
+};
+} // anonymous namespace
+
+JsonProducer streamgetrawmempool(const Array& params, bool fHelp, CWallet* pwallet)
 {
     if (fHelp || params.size() > 1)
         throw runtime_error(
@@ -114,42 +131,63 @@ Value getrawmempool(const Array& params, bool fHelp, CWallet* pwallet)
     CTxMemPool& mempool = GetTransactionMemoryPool();
     if (fVerbose) {
         const ChainstateManager::Reference chainstate;
-        LOCK(mempool.cs);
-        Object o;
-        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx) {
-            const uint256& hash = entry.first;
-            const CTxMemPoolEntry& e = entry.second;
-            Object info;
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.ComputeInputCoinAgePerByte(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.ComputeInputCoinAgePerByte(chainstate->ActiveChain().Height())));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            for (const CTxIn& txin : tx.vin) {
-                CTransaction dummyResult;
-                if (mempool.lookupOutpoint(txin.prevout.hash, dummyResult))
-                    setDepends.insert(txin.prevout.hash.ToString());
+        const std::shared_ptr<std::vector<MempoolEntrySummary>> entries = std::make_shared<std::vector<MempoolEntrySummary>>();
+        {
+            LOCK(mempool.cs);
+            entries->reserve(mempool.mapTx.size());
+            BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx) {
+                const CTxMemPoolEntry& e = entry.second;
+                MempoolEntrySummary summary;
+                summary.hash = entry.first;
+                summary.size = e.GetTxSize();
+                summary.fee = e.GetFee();
+                summary.time = e.GetTime();
+                summary.height = e.GetHeight();
+                summary.startingPriority = e.ComputeInputCoinAgePerByte(e.GetHeight());
+                summary.currentPriority = e.ComputeInputCoinAgePerByte(chainstate->ActiveChain().Height());
+                const CTransaction& tx = e.GetTx();
+                for (const CTxIn& txin : tx.vin) {
+                    CTransaction dummyResult;
+                    if (mempool.lookupOutpoint(txin.prevout.hash, dummyResult))
+                        summary.depends.insert(txin.prevout.hash.ToString());
+                }
+                entries->push_back(summary);
             }
-            Array depends(setDepends.begin(), setDepends.end());
-            info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
         }
-        return o;
+        return [entries](I_JsonWriter& writer) {
+            writer.BeginObject();
+            for (const MempoolEntrySummary& summary: *entries) {
+                writer.Key(summary.hash.ToString());
+                writer.BeginObject();
+                writer.WriteField("size", (int)summary.size);
+                writer.WriteField("fee", ValueFromAmount(summary.fee));
+                writer.WriteField("time", summary.time);
+                writer.WriteField("height", (int)summary.height);
+                writer.WriteField("startingpriority", summary.startingPriority);
+                writer.WriteField("currentpriority", summary.currentPriority);
+                writer.WriteField("depends", Array(summary.depends.begin(), summary.depends.end()));
+                writer.EndObject();
+            }
+            writer.EndObject();
+        };
     } else {
-        std::vector<uint256> vtxid;
-        mempool.queryHashes(vtxid);
-
-        Array a;
-        BOOST_FOREACH (const uint256& hash, vtxid)
-            a.push_back(hash.ToString());
-
-        return a;
+        const std::shared_ptr<std::vector<uint256>> vtxid = std::make_shared<std::vector<uint256>>();
+        mempool.queryHashes(*vtxid);
+
+        return [vtxid](I_JsonWriter& writer) {
+            writer.BeginArray();
+            BOOST_FOREACH (const uint256& hash, *vtxid)
+                writer.Write(hash.ToString());
+            writer.EndArray();
+        };
     }
 }
 
+Value getrawmempool(const Array& params, bool fHelp, CWallet* pwallet)
+{
+    return BuildJsonValue(streamgetrawmempool(params, fHelp, pwallet));
+}
+
 Value getblockhash(const Array& params, bool fHelp, CWallet* pwallet)
 {
     if (fHelp || params.size() != 1)
@@ -163,17 +201,17 @@ Value getblockhash(const Array& params, bool fHelp, CWallet* pwallet)
             "\nExamples:\n" +
             HelpExampleCli("getblockhash", "1000") + HelpExampleRpc("getblockhash", "1000"));
 
-    const ChainstateManager::Reference chainstate;
+    const std::shared_ptr<const ChainStateSnapshot> chainSnapshot = ChainStateSnapshot::Current();
 
     int nHeight = params[0].get_int();
-    if (nHeight < 0 || nHeight > chainstate->ActiveChain().Height())
+    if (nHeight < 0 || nHeight > chainSnapshot->Height())
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
-    const CBlockIndex* pblockindex = chainstate->ActiveChain()[nHeight];
+    const CBlockIndex* pblockindex = (*chainSnapshot)[nHeight];
     return pblockindex->GetBlockHash().GetHex();
 }
 
-Value getblock(const Array& params, bool fHelp, CWallet* pwallet)
+JsonProducer streamgetblock(const Array& params, bool fHelp, CWallet* pwallet)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
@@ -216,28 +254,39 @@ Value getblock(const Array& params, bool fHelp, CWallet* pwallet)
         fVerbose = params[1].get_bool();
 
     const ChainstateManager::Reference chainstate;
-    const auto& blockMap = chainstate->GetBlockMap();
-    const auto mit = blockMap.find(hash);
-    if (mit == blockMap.end())
+    const CBlockIndex* pblockindex = chainstate->GetBlockMap().FindWithoutMainLock(hash);
+    if (pblockindex == nullptr)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
-    const CBlockIndex* pblockindex = mit->second;
+    const std::shared_ptr<const ChainStateSnapshot> chainSnapshot = ChainStateSnapshot::Current();
+
+    // Without the response cache the JSON is written straight from the block instead of being rendered to text first
+    if (!fVerbose || GetRenderedResponseCache().IsEnabled()) {
+        const std::shared_ptr<const std::string> rendered =
+            RenderBlockResponse(*chainSnapshot, pblockindex, fVerbose? RenderedResponseCache::BLOCK_JSON: RenderedResponseCache::BLOCK_HEX);
+        if (!rendered)
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+        if (!fVerbose)
+            return [rendered](I_JsonWriter& writer) { writer.Write(*rendered); };
+        return [rendered](I_JsonWriter& writer) { writer.WriteRaw(*rendered); };
+    }
+
+    const std::shared_ptr<CBlock> block = std::make_shared<CBlock>();
 
-    if (!ReadBlockFromDisk(block, pblockindex))
+    if (!ReadBlockFromDisk(*block, pblockindex))
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 
-    if (!fVerbose) {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block;
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
-    }
+    return [chainSnapshot, block, pblockindex](I_JsonWriter& writer) {
+        blockToJSON(writer, *chainSnapshot, *block, pblockindex);
+    };
+}
 
-    return blockToJSON(chainstate->ActiveChain(), block, pblockindex);
+Value getblock(const Array& params, bool fHelp, CWallet* pwallet)
+{
+    return BuildJsonValue(streamgetblock(params, fHelp, pwallet));
 }
 
-Value getblockheader(const Array& params, bool fHelp, CWallet* pwallet)
+JsonProducer streamgetblockheader(const Array& params, bool fHelp, CWallet* pwallet)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
@@ -269,25 +318,25 @@ Value getblockheader(const Array& params, bool fHelp, CWallet* pwallet)
         fVerbose = params[1].get_bool();
 
     const ChainstateManager::Reference chainstate;
-    const auto& blockMap = chainstate->GetBlockMap();
-    const auto mit = blockMap.find(hash);
-    if (mit == blockMap.end())
+    const CBlockIndex* pblockindex = chainstate->GetBlockMap().FindWithoutMainLock(hash);
+    if (pblockindex == nullptr)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlock block;
-    const CBlockIndex* pblockindex = mit->second;
-
-    if (!ReadBlockFromDisk(block, pblockindex))
+    const std::shared_ptr<const std::string> rendered = RenderBlockResponse(
+        *ChainStateSnapshot::Current(),
+        pblockindex,
+        fVerbose? RenderedResponseCache::BLOCK_HEADER_JSON: RenderedResponseCache::BLOCK_HEADER_HEX);
+    if (!rendered)
         throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
 
-    if (!fVerbose) {
-        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-        ssBlock << block.GetBlockHeader();
-        std::string strHex = HexStr(ssBlock.begin(), ssBlock.end());
-        return strHex;
-    }
+    if (!fVerbose)
+        return [rendered](I_JsonWriter& writer) { writer.Write(*rendered); };
+    return [rendered](I_JsonWriter& writer) { writer.WriteRaw(*rendered); };
+}
 
-    return blockHeaderToJSON(block, pblockindex);
+Value getblockheader(const Array& params, bool fHelp, CWallet* pwallet)
+{
+    return BuildJsonValue(streamgetblockheader(params, fHelp, pwallet));
 }
 
 Value gettxoutsetinfo(const Array& params, bool fHelp, CWallet* pwallet)
@@ -440,15 +489,15 @@ Value getblockchaininfo(const Array& params, bool fHelp, CWallet* pwallet)
             "\nExamples:\n" +
             HelpExampleCli("getblockchaininfo", "") + HelpExampleRpc("getblockchaininfo", ""));
 
-    const ChainstateManager::Reference chainstate;
+    const std::shared_ptr<const ChainStateSnapshot> chainSnapshot = ChainStateSnapshot::Current();
 
     Object obj;
     obj.push_back(Pair("chain", Params().NetworkIDString()));
-    obj.push_back(Pair("blocks", (int)chainstate->ActiveChain().Height()));
-    obj.push_back(Pair("headers", GetBestHeaderBlockHeight()));
-    obj.push_back(Pair("bestblockhash", chainstate->ActiveChain().Tip()->GetBlockHash().GetHex()));
-    obj.push_back(Pair("difficulty", (double)GetDifficulty(chainstate->ActiveChain())));
-    obj.push_back(Pair("chainwork", chainstate->ActiveChain().Tip()->nChainWork.GetHex()));
+    obj.push_back(Pair("blocks", chainSnapshot->Height()));
+    obj.push_back(Pair("headers", chainSnapshot->BestHeaderHeight()));
+    obj.push_back(Pair("bestblockhash", chainSnapshot->Tip()->GetBlockHash().GetHex()));
+    obj.push_back(Pair("difficulty", (double)GetDifficulty(*chainSnapshot)));
+    obj.push_back(Pair("chainwork", chainSnapshot->Tip()->nChainWork.GetHex()));
     return obj;
 }
 
@@ -574,6 +623,74 @@ Value getmempoolinfo(const Array& params, bool fHelp, CWallet* pwallet)
     return ret;
 }
 
+Value getresponsecacheinfo(const Array& params, bool fHelp, CWallet* pwallet)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getresponsecacheinfo\n"
+            "\nReturns usage of the cache of rendered block and transaction responses (see -rpccachesize).\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"entries\": xxxxx             (numeric) Cached responses\n"
+            "  \"bytes\": xxxxx               (numeric) Total size of the cached responses\n"
+            "  \"maxbytes\": xxxxx            (numeric) Size limit, 0 if the cache is disabled\n"
+            "  \"hits\": xxxxx                (numeric) Requests served from the cache\n"
+            "  \"misses\": xxxxx              (numeric) Requests that had to be rendered\n"
+            "  \"hitrate\": x.xxx             (numeric) hits / (hits + misses)\n"
+            "  \"evictions\": xxxxx           (numeric) Responses dropped to stay within maxbytes\n"
+            "  \"invalidations\": xxxxx       (numeric) Responses dropped because a reorg disconnected their block\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getresponsecacheinfo", "") + HelpExampleRpc("getresponsecacheinfo", ""));
+
+    const RenderedResponseCache::Statistics stats = GetRenderedResponseCache().GetStatistics();
+    const uint64_t lookups = stats.hits + stats.misses;
+
+    Object ret;
+    ret.push_back(Pair("entries", (int64_t)stats.entries));
+    ret.push_back(Pair("bytes", (int64_t)stats.bytes));
+    ret.push_back(Pair("maxbytes", (int64_t)stats.maxBytes));
+    ret.push_back(Pair("hits", (int64_t)stats.hits));
+    ret.push_back(Pair("misses", (int64_t)stats.misses));
+    ret.push_back(Pair("hitrate", lookups > 0? (double)stats.hits / lookups: 0.0));
+    ret.push_back(Pair("evictions", (int64_t)stats.evictions));
+    ret.push_back(Pair("invalidations", (int64_t)stats.invalidations));
+    return ret;
+}
+
+Value getindexinfo(const Array& params, bool fHelp, CWallet* pwallet)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getindexinfo\n"
+            "\nReturns how far the address and spent indexes (see -addressindex and -spentindex) have been built.\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"addressindex\": true|false     (boolean) Whether the address index is maintained\n"
+            "  \"spentindex\": true|false       (boolean) Whether the spent index is maintained\n"
+            "  \"height\": xxxxx                (numeric) Height of the last indexed block, -1 if none\n"
+            "  \"bestblockhash\": \"hash\"        (string) Hash of the last indexed block\n"
+            "  \"chainheight\": xxxxx           (numeric) Height of the active chain\n"
+            "  \"synced\": true|false           (boolean) Whether the indexes reflect the active chain tip\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getindexinfo", "") + HelpExampleRpc("getindexinfo", ""));
+
+    const AsyncIndexBuilder* indexBuilder = GetAsyncIndexBuilder();
+    if (!indexBuilder)
+        throw JSONRPCError(RPC_IN_WARMUP, "Indexes are not loaded yet");
+    const AsyncIndexBuilder::Status status = indexBuilder->GetStatus();
+
+    Object ret;
+    ret.push_back(Pair("addressindex", status.addressIndexing));
+    ret.push_back(Pair("spentindex", status.spentIndexing));
+    ret.push_back(Pair("height", status.indexedHeight));
+    ret.push_back(Pair("bestblockhash", status.indexedBlockHash.GetHex()));
+    ret.push_back(Pair("chainheight", status.chainHeight));
+    ret.push_back(Pair("synced", status.synced));
+    return ret;
+}
+
 Value reverseblocktransactions(const Array& params, bool fHelp, CWallet* pwallet)
 {
     if (fHelp || params.size() != 1)
@@ -88,7 +88,7 @@ Value importprivkey(const Array& params, bool fHelp, CWallet* pwallet)
         if (pwallet->HaveKey(vchAddress))
             return Value::null;
 
-        if (!pwallet->AddKeyPubKey(key, pubkey))
+        if (!pwallet->ImportKeyPubKey(key, pubkey))
             throw JSONRPCError(RPC_WALLET_ERROR, "Error adding key to wallet");
 
         // whenever a key is imported, we need to scan the whole chain; 0 would be considered 'no value'
@@ -336,7 +336,7 @@ Value bip38decrypt(const Array& params, bool fHelp, CWallet* pwallet)
         if (pwallet->HaveKey(vchAddress))
             throw JSONRPCError(RPC_WALLET_ERROR, "Key already held by wallet");
 
-        if (!pwallet->AddKeyPubKey(key, pubkey))
+        if (!pwallet->ImportKeyPubKey(key, pubkey))
             throw JSONRPCError(RPC_WALLET_ERROR, "Error adding key to wallet");
 
         // whenever a key is imported, we need to scan the whole chain; 0 would be considered 'no value'
@@ -36,8 +36,10 @@
 #include <PeerBanningService.h>
 #include <IndexDatabaseUpdateCollector.h>
 #include <TransactionSearchIndexes.h>
+#include <utilstrencodings.h>
 
 #include <JsonBlockHelpers.h>
+#include <JsonStreamWriter.h>
 
 #include <Settings.h>
 extern Settings& settings;
@@ -606,6 +608,56 @@ bool getAddressFromIndex(const int &type, const uint160 &hash, std::string &addr
     return true;
 }
 
+/** Reads the optional "limit" and "cursor" fields of an address query.  With a limit
+ *  the reply is one page of the result, followed by a cursor to the next page if any */
+bool getPageFromParams(const Array& params, size_t& limit, std::string& cursor)
+{
+    if (params[0].type() != obj_type)
+        return false;
+    const Value limitValue = find_value(params[0].get_obj(), "limit");
+    const Value cursorValue = find_value(params[0].get_obj(), "cursor");
+    if (limitValue.type() == null_type) {
+        if (cursorValue.type() != null_type)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "A cursor requires a limit");
+        return false;
+    }
+    if (limitValue.type() != int_type || limitValue.get_int() <= 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Limit is expected to be greater than zero");
+    if (cursorValue.type() != null_type && cursorValue.type() != str_type)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Cursor is expected to be a string");
+    limit = limitValue.get_int();
+    cursor = cursorValue.type() == str_type ? cursorValue.get_str() : std::string();
+    return true;
+}
+
+template <typename Key>
+std::string encodeCursor(const Key& key)
+{
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << key;
+    return HexStr(stream.begin(), stream.end());
+}
+
+/** Null when no cursor was given, i.e. for the first page */
+template <typename Key>
+std::unique_ptr<Key> decodeCursor(const std::string& cursor)
+{
+    if (cursor.empty())
+        return std::unique_ptr<Key>();
+    if (!IsHex(cursor))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    CDataStream stream(ParseHex(cursor), SER_DISK, CLIENT_VERSION);
+    std::unique_ptr<Key> key(new Key());
+    try {
+        stream >> *key;
+    } catch (const std::exception&) {
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    }
+    if (!stream.empty())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid cursor");
+    return key;
+}
+
 Value getaddresstxids(const Array& params, bool fHelp, CWallet* pwallet)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -618,12 +670,19 @@ Value getaddresstxids(const Array& params, bool fHelp, CWallet* pwallet)
             "               (1) '\"addresses\"' (required) array of base58check encoded addresses\n"
             "               (2) '\"start\"' (optional field) integer block height to start at\n"
             "               (3) '\"end\"' (optional field) integer block height to stop at\n"
+            "               (4) '\"limit\"' (optional field) integer maximum number of txids to return\n"
+            "               (5) '\"cursor\"' (optional field) string cursor returned with the previous page\n"
             "\"only_vaults\" (boolean, optional) Only return utxos spendable by the specified addresses\n"
             "\nResult:\n"
             "[\n"
             "  \"transactionid\"  (string) The transaction id\n"
             "  ,...\n"
             "]\n"
+            "\nResult (with limit, ordered by height and position in the block):\n"
+            "{\n"
+            "  \"txids\": [ \"transactionid\", ... ]\n"
+            "  \"cursor\"  (string) Pass to get the next page, absent on the last page\n"
+            "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddresstxids", "'{\"addresses\": [\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\"]}'")
             + HelpExampleRpc("getaddresstxids", "{\"addresses\": [\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\"]}")
@@ -650,15 +709,35 @@ Value getaddresstxids(const Array& params, bool fHelp, CWallet* pwallet)
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     const ChainstateManager::Reference chainstate;
-    const auto& blockTree = chainstate->BlockTree();
+    const auto& searchIndexes = chainstate->SearchIndexes();
+
+    size_t limit = 0;
+    std::string cursor;
+    if (getPageFromParams(params, limit, cursor)) {
+        const std::unique_ptr<CAddressIndexKey> after = decodeCursor<CAddressIndexKey>(cursor);
+        std::vector<CAddressIndexKey> transactions;
+        bool more = false;
+        if (!TransactionSearchIndexes::GetAddressTransactionPage(&searchIndexes, addresses, start, end, after.get(), limit, transactions, more)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+
+        Array txids;
+        for (const CAddressIndexKey& transaction: transactions)
+            txids.push_back(transaction.txhash.GetHex());
+        Object page;
+        page.push_back(Pair("txids", txids));
+        if (more)
+            page.push_back(Pair("cursor", encodeCursor(transactions.back())));
+        return page;
+    }
 
     for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
         if (start > 0 && end > 0) {
-            if (!TransactionSearchIndexes::GetAddressIndex(&blockTree, (*it).first, (*it).second, addressIndex, start, end)) {
+            if (!TransactionSearchIndexes::GetAddressIndex(&searchIndexes, (*it).first, (*it).second, addressIndex, start, end)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         } else {
-            if (!TransactionSearchIndexes::GetAddressIndex(&blockTree, (*it).first, (*it).second, addressIndex)) {
+            if (!TransactionSearchIndexes::GetAddressIndex(&searchIndexes, (*it).first, (*it).second, addressIndex)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         }
@@ -690,7 +769,7 @@ Value getaddresstxids(const Array& params, bool fHelp, CWallet* pwallet)
 
 }
 
-Value getaddressdeltas(const Array& params, bool fHelp, CWallet* pwallet)
+JsonProducer streamgetaddressdeltas(const Array& params, bool fHelp, CWallet* pwallet)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
@@ -703,7 +782,11 @@ Value getaddressdeltas(const Array& params, bool fHelp, CWallet* pwallet)
             "               (2) '\"start\"' (optional field) integer block height to start at\n"
             "               (3) '\"end\"' (optional field) integer block height to stop at\n"
             "               (4) '\"chainInfo\"' (optional field) bool flag to include chain info\n"
+            "               (5) '\"limit\"' (optional field) integer maximum number of deltas to return\n"
+            "               (6) '\"cursor\"' (optional field) string cursor returned with the previous page\n"
             "\"only_vaults\" (boolean, optional) Only return utxos spendable by the specified addresses\n"
+            "\nWith a limit the deltas of all addresses are ordered by height and position in the block, and\n"
+            "returned as the \"deltas\" of an object which also holds the \"cursor\" of the next page, if any.\n"
             "\nResult:\n"
             "[\n"
             "  {\n"
@@ -751,42 +834,54 @@ Value getaddressdeltas(const Array& params, bool fHelp, CWallet* pwallet)
     std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
 
     const ChainstateManager::Reference chainstate;
-    const auto& blockTree = chainstate->BlockTree();
+    const auto& searchIndexes = chainstate->SearchIndexes();
     const auto& chain = chainstate->ActiveChain();
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+    size_t limit = 0;
+    std::string cursor;
+    const bool paginated = getPageFromParams(params, limit, cursor);
+    std::string nextCursor;
+    if (paginated) {
+        const std::unique_ptr<CAddressIndexKey> after = decodeCursor<CAddressIndexKey>(cursor);
+        bool more = false;
+        if (!TransactionSearchIndexes::GetAddressIndexPage(&searchIndexes, addresses, start, end, after.get(), limit, addressIndex, more)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+        }
+        if (more)
+            nextCursor = encodeCursor(addressIndex.back().first);
+    }
+
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); !paginated && it != addresses.end(); it++) {
         if (start > 0 && end > 0) {
-            if (!TransactionSearchIndexes::GetAddressIndex(&blockTree, (*it).first, (*it).second, addressIndex, start, end)) {
+            if (!TransactionSearchIndexes::GetAddressIndex(&searchIndexes, (*it).first, (*it).second, addressIndex, start, end)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         } else {
-            if (!TransactionSearchIndexes::GetAddressIndex(&blockTree, (*it).first, (*it).second, addressIndex)) {
+            if (!TransactionSearchIndexes::GetAddressIndex(&searchIndexes, (*it).first, (*it).second, addressIndex)) {
                 throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
             }
         }
     }
 
-    Array deltas;
-
+    // Resolve each distinct address once, and fail now rather than halfway through the reply
+    const std::shared_ptr<std::map<std::pair<unsigned int, uint160>, std::string>> addressNames =
+        std::make_shared<std::map<std::pair<unsigned int, uint160>, std::string>>();
     for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
+        const std::pair<unsigned int, uint160> addressKey(it->first.type, it->first.hashBytes);
+        if (addressNames->count(addressKey) > 0)
+            continue;
         std::string address;
         if (!getAddressFromIndex(it->first.type, it->first.hashBytes, address)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unknown address type");
         }
-
-        Object delta;
-        delta.push_back(Pair("satoshis", it->second));
-        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
-        delta.push_back(Pair("index", (int)it->first.index));
-        delta.push_back(Pair("blockindex", (int)it->first.txindex));
-        delta.push_back(Pair("height", it->first.blockHeight));
-        delta.push_back(Pair("address", address));
-        deltas.push_back(delta);
+        (*addressNames)[addressKey] = address;
     }
 
-    Object result;
+    Object startInfo;
+    Object endInfo;
+    const bool wrapWithChainInfo = includeChainInfo && start > 0 && end > 0;
 
-    if (includeChainInfo && start > 0 && end > 0) {
+    if (wrapWithChainInfo) {
 
         if (start > chain.Height() || end > chain.Height()) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Start or end is outside chain range");
@@ -795,23 +890,48 @@ Value getaddressdeltas(const Array& params, bool fHelp, CWallet* pwallet)
         const CBlockIndex* startIndex = chain[start];
         const CBlockIndex* endIndex = chain[end];
 
-        Object startInfo;
-        Object endInfo;
-
         startInfo.push_back(Pair("hash", startIndex->GetBlockHash().GetHex()));
         startInfo.push_back(Pair("height", start));
 
         endInfo.push_back(Pair("hash", endIndex->GetBlockHash().GetHex()));
         endInfo.push_back(Pair("height", end));
+    }
 
-        result.push_back(Pair("deltas", deltas));
-        result.push_back(Pair("start", startInfo));
-        result.push_back(Pair("end", endInfo));
+    const std::shared_ptr<const std::vector<std::pair<CAddressIndexKey, CAmount> > > deltas =
+        std::make_shared<const std::vector<std::pair<CAddressIndexKey, CAmount> > >(std::move(addressIndex));
+    return [deltas, addressNames, wrapWithChainInfo, paginated, nextCursor, startInfo, endInfo](I_JsonWriter& writer) {
+        if (wrapWithChainInfo || paginated) {
+            writer.BeginObject();
+            writer.Key("deltas");
+        }
+        writer.BeginArray();
+        for (const std::pair<CAddressIndexKey, CAmount>& entry: *deltas) {
+            Object delta;
+            delta.push_back(Pair("satoshis", entry.second));
+            delta.push_back(Pair("txid", entry.first.txhash.GetHex()));
+            delta.push_back(Pair("index", (int)entry.first.index));
+            delta.push_back(Pair("blockindex", (int)entry.first.txindex));
+            delta.push_back(Pair("height", entry.first.blockHeight));
+            delta.push_back(Pair("address", addressNames->at(std::make_pair(entry.first.type, entry.first.hashBytes))));
+            writer.Write(delta);
+        }
+        writer.EndArray();
+        if (wrapWithChainInfo) {
+            writer.WriteField("start", startInfo);
+            writer.WriteField("end", endInfo);
+        }
+        if (!nextCursor.empty()) {
+            writer.WriteField("cursor", Value(nextCursor));
+        }
+        if (wrapWithChainInfo || paginated) {
+            writer.EndObject();
+        }
+    };
+}
 
-        return result;
-    } else {
-        return deltas;
-    }
+Value getaddressdeltas(const Array& params, bool fHelp, CWallet* pwallet)
+{
+    return BuildJsonValue(streamgetaddressdeltas(params, fHelp, pwallet));
 }
 
 Value getaddressbalance(const Array& params, bool fHelp, CWallet* pwallet)
@@ -829,6 +949,7 @@ Value getaddressbalance(const Array& params, bool fHelp, CWallet* pwallet)
             "{\n"
             "  \"balance\"  (string) The current balance in satoshis\n"
             "  \"received\"  (string) The total number of satoshis received (including change)\n"
+            "  \"txcount\"  (numeric) The number of transactions involving each address, added up\n"
             "}\n"
             "\nExamples:\n"
             + HelpExampleCli("getaddressbalance", "'\"12c6DSiU4Rq3P4ZxziKxzrL5LmMBrzjrJX\"'")
@@ -842,29 +963,26 @@ Value getaddressbalance(const Array& params, bool fHelp, CWallet* pwallet)
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address");
     }
 
-    std::vector<std::pair<CAddressIndexKey, CAmount> > addressIndex;
-
     const ChainstateManager::Reference chainstate;
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!TransactionSearchIndexes::GetAddressIndex(&chainstate->BlockTree(), (*it).first, (*it).second, addressIndex)) {
-            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
-        }
-    }
-
     CAmount balance = 0;
     CAmount received = 0;
+    int64_t txCount = 0;
 
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=addressIndex.begin(); it!=addressIndex.end(); it++) {
-        if (it->second > 0) {
-            received += it->second;
+    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+        CAddressBalance addressBalance;
+        if (!TransactionSearchIndexes::GetAddressBalance(&chainstate->SearchIndexes(), (*it).first, (*it).second, addressBalance)) {
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-        balance += it->second;
+        balance += addressBalance.balance;
+        received += addressBalance.received;
+        txCount += addressBalance.txCount;
     }
 
     Object result;
     result.push_back(Pair("balance", balance));
     result.push_back(Pair("received", received));
+    result.push_back(Pair("txcount", txCount));
 
     return result;
 
@@ -913,7 +1031,7 @@ Value getspentinfo(const Array& params, bool fHelp, CWallet* pwallet)
 
     const ChainstateManager::Reference chainstate;
 
-    if (!TransactionSearchIndexes::GetSpentIndex(&chainstate->BlockTree(), key, value)) {
+    if (!TransactionSearchIndexes::GetSpentIndex(&chainstate->SearchIndexes(), key, value)) {
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Unable to get spent info");
     }
 
@@ -936,7 +1054,12 @@ Value getaddressutxos(const Array& params, bool fHelp, CWallet* pwallet)
             "\"addresses\": (optional JSON object) An object with fields:\n"
             "               (1) '\"addresses\"' (required) array of base58check encoded addresses\n"
             "               (2) '\"chainInfo\"' (optional field) bool flag to include chain info\n"
+            "               (3) '\"limit\"' (optional field) integer maximum number of outputs to return\n"
+            "               (4) '\"cursor\"' (optional field) string cursor returned with the previous page\n"
             "\"only_vaults\" (boolean, optional) Only return utxos spendable by the specified addresses\n"
+            "\nWithout a limit the outputs are sorted by height. With a limit they are in index order (by\n"
+            "address, txid and output index) and returned as the \"utxos\" of an object which also holds\n"
+            "the \"cursor\" of the next page, if any.\n"
             "\nResult\n"
             "[\n"
             "  {\n"
@@ -971,13 +1094,27 @@ Value getaddressutxos(const Array& params, bool fHelp, CWallet* pwallet)
     const ChainstateManager::Reference chainstate;
     const auto& chain = chainstate->ActiveChain();
 
-    for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
-        if (!TransactionSearchIndexes::GetAddressUnspent(&chainstate->BlockTree(), (*it).first, (*it).second, unspentOutputs)) {
+    size_t limit = 0;
+    std::string cursor;
+    const bool paginated = getPageFromParams(params, limit, cursor);
+    std::string nextCursor;
+    if (paginated) {
+        const std::unique_ptr<CAddressUnspentKey> after = decodeCursor<CAddressUnspentKey>(cursor);
+        bool more = false;
+        if (!TransactionSearchIndexes::GetAddressUnspentPage(&chainstate->SearchIndexes(), addresses, after.get(), limit, unspentOutputs, more)) {
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
         }
-    }
+        if (more)
+            nextCursor = encodeCursor(unspentOutputs.back().first);
+    } else {
+        for (std::vector<std::pair<uint160, int> >::iterator it = addresses.begin(); it != addresses.end(); it++) {
+            if (!TransactionSearchIndexes::GetAddressUnspent(&chainstate->SearchIndexes(), (*it).first, (*it).second, unspentOutputs)) {
+                throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available for address");
+            }
+        }
 
-    std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+        std::sort(unspentOutputs.begin(), unspentOutputs.end(), heightSort);
+    }
 
     Array utxos;
 
@@ -997,12 +1134,17 @@ Value getaddressutxos(const Array& params, bool fHelp, CWallet* pwallet)
         utxos.push_back(output);
     }
 
-    if (includeChainInfo) {
+    if (includeChainInfo || paginated) {
         Object result;
         result.push_back(Pair("utxos", utxos));
 
-        result.push_back(Pair("hash", chain.Tip()->GetBlockHash().GetHex()));
-        result.push_back(Pair("height", (int)chain.Height()));
+        if (includeChainInfo) {
+            result.push_back(Pair("hash", chain.Tip()->GetBlockHash().GetHex()));
+            result.push_back(Pair("height", (int)chain.Height()));
+        }
+        if (!nextCursor.empty()) {
+            result.push_back(Pair("cursor", nextCursor));
+        }
         return result;
     } else {
         return utxos;
@@ -64,6 +64,24 @@ Value ping(const Array& params, bool fHelp, CWallet* pwallet)
     return Value::null;
 }
 
+static Object MessageTotalsToJSON(const std::map<std::string, MessageTypeStatistics::Totals>& totalsByCommand)
+{
+    Object result;
+    for(const auto& commandAndTotals: totalsByCommand)
+    {
+        const MessageTypeStatistics::Totals& totals = commandAndTotals.second;
+        Object obj;
+        obj.push_back(Pair("msgrecv", totals.messagesReceived));
+        obj.push_back(Pair("bytesrecv", totals.bytesReceived));
+        obj.push_back(Pair("msgsent", totals.messagesSent));
+        obj.push_back(Pair("bytessent", totals.bytesSent));
+        obj.push_back(Pair("processing_us", totals.processingMicros));
+        obj.push_back(Pair("max_processing_us", totals.maxProcessingMicros));
+        result.push_back(Pair(commandAndTotals.first, obj));
+    }
+    return result;
+}
+
 Value getpeerinfo(const Array& params, bool fHelp, CWallet* pwallet)
 {
     if (fHelp || params.size() != 0)
@@ -94,7 +112,10 @@ Value getpeerinfo(const Array& params, bool fHelp, CWallet* pwallet)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"msgstats\": {             (json object) Traffic with this peer by message type, as in getmessagestats\n"
+            "       ...\n"
+            "    }\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -146,6 +167,7 @@ Value getpeerinfo(const Array& params, bool fHelp, CWallet* pwallet)
             obj.push_back(Pair("inflight", heights));
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
+        obj.push_back(Pair("msgstats", MessageTotalsToJSON(stats.messageTotals)));
 
         ret.push_back(obj);
     }
@@ -297,7 +319,16 @@ Value getnettotals(const Array& params, bool fHelp, CWallet* pwallet)
             "{\n"
             "  \"totalbytesrecv\": n,   (numeric) Total bytes received\n"
             "  \"totalbytessent\": n,   (numeric) Total bytes sent\n"
-            "  \"timemillis\": t        (numeric) Total cpu time\n"
+            "  \"timemillis\": t,       (numeric) Total cpu time\n"
+            "  \"uploadtarget\":\n"
+            "  {\n"
+            "    \"timeframe\": n,                         (numeric) Length of the measuring timeframe in seconds\n"
+            "    \"target\": n,                            (numeric) Target in bytes\n"
+            "    \"target_reached\": true|false,           (boolean) True if target is reached\n"
+            "    \"serve_historical_blocks\": true|false,  (boolean) True if serving historical blocks\n"
+            "    \"bytes_left_in_cycle\": t,               (numeric) Bytes left in current time cycle\n"
+            "    \"time_left_in_cycle\": t                 (numeric) Seconds left in current time cycle\n"
+            "  }\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getnettotals", "") + HelpExampleRpc("getnettotals", ""));
@@ -306,9 +337,43 @@ Value getnettotals(const Array& params, bool fHelp, CWallet* pwallet)
     obj.push_back(Pair("totalbytesrecv", NetworkUsageStats::GetTotalBytesRecv()));
     obj.push_back(Pair("totalbytessent", NetworkUsageStats::GetTotalBytesSent()));
     obj.push_back(Pair("timemillis", GetTimeMillis()));
+
+    Object outboundLimit;
+    outboundLimit.push_back(Pair("timeframe", NetworkUsageStats::GetMaxOutboundTimeframe()));
+    outboundLimit.push_back(Pair("target", NetworkUsageStats::GetMaxOutboundTarget()));
+    outboundLimit.push_back(Pair("target_reached", NetworkUsageStats::OutboundTargetReached(false)));
+    outboundLimit.push_back(Pair("serve_historical_blocks", !NetworkUsageStats::OutboundTargetReached(true)));
+    outboundLimit.push_back(Pair("bytes_left_in_cycle", NetworkUsageStats::GetOutboundTargetBytesLeft()));
+    outboundLimit.push_back(Pair("time_left_in_cycle", NetworkUsageStats::GetMaxOutboundTimeLeftInCycle()));
+    obj.push_back(Pair("uploadtarget", outboundLimit));
     return obj;
 }
 
+Value getmessagestats(const Array& params, bool fHelp, CWallet* pwallet)
+{
+    if (fHelp || params.size() > 0)
+        throw runtime_error(
+            "getmessagestats\n"
+            "\nReturns network traffic and handling time by message type, summed over all peers\n"
+            "since startup. Message types not known to this node are counted as \"*other*\".\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"command\": {                (json object) One entry per message type seen\n"
+            "    \"msgrecv\": n,             (numeric) Messages received\n"
+            "    \"bytesrecv\": n,           (numeric) Bytes received, including headers\n"
+            "    \"msgsent\": n,             (numeric) Messages sent\n"
+            "    \"bytessent\": n,           (numeric) Bytes sent, including headers\n"
+            "    \"processing_us\": n,       (numeric) Total time spent handling received messages in microseconds\n"
+            "    \"max_processing_us\": n    (numeric) Longest time spent handling one message in microseconds\n"
+            "  },\n"
+            "  ...\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getmessagestats", "") + HelpExampleRpc("getmessagestats", ""));
+
+    return MessageTotalsToJSON(MessageTypeStatistics::Global().GetTotals());
+}
+
 static Array GetNetworksInfo()
 {
     Array networks;
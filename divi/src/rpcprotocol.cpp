@@ -135,6 +135,111 @@ string HTTPReply(int nStatus, const string& strMsg, bool keepalive, bool headers
     }
 }
 
+string HTTPChunkedReplyHeader(int nStatus, bool keepalive, const char* contentType)
+{
+    return strprintf(
+        "HTTP/1.1 %d %s\r\n"
+        "Date: %s\r\n"
+        "Connection: %s\r\n"
+        "Transfer-Encoding: chunked\r\n"
+        "Content-Type: %s\r\n"
+        "Server: divi-json-rpc/%s\r\n"
+        "\r\n",
+        nStatus,
+        httpStatusDescription(nStatus),
+        rfc1123Time(),
+        keepalive ? "keep-alive" : "close",
+        contentType,
+        FormatFullVersion());
+}
+
+//! Bytes collected before a chunk is handed to the connection
+static const size_t HTTP_CHUNK_SIZE = 64 * 1024;
+
+HTTPStreamedReply::ChunkedStreamBuf::ChunkedStreamBuf(
+    std::ostream& connection,
+    size_t chunkSize
+    ): connection_(connection)
+    , buffer_(chunkSize)
+{
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+bool HTTPStreamedReply::ChunkedStreamBuf::WriteChunk()
+{
+    const std::ptrdiff_t length = pptr() - pbase();
+    if (length > 0) {
+        connection_ << strprintf("%x\r\n", length);
+        connection_.write(pbase(), length);
+        connection_ << "\r\n";
+        setp(buffer_.data(), buffer_.data() + buffer_.size());
+    }
+    return connection_.good();
+}
+
+HTTPStreamedReply::ChunkedStreamBuf::int_type HTTPStreamedReply::ChunkedStreamBuf::overflow(int_type ch)
+{
+    if (!WriteChunk())
+        return traits_type::eof();
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int HTTPStreamedReply::ChunkedStreamBuf::sync()
+{
+    if (!WriteChunk())
+        return -1;
+    connection_.flush();
+    return connection_.good() ? 0 : -1;
+}
+
+bool HTTPStreamedReply::ChunkedStreamBuf::Finish()
+{
+    if (!WriteChunk())
+        return false;
+    connection_ << "0\r\n\r\n" << std::flush;
+    return connection_.good();
+}
+
+HTTPStreamedReply::HTTPStreamedReply(
+    std::ostream& connection,
+    int nStatus,
+    bool keepalive,
+    bool chunked,
+    const char* contentType
+    ): connection_(connection)
+    , nStatus_(nStatus)
+    , keepalive_(keepalive)
+    , contentType_(contentType)
+    , chunkedBuffer_()
+    , chunkedBody_()
+    , bufferedBody_()
+{
+    if (chunked) {
+        connection_ << HTTPChunkedReplyHeader(nStatus_, keepalive_, contentType_);
+        chunkedBuffer_.reset(new ChunkedStreamBuf(connection_, HTTP_CHUNK_SIZE));
+        chunkedBody_.reset(new std::ostream(chunkedBuffer_.get()));
+    }
+}
+
+std::ostream& HTTPStreamedReply::Body()
+{
+    return chunkedBody_ ? *chunkedBody_ : bufferedBody_;
+}
+
+bool HTTPStreamedReply::Finish()
+{
+    if (chunkedBuffer_)
+        return chunkedBody_->good() && chunkedBuffer_->Finish();
+
+    const string strBody = bufferedBody_.str();
+    connection_ << HTTPReplyHeader(nStatus_, keepalive_, strBody.size(), contentType_) << strBody << std::flush;
+    return connection_.good();
+}
+
 bool ReadHTTPRequestLine(std::basic_istream<char>& stream, int& proto, string& http_method, string& http_uri)
 {
     string str;
@@ -220,7 +325,27 @@ int ReadHTTPMessage(std::basic_istream<char>& stream, map<string, string>& mapHe
         return HTTP_INTERNAL_SERVER_ERROR;
 
     // Read message
-    if (nLen > 0) {
+    if (mapHeadersRet["transfer-encoding"] == "chunked") {
+        while (true) {
+            string strChunkSize;
+            if (!getline(stream, strChunkSize))
+                return HTTP_INTERNAL_SERVER_ERROR;
+            const size_t nChunkSize = strtoul(strChunkSize.c_str(), NULL, 16);
+            if (nChunkSize == 0)
+                break;
+            if (nChunkSize > max_size - strMessageRet.size())
+                return HTTP_INTERNAL_SERVER_ERROR;
+            const size_t nOffset = strMessageRet.size();
+            strMessageRet.resize(nOffset + nChunkSize);
+            stream.read(&strMessageRet[nOffset], nChunkSize);
+            string strChunkEnd;
+            if (!stream || !getline(stream, strChunkEnd)) // Connection lost while reading
+                return HTTP_INTERNAL_SERVER_ERROR;
+        }
+        // Skip trailers up to the empty line that ends the message
+        map<string, string> mapTrailers;
+        ReadHTTPHeaders(stream, mapTrailers);
+    } else if (nLen > 0) {
         std::vector<char> vch;
         size_t ptr = 0;
         while (ptr < (size_t)nLen) {
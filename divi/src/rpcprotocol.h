@@ -11,8 +11,11 @@
 #include <boost/iostreams/stream.hpp>
 #include <list>
 #include <map>
+#include <memory>
+#include <sstream>
 #include <stdint.h>
 #include <string>
+#include <vector>
 
 #include "json/json_spirit_reader_template.h"
 #include "json/json_spirit_utils.h"
@@ -80,10 +83,52 @@ std::string HTTPPost(const std::string& strMsg, const std::map<std::string, std:
 std::string HTTPError(int nStatus, bool keepalive, bool headerOnly = false);
 std::string HTTPReplyHeader(int nStatus, bool keepalive, size_t contentLength, const char* contentType = "application/json");
 std::string HTTPReply(int nStatus, const std::string& strMsg, bool keepalive, bool headerOnly = false, const char* contentType = "application/json");
+std::string HTTPChunkedReplyHeader(int nStatus, bool keepalive, const char* contentType = "application/json");
 bool ReadHTTPRequestLine(std::basic_istream<char>& stream, int& proto, std::string& http_method, std::string& http_uri);
 int ReadHTTPStatus(std::basic_istream<char>& stream, int& proto);
 int ReadHTTPHeaders(std::basic_istream<char>& stream, std::map<std::string, std::string>& mapHeadersRet);
 int ReadHTTPMessage(std::basic_istream<char>& stream, std::map<std::string, std::string>& mapHeadersRet, std::string& strMessageRet, int nProto, size_t max_size);
+/**
+ * Sends a reply body of unknown length while it is being produced: HTTP/1.1
+ * clients get it with chunked transfer encoding as it is written, older ones
+ * get it buffered behind a Content-Length header once Finish() is called.
+ */
+class HTTPStreamedReply
+{
+private:
+    class ChunkedStreamBuf: public std::streambuf
+    {
+    private:
+        std::ostream& connection_;
+        std::vector<char> buffer_;
+
+        bool WriteChunk();
+
+    protected:
+        int_type overflow(int_type ch) override;
+        int sync() override;
+
+    public:
+        ChunkedStreamBuf(std::ostream& connection, size_t chunkSize);
+        bool Finish();
+    };
+
+    std::ostream& connection_;
+    const int nStatus_;
+    const bool keepalive_;
+    const char* const contentType_;
+    std::unique_ptr<ChunkedStreamBuf> chunkedBuffer_;
+    std::unique_ptr<std::ostream> chunkedBody_;
+    std::ostringstream bufferedBody_;
+
+public:
+    HTTPStreamedReply(std::ostream& connection, int nStatus, bool keepalive, bool chunked, const char* contentType = "application/json");
+
+    std::ostream& Body();
+    /** Completes the reply; false if the connection failed along the way */
+    bool Finish();
+};
+
 std::string JSONRPCRequest(const std::string& strMethod, const json_spirit::Array& params, const json_spirit::Value& id);
 json_spirit::Object JSONRPCReplyObj(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id);
 std::string JSONRPCReply(const json_spirit::Value& result, const json_spirit::Value& error, const json_spirit::Value& id);
@@ -10,6 +10,7 @@
 #include <blockmap.h>
 #include <chain.h>
 #include <ChainstateManager.h>
+#include <ChainStateSnapshot.h>
 #include "core_io.h"
 #include <FeeAndPriorityCalculator.h>
 #include "init.h"
@@ -34,6 +35,9 @@
 
 #include "json/json_spirit_utils.h"
 #include "json/json_spirit_value.h"
+#include "json/json_spirit_writer_template.h"
+#include <JsonStreamWriter.h>
+#include <RenderedResponseCache.h>
 #include <boost/assign/list_of.hpp>
 #include <ValidationState.h>
 #include <script/SignatureCheckers.h>
@@ -51,7 +55,7 @@ void TxToJSONExpanded(const CTransaction& tx, const uint256 hashBlock, Object& e
                       int nHeight = 0, int nConfirmations = 0, int nBlockTime = 0)
 {
     const ChainstateManager::Reference chainstate;
-    const auto& blockTree = chainstate->BlockTree();
+    const auto& searchIndexes = chainstate->SearchIndexes();
 
     uint256 txid = tx.GetHash();
     entry.push_back(Pair("txid", txid.GetHex()));
@@ -74,7 +78,7 @@ void TxToJSONExpanded(const CTransaction& tx, const uint256 hashBlock, Object& e
             // Add address and value info if spentindex enabled
             CSpentIndexValue spentInfo;
             const CSpentIndexKey spentKey(txin.prevout.hash, txin.prevout.n);
-            if (TransactionSearchIndexes::GetSpentIndex(&blockTree, spentKey, spentInfo)) {
+            if (TransactionSearchIndexes::GetSpentIndex(&searchIndexes, spentKey, spentInfo)) {
                 in.push_back(Pair("value", ValueFromAmount(spentInfo.satoshis)));
                 in.push_back(Pair("valueSat", spentInfo.satoshis));
                 if (spentInfo.addressType == 1) {
@@ -105,9 +109,9 @@ void TxToJSONExpanded(const CTransaction& tx, const uint256 hashBlock, Object& e
         // so we simply try looking up by both txid and bare txid as at
         // most one of them can match anyway.
         CSpentIndexValue spentInfo;
-        bool found = TransactionSearchIndexes::GetSpentIndex(&blockTree, CSpentIndexKey(txid, i), spentInfo);
+        bool found = TransactionSearchIndexes::GetSpentIndex(&searchIndexes, CSpentIndexKey(txid, i), spentInfo);
         if (!found)
-          found = TransactionSearchIndexes::GetSpentIndex(&blockTree, CSpentIndexKey(tx.GetBareTxid(), i), spentInfo);
+          found = TransactionSearchIndexes::GetSpentIndex(&searchIndexes, CSpentIndexKey(tx.GetBareTxid(), i), spentInfo);
         if (found) {
             out.push_back(Pair("spentTxId", spentInfo.txid.GetHex()));
             out.push_back(Pair("spentIndex", (int)spentInfo.inputIndex));
@@ -136,7 +140,7 @@ void TxToJSONExpanded(const CTransaction& tx, const uint256 hashBlock, Object& e
 
 }
 
-Value getrawtransaction(const Array& params, bool fHelp, CWallet* pwallet)
+JsonProducer streamgetrawtransaction(const Array& params, bool fHelp, CWallet* pwallet)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
         throw runtime_error(
@@ -206,27 +210,28 @@ Value getrawtransaction(const Array& params, bool fHelp, CWallet* pwallet)
     if (params.size() > 1)
         fVerbose = (params[1].get_int() != 0);
 
-    CTransaction tx;
-    uint256 hashBlock = 0;
-    int nHeight = 0;
-    int nConfirmations = 0;
-    int nBlockTime = 0;
+    const std::shared_ptr<const ChainStateSnapshot> chainSnapshot = ChainStateSnapshot::Current();
+    const uint256 chainTip = chainSnapshot->Tip()? chainSnapshot->Tip()->GetBlockHash(): uint256(0);
+    const RenderedResponseCache::Format format = fVerbose? RenderedResponseCache::TRANSACTION_JSON: RenderedResponseCache::TRANSACTION_HEX;
+    RenderedResponseCache& cache = GetRenderedResponseCache();
+
+    std::shared_ptr<const std::string> rendered = cache.Get(hash, format, chainTip);
+    if (!rendered) {
+        CTransaction tx;
+        uint256 hashBlock = 0;
+        int nHeight = 0;
+        int nConfirmations = 0;
+        int nBlockTime = 0;
 
-    {
-        LOCK(cs_main);
         if (!GetTransaction(hash, tx, hashBlock, true))
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available about transaction");
 
         const ChainstateManager::Reference chainstate;
-        const auto& chain = chainstate->ActiveChain();
-        const auto& blockMap = chainstate->GetBlockMap();
-
-        const auto mi = blockMap.find(hashBlock);
-        if (mi != blockMap.end() && (*mi).second) {
-            CBlockIndex* pindex = (*mi).second;
-            if (chain.Contains(pindex)) {
+        const CBlockIndex* pindex = chainstate->GetBlockMap().FindWithoutMainLock(hashBlock);
+        if (pindex) {
+            if (chainSnapshot->Contains(pindex)) {
                 nHeight = pindex->nHeight;
-                nConfirmations = 1 + chain.Height() - pindex->nHeight;
+                nConfirmations = 1 + chainSnapshot->Height() - pindex->nHeight;
                 nBlockTime = pindex->GetBlockTime();
             } else {
                 nHeight = -1;
@@ -234,17 +239,30 @@ Value getrawtransaction(const Array& params, bool fHelp, CWallet* pwallet)
                 nBlockTime = pindex->GetBlockTime();
             }
         }
-    }
 
-    string strHex = EncodeHexTx(tx);
+        string strHex = EncodeHexTx(tx);
+        if (fVerbose) {
+            Object result;
+            result.push_back(Pair("hex", strHex));
+            TxToJSONExpanded(tx, hashBlock, result, nHeight, nConfirmations, nBlockTime);
+            rendered = std::make_shared<const std::string>(write_string(Value(result), false));
+        } else {
+            rendered = std::make_shared<const std::string>(strHex);
+        }
+
+        // Mempool transactions are left out, their rendering changes once they are mined
+        if (nConfirmations > 0)
+            cache.Insert(hash, format, chainTip, rendered);
+    }
 
     if (!fVerbose)
-        return strHex;
+        return [rendered](I_JsonWriter& writer) { writer.Write(*rendered); };
+    return [rendered](I_JsonWriter& writer) { writer.WriteRaw(*rendered); };
+}
 
-    Object result;
-    result.push_back(Pair("hex", strHex));
-    TxToJSONExpanded(tx, hashBlock, result, nHeight, nConfirmations, nBlockTime);
-    return result;
+Value getrawtransaction(const Array& params, bool fHelp, CWallet* pwallet)
+{
+    return BuildJsonValue(streamgetrawtransaction(params, fHelp, pwallet));
 }
 
 #ifdef ENABLE_WALLET
@@ -21,8 +21,11 @@
 #include <random.h>
 #include <alert.h>
 #include <Warnings.h>
+#include <RpcBatchExecutor.h>
+#include <JsonStreamWriter.h>
 
 #include <deque>
+#include <set>
 
 #include "json/json_spirit_writer_template.h"
 #include <boost/algorithm/string.hpp>
@@ -47,6 +50,7 @@ extern json_spirit::Value ping(const json_spirit::Array& params, bool fHelp, CWa
 extern json_spirit::Value addnode(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getaddednodeinfo(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getnettotals(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
+extern json_spirit::Value getmessagestats(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getnetworkinfo(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 
 extern json_spirit::Value importprivkey(const json_spirit::Array& params, bool fHelp, CWallet* pwallet); // in rpcdump.cpp
@@ -100,6 +104,7 @@ extern json_spirit::Value getwalletinfo(const json_spirit::Array& params, bool f
 extern json_spirit::Value loadwallet(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 
 extern json_spirit::Value getrawtransaction(const json_spirit::Array& params, bool fHelp, CWallet* pwallet); // in rcprawtransaction.cpp
+extern JsonProducer streamgetrawtransaction(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value listunspent(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value createrawtransaction(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value decoderawtransaction(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
@@ -114,15 +119,20 @@ extern json_spirit::Value getblockcount(const json_spirit::Array& params, bool f
 extern json_spirit::Value getbestblockhash(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getdifficulty(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getrawmempool(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
+extern JsonProducer streamgetrawmempool(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getblockhash(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getblock(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
+extern JsonProducer streamgetblock(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getblockheader(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
+extern JsonProducer streamgetblockheader(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value gettxoutsetinfo(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value gettxout(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value verifychain(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getblockchaininfo(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getchaintips(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getmempoolinfo(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
+extern json_spirit::Value getresponsecacheinfo(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
+extern json_spirit::Value getindexinfo(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value reverseblocktransactions(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value invalidateblock(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value reconsiderblock(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
@@ -151,6 +161,7 @@ extern json_spirit::Value verifymessage(const json_spirit::Array& params, bool f
 extern json_spirit::Value setmocktime(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getaddresstxids(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getaddressdeltas(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
+extern JsonProducer streamgetaddressdeltas(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getaddressbalance(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getspentinfo(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 extern json_spirit::Value getaddressutxos(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
@@ -323,149 +334,171 @@ Value stop(const Array& params, bool fHelp, CWallet* pwallet)
  */
 static const CRPCCommand vRPCCommands[] =
     {
-        //  category              name                      actor (function)         okSafeMode threadSafe requiresWalletLock requiresWalletInstance
-        //  --------------------- ------------------------  -----------------------  ---------- ---------- ------------------ ----------------------
+        //  category              name                      actor (function)         okSafeMode threadSafe requiresWalletLock requiresWalletInstance readOnly
+        //  (threadSafe commands run without cs_main; chain reads among them go through ChainStateSnapshot)
+        //  (readOnly commands are threadSafe and free of side effects, so the calls of a batch may run them in parallel)
+        //  --------------------- ------------------------  -----------------------  ---------- ---------- ------------------ ---------------------- --------
         /* Overall control/query calls */
-        {"control", "getinfo", &getinfo, true, false, false,false}, /* uses wallet if enabled */
-        {"control", "help", &help, true, true, false,false},
-        {"control", "stop", &stop, true, true, false,false},
+        {"control", "getinfo", &getinfo, true, false, false,false, false}, /* uses wallet if enabled */
+        {"control", "help", &help, true, true, false,false, true},
+        {"control", "stop", &stop, true, true, false,false, false},
 
         /* P2P networking */
-        {"network", "getnetworkinfo", &getnetworkinfo, true, false, false,false},
-        {"network", "addnode", &addnode, true, true, false,false},
-        {"network", "getaddednodeinfo", &getaddednodeinfo, true, true, false,false},
-        {"network", "getconnectioncount", &getconnectioncount, true, false, false, false},
-        {"network", "getnettotals", &getnettotals, true, true, false, false},
-        {"network", "getpeerinfo", &getpeerinfo, true, false, false, false},
-        {"network", "ping", &ping, true, false, false, false},
+        {"network", "getnetworkinfo", &getnetworkinfo, true, false, false,false, false},
+        {"network", "addnode", &addnode, true, true, false,false, false},
+        {"network", "getaddednodeinfo", &getaddednodeinfo, true, true, false,false, false},
+        {"network", "getconnectioncount", &getconnectioncount, true, false, false, false, false},
+        {"network", "getnettotals", &getnettotals, true, true, false, false, true},
+        {"network", "getmessagestats", &getmessagestats, true, true, false, false, true},
+        {"network", "getpeerinfo", &getpeerinfo, true, false, false, false, false},
+        {"network", "ping", &ping, true, false, false, false, false},
 
         /* Block chain and UTXO */
-        {"blockchain", "getblockchaininfo", &getblockchaininfo, true, false, false, false},
-        {"blockchain", "getbestblockhash", &getbestblockhash, true, false, false, false},
-        {"blockchain", "getblockcount", &getblockcount, true, false, false, false},
-        {"blockchain", "getlotteryblockwinners", &getlotteryblockwinners, true, false, false, false},
-        {"blockchain", "getblock", &getblock, true, false, false, false},
-        {"blockchain", "getblockhash", &getblockhash, true, false, false, false},
-        {"blockchain", "getblockheader", &getblockheader, false, false, false, false},
-        {"blockchain", "getchaintips", &getchaintips, true, false, false, false},
-        {"blockchain", "getdifficulty", &getdifficulty, true, false, false, false},
-        {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false, false},
-        {"blockchain", "getrawmempool", &getrawmempool, true, false, false, false},
-        {"blockchain", "gettxout", &gettxout, true, false, false, false},
-        {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false, false},
-        {"blockchain", "verifychain", &verifychain, true, false, false, false},
-        {"blockchain", "reverseblocktransactions", &reverseblocktransactions, true, false, false, false},
-        {"blockchain", "invalidateblock", &invalidateblock, true, false, false, false},
-        {"blockchain", "reconsiderblock", &reconsiderblock, true, false, false, false},
-        {"getinvalid", "getinvalid", &getinvalid, true, true, false, false},
+        {"blockchain", "getblockchaininfo", &getblockchaininfo, true, true, false, false, true},
+        {"blockchain", "getbestblockhash", &getbestblockhash, true, true, false, false, true},
+        {"blockchain", "getblockcount", &getblockcount, true, true, false, false, true},
+        {"blockchain", "getlotteryblockwinners", &getlotteryblockwinners, true, false, false, false, false},
+        {"blockchain", "getblock", &getblock, true, true, false, false, true},
+        {"blockchain", "getblockhash", &getblockhash, true, true, false, false, true},
+        {"blockchain", "getblockheader", &getblockheader, false, true, false, false, true},
+        {"blockchain", "getchaintips", &getchaintips, true, false, false, false, false},
+        {"blockchain", "getdifficulty", &getdifficulty, true, true, false, false, true},
+        {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false, false, true},
+        {"blockchain", "getresponsecacheinfo", &getresponsecacheinfo, true, true, false, false, true},
+        {"blockchain", "getindexinfo", &getindexinfo, true, true, false, false, true},
+        {"blockchain", "getrawmempool", &getrawmempool, true, false, false, false, false},
+        {"blockchain", "gettxout", &gettxout, true, false, false, false, false},
+        {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false, false, false},
+        {"blockchain", "verifychain", &verifychain, true, false, false, false, false},
+        {"blockchain", "reverseblocktransactions", &reverseblocktransactions, true, false, false, false, false},
+        {"blockchain", "invalidateblock", &invalidateblock, true, false, false, false, false},
+        {"blockchain", "reconsiderblock", &reconsiderblock, true, false, false, false, false},
+        {"getinvalid", "getinvalid", &getinvalid, true, true, false, false, true},
 
         /* Mining */
-        {"mining", "getmininginfo", &getmininginfo, true, false, false, false},
-        {"mining", "prioritisetransaction", &prioritisetransaction, true, false, false, false},
+        {"mining", "getmininginfo", &getmininginfo, true, false, false, false, false},
+        {"mining", "prioritisetransaction", &prioritisetransaction, true, false, false, false, false},
 
 #ifdef ENABLE_WALLET
         /* Coin generation */
-        {"generating", "setgenerate", &setgenerate, true, true, false, true},
-        {"generating", "generateblock", &generateblock, true, true, false, true},
+        {"generating", "setgenerate", &setgenerate, true, true, false, true, false},
+        {"generating", "generateblock", &generateblock, true, true, false, true, false},
 #endif
 
         /* Raw transactions */
-        {"rawtransactions", "createrawtransaction", &createrawtransaction, true, false, false, false},
-        {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true, false, false, false},
-        {"rawtransactions", "decodescript", &decodescript, true, false, false, false},
-        {"rawtransactions", "getrawtransaction", &getrawtransaction, true, false, false, false},
-        {"rawtransactions", "sendrawtransaction", &sendrawtransaction, false, false, false, false},
-        {"rawtransactions", "signtransactionwithaddresskey", &signtransactionwithaddresskey, false, false, false, true},
-        {"rawtransactions", "signrawtransaction", &signrawtransaction, false, false, false, false}, /* uses wallet if enabled */
+        {"rawtransactions", "createrawtransaction", &createrawtransaction, true, false, false, false, false},
+        {"rawtransactions", "decoderawtransaction", &decoderawtransaction, true, false, false, false, false},
+        {"rawtransactions", "decodescript", &decodescript, true, false, false, false, false},
+        {"rawtransactions", "getrawtransaction", &getrawtransaction, true, true, false, false, true},
+        {"rawtransactions", "sendrawtransaction", &sendrawtransaction, false, false, false, false, false},
+        {"rawtransactions", "signtransactionwithaddresskey", &signtransactionwithaddresskey, false, false, false, true, false},
+        {"rawtransactions", "signrawtransaction", &signrawtransaction, false, false, false, false, false}, /* uses wallet if enabled */
 
         /* Utility functions */
-        {"util", "createmultisig", &createmultisig, true, true, false, false},
-        {"util", "validateaddress", &validateaddress, true, false, false, false}, /* uses wallet if enabled */
-        {"util", "verifymessage", &verifymessage, true, false, false, false},
+        {"util", "createmultisig", &createmultisig, true, true, false, false, true},
+        {"util", "validateaddress", &validateaddress, true, false, false, false, false}, /* uses wallet if enabled */
+        {"util", "verifymessage", &verifymessage, true, false, false, false, false},
 
         /* Not shown in help */
-        {"hidden", "invalidateblock", &invalidateblock, true, false, false, false},
-        {"hidden", "reconsiderblock", &reconsiderblock, true, false, false, false},
-        {"hidden", "setmocktime", &setmocktime, true, false, false, false},
+        {"hidden", "invalidateblock", &invalidateblock, true, false, false, false, false},
+        {"hidden", "reconsiderblock", &reconsiderblock, true, false, false, false, false},
+        {"hidden", "setmocktime", &setmocktime, true, false, false, false, false},
 
         /* Divi features */
-		{ "divi", "allocatefunds", &allocatefunds, true, true, false, true},
-		{"divi", "listmasternodes", &listmasternodes, true, true, false, false},
-        {"divi", "getmasternodecount", &getmasternodecount, true, true, false,false},
-        {"divi","setupmasternode",&setupmasternode,true,false,true,true},
-        {"divi","signmnbroadcast",&signmnbroadcast,true,false,true,true},
-        {"divi","verifymasternodesetup",&verifymasternodesetup,true,true,true, false},
-        {"divi", "broadcaststartmasternode", &broadcaststartmasternode, true, true, false, false},
-        {"divi", "startmasternode", &startmasternode, true, true, false, true},
-        {"divi", "getmasternodestatus", &getmasternodestatus, true, true, false, false},
-        {"divi", "getmasternodewinners", &getmasternodewinners, true, true, false, false},
-        {"divi", "importmnbroadcast", &importmnbroadcast, true, false, false, false},
-        {"divi", "listmnbroadcasts", &listmnbroadcasts, true, false, false, false},
-
-        {"divi", "mnsync", &mnsync, true, true, false, false},
-        {"divi", "spork", &spork, true, true, false, false},
-        {"divi","ban",&ban,false,false,false, false},
-        {"divi","clearbanned",&clearbanned,false,false,false, false},
-        {"divi","listbanned",&listbanned,false,false,false, false},
+		{ "divi", "allocatefunds", &allocatefunds, true, true, false, true, false},
+		{"divi", "listmasternodes", &listmasternodes, true, true, false, false, true},
+        {"divi", "getmasternodecount", &getmasternodecount, true, true, false,false, true},
+        {"divi","setupmasternode",&setupmasternode,true,false,true,true, false},
+        {"divi","signmnbroadcast",&signmnbroadcast,true,false,true,true, false},
+        {"divi","verifymasternodesetup",&verifymasternodesetup,true,true,true, false, false},
+        {"divi", "broadcaststartmasternode", &broadcaststartmasternode, true, true, false, false, false},
+        {"divi", "startmasternode", &startmasternode, true, true, false, true, false},
+        {"divi", "getmasternodestatus", &getmasternodestatus, true, true, false, false, true},
+        {"divi", "getmasternodewinners", &getmasternodewinners, true, true, false, false, true},
+        {"divi", "importmnbroadcast", &importmnbroadcast, true, false, false, false, false},
+        {"divi", "listmnbroadcasts", &listmnbroadcasts, true, false, false, false, false},
+
+        {"divi", "mnsync", &mnsync, true, true, false, false, false},
+        {"divi", "spork", &spork, true, true, false, false, false},
+        {"divi","ban",&ban,false,false,false, false, false},
+        {"divi","clearbanned",&clearbanned,false,false,false, false, false},
+        {"divi","listbanned",&listbanned,false,false,false, false, false},
 
         /* address index */
-        { "addressindex", "getaddresstxids", &getaddresstxids, false, false, false, false },
-        { "addressindex", "getaddressdeltas", &getaddressdeltas, false, false, false, false },
-        { "addressindex", "getaddressbalance", &getaddressbalance, false, false, false, false },
-        { "addressindex", "getaddressutxos", &getaddressutxos, false, false, false, false },
+        { "addressindex", "getaddresstxids", &getaddresstxids, false, false, false, false, false },
+        { "addressindex", "getaddressdeltas", &getaddressdeltas, false, false, false, false, false },
+        { "addressindex", "getaddressbalance", &getaddressbalance, false, false, false, false, false },
+        { "addressindex", "getaddressutxos", &getaddressutxos, false, false, false, false, false },
 
-        { "blockchain", "getspentinfo", &getspentinfo, false, false, false, false },
+        { "blockchain", "getspentinfo", &getspentinfo, false, false, false, false, false },
 
 #ifdef ENABLE_WALLET
-        {"wallet", "addmultisigaddress", &addmultisigaddress, true, false, true, true},
-        {"wallet", "backupwallet", &backupwallet, true, false, true, true},
-        {"wallet", "dumpprivkey", &dumpprivkey, true, false, true, true},
-        {"wallet", "dumphdinfo", &dumphdinfo, true, false, true, true},
-        {"wallet", "bip38paperwallet", &bip38paperwallet, true, false, true, true},
-        {"wallet", "bip38decrypt", &bip38decrypt, true, false, true, true},
-        {"wallet", "encryptwallet", &encryptwallet, true, false, true, true},
-        {"wallet", "getaccountaddress", &getaccountaddress, true, false, true, true},
-        {"wallet", "getaccount", &getaccount, true, false, true, true},
-        {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, false, true, true},
-        {"wallet", "getbalance", &getbalance, false, false, true, true},
-        {"wallet", "getnewaddress", &getnewaddress, true, false, true, true},
-        {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, false, true, true},
-        {"wallet", "getreceivedbyaccount", &getreceivedbyaccount, false, false, true, true},
-        {"wallet", "getreceivedbyaddress", &getreceivedbyaddress, false, false, true, true},
-        {"wallet", "getstakingstatus", &getstakingstatus, false, false, true, true},
-        {"wallet", "gettransaction", &gettransaction, false, false, true, true},
-        {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, false, true, true},
-        {"wallet", "getwalletinfo", &getwalletinfo, false, false, true, true},
-        {"wallet", "loadwallet", &loadwallet, true, false, true, true},
-        {"wallet", "importprivkey", &importprivkey, true, false, true, true},
-        {"wallet", "importaddress", &importaddress, true, false, true, true},
-        {"wallet", "keypoolrefill", &keypoolrefill, true, false, true, true},
-        {"wallet", "listaccounts", &listaccounts, false, false, true, true},
-        {"wallet", "listlockunspent", &listlockunspent, false, false, true, true},
-        {"wallet", "listreceivedbyaccount", &listreceivedbyaccount, false, false, true, true},
-        {"wallet", "listreceivedbyaddress", &listreceivedbyaddress, false, false, true, true},
-        {"wallet", "listsinceblock", &listsinceblock, false, false, true, true},
-        {"wallet", "listtransactions", &listtransactions, false, false, true, true},
-        {"wallet", "listunspent", &listunspent, false, false, true, true},
-        {"wallet", "lockunspent", &lockunspent, true, false, true, true},
-        {"wallet", "sendfrom", &sendfrom, false, false, true, true},
-        {"wallet", "sendmany", &sendmany, false, false, true, true},
-        {"wallet", "sendtoaddress", &sendtoaddress, false, false, true, true},
-        {"wallet", "fundvault", &fundvault, false, false, true, true},
-        {"wallet", "reclaimvaultfunds", &reclaimvaultfunds, false, false, true, true},
-        {"wallet", "debitvaultbyname", &debitvaultbyname, false, false, true, true},
-        {"wallet", "removevault", &removevault, false, false, true, true},
-        {"wallet", "addvault", &addvault, false, false, true, true},
-        {"wallet", "getcoinavailability", &getcoinavailability, false, false, true, true},
-        {"wallet", "setaccount", &setaccount, true, false, true, true},
-        {"wallet", "signmessage", &signmessage, true, false, true, true},
-        {"wallet", "walletlock", &walletlock, true, false, true, true},
-        {"wallet", "walletpassphrasechange", &walletpassphrasechange, true, false, true, true},
-        {"wallet", "walletpassphrase", &walletpassphrase, true, false, true, true},
+        {"wallet", "addmultisigaddress", &addmultisigaddress, true, false, true, true, false},
+        {"wallet", "backupwallet", &backupwallet, true, false, true, true, false},
+        {"wallet", "dumpprivkey", &dumpprivkey, true, false, true, true, false},
+        {"wallet", "dumphdinfo", &dumphdinfo, true, false, true, true, false},
+        {"wallet", "bip38paperwallet", &bip38paperwallet, true, false, true, true, false},
+        {"wallet", "bip38decrypt", &bip38decrypt, true, false, true, true, false},
+        {"wallet", "encryptwallet", &encryptwallet, true, false, true, true, false},
+        {"wallet", "getaccountaddress", &getaccountaddress, true, false, true, true, false},
+        {"wallet", "getaccount", &getaccount, true, false, true, true, false},
+        {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, false, true, true, false},
+        {"wallet", "getbalance", &getbalance, false, false, true, true, false},
+        {"wallet", "getnewaddress", &getnewaddress, true, false, true, true, false},
+        {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, false, true, true, false},
+        {"wallet", "getreceivedbyaccount", &getreceivedbyaccount, false, false, true, true, false},
+        {"wallet", "getreceivedbyaddress", &getreceivedbyaddress, false, false, true, true, false},
+        {"wallet", "getstakingstatus", &getstakingstatus, false, false, true, true, false},
+        {"wallet", "gettransaction", &gettransaction, false, false, true, true, false},
+        {"wallet", "getunconfirmedbalance", &getunconfirmedbalance, false, false, true, true, false},
+        {"wallet", "getwalletinfo", &getwalletinfo, false, false, true, true, false},
+        {"wallet", "loadwallet", &loadwallet, true, false, true, true, false},
+        {"wallet", "importprivkey", &importprivkey, true, false, true, true, false},
+        {"wallet", "importaddress", &importaddress, true, false, true, true, false},
+        {"wallet", "keypoolrefill", &keypoolrefill, true, false, true, true, false},
+        {"wallet", "listaccounts", &listaccounts, false, false, true, true, false},
+        {"wallet", "listlockunspent", &listlockunspent, false, false, true, true, false},
+        {"wallet", "listreceivedbyaccount", &listreceivedbyaccount, false, false, true, true, false},
+        {"wallet", "listreceivedbyaddress", &listreceivedbyaddress, false, false, true, true, false},
+        {"wallet", "listsinceblock", &listsinceblock, false, false, true, true, false},
+        {"wallet", "listtransactions", &listtransactions, false, false, true, true, false},
+        {"wallet", "listunspent", &listunspent, false, false, true, true, false},
+        {"wallet", "lockunspent", &lockunspent, true, false, true, true, false},
+        {"wallet", "sendfrom", &sendfrom, false, false, true, true, false},
+        {"wallet", "sendmany", &sendmany, false, false, true, true, false},
+        {"wallet", "sendtoaddress", &sendtoaddress, false, false, true, true, false},
+        {"wallet", "fundvault", &fundvault, false, false, true, true, false},
+        {"wallet", "reclaimvaultfunds", &reclaimvaultfunds, false, false, true, true, false},
+        {"wallet", "debitvaultbyname", &debitvaultbyname, false, false, true, true, false},
+        {"wallet", "removevault", &removevault, false, false, true, true, false},
+        {"wallet", "addvault", &addvault, false, false, true, true, false},
+        {"wallet", "getcoinavailability", &getcoinavailability, false, false, true, true, false},
+        {"wallet", "setaccount", &setaccount, true, false, true, true, false},
+        {"wallet", "signmessage", &signmessage, true, false, true, true, false},
+        {"wallet", "walletlock", &walletlock, true, false, true, true, false},
+        {"wallet", "walletpassphrasechange", &walletpassphrasechange, true, false, true, true, false},
+        {"wallet", "walletpassphrase", &walletpassphrase, true, false, true, true, false},
 
 #endif // ENABLE_WALLET
 };
 
+/**
+ * Commands that can also write their result straight to the connection, so large
+ * results are never held in memory as a whole. Each needs an entry in vRPCCommands,
+ * which still serves batches, help and the other callers.
+ */
+static const struct {
+    const char* name;
+    streamingrpcfn_type actor;
+} vStreamingRPCCommands[] =
+    {
+        {"getblock", &streamgetblock},
+        {"getblockheader", &streamgetblockheader},
+        {"getrawtransaction", &streamgetrawtransaction},
+        {"getrawmempool", &streamgetrawmempool},
+        {"getaddressdeltas", &streamgetaddressdeltas},
+};
+
 CRPCTable::CRPCTable()
 {
     unsigned int vcidx;
@@ -473,8 +506,13 @@ CRPCTable::CRPCTable()
         const CRPCCommand* pcmd;
 
         pcmd = &vRPCCommands[vcidx];
+        assert(!pcmd->readOnly || pcmd->threadSafe);
         mapCommands[pcmd->name] = pcmd;
     }
+    for (vcidx = 0; vcidx < (sizeof(vStreamingRPCCommands) / sizeof(vStreamingRPCCommands[0])); vcidx++) {
+        assert(mapCommands.count(vStreamingRPCCommands[vcidx].name) > 0);
+        mapStreamingCommands[vStreamingRPCCommands[vcidx].name] = vStreamingRPCCommands[vcidx].actor;
+    }
 }
 
 const CRPCCommand* CRPCTable::operator[](string name) const
@@ -924,19 +962,58 @@ static Object JSONRPCExecOne(const Value& req)
     return rpc_result;
 }
 
+static bool JSONRPCCanRunConcurrently(const Value& req)
+{
+    if (req.type() != obj_type)
+        return false;
+    const Value& valMethod = find_value(req.get_obj(), "method");
+    if (valMethod.type() != str_type)
+        return false;
+    const CRPCCommand* pcmd = CRPCTable::getRPCTable()[valMethod.get_str()];
+    return pcmd && pcmd->readOnly;
+}
+
+static void PostRPCTask(const boost::function<void()>& task)
+{
+    if (rpc_io_service)
+        rpc_io_service->post(task);
+}
+
 static string JSONRPCExecBatch(const Array& vReq)
 {
-    Array ret;
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    // Read-only thread-safe calls are spread over the RPC worker threads, the rest run serially in order
+    const int64_t maxConcurrency = settings.GetArg("-rpcbatchthreads", settings.GetArg("-rpcthreads", 4));
+    const RpcBatchExecutor executor(&JSONRPCExecOne, &JSONRPCCanRunConcurrently, &PostRPCTask, std::max<int64_t>(maxConcurrency, 1));
+    Array ret = executor.Execute(vReq);
 
     return write_string(Value(ret), false) + "\n";
 }
 
+static bool StreamJSONRPCReply(AcceptedConnection* conn, const JsonProducer& producer, const Value& id, bool fRun, bool fChunked)
+{
+    HTTPStreamedReply reply(conn->stream(), HTTP_OK, fRun, fChunked);
+    try {
+        JsonStreamWriter writer(reply.Body());
+        writer.BeginObject();
+        writer.Key("result");
+        producer(writer);
+        writer.WriteField("error", Value::null);
+        writer.WriteField("id", id);
+        writer.EndObject();
+        reply.Body() << "\n";
+    } catch (std::exception& e) {
+        // Part of the reply may be on the wire already; dropping the connection is all that is left
+        LogPrintf("%s: Error: %s\n", __func__, e.what());
+        return false;
+    }
+    return reply.Finish();
+}
+
 static bool HTTPReq_JSONRPC(AcceptedConnection* conn,
     string& strRequest,
     map<string, string>& mapHeaders,
-    bool fRun)
+    bool fRun,
+    bool fChunked)
 {
     // Check authorization
     if (mapHeaders.count("authorization") == 0) {
@@ -975,6 +1052,10 @@ static bool HTTPReq_JSONRPC(AcceptedConnection* conn,
         if (valRequest.type() == obj_type) {
             jreq.parse(valRequest);
 
+            const JsonProducer producer = CRPCTable::getRPCTable().prepareStreaming(jreq.strMethod, jreq.params);
+            if (producer)
+                return StreamJSONRPCReply(conn, producer, jreq.id, fRun, fChunked);
+
             Value result = CRPCTable::getRPCTable().execute(jreq.strMethod, jreq.params);
 
             // Send reply
@@ -1016,14 +1097,17 @@ void ServiceConnection(AcceptedConnection* conn)
         if ((mapHeaders["connection"] == "close") || (!settings.GetBoolArg("-rpckeepalive", true)))
             fRun = false;
 
+        // Large replies are streamed to clients that understand chunked transfer encoding
+        const bool fChunked = nProto >= 1;
+
         // Process via JSON-RPC API
         if (strURI == "/") {
-            if (!HTTPReq_JSONRPC(conn, strRequest, mapHeaders, fRun))
+            if (!HTTPReq_JSONRPC(conn, strRequest, mapHeaders, fRun, fChunked))
                 break;
 
             // Process via HTTP REST API
         } else if (strURI.substr(0, 6) == "/rest/" && settings.GetBoolArg("-rest", false)) {
-            if (!HTTPReq_REST(&RPCIsInWarmup,conn, strURI, mapHeaders, fRun))
+            if (!HTTPReq_REST(&RPCIsInWarmup,conn, strURI, mapHeaders, fRun, fChunked))
                 break;
 
         } else {
@@ -1033,6 +1117,14 @@ void ServiceConnection(AcceptedConnection* conn)
     }
 }
 
+static void ObserveSafeMode(const CRPCCommand* pcmd)
+{
+    string strWarning = GetWarningMessage("rpc");
+    if (strWarning != "" && !settings.GetBoolArg("-disablesafemode", false) &&
+        !pcmd->okSafeMode)
+        throw JSONRPCError(RPC_FORBIDDEN_BY_SAFE_MODE, string("Safe mode: ") + strWarning);
+}
+
 json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_spirit::Array& params) const
 {
     // Find method
@@ -1047,11 +1139,7 @@ json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_s
         throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method unavailable due to manually disabled wallet");
 #endif
 
-    // Observe safe mode
-    string strWarning = GetWarningMessage("rpc");
-    if (strWarning != "" && !settings.GetBoolArg("-disablesafemode", false) &&
-        !pcmd->okSafeMode)
-        throw JSONRPCError(RPC_FORBIDDEN_BY_SAFE_MODE, string("Safe mode: ") + strWarning);
+    ObserveSafeMode(pcmd);
 
     try {
         // Execute
@@ -1109,6 +1197,27 @@ json_spirit::Value CRPCTable::execute(const std::string& strMethod, const json_s
     }
 }
 
+JsonProducer CRPCTable::prepareStreaming(const std::string& strMethod, const json_spirit::Array& params) const
+{
+    const auto it = mapStreamingCommands.find(strMethod);
+    if (it == mapStreamingCommands.end())
+        return JsonProducer();
+    const CRPCCommand* pcmd = CRPCTable::getRPCTable()[strMethod];
+    assert(!pcmd->requiresWalletLock && !pcmd->requiresWalletInstance);
+
+    ObserveSafeMode(pcmd);
+
+    try {
+        // Only the preparation runs under cs_main; the producer works on what it gathered
+        if (pcmd->threadSafe)
+            return it->second(params, false, GetWallet());
+        LOCK(cs_main);
+        return it->second(params, false, GetWallet());
+    } catch (std::exception& e) {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
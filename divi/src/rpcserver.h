@@ -20,6 +20,7 @@
 #include "json/json_spirit_utils.h"
 #include "json/json_spirit_writer_template.h"
 #include <JsonParseHelpers.h>
+#include <I_JsonWriter.h>
 
 class CBlockIndex;
 class CNetAddr;
@@ -69,6 +70,8 @@ CNetAddr BoostAsioToCNetAddr(boost::asio::ip::address address);
 
 class CWallet;
 typedef json_spirit::Value (*rpcfn_type)(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
+/** Validates the call and gathers what it needs; the returned producer writes the result */
+typedef JsonProducer (*streamingrpcfn_type)(const json_spirit::Array& params, bool fHelp, CWallet* pwallet);
 
 class CRPCCommand
 {
@@ -80,6 +83,7 @@ public:
     bool threadSafe;
     bool requiresWalletLock;
     bool requiresWalletInstance;
+    bool readOnly;
 };
 
 /**
@@ -89,6 +93,7 @@ class CRPCTable
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands;
+    std::map<std::string, streamingrpcfn_type> mapStreamingCommands;
     CRPCTable();
 
 public:
@@ -104,6 +109,15 @@ public:
      */
     json_spirit::Value execute(const std::string& method, const json_spirit::Array& params) const;
 
+    /**
+     * Prepare a method whose result can be sent while it is being produced.
+     * @param method   Method to execute
+     * @param params   Array of arguments (JSON objects)
+     * @returns The producer of the result, or an empty one if the method has no streaming form.
+     * @throws an exception (json_spirit::Value) when an error happens before anything is produced.
+     */
+    JsonProducer prepareStreaming(const std::string& method, const json_spirit::Array& params) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -2884,7 +2884,12 @@ Value getwalletinfo(const Array& params, bool fHelp, CWallet* pwallet)
                 "  \"keypoololdest\": xxxxxx,    (numeric) the timestamp (seconds since GMT epoch) of the oldest pre-generated key in the key pool\n"
                 "  \"keypoolsize\": xxxx,        (numeric) how many new keys are pre-generated\n"
                 "  \"unlocked_until\": ttt,      (numeric) the timestamp in seconds since epoch (midnight Jan 1 1970 GMT) that the wallet is unlocked for transfers, or 0 if the wallet is locked\n"
-                "  \"encryption_status\": status (string) encryption status, possible values: unencrypted/unlocked/locked/locked-anonymization"
+                "  \"encryption_status\": status (string) encryption status, possible values: unencrypted/unlocked/locked/locked-anonymization\n"
+                "  \"scanning\":                  (json object) current chain scan details, or false if no scan is in progress\n"
+                "    {\n"
+                "      \"duration\" : xxxx          (numeric) elapsed seconds since the scan started\n"
+                "      \"progress\" : x.xxxx,       (numeric) scanning progress percentage [0.0, 1.0]\n"
+                "    }\n"
                 "}\n"
                 "\nExamples:\n" +
                 HelpExampleCli("getwalletinfo", "") + HelpExampleRpc("getwalletinfo", ""));
@@ -2904,5 +2909,15 @@ Value getwalletinfo(const Array& params, bool fHelp, CWallet* pwallet)
         obj.push_back(Pair("unlocked_until", TimeTillWalletLock(pwallet) ));
 
     obj.push_back(Pair("encryption_status", DescribeEncryptionStatus(*pwallet)));
+    int rescanProgress = 0;
+    int64_t rescanStartTime = 0;
+    if (pwallet->GetRescanProgress(rescanProgress, rescanStartTime)) {
+        Object scanning;
+        scanning.push_back(Pair("duration", GetTime() - rescanStartTime));
+        scanning.push_back(Pair("progress", rescanProgress / 100.0));
+        obj.push_back(Pair("scanning", scanning));
+    } else {
+        obj.push_back(Pair("scanning", false));
+    }
     return obj;
 }
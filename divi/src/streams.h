@@ -283,7 +283,10 @@ public:
 
     void GetAndClear(CSerializeData& data)
     {
-        data.insert(data.end(), begin(), end());
+        if (data.empty() && nReadPos == 0)
+            data.swap(vch); // hand the buffer over rather than copying it
+        else
+            data.insert(data.end(), begin(), end());
         clear();
     }
 };
@@ -0,0 +1,93 @@
+#include <test/test_only.h>
+
+#include <ActiveChainHeightCache.h>
+#include <test/FakeBlockIndexChain.h>
+#include <blockmap.h>
+#include <chain.h>
+
+namespace
+{
+struct ActiveChainHeightCacheTestFixture
+{
+    FakeBlockIndexWithHashes fakeChain;
+    ActiveChainHeightCache cache;
+
+    ActiveChainHeightCacheTestFixture(
+        ): fakeChain(100u, 1600000000u, 4u)
+        , cache(*fakeChain.blockIndexByHash)
+    {
+        cache.updateTip(fakeChain.activeChain->Tip());
+    }
+
+    int chainDepth(const CBlockIndex* pindex) const
+    {
+        const CChain& chain = *fakeChain.activeChain;
+        return chain.Contains(pindex)? chain.Height() - pindex->nHeight + 1: 0;
+    }
+};
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(ActiveChainHeightCache_tests, ActiveChainHeightCacheTestFixture)
+
+BOOST_AUTO_TEST_CASE(agreesWithTheActiveChainOnDepths)
+{
+    const CChain& chain = *fakeChain.activeChain;
+    BOOST_CHECK_EQUAL(cache.tipHeight(), chain.Height());
+    for(int height = 0; height <= chain.Height(); ++height)
+    {
+        const std::pair<const CBlockIndex*,int> blockAndDepth = cache.findBlockAndDepth(chain[height]->GetBlockHash());
+        BOOST_CHECK(blockAndDepth.first == chain[height]);
+        BOOST_CHECK_EQUAL(blockAndDepth.second, chainDepth(chain[height]));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(doesNotFindUnknownBlocks)
+{
+    const std::pair<const CBlockIndex*,int> blockAndDepth = cache.findBlockAndDepth(uint256S("0x1234"));
+    BOOST_CHECK(blockAndDepth.first == nullptr);
+    BOOST_CHECK_EQUAL(blockAndDepth.second, 0);
+}
+
+BOOST_AUTO_TEST_CASE(deepensCachedBlocksAsTheChainGrows)
+{
+    const CBlockIndex* block = (*fakeChain.activeChain)[50];
+    BOOST_CHECK_EQUAL(cache.findBlockAndDepth(block->GetBlockHash()).second, 50);
+
+    fakeChain.addBlocks(5u, 4u);
+    cache.updateTip(fakeChain.activeChain->Tip());
+    BOOST_CHECK_EQUAL(cache.tipHeight(), 104);
+    BOOST_CHECK_EQUAL(cache.findBlockAndDepth(block->GetBlockHash()).second, 55);
+}
+
+BOOST_AUTO_TEST_CASE(dropsBlocksThatAReorganizationDisconnects)
+{
+    const CBlockIndex* oldTip = fakeChain.activeChain->Tip();
+    const CBlockIndex* forkPoint = oldTip->GetAncestor(oldTip->nHeight - 10);
+    BOOST_CHECK(cache.findBlockAndDepth(oldTip->GetBlockHash()).first == oldTip);
+    BOOST_CHECK(cache.findBlockAndDepth(forkPoint->GetBlockHash()).first == forkPoint);
+
+    fakeChain.fork(20u, 10u);
+    const CBlockIndex* newTip = fakeChain.activeChain->Tip();
+    BOOST_CHECK(cache.findBlockAndDepth(newTip->GetBlockHash()).first == nullptr);
+
+    cache.updateTip(newTip);
+    BOOST_CHECK(cache.findBlockAndDepth(oldTip->GetBlockHash()).first == nullptr);
+    BOOST_CHECK(cache.findBlockAndDepth(newTip->GetBlockHash()).first == newTip);
+    BOOST_CHECK_EQUAL(cache.findBlockAndDepth(newTip->GetBlockHash()).second, 1);
+    BOOST_CHECK_EQUAL(cache.findBlockAndDepth(forkPoint->GetBlockHash()).second, chainDepth(forkPoint));
+}
+
+BOOST_AUTO_TEST_CASE(forgetsEverythingWhenTheTipIsCleared)
+{
+    const CBlockIndex* tip = fakeChain.activeChain->Tip();
+    BOOST_CHECK(cache.findBlockAndDepth(tip->GetBlockHash()).first == tip);
+
+    cache.updateTip(nullptr);
+    BOOST_CHECK_EQUAL(cache.tipHeight(), -1);
+    BOOST_CHECK(cache.findBlockAndDepth(tip->GetBlockHash()).first == nullptr);
+
+    cache.updateTip(tip);
+    BOOST_CHECK(cache.findBlockAndDepth(tip->GetBlockHash()).first == tip);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
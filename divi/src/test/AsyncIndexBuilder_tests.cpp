@@ -0,0 +1,287 @@
+#include <test/test_only.h>
+
+#include <AsyncIndexBuilder.h>
+#include <ChainStateSnapshot.h>
+#include <I_BlockDataReader.h>
+#include <TransactionSearchIndexes.h>
+#include <blockmap.h>
+#include <chain.h>
+#include <primitives/block.h>
+#include <script/standard.h>
+#include <test/FakeBlockIndexChain.h>
+#include <txdb.h>
+#include <BlockUndo.h>
+#include <undo.h>
+
+#include <set>
+
+namespace
+{
+const uint160 minerAddress = uint160(1);
+const uint160 recipientAddress = uint160(2);
+
+CScript PayTo(const uint160& addressHash)
+{
+    return GetScriptForDestination(CKeyID(addressHash));
+}
+
+/** Every block past the genesis block has a coinbase paying the miner, and from
+ *  height 2 on a transaction moving the previous coinbase to the recipient */
+CTransaction CoinbaseOf(const CBlockIndex* blockIndex)
+{
+    CMutableTransaction coinbase;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << blockIndex->nHeight << ToByteVector(blockIndex->GetBlockHash());
+    coinbase.vout.push_back(CTxOut(100 * COIN, PayTo(minerAddress)));
+    return coinbase;
+}
+
+class FakeBlockDataReader final: public I_BlockDataReader
+{
+public:
+    bool ReadBlock(const CBlockIndex* blockIndex, CBlock& block) const override
+    {
+        block = CBlock();
+        block.vtx.push_back(CoinbaseOf(blockIndex));
+        if (blockIndex->pprev && blockIndex->pprev->pprev)
+        {
+            CMutableTransaction spend;
+            spend.vin.push_back(CTxIn(CoinbaseOf(blockIndex->pprev).GetHash(), 0u));
+            spend.vout.push_back(CTxOut(100 * COIN, PayTo(recipientAddress)));
+            block.vtx.push_back(spend);
+        }
+        return true;
+    }
+    bool ReadBlockUndo(const CBlockIndex* blockIndex, CBlockUndo& blockUndo) const override
+    {
+        blockUndo = CBlockUndo();
+        if (blockIndex->pprev && blockIndex->pprev->pprev)
+        {
+            CTxUndo spendUndo;
+            spendUndo.vprevout.push_back(CTxInUndo(CoinbaseOf(blockIndex->pprev).vout[0], true));
+            blockUndo.vtxundo.push_back(spendUndo);
+        }
+        return true;
+    }
+};
+
+struct AsyncIndexBuilderTestFixture
+{
+    FakeBlockIndexWithHashes fakeChain;
+    FakeBlockDataReader blockDataReader;
+    CSearchIndexDB searchIndexes;
+
+    AsyncIndexBuilderTestFixture(
+        ): fakeChain(10u, 1600000000u, 4u)
+        , blockDataReader()
+        , searchIndexes(1 << 20, true)
+    {
+    }
+
+    ChainStateSnapshot ActiveChain() const
+    {
+        return ChainStateSnapshot(fakeChain.activeChain->Tip(), fakeChain.activeChain->Tip());
+    }
+
+    static void SyncToTip(AsyncIndexBuilder& builder, const ChainStateSnapshot& chain)
+    {
+        bool caughtUp = false;
+        for (unsigned batches = 0; !caughtUp && batches < 100u; ++batches)
+            BOOST_REQUIRE(builder.SyncBatch(chain, caughtUp));
+        BOOST_REQUIRE(caughtUp);
+    }
+
+    static std::vector<std::pair<CAddressIndexKey, CAmount>> History(const CSearchIndexDB& indexes, const uint160& addressHash)
+    {
+        std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndex;
+        BOOST_REQUIRE(TransactionSearchIndexes::GetAddressIndex(&indexes, addressHash, 1, addressIndex));
+        return addressIndex;
+    }
+
+    static CAddressBalance Balance(const CSearchIndexDB& indexes, const uint160& addressHash)
+    {
+        CAddressBalance balance;
+        BOOST_REQUIRE(TransactionSearchIndexes::GetAddressBalance(&indexes, addressHash, 1, balance));
+        return balance;
+    }
+
+    /** What getaddressbalance used to compute by summing up the address history */
+    static CAddressBalance BalanceFromHistory(const CSearchIndexDB& indexes, const uint160& addressHash)
+    {
+        CAddressBalance balance;
+        std::set<uint256> transactions;
+        for (const auto& entry: History(indexes, addressHash))
+        {
+            balance.balance += entry.second;
+            if (entry.second > 0)
+                balance.received += entry.second;
+            transactions.insert(entry.first.txhash);
+        }
+        balance.txCount = transactions.size();
+        return balance;
+    }
+
+    static void CheckBalanceMatchesHistory(const CSearchIndexDB& indexes, const uint160& addressHash)
+    {
+        const CAddressBalance balance = Balance(indexes, addressHash);
+        const CAddressBalance expectedBalance = BalanceFromHistory(indexes, addressHash);
+        BOOST_CHECK_EQUAL(balance.balance, expectedBalance.balance);
+        BOOST_CHECK_EQUAL(balance.received, expectedBalance.received);
+        BOOST_CHECK_EQUAL(balance.txCount, expectedBalance.txCount);
+    }
+
+    static std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> Unspent(const CSearchIndexDB& indexes, const uint160& addressHash)
+    {
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> unspentOutputs;
+        BOOST_REQUIRE(TransactionSearchIndexes::GetAddressUnspent(&indexes, addressHash, 1, unspentOutputs));
+        return unspentOutputs;
+    }
+};
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(AsyncIndexBuilder_tests, AsyncIndexBuilderTestFixture)
+
+BOOST_AUTO_TEST_CASE(catchesUpWithTheChainInBatchesOfBlocks)
+{
+    AsyncIndexBuilder builder(searchIndexes, *fakeChain.blockIndexByHash, blockDataReader, true, true, 4u);
+    BOOST_REQUIRE(builder.Initialize());
+    BOOST_CHECK_EQUAL(builder.GetStatus().indexedHeight, -1);
+
+    const ChainStateSnapshot chain = ActiveChain();
+    bool caughtUp = true;
+    BOOST_CHECK(builder.SyncBatch(chain, caughtUp));
+    BOOST_CHECK(!caughtUp);
+    uint256 bestBlockHash;
+    BOOST_CHECK(searchIndexes.ReadBestBlockHash(bestBlockHash));
+    BOOST_CHECK(bestBlockHash == chain[3]->GetBlockHash());
+
+    BOOST_CHECK(builder.SyncBatch(chain, caughtUp));
+    BOOST_CHECK(!caughtUp);
+    BOOST_CHECK(builder.SyncBatch(chain, caughtUp));
+    BOOST_CHECK(caughtUp);
+    BOOST_CHECK(searchIndexes.ReadBestBlockHash(bestBlockHash));
+    BOOST_CHECK(bestBlockHash == chain.Tip()->GetBlockHash());
+
+    // 9 coinbases received by the miner, 8 of them moved on to the recipient
+    BOOST_CHECK_EQUAL(History(searchIndexes, minerAddress).size(), 17u);
+    BOOST_CHECK_EQUAL(Unspent(searchIndexes, minerAddress).size(), 1u);
+    BOOST_CHECK_EQUAL(Unspent(searchIndexes, recipientAddress).size(), 8u);
+
+    const CAddressBalance minerBalance = Balance(searchIndexes, minerAddress);
+    BOOST_CHECK_EQUAL(minerBalance.balance, 100 * COIN);
+    BOOST_CHECK_EQUAL(minerBalance.received, 900 * COIN);
+    BOOST_CHECK_EQUAL(minerBalance.txCount, 17);
+    const CAddressBalance recipientBalance = Balance(searchIndexes, recipientAddress);
+    BOOST_CHECK_EQUAL(recipientBalance.balance, 800 * COIN);
+    BOOST_CHECK_EQUAL(recipientBalance.received, 800 * COIN);
+    BOOST_CHECK_EQUAL(recipientBalance.txCount, 8);
+    BOOST_CHECK(Balance(searchIndexes, uint160(3)).IsNull());
+
+    CSpentIndexValue spentBy;
+    const CTransaction firstCoinbase = CoinbaseOf(chain[1]);
+    BOOST_CHECK(TransactionSearchIndexes::GetSpentIndex(&searchIndexes, CSpentIndexKey(firstCoinbase.GetHash(), 0u), spentBy));
+    BOOST_CHECK_EQUAL(spentBy.blockHeight, 2);
+    BOOST_CHECK(!TransactionSearchIndexes::GetSpentIndex(&searchIndexes, CSpentIndexKey(CoinbaseOf(chain.Tip()).GetHash(), 0u), spentBy));
+}
+
+BOOST_AUTO_TEST_CASE(rollsBackBlocksThatWereReorganizedAway)
+{
+    AsyncIndexBuilder builder(searchIndexes, *fakeChain.blockIndexByHash, blockDataReader, true, true, 4u);
+    BOOST_REQUIRE(builder.Initialize());
+    SyncToTip(builder, ActiveChain());
+    const CBlockIndex* staleTip = fakeChain.activeChain->Tip();
+
+    fakeChain.fork(5u, 3u);
+    const ChainStateSnapshot chain = ActiveChain();
+    BOOST_REQUIRE(!chain.Contains(staleTip));
+    SyncToTip(builder, chain);
+    BOOST_CHECK(builder.GetStatus().indexedBlockHash == chain.Tip()->GetBlockHash());
+
+    CSearchIndexDB rebuiltIndexes(1 << 20, true);
+    AsyncIndexBuilder rebuilder(rebuiltIndexes, *fakeChain.blockIndexByHash, blockDataReader, true, true);
+    BOOST_REQUIRE(rebuilder.Initialize());
+    SyncToTip(rebuilder, chain);
+
+    for (const uint160& addressHash: {minerAddress, recipientAddress})
+    {
+        const auto history = History(searchIndexes, addressHash);
+        const auto expectedHistory = History(rebuiltIndexes, addressHash);
+        BOOST_REQUIRE_EQUAL(history.size(), expectedHistory.size());
+        for (unsigned entry = 0; entry < history.size(); ++entry)
+        {
+            BOOST_CHECK(history[entry].first.txhash == expectedHistory[entry].first.txhash);
+            BOOST_CHECK_EQUAL(history[entry].second, expectedHistory[entry].second);
+        }
+
+        CheckBalanceMatchesHistory(searchIndexes, addressHash);
+        CheckBalanceMatchesHistory(rebuiltIndexes, addressHash);
+
+        const auto unspent = Unspent(searchIndexes, addressHash);
+        const auto expectedUnspent = Unspent(rebuiltIndexes, addressHash);
+        BOOST_REQUIRE_EQUAL(unspent.size(), expectedUnspent.size());
+        for (unsigned entry = 0; entry < unspent.size(); ++entry)
+            BOOST_CHECK(unspent[entry].first.txhash == expectedUnspent[entry].first.txhash);
+    }
+
+    CSpentIndexValue spentBy;
+    BOOST_CHECK(!TransactionSearchIndexes::GetSpentIndex(&searchIndexes, CSpentIndexKey(CoinbaseOf(staleTip->pprev).GetHash(), 0u), spentBy));
+}
+
+BOOST_AUTO_TEST_CASE(resumesFromTheLastIndexedBlock)
+{
+    {
+        AsyncIndexBuilder builder(searchIndexes, *fakeChain.blockIndexByHash, blockDataReader, true, false, 4u);
+        BOOST_REQUIRE(builder.Initialize());
+        bool caughtUp = false;
+        BOOST_REQUIRE(builder.SyncBatch(ActiveChain(), caughtUp));
+    }
+
+    AsyncIndexBuilder builder(searchIndexes, *fakeChain.blockIndexByHash, blockDataReader, true, false, 4u);
+    BOOST_REQUIRE(builder.Initialize());
+    BOOST_CHECK_EQUAL(builder.GetStatus().indexedHeight, 3);
+    SyncToTip(builder, ActiveChain());
+    BOOST_CHECK_EQUAL(History(searchIndexes, minerAddress).size(), 17u);
+    CheckBalanceMatchesHistory(searchIndexes, minerAddress);
+    CheckBalanceMatchesHistory(searchIndexes, recipientAddress);
+}
+
+BOOST_AUTO_TEST_CASE(changingTheEnabledIndexesRebuildsThemFromTheGenesisBlock)
+{
+    {
+        AsyncIndexBuilder builder(searchIndexes, *fakeChain.blockIndexByHash, blockDataReader, true, false);
+        BOOST_REQUIRE(builder.Initialize());
+        SyncToTip(builder, ActiveChain());
+    }
+    CSpentIndexValue spentBy;
+    const CSpentIndexKey firstCoinbaseOutput(CoinbaseOf(ActiveChain()[1]).GetHash(), 0u);
+    BOOST_CHECK(!TransactionSearchIndexes::GetSpentIndex(&searchIndexes, firstCoinbaseOutput, spentBy));
+
+    AsyncIndexBuilder builder(searchIndexes, *fakeChain.blockIndexByHash, blockDataReader, false, true);
+    BOOST_REQUIRE(builder.Initialize());
+    BOOST_CHECK_EQUAL(builder.GetStatus().indexedHeight, -1);
+    BOOST_CHECK(!searchIndexes.GetAddressIndexing());
+    std::vector<std::pair<CAddressIndexKey, CAmount>> addressIndex;
+    BOOST_CHECK(searchIndexes.ReadAddressIndex(minerAddress, 1, addressIndex));
+    BOOST_CHECK(addressIndex.empty());
+
+    SyncToTip(builder, ActiveChain());
+    BOOST_CHECK(TransactionSearchIndexes::GetSpentIndex(&searchIndexes, firstCoinbaseOutput, spentBy));
+}
+
+BOOST_AUTO_TEST_CASE(rebuildsWhenTheIndexedBlockIsUnknown)
+{
+    {
+        AsyncIndexBuilder builder(searchIndexes, *fakeChain.blockIndexByHash, blockDataReader, true, true);
+        BOOST_REQUIRE(builder.Initialize());
+        SyncToTip(builder, ActiveChain());
+    }
+
+    FakeBlockIndexWithHashes otherChain(3u, 1600000000u, 4u);
+    AsyncIndexBuilder builder(searchIndexes, *otherChain.blockIndexByHash, blockDataReader, true, true);
+    BOOST_REQUIRE(builder.Initialize());
+    BOOST_CHECK_EQUAL(builder.GetStatus().indexedHeight, -1);
+    BOOST_CHECK(Unspent(searchIndexes, recipientAddress).empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,449 @@
+#include <BlockDownloadScheduler.h>
+
+#include <BlocksInFlightRegistry.h>
+#include <chainparams.h>
+#include <defaultValues.h>
+#include <random.h>
+#include <ValidationState.h>
+#include <version.h>
+#include <MockDifficultyAdjuster.h>
+
+#include <set>
+
+#include <boost/test/unit_test.hpp>
+
+using ::testing::NiceMock;
+using ::testing::Return;
+using ::testing::_;
+
+namespace
+{
+constexpr int64_t MAX_BLOCK_TIME = 2000000000;
+constexpr uint32_t FIRST_BLOCK_TIME = 1600000000;
+constexpr unsigned EASY_BITS = 0x207fffff;
+constexpr unsigned HARD_BITS = 0x1f7fffff;
+
+void SolveHeader(CBlockHeader& header)
+{
+    uint256 target;
+    target.SetCompact(header.nBits);
+    while(header.GetHash() > target)
+        ++header.nNonce;
+}
+
+std::vector<CBlockHeader> CreateHeaderChain(
+    const uint256& parentHash,
+    unsigned numberOfHeaders,
+    uint32_t firstBlockTime = FIRST_BLOCK_TIME,
+    unsigned nBits = EASY_BITS)
+{
+    std::vector<CBlockHeader> headers;
+    uint256 previousHash = parentHash;
+    for(unsigned headerIndex = 0; headerIndex < numberOfHeaders; ++headerIndex)
+    {
+        CBlockHeader header;
+        header.nVersion = 4;
+        header.hashPrevBlock = previousHash;
+        header.hashMerkleRoot = GetRandHash();
+        header.nTime = firstBlockTime + 60 * headerIndex;
+        header.nBits = nBits;
+        SolveHeader(header);
+        headers.push_back(header);
+        previousHash = header.GetHash();
+    }
+    return headers;
+}
+
+/** Block index entry of the block a header chain starts from */
+struct FakeParentBlock
+{
+    uint256 hash;
+    CBlockIndex index;
+
+    FakeParentBlock(int height, uint32_t blockTime = FIRST_BLOCK_TIME - 60): hash(GetRandHash()), index()
+    {
+        index.phashBlock = &hash;
+        index.nHeight = height;
+        index.nTime = blockTime;
+        index.nBits = EASY_BITS;
+        index.nChainWork = index.getBlockProof() * static_cast<uint32_t>(height + 1);
+    }
+};
+
+struct BlockDownloadSchedulerTestFixture
+{
+    const CChainParams& chainParameters;
+    NiceMock<MockDifficultyAdjuster> difficultyAdjuster;
+
+    BlockDownloadSchedulerTestFixture(
+        ): chainParameters(Params(CBaseChainParams::REGTEST))
+        , difficultyAdjuster()
+    {
+        ON_CALL(difficultyAdjuster, computeNextBlockDifficulty(_)).WillByDefault(Return(EASY_BITS));
+    }
+
+    bool AcceptHeaders(
+        BlockDownloadScheduler& scheduler,
+        const std::vector<CBlockHeader>& headers,
+        const CBlockIndex* parentIndex,
+        CValidationState& state,
+        NodeId source = 1,
+        const MapCheckpoints* checkpoints = nullptr,
+        int64_t maxBlockTime = MAX_BLOCK_TIME,
+        const uint256& activeChainWork = uint256(0))
+    {
+        return scheduler.AcceptHeaders(
+            headers, parentIndex, source, chainParameters, difficultyAdjuster, maxBlockTime, checkpoints, activeChainWork, state);
+    }
+    bool AcceptHeaders(
+        BlockDownloadScheduler& scheduler,
+        const std::vector<CBlockHeader>& headers,
+        const CBlockIndex* parentIndex,
+        NodeId source = 1)
+    {
+        CValidationState state;
+        return AcceptHeaders(scheduler, headers, parentIndex, state, source);
+    }
+};
+}
+
+BOOST_FIXTURE_TEST_SUITE(BlockDownloadScheduler_tests, BlockDownloadSchedulerTestFixture)
+
+BOOST_AUTO_TEST_CASE(willExtendTheHeaderChainWithConnectedHeaders)
+{
+    BlockDownloadScheduler scheduler;
+    const FakeParentBlock parent(10);
+    const std::vector<CBlockHeader> headers = CreateHeaderChain(parent.hash, 5);
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index));
+    BOOST_CHECK_EQUAL(scheduler.BestHeaderHeight(), 15);
+    BOOST_CHECK_EQUAL(scheduler.GetPendingHeight(headers[0].GetHash()), 11);
+
+    const std::vector<CBlockHeader> moreHeaders = CreateHeaderChain(headers.back().GetHash(), 20, FIRST_BLOCK_TIME + 300);
+    BOOST_CHECK(AcceptHeaders(scheduler, moreHeaders, nullptr));
+    BOOST_CHECK_EQUAL(scheduler.BestHeaderHeight(), 35);
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 25u);
+    BOOST_CHECK(scheduler.BestHeaderHash() == moreHeaders.back().GetHash());
+    BOOST_CHECK(scheduler.BestHeaderChainWork() == parent.index.nChainWork + parent.index.getBlockProof() * 25u);
+
+    // Overlapping headers are not added twice
+    BOOST_CHECK(AcceptHeaders(scheduler, std::vector<CBlockHeader>(moreHeaders.begin(), moreHeaders.begin() + 3), nullptr));
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 25u);
+
+    const std::vector<uint256> locatorHashes = scheduler.GetLocatorHashes();
+    BOOST_CHECK(locatorHashes.front() == moreHeaders.back().GetHash());
+    BOOST_CHECK(locatorHashes.size() < scheduler.PendingBlockCount());
+}
+
+BOOST_AUTO_TEST_CASE(willRejectHeadersThatBreakTheRules)
+{
+    BlockDownloadScheduler scheduler;
+    const FakeParentBlock parent(10);
+    std::vector<CBlockHeader> headers = CreateHeaderChain(parent.hash, 5);
+    std::swap(headers[1], headers[2]);
+    CValidationState state;
+    int nDoS = 0;
+    BOOST_CHECK(!AcceptHeaders(scheduler, headers, &parent.index, state));
+    BOOST_CHECK(state.IsInvalid(nDoS) && nDoS > 0);
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 0u);
+
+    headers = CreateHeaderChain(parent.hash, 5);
+    CValidationState futureState;
+    BOOST_CHECK(!AcceptHeaders(scheduler, headers, &parent.index, futureState, 1, nullptr, headers[2].GetBlockTime() - 1));
+
+    MapCheckpoints checkpoints;
+    checkpoints[13] = GetRandHash();
+    CValidationState checkpointState;
+    BOOST_CHECK(!AcceptHeaders(scheduler, headers, &parent.index, checkpointState, 1, &checkpoints));
+    BOOST_CHECK(checkpointState.IsInvalid(nDoS) && nDoS == 100);
+
+    checkpoints[13] = headers[2].GetHash();
+    CValidationState matchingCheckpointState;
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index, matchingCheckpointState, 1, &checkpoints));
+
+    CValidationState unconnectedState;
+    BOOST_CHECK(!AcceptHeaders(scheduler, CreateHeaderChain(GetRandHash(), 2), nullptr, unconnectedState));
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 5u);
+}
+
+BOOST_AUTO_TEST_CASE(willRejectHeadersWithoutTheRequiredDifficultyOrProof)
+{
+    BlockDownloadScheduler scheduler;
+    const FakeParentBlock parent(10);
+    int nDoS = 0;
+
+    CValidationState wrongDifficultyState;
+    BOOST_CHECK(!AcceptHeaders(scheduler, CreateHeaderChain(parent.hash, 2, FIRST_BLOCK_TIME, HARD_BITS), &parent.index, wrongDifficultyState));
+    BOOST_CHECK(wrongDifficultyState.IsInvalid(nDoS) && nDoS == 100);
+
+    std::vector<CBlockHeader> earlyHeader = CreateHeaderChain(parent.hash, 1);
+    earlyHeader[0].nTime = parent.index.nTime;
+    SolveHeader(earlyHeader[0]);
+    CValidationState earlyState;
+    BOOST_CHECK(!AcceptHeaders(scheduler, earlyHeader, &parent.index, earlyState));
+    BOOST_CHECK(earlyState.IsInvalid(nDoS) && nDoS > 0);
+
+    // Up to the last proof-of-work block the header has to carry the work it claims
+    std::vector<CBlockHeader> unsolvedHeader = CreateHeaderChain(parent.hash, 1);
+    unsolvedHeader[0].nBits = 0x1d00ffff;
+    ON_CALL(difficultyAdjuster, computeNextBlockDifficulty(_)).WillByDefault(Return(0x1d00ffff));
+    CValidationState unsolvedState;
+    BOOST_CHECK(!AcceptHeaders(scheduler, unsolvedHeader, &parent.index, unsolvedState));
+    BOOST_CHECK(unsolvedState.IsInvalid(nDoS) && nDoS > 0);
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 0u);
+
+    // Beyond it the stake behind a header can only be checked once its block arrives
+    const FakeParentBlock proofOfStakeParent(chainParameters.LAST_POW_BLOCK());
+    unsolvedHeader[0].hashPrevBlock = proofOfStakeParent.hash;
+    BOOST_CHECK(AcceptHeaders(scheduler, unsolvedHeader, &proofOfStakeParent.index));
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(willOnlySwitchToAForkWithMoreWork)
+{
+    BlockDownloadScheduler scheduler;
+    const FakeParentBlock parent(0);
+    const std::vector<CBlockHeader> headers = CreateHeaderChain(parent.hash, 10);
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index, 1));
+
+    const std::vector<CBlockHeader> shorterFork = CreateHeaderChain(headers[4].GetHash(), 3, FIRST_BLOCK_TIME + 1000);
+    BOOST_CHECK(AcceptHeaders(scheduler, shorterFork, nullptr, 2));
+    BOOST_CHECK(scheduler.BestHeaderHash() == headers.back().GetHash());
+    BOOST_CHECK(!scheduler.IsPending(shorterFork[0].GetHash()));
+
+    const std::vector<CBlockHeader> longerFork = CreateHeaderChain(headers[4].GetHash(), 8, FIRST_BLOCK_TIME + 2000);
+    BOOST_CHECK(AcceptHeaders(scheduler, longerFork, nullptr, 2));
+    BOOST_CHECK(scheduler.BestHeaderHash() == longerFork.back().GetHash());
+    BOOST_CHECK_EQUAL(scheduler.BestHeaderHeight(), 13);
+    BOOST_CHECK(scheduler.IsPending(headers[4].GetHash()));
+    BOOST_CHECK(!scheduler.IsPending(headers[5].GetHash()));
+
+    // Fewer headers at a higher difficulty outweigh a longer chain
+    ON_CALL(difficultyAdjuster, computeNextBlockDifficulty(_)).WillByDefault(Return(HARD_BITS));
+    const std::vector<CBlockHeader> heavierFork = CreateHeaderChain(headers[4].GetHash(), 2, FIRST_BLOCK_TIME + 3000, HARD_BITS);
+    BOOST_CHECK(AcceptHeaders(scheduler, heavierFork, nullptr, 3));
+    BOOST_CHECK(scheduler.BestHeaderHash() == heavierFork.back().GetHash());
+    BOOST_CHECK_EQUAL(scheduler.BestHeaderHeight(), 7);
+}
+
+BOOST_AUTO_TEST_CASE(willIgnoreHeadersThatDoNotLeadToMoreWorkThanTheActiveChain)
+{
+    BlockDownloadScheduler scheduler;
+    const FakeParentBlock parent(10);
+    const std::vector<CBlockHeader> headers = CreateHeaderChain(parent.hash, 5);
+    const uint256 activeChainWork = parent.index.nChainWork + parent.index.getBlockProof() * 5u;
+
+    CValidationState state;
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index, state, 1, nullptr, MAX_BLOCK_TIME, activeChainWork));
+    BOOST_CHECK(!state.IsInvalid());
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 0u);
+
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index, state, 1, nullptr, MAX_BLOCK_TIME, activeChainWork - 1));
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 5u);
+}
+
+BOOST_AUTO_TEST_CASE(willKeepNoMoreHeadersThanItsLimit)
+{
+    BlockDownloadScheduler scheduler(MAX_BUFFERED_BLOCK_BYTES, 10);
+    const FakeParentBlock parent(200);
+    const std::vector<CBlockHeader> headers = CreateHeaderChain(parent.hash, 16);
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index));
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 10u);
+    BOOST_CHECK(scheduler.BestHeaderHash() == headers[9].GetHash());
+    BOOST_CHECK(!scheduler.NeedsMoreHeaders());
+
+    // Once the blocks of half the chain are in, the rest of the headers are asked for again
+    std::vector<CBlockIndex> acceptedBlocks(5);
+    std::vector<uint256> acceptedHashes(5);
+    for(unsigned index = 0; index < acceptedBlocks.size(); ++index)
+    {
+        acceptedHashes[index] = headers[index].GetHash();
+        acceptedBlocks[index].phashBlock = &acceptedHashes[index];
+        acceptedBlocks[index].pprev = index > 0? &acceptedBlocks[index - 1]: const_cast<CBlockIndex*>(&parent.index);
+        acceptedBlocks[index].nHeight = parent.index.nHeight + 1 + static_cast<int>(index);
+        acceptedBlocks[index].nTime = headers[index].nTime;
+    }
+    scheduler.RemoveAcceptedBlocks(
+        [&acceptedBlocks](const uint256& hash) -> const CBlockIndex*
+        {
+            for(const CBlockIndex& blockIndex: acceptedBlocks)
+                if(blockIndex.GetBlockHash() == hash) return &blockIndex;
+            return nullptr;
+        });
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 5u);
+    BOOST_CHECK(scheduler.NeedsMoreHeaders());
+    scheduler.RecordMoreHeadersRequested();
+    BOOST_CHECK(!scheduler.NeedsMoreHeaders());
+
+    BOOST_CHECK(AcceptHeaders(scheduler, std::vector<CBlockHeader>(headers.begin() + 10, headers.end()), nullptr));
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 10u);
+    BOOST_CHECK(scheduler.BestHeaderHash() == headers[14].GetHash());
+    BOOST_CHECK(!scheduler.NeedsMoreHeaders());
+}
+
+BOOST_AUTO_TEST_CASE(willDropTheHeaderChainIfItsFirstBlockNeverArrives)
+{
+    BlockDownloadScheduler scheduler;
+    const FakeParentBlock parent(200);
+    const std::vector<CBlockHeader> headers = CreateHeaderChain(parent.hash, 5);
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index, 7));
+
+    std::vector<uint256> discardedHashes;
+    BOOST_CHECK_EQUAL(scheduler.DiscardIfFirstBlockNeverArrives(1000, 100, discardedHashes), -1);
+    BOOST_CHECK_EQUAL(scheduler.DiscardIfFirstBlockNeverArrives(1100, 100, discardedHashes), -1);
+    BOOST_CHECK(discardedHashes.empty());
+    BOOST_CHECK_EQUAL(scheduler.DiscardIfFirstBlockNeverArrives(1101, 100, discardedHashes), 7);
+    BOOST_CHECK_EQUAL(discardedHashes.size(), 5u);
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 0u);
+    BOOST_CHECK_EQUAL(scheduler.DiscardIfFirstBlockNeverArrives(5000, 100, discardedHashes), -1);
+}
+
+BOOST_AUTO_TEST_CASE(willSpreadTheDownloadWindowOverPeers)
+{
+    BlockDownloadScheduler scheduler;
+    const FakeParentBlock parent(0);
+    const std::vector<CBlockHeader> headers = CreateHeaderChain(parent.hash, 100);
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index));
+    BlocksInFlightRegistry blocksInFlight;
+    blocksInFlight.RegisterNodedId(1);
+    blocksInFlight.RegisterNodedId(2);
+
+    std::set<uint256> requestedBlocks;
+    for(NodeId nodeId = 1; nodeId <= 2; ++nodeId)
+    {
+        std::vector<uint256> vBlocks;
+        NodeId staller = -1;
+        scheduler.FindNextBlocksToDownload(blocksInFlight, nodeId, 100, MAX_BLOCKS_IN_TRANSIT_PER_PEER, vBlocks, staller);
+        BOOST_CHECK_EQUAL(vBlocks.size(), static_cast<size_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER));
+        BOOST_CHECK_EQUAL(staller, -1);
+        for(const uint256& blockHash: vBlocks)
+        {
+            BOOST_CHECK(requestedBlocks.insert(blockHash).second);
+            blocksInFlight.MarkBlockAsInFlight(nodeId, blockHash);
+        }
+    }
+    BOOST_CHECK(requestedBlocks.count(headers[0].GetHash()) > 0);
+    BOOST_CHECK(requestedBlocks.count(headers[2 * MAX_BLOCKS_IN_TRANSIT_PER_PEER - 1].GetHash()) > 0);
+
+    // A peer is never asked for blocks beyond the height it has
+    std::vector<uint256> vBlocks;
+    NodeId staller = -1;
+    scheduler.FindNextBlocksToDownload(blocksInFlight, 3, 2 * MAX_BLOCKS_IN_TRANSIT_PER_PEER, MAX_BLOCKS_IN_TRANSIT_PER_PEER, vBlocks, staller);
+    BOOST_CHECK(vBlocks.empty());
+
+    // Once a peer's blocks are released they go to the next peer asking
+    blocksInFlight.ReleaseBlocksInFlight(1);
+    scheduler.FindNextBlocksToDownload(blocksInFlight, 3, 100, MAX_BLOCKS_IN_TRANSIT_PER_PEER, vBlocks, staller);
+    BOOST_REQUIRE_EQUAL(vBlocks.size(), static_cast<size_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER));
+    BOOST_CHECK(vBlocks.front() == headers[0].GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(willReportThePeerHoldingUpTheWindow)
+{
+    BlockDownloadScheduler scheduler;
+    const FakeParentBlock parent(0);
+    const std::vector<CBlockHeader> headers = CreateHeaderChain(parent.hash, BLOCK_DOWNLOAD_WINDOW + 10);
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index));
+    BlocksInFlightRegistry blocksInFlight;
+    blocksInFlight.RegisterNodedId(1);
+    blocksInFlight.RegisterNodedId(2);
+
+    // Peer 1 holds the first block of the window; all others have arrived or are on their way
+    blocksInFlight.MarkBlockAsInFlight(1, headers[0].GetHash());
+    for(unsigned headerIndex = 1; headerIndex < BLOCK_DOWNLOAD_WINDOW; ++headerIndex)
+    {
+        if(headerIndex % 2 == 0)
+            BOOST_CHECK(scheduler.BufferBlock(CBlock(headers[headerIndex]), 2));
+        else
+            blocksInFlight.MarkBlockAsInFlight(2, headers[headerIndex].GetHash());
+    }
+
+    std::vector<uint256> vBlocks;
+    NodeId staller = -1;
+    scheduler.FindNextBlocksToDownload(blocksInFlight, 3, BLOCK_DOWNLOAD_WINDOW + 10, MAX_BLOCKS_IN_TRANSIT_PER_PEER, vBlocks, staller);
+    BOOST_CHECK(vBlocks.empty());
+    BOOST_CHECK_EQUAL(staller, 1);
+
+    staller = -1;
+    scheduler.FindNextBlocksToDownload(blocksInFlight, 1, BLOCK_DOWNLOAD_WINDOW + 10, MAX_BLOCKS_IN_TRANSIT_PER_PEER, vBlocks, staller);
+    BOOST_CHECK_EQUAL(staller, -1);
+}
+
+BOOST_AUTO_TEST_CASE(willHandOutBufferedBlocksInChainOrder)
+{
+    BlockDownloadScheduler scheduler;
+    const FakeParentBlock parent(0);
+    const uint256& anchorHash = parent.hash;
+    const std::vector<CBlockHeader> headers = CreateHeaderChain(anchorHash, 4);
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index));
+
+    BOOST_CHECK(!scheduler.BufferBlock(CBlock(CreateHeaderChain(anchorHash, 1)[0]), 2));
+    BOOST_CHECK(scheduler.BufferBlock(CBlock(headers[2]), 2));
+    BOOST_CHECK(scheduler.BufferBlock(CBlock(headers[1]), 3));
+    BOOST_CHECK_EQUAL(scheduler.BufferedBlockCount(), 2u);
+
+    CBlock block;
+    NodeId source = -1;
+    BOOST_CHECK(!scheduler.TakeBufferedChild(anchorHash, block, source));
+
+    const uint256 acceptedHash = headers[0].GetHash();
+    CBlockIndex acceptedBlock;
+    acceptedBlock.phashBlock = &acceptedHash;
+    acceptedBlock.pprev = const_cast<CBlockIndex*>(&parent.index);
+    acceptedBlock.nHeight = 1;
+    acceptedBlock.nTime = headers[0].nTime;
+    const auto acceptedBlockIndex = [&acceptedBlock](const uint256& hash) -> const CBlockIndex*
+    {
+        return hash == acceptedBlock.GetBlockHash()? &acceptedBlock: nullptr;
+    };
+    scheduler.RemoveAcceptedBlocks(acceptedBlockIndex);
+    BOOST_CHECK_EQUAL(scheduler.PendingBlockCount(), 3u);
+
+    BOOST_CHECK(scheduler.TakeBufferedChild(headers[0].GetHash(), block, source));
+    BOOST_CHECK(block.GetHash() == headers[1].GetHash());
+    BOOST_CHECK_EQUAL(source, 3);
+    BOOST_CHECK(scheduler.TakeBufferedChild(headers[1].GetHash(), block, source));
+    BOOST_CHECK(block.GetHash() == headers[2].GetHash());
+    BOOST_CHECK_EQUAL(source, 2);
+    BOOST_CHECK(!scheduler.TakeBufferedChild(headers[2].GetHash(), block, source));
+    BOOST_CHECK_EQUAL(scheduler.BufferedBlockCount(), 0u);
+    BOOST_CHECK_EQUAL(scheduler.BufferedBlockBytes(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(willNotBufferBeyondItsByteLimit)
+{
+    const FakeParentBlock parent(0);
+    const std::vector<CBlockHeader> headers = CreateHeaderChain(parent.hash, 4);
+    const size_t blockSize = ::GetSerializeSize(CBlock(headers[0]), SER_NETWORK, PROTOCOL_VERSION);
+    BlockDownloadScheduler scheduler(2 * blockSize);
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index));
+
+    BOOST_CHECK(scheduler.BufferBlock(CBlock(headers[1]), 2));
+    BOOST_CHECK(scheduler.BufferBlock(CBlock(headers[2]), 2));
+    BOOST_CHECK(!scheduler.BufferBlock(CBlock(headers[3]), 2));
+
+    // With the buffer full only the block that can be accepted right away is requested
+    BlocksInFlightRegistry blocksInFlight;
+    blocksInFlight.RegisterNodedId(1);
+    std::vector<uint256> vBlocks;
+    NodeId staller = -1;
+    scheduler.FindNextBlocksToDownload(blocksInFlight, 1, 4, MAX_BLOCKS_IN_TRANSIT_PER_PEER, vBlocks, staller);
+    BOOST_REQUIRE_EQUAL(vBlocks.size(), 1u);
+    BOOST_CHECK(vBlocks[0] == headers[0].GetHash());
+}
+
+BOOST_AUTO_TEST_CASE(willDiscardAnInvalidBlockAndItsDescendants)
+{
+    BlockDownloadScheduler scheduler;
+    const FakeParentBlock parent(0);
+    const std::vector<CBlockHeader> headers = CreateHeaderChain(parent.hash, 6);
+    BOOST_CHECK(AcceptHeaders(scheduler, headers, &parent.index, 7));
+    BOOST_CHECK(scheduler.BufferBlock(CBlock(headers[4]), 2));
+
+    BOOST_CHECK_EQUAL(scheduler.DiscardFrom(headers[3].GetHash()), 7);
+    BOOST_CHECK_EQUAL(scheduler.BestHeaderHeight(), 3);
+    BOOST_CHECK(!scheduler.IsPending(headers[4].GetHash()));
+    BOOST_CHECK_EQUAL(scheduler.BufferedBlockCount(), 0u);
+    BOOST_CHECK_EQUAL(scheduler.DiscardFrom(headers[4].GetHash()), -1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
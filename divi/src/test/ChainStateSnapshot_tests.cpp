@@ -0,0 +1,84 @@
+#include <test/test_only.h>
+
+#include <ChainStateSnapshot.h>
+#include <test/FakeBlockIndexChain.h>
+#include <blockmap.h>
+#include <chain.h>
+
+BOOST_AUTO_TEST_SUITE(ChainStateSnapshot_tests)
+
+BOOST_AUTO_TEST_CASE(snapshotAgreesWithTheActiveChain)
+{
+    FakeBlockIndexWithHashes fakeChain(200, 1600000000, 4);
+    const CChain& chain = *fakeChain.activeChain;
+    const ChainStateSnapshot snapshot(chain.Tip(), chain.Tip());
+
+    BOOST_CHECK_EQUAL(snapshot.Height(), chain.Height());
+    for (int height = 0; height <= chain.Height(); ++height)
+    {
+        BOOST_CHECK(snapshot[height] == chain[height]);
+        BOOST_CHECK(snapshot.Contains(chain[height]));
+        BOOST_CHECK(snapshot.Next(chain[height]) == chain.Next(chain[height]));
+    }
+    BOOST_CHECK(snapshot[-1] == nullptr);
+    BOOST_CHECK(snapshot[chain.Height() + 1] == nullptr);
+    BOOST_CHECK(snapshot.Next(chain.Tip()) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(snapshotKeepsItsChainAcrossReorganizations)
+{
+    FakeBlockIndexWithHashes fakeChain(100, 1600000000, 4);
+    const CBlockIndex* oldTip = fakeChain.activeChain->Tip();
+    const ChainStateSnapshot oldSnapshot(oldTip, oldTip);
+
+    fakeChain.fork(20, 10);
+    const CBlockIndex* newTip = fakeChain.activeChain->Tip();
+    const ChainStateSnapshot newSnapshot(newTip, newTip);
+
+    const CBlockIndex* forkPoint = oldTip->GetAncestor(oldTip->nHeight - 10);
+    BOOST_CHECK(oldSnapshot.Contains(forkPoint));
+    BOOST_CHECK(newSnapshot.Contains(forkPoint));
+    BOOST_CHECK(oldSnapshot.Contains(oldTip));
+    BOOST_CHECK(!newSnapshot.Contains(oldTip));
+    BOOST_CHECK(!oldSnapshot.Contains(newTip));
+    BOOST_CHECK(oldSnapshot.Next(forkPoint) != newSnapshot.Next(forkPoint));
+    BOOST_CHECK_EQUAL(oldSnapshot.Height(), 99);
+    BOOST_CHECK_EQUAL(newSnapshot.Height(), 109);
+}
+
+BOOST_AUTO_TEST_CASE(publishedSnapshotsTrackTipAndBestHeaderSeparately)
+{
+    FakeBlockIndexWithHashes fakeChain(50, 1600000000, 4);
+    const CBlockIndex* tip = fakeChain.activeChain->Tip();
+    const CBlockIndex* header = tip->pprev;
+
+    ChainStateSnapshot::Clear();
+    BOOST_CHECK(ChainStateSnapshot::Current()->Tip() == nullptr);
+    BOOST_CHECK_EQUAL(ChainStateSnapshot::Current()->Height(), -1);
+
+    ChainStateSnapshot::PublishBestHeader(header);
+    ChainStateSnapshot::PublishTip(tip);
+    const std::shared_ptr<const ChainStateSnapshot> published = ChainStateSnapshot::Current();
+    BOOST_CHECK(published->Tip() == tip);
+    BOOST_CHECK(published->BestHeader() == header);
+    BOOST_CHECK_EQUAL(published->BestHeaderHeight(), header->nHeight);
+
+    ChainStateSnapshot::PublishBestHeader(header);
+    BOOST_CHECK(ChainStateSnapshot::Current() == published);
+
+    ChainStateSnapshot::Clear();
+    BOOST_CHECK(ChainStateSnapshot::Current()->Tip() == nullptr);
+    BOOST_CHECK(published->Tip() == tip);
+}
+
+BOOST_AUTO_TEST_CASE(blockMapLookupsWithoutMainLockFindInsertedBlocks)
+{
+    FakeBlockIndexWithHashes fakeChain(10, 1600000000, 4);
+    const BlockMap& blockMap = *fakeChain.blockIndexByHash;
+    const CBlockIndex* tip = fakeChain.activeChain->Tip();
+
+    BOOST_CHECK(blockMap.FindWithoutMainLock(tip->GetBlockHash()) == tip);
+    BOOST_CHECK(blockMap.FindWithoutMainLock(uint256S("0x1234")) == nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
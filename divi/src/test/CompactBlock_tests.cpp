@@ -0,0 +1,194 @@
+#include <CompactBlock.h>
+
+#include <random.h>
+#include <streams.h>
+#include <txmempool.h>
+#include <version.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+CTransaction CreateSpendingTransaction(CAmount value)
+{
+    CMutableTransaction tx;
+    tx.vin.emplace_back(COutPoint(GetRandHash(), 0));
+    tx.vout.emplace_back(value, CScript() << OP_TRUE);
+    return tx;
+}
+
+CBlock CreateProofOfStakeBlock(unsigned numberOfRegularTransactions)
+{
+    CBlock block;
+    block.nBits = 0x1e0ffff0;
+    block.nTime = 1600000000;
+    block.hashPrevBlock = GetRandHash();
+
+    CMutableTransaction coinbase;
+    coinbase.vin.emplace_back(COutPoint());
+    coinbase.vout.emplace_back(0, CScript());
+    block.vtx.push_back(coinbase);
+
+    CMutableTransaction coinstake;
+    coinstake.vin.emplace_back(COutPoint(GetRandHash(), 1));
+    coinstake.vout.resize(2);
+    coinstake.vout[0].SetEmpty();
+    coinstake.vout[1] = CTxOut(100, CScript() << OP_TRUE);
+    block.vtx.push_back(coinstake);
+
+    for(unsigned txIndex = 0; txIndex < numberOfRegularTransactions; ++txIndex)
+    {
+        block.vtx.push_back(CreateSpendingTransaction(txIndex + 1));
+    }
+    block.vchBlockSig.assign(72, 0x42);
+    block.hashMerkleRoot = block.BuildMerkleTree();
+    return block;
+}
+
+void AddToMempool(CTxMemPool& mempool, const CTransaction& tx)
+{
+    mempool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, 0, 0, 0.0, 1));
+}
+
+template <typename T>
+T SerializeAndDeserialize(const T& object)
+{
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << object;
+    T copy;
+    stream >> copy;
+    return copy;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(CompactBlock_tests)
+
+BOOST_AUTO_TEST_CASE(willPrefillCoinbaseAndCoinstakeAndShortenTheRest)
+{
+    const CBlock block = CreateProofOfStakeBlock(3);
+    const CBlockHeaderAndShortTxIDs compactBlock(block, 7u);
+
+    BOOST_CHECK_EQUAL(compactBlock.prefilledTransactions.size(), 2u);
+    BOOST_CHECK_EQUAL(compactBlock.prefilledTransactions[0].index, 0u);
+    BOOST_CHECK_EQUAL(compactBlock.prefilledTransactions[1].index, 1u);
+    BOOST_CHECK_EQUAL(compactBlock.shortTxIds.size(), 3u);
+    BOOST_CHECK_EQUAL(compactBlock.BlockTransactionCount(), block.vtx.size());
+    for(uint64_t shortTxId: compactBlock.shortTxIds)
+    {
+        BOOST_CHECK_EQUAL(shortTxId >> (8 * SHORT_TXID_LENGTH), 0u);
+    }
+
+    const CBlockHeaderAndShortTxIDs copy = SerializeAndDeserialize(compactBlock);
+    BOOST_CHECK(copy.header.GetHash() == block.GetHash());
+    BOOST_CHECK(copy.shortTxIds == compactBlock.shortTxIds);
+    BOOST_CHECK(copy.vchBlockSig == block.vchBlockSig);
+    BOOST_CHECK_EQUAL(copy.GetShortID(block.vtx[2].GetHash()), compactBlock.shortTxIds[0]);
+}
+
+BOOST_AUTO_TEST_CASE(willBeMuchSmallerThanTheFullBlock)
+{
+    const CBlock block = CreateProofOfStakeBlock(100);
+    const CBlockHeaderAndShortTxIDs compactBlock(block, 7u);
+
+    const size_t fullBlockSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    const size_t compactBlockSize = ::GetSerializeSize(compactBlock, SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_CHECK_MESSAGE(compactBlockSize * 5 < fullBlockSize, compactBlockSize << " vs " << fullBlockSize);
+}
+
+BOOST_AUTO_TEST_CASE(willReconstructBlockFromMempool)
+{
+    const CBlock block = CreateProofOfStakeBlock(4);
+    CTxMemPool mempool;
+    for(unsigned txIndex = 2; txIndex < block.vtx.size(); ++txIndex)
+    {
+        AddToMempool(mempool, block.vtx[txIndex]);
+    }
+    AddToMempool(mempool, CreateSpendingTransaction(12345));
+
+    PartiallyDownloadedBlock partialBlock;
+    BOOST_CHECK(partialBlock.InitData(SerializeAndDeserialize(CBlockHeaderAndShortTxIDs(block, 9u)), mempool) == CompactBlockReadStatus::OK);
+    BOOST_CHECK(partialBlock.GetMissingTransactionIndexes().empty());
+    BOOST_CHECK_EQUAL(partialBlock.PrefilledTransactionCount(), 2u);
+    BOOST_CHECK_EQUAL(partialBlock.MempoolTransactionCount(), 4u);
+
+    CBlock reconstructedBlock;
+    BOOST_CHECK(partialBlock.FillBlock(reconstructedBlock, std::vector<CTransaction>()) == CompactBlockReadStatus::OK);
+    BOOST_CHECK(reconstructedBlock.GetHash() == block.GetHash());
+    BOOST_CHECK(reconstructedBlock.IsProofOfStake());
+    BOOST_CHECK(reconstructedBlock.vchBlockSig == block.vchBlockSig);
+    BOOST_CHECK(SerializeHash(reconstructedBlock) == SerializeHash(block));
+}
+
+BOOST_AUTO_TEST_CASE(willRequestOnlyTransactionsMissingFromMempool)
+{
+    const CBlock block = CreateProofOfStakeBlock(4);
+    CTxMemPool mempool;
+    AddToMempool(mempool, block.vtx[2]);
+    AddToMempool(mempool, block.vtx[4]);
+
+    PartiallyDownloadedBlock partialBlock;
+    BOOST_CHECK(partialBlock.InitData(CBlockHeaderAndShortTxIDs(block, 9u), mempool) == CompactBlockReadStatus::OK);
+    const std::vector<uint16_t> missingIndexes = partialBlock.GetMissingTransactionIndexes();
+    BOOST_REQUIRE_EQUAL(missingIndexes.size(), 2u);
+    BOOST_CHECK_EQUAL(missingIndexes[0], 3u);
+    BOOST_CHECK_EQUAL(missingIndexes[1], 5u);
+
+    BlockTransactionsRequest request;
+    request.blockhash = block.GetHash();
+    request.indexes = missingIndexes;
+    request = SerializeAndDeserialize(request);
+    BOOST_CHECK(request.indexes == missingIndexes);
+
+    BlockTransactions response(request);
+    for(size_t requestIndex = 0; requestIndex < request.indexes.size(); ++requestIndex)
+    {
+        response.txn[requestIndex] = block.vtx[request.indexes[requestIndex]];
+    }
+    response = SerializeAndDeserialize(response);
+
+    CBlock reconstructedBlock;
+    BOOST_CHECK(partialBlock.FillBlock(reconstructedBlock, response.txn) == CompactBlockReadStatus::OK);
+    BOOST_CHECK(reconstructedBlock.GetHash() == block.GetHash());
+    BOOST_CHECK(SerializeHash(reconstructedBlock) == SerializeHash(block));
+}
+
+BOOST_AUTO_TEST_CASE(willRejectFillsThatDoNotMatchTheBlock)
+{
+    const CBlock block = CreateProofOfStakeBlock(2);
+    CTxMemPool mempool;
+
+    PartiallyDownloadedBlock partialBlock;
+    BOOST_CHECK(partialBlock.InitData(CBlockHeaderAndShortTxIDs(block, 9u), mempool) == CompactBlockReadStatus::OK);
+    BOOST_CHECK_EQUAL(partialBlock.GetMissingTransactionIndexes().size(), 2u);
+
+    CBlock reconstructedBlock;
+    const std::vector<CTransaction> tooFewTransactions(1, block.vtx[2]);
+    BOOST_CHECK(partialBlock.FillBlock(reconstructedBlock, tooFewTransactions) == CompactBlockReadStatus::INVALID);
+
+    const std::vector<CTransaction> wrongTransactions = {block.vtx[2], CreateSpendingTransaction(1)};
+    BOOST_CHECK(partialBlock.FillBlock(reconstructedBlock, wrongTransactions) == CompactBlockReadStatus::FAILED);
+
+    const std::vector<CTransaction> rightTransactions = {block.vtx[2], block.vtx[3]};
+    BOOST_CHECK(partialBlock.FillBlock(reconstructedBlock, rightTransactions) == CompactBlockReadStatus::OK);
+}
+
+BOOST_AUTO_TEST_CASE(willRejectMalformedCompactBlocks)
+{
+    const CBlock block = CreateProofOfStakeBlock(2);
+    CTxMemPool mempool;
+
+    CBlockHeaderAndShortTxIDs duplicatePrefilledIndex(block, 9u);
+    duplicatePrefilledIndex.prefilledTransactions[1].index = 0;
+    PartiallyDownloadedBlock partialBlock;
+    BOOST_CHECK(partialBlock.InitData(duplicatePrefilledIndex, mempool) == CompactBlockReadStatus::INVALID);
+
+    CBlockHeaderAndShortTxIDs prefilledOutOfRange(block, 9u);
+    prefilledOutOfRange.prefilledTransactions[1].index = 10;
+    BOOST_CHECK(partialBlock.InitData(prefilledOutOfRange, mempool) == CompactBlockReadStatus::INVALID);
+
+    CBlockHeaderAndShortTxIDs collidingShortIds(block, 9u);
+    collidingShortIds.shortTxIds[1] = collidingShortIds.shortTxIds[0];
+    BOOST_CHECK(partialBlock.InitData(collidingShortIds, mempool) == CompactBlockReadStatus::FAILED);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -14,6 +14,7 @@
 #include "serialize.h"
 #include <Settings.h>
 #include <stdint.h>
+#include <limits>
 #include <utiltime.h>
 #include <main.h>
 #include <OrphanTransactions.h>
@@ -36,6 +37,7 @@
 
 // Tests this internal-to-main.cpp method:
 extern Settings& settings;
+extern CCriticalSection cs_main;
 
 CService ToIP(uint32_t i)
 {
@@ -208,13 +210,102 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     }
 
     // Test LimitOrphanTxSize() function:
-    LimitOrphanTxSize(40);
+    const size_t noByteLimit = std::numeric_limits<size_t>::max();
+    LimitOrphanTxSize(40, noByteLimit);
     BOOST_CHECK(OrphanTotalCount() <= 40);
-    LimitOrphanTxSize(10);
+    LimitOrphanTxSize(10, noByteLimit);
     BOOST_CHECK(OrphanTotalCount() <= 10);
-    LimitOrphanTxSize(0);
+    const size_t bytesRemaining = OrphanTotalBytes();
+    LimitOrphanTxSize(10, bytesRemaining / 2);
+    BOOST_CHECK(OrphanTotalBytes() <= bytesRemaining / 2);
+    LimitOrphanTxSize(0, noByteLimit);
     BOOST_CHECK(OrphanMapsAreEmpty());
+    BOOST_CHECK_EQUAL(OrphanTotalBytes(), 0u);
 
 }
 
+static CTransaction CreateOrphanSpending(const COutPoint& prevout)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = prevout;
+    tx.vin[0].scriptSig << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 1*CENT;
+    tx.vout[0].scriptPubKey << OP_1;
+    return tx;
+}
+
+BOOST_AUTO_TEST_CASE(DoS_orphanPeerQuota)
+{
+    const NodeId floodingPeer = 1;
+    const NodeId honestPeer = 2;
+    unsigned int accepted = 0;
+    for (int i = 0; i < 10000; i++)
+    {
+        if(!AddOrphanTx(CreateOrphanSpending(COutPoint(GetRandHash(), 0)), floodingPeer)) break;
+        ++accepted;
+    }
+    BOOST_CHECK(accepted > 0);
+    BOOST_CHECK(OrphanBytesFromPeer(floodingPeer) <= MAX_ORPHAN_BYTES_PER_PEER);
+    BOOST_CHECK_EQUAL(OrphanTotalCount(), accepted);
+
+    BOOST_CHECK(AddOrphanTx(CreateOrphanSpending(COutPoint(GetRandHash(), 0)), honestPeer));
+    BOOST_CHECK_EQUAL(OrphanTotalCount(), accepted + 1);
+
+    EraseOrphansFor(floodingPeer);
+    BOOST_CHECK_EQUAL(OrphanBytesFromPeer(floodingPeer), 0u);
+    BOOST_CHECK_EQUAL(OrphanTotalCount(), 1u);
+    EraseOrphansFor(honestPeer);
+    BOOST_CHECK(OrphanMapsAreEmpty());
+}
+
+BOOST_AUTO_TEST_CASE(DoS_orphanExpiry)
+{
+    const int64_t nStartTime = GetTime();
+    SetMockTime(nStartTime);
+    BOOST_CHECK(AddOrphanTx(CreateOrphanSpending(COutPoint(GetRandHash(), 0)), 1));
+    LimitOrphanTxSize(100, std::numeric_limits<size_t>::max());
+    BOOST_CHECK_EQUAL(OrphanTotalCount(), 1u);
+
+    SetMockTime(nStartTime + ORPHAN_TX_EXPIRE_TIME + ORPHAN_TX_EXPIRE_INTERVAL);
+    LimitOrphanTxSize(100, std::numeric_limits<size_t>::max());
+    BOOST_CHECK(OrphanMapsAreEmpty());
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(DoS_orphanWorkQueueMatchesExactOutpoints)
+{
+    CMutableTransaction parent;
+    parent.vin.resize(1);
+    parent.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    parent.vout.resize(2);
+    parent.vout[0].nValue = 1*CENT;
+    parent.vout[1].nValue = 1*CENT;
+    const CTransaction parentTx(parent);
+
+    const CTransaction childOfFirstOutput = CreateOrphanSpending(COutPoint(parentTx.GetHash(), 0));
+    const CTransaction childOfMissingOutput = CreateOrphanSpending(COutPoint(parentTx.GetHash(), 5));
+    BOOST_CHECK(AddOrphanTx(childOfFirstOutput, 1));
+    BOOST_CHECK(AddOrphanTx(childOfMissingOutput, 1));
+
+    LOCK(cs_main);
+    AddOrphansSpendingTransactionToWorkQueue(parentTx);
+    AddOrphansSpendingTransactionToWorkQueue(parentTx);
+    BOOST_CHECK_EQUAL(OrphanWorkQueueSize(), 1u);
+
+    uint256 orphanHash;
+    BOOST_CHECK(PopOrphanFromWorkQueue(orphanHash));
+    BOOST_CHECK(orphanHash == childOfFirstOutput.GetHash());
+    BOOST_CHECK(!PopOrphanFromWorkQueue(orphanHash));
+
+    // Orphans evicted while queued are skipped
+    AddOrphansSpendingTransactionToWorkQueue(parentTx);
+    EraseOrphanTx(childOfFirstOutput.GetHash());
+    BOOST_CHECK(!PopOrphanFromWorkQueue(orphanHash));
+
+    EraseOrphansFor(1);
+    BOOST_CHECK(OrphanMapsAreEmpty());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
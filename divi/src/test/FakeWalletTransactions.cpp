@@ -0,0 +1,65 @@
+#include <FakeWalletTransactions.h>
+
+using ::testing::Invoke;
+using ::testing::ReturnRef;
+using ::testing::_;
+
+FakeWalletTransactions::FakeWalletTransactions(
+    ): walletTransactions()
+    , depthByTxid()
+    , blocksToMaturityByTxid()
+    , ownershipByScript()
+    , transactionCounter(0u)
+    , txRecord()
+    , confsCalculator()
+    , ownershipDetector()
+    , spentOutputTracker()
+{
+    ON_CALL(txRecord, GetWalletTransactions()).WillByDefault(ReturnRef(walletTransactions));
+    ON_CALL(txRecord, GetWalletTx(_)).WillByDefault(Invoke(
+        [this](const uint256& hash) -> const CWalletTx*
+        {
+            const auto it = walletTransactions.find(hash);
+            return it != walletTransactions.end()? &it->second: nullptr;
+        }));
+    ON_CALL(confsCalculator, GetNumberOfBlockConfirmations(_)).WillByDefault(Invoke(
+        [this](const CMerkleTx& tx) { return depthByTxid[tx.GetHash()]; }));
+    ON_CALL(confsCalculator, GetBlocksToMaturity(_)).WillByDefault(Invoke(
+        [this](const CMerkleTx& tx) { return blocksToMaturityByTxid[tx.GetHash()]; }));
+    ON_CALL(ownershipDetector, isMine(_)).WillByDefault(Invoke(
+        [this](const CTxOut& output)
+        {
+            const auto it = ownershipByScript.find(output.scriptPubKey);
+            return it != ownershipByScript.end()? it->second: isminetype::ISMINE_NO;
+        }));
+    ON_CALL(spentOutputTracker, IsSpent(_,_,_)).WillByDefault(Invoke(
+        [this](const uint256& hash, unsigned n, int minimumConfirmation)
+        {
+            for(const auto& txidAndTransaction: walletTransactions)
+            {
+                if(depthByTxid[txidAndTransaction.first] < minimumConfirmation) continue;
+                for(const CTxIn& input: txidAndTransaction.second.vin)
+                {
+                    if(input.prevout == COutPoint(hash, n)) return true;
+                }
+            }
+            return false;
+        }));
+}
+
+CScript FakeWalletTransactions::scriptOwnedAs(isminetype ownership)
+{
+    CScript script = CScript() << static_cast<int64_t>(ownershipByScript.size() + 1);
+    ownershipByScript[script] = ownership;
+    return script;
+}
+
+const CWalletTx& FakeWalletTransactions::recordTransaction(CMutableTransaction tx, int depth, int blocksToMaturity)
+{
+    tx.nLockTime = ++transactionCounter;
+    const CWalletTx walletTx{CTransaction(tx)};
+    const uint256 txid = walletTx.GetHash();
+    depthByTxid[txid] = depth;
+    blocksToMaturityByTxid[txid] = blocksToMaturity;
+    return walletTransactions.emplace(txid, walletTx).first->second;
+}
@@ -0,0 +1,38 @@
+#ifndef FAKE_WALLET_TRANSACTIONS_H
+#define FAKE_WALLET_TRANSACTIONS_H
+#include <MockTransactionRecord.h>
+#include <MockMerkleTxConfirmationNumberCalculator.h>
+#include <MockSpentOutputTracker.h>
+#include <MockUtxoOwnershipDetector.h>
+#include <WalletTx.h>
+#include <script/script.h>
+
+#include <map>
+
+/** Wallet transactions kept in memory, with mocks of the transaction record,
+ *  the confirmation calculator, the ownership detector and the spent output
+ *  tracker that answer from them. Depths, maturities and output ownership are
+ *  set through the maps; an output counts as spent once a recorded transaction
+ *  at the requested depth spends it. */
+class FakeWalletTransactions
+{
+public:
+    std::map<uint256, CWalletTx> walletTransactions;
+    std::map<uint256, int> depthByTxid;
+    std::map<uint256, int> blocksToMaturityByTxid;
+    std::map<CScript, isminetype> ownershipByScript;
+    unsigned transactionCounter;
+
+    ::testing::NiceMock<MockTransactionRecord> txRecord;
+    ::testing::NiceMock<MockMerkleTxConfirmationNumberCalculator> confsCalculator;
+    ::testing::NiceMock<MockUtxoOwnershipDetector> ownershipDetector;
+    ::testing::NiceMock<MockSpentOutputTracker> spentOutputTracker;
+
+    FakeWalletTransactions();
+
+    /** A script that is new to the wallet and recognized with the given ownership */
+    CScript scriptOwnedAs(isminetype ownership);
+    /** Makes the transaction unique and records it at the given depth */
+    const CWalletTx& recordTransaction(CMutableTransaction tx, int depth, int blocksToMaturity = 0);
+};
+#endif// FAKE_WALLET_TRANSACTIONS_H
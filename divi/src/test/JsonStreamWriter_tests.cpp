@@ -0,0 +1,141 @@
+#include <test/test_only.h>
+
+#include <JsonStreamWriter.h>
+#include <rpcprotocol.h>
+#include <tinyformat.h>
+
+#include <sstream>
+
+namespace
+{
+json_spirit::Value SampleDocument()
+{
+    json_spirit::Object inner;
+    inner.push_back(json_spirit::Pair("text", "quote \" and \\ backslash"));
+    inner.push_back(json_spirit::Pair("amount", 1.5));
+    inner.push_back(json_spirit::Pair("empty", json_spirit::Array()));
+
+    json_spirit::Array list;
+    list.push_back(1);
+    list.push_back(inner);
+    list.push_back(json_spirit::Value::null);
+
+    json_spirit::Object document;
+    document.push_back(json_spirit::Pair("name", "block"));
+    document.push_back(json_spirit::Pair("list", list));
+    document.push_back(json_spirit::Pair("flag", true));
+    document.push_back(json_spirit::Pair("nested", json_spirit::Object()));
+    return document;
+}
+
+/** Writes SampleDocument piece by piece, leaving part of it as complete subtrees */
+void WriteSampleDocument(I_JsonWriter& writer)
+{
+    writer.BeginObject();
+    writer.WriteField("name", "block");
+    writer.Key("list");
+    writer.BeginArray();
+    writer.Write(1);
+    writer.BeginObject();
+    writer.WriteField("text", "quote \" and \\ backslash");
+    writer.WriteField("amount", 1.5);
+    writer.Key("empty");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.EndObject();
+    writer.Write(json_spirit::Value::null);
+    writer.EndArray();
+    writer.WriteField("flag", true);
+    writer.WriteField("nested", json_spirit::Object());
+    writer.EndObject();
+}
+
+std::string ChunkedReplyBody(const std::string& reply)
+{
+    std::istringstream stream(reply);
+    int nProto = 0;
+    BOOST_REQUIRE_EQUAL(ReadHTTPStatus(stream, nProto), HTTP_OK);
+    std::map<std::string, std::string> mapHeaders;
+    std::string strBody;
+    BOOST_REQUIRE_EQUAL(ReadHTTPMessage(stream, mapHeaders, strBody, nProto, 1 << 24), HTTP_OK);
+    return strBody;
+}
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(JsonStreamWriter_tests)
+
+BOOST_AUTO_TEST_CASE(streamedDocumentMatchesTheTreeSerialization)
+{
+    std::ostringstream stream;
+    JsonStreamWriter writer(stream);
+    WriteSampleDocument(writer);
+    BOOST_CHECK_EQUAL(stream.str(), json_spirit::write_string(SampleDocument(), false));
+}
+
+BOOST_AUTO_TEST_CASE(builderRecreatesTheTree)
+{
+    const json_spirit::Value built = BuildJsonValue(&WriteSampleDocument);
+    BOOST_CHECK_EQUAL(json_spirit::write_string(built, false), json_spirit::write_string(SampleDocument(), false));
+}
+
+BOOST_AUTO_TEST_CASE(topLevelScalarsAndArraysAreWrittenAsIs)
+{
+    std::ostringstream stream;
+    JsonStreamWriter writer(stream);
+    writer.BeginArray();
+    writer.Write("a");
+    writer.Write("b");
+    writer.EndArray();
+    BOOST_CHECK_EQUAL(stream.str(), "[\"a\",\"b\"]");
+
+    const json_spirit::Value scalar = BuildJsonValue([](I_JsonWriter& builder) { builder.Write("hex"); });
+    BOOST_CHECK_EQUAL(scalar.get_str(), "hex");
+}
+
+BOOST_AUTO_TEST_CASE(chunkedRepliesAreReadBackWhole)
+{
+    std::ostringstream connection;
+    HTTPStreamedReply reply(connection, HTTP_OK, true, true);
+    std::string expectedBody;
+    for (int line = 0; line < 20000; ++line)
+    {
+        const std::string text = strprintf("line %d\n", line);
+        reply.Body() << text;
+        expectedBody += text;
+    }
+    BOOST_CHECK(reply.Finish());
+
+    BOOST_CHECK(connection.str().find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+    BOOST_CHECK(connection.str().find("Content-Length") == std::string::npos);
+    BOOST_CHECK_EQUAL(connection.str().substr(connection.str().size() - 5), "0\r\n\r\n");
+    BOOST_CHECK(ChunkedReplyBody(connection.str()) == expectedBody);
+}
+
+BOOST_AUTO_TEST_CASE(unchunkedRepliesAreSentWithContentLength)
+{
+    std::ostringstream connection;
+    HTTPStreamedReply reply(connection, HTTP_OK, false, false);
+    reply.Body() << "{\"result\":1}\n";
+    BOOST_CHECK(connection.str().empty());
+    BOOST_CHECK(reply.Finish());
+
+    BOOST_CHECK(connection.str().find("Content-Length: 13\r\n") != std::string::npos);
+    BOOST_CHECK_EQUAL(ChunkedReplyBody(connection.str()), "{\"result\":1}\n");
+}
+
+BOOST_AUTO_TEST_CASE(chunkedMessagesLargerThanTheLimitAreRejected)
+{
+    std::ostringstream connection;
+    HTTPStreamedReply reply(connection, HTTP_OK, true, true);
+    reply.Body() << std::string(1000, 'x');
+    reply.Finish();
+
+    std::istringstream stream(connection.str());
+    int nProto = 0;
+    ReadHTTPStatus(stream, nProto);
+    std::map<std::string, std::string> mapHeaders;
+    std::string strBody;
+    BOOST_CHECK_EQUAL(ReadHTTPMessage(stream, mapHeaders, strBody, nProto, 999), HTTP_INTERNAL_SERVER_ERROR);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,318 @@
+#include <test/MessageReplayHarness.h>
+
+#include <chainparams.h>
+#include <netbase.h>
+#include <Node.h>
+#include <NodeSignals.h>
+#include <tinyformat.h>
+#include <utiltime.h>
+
+#include <algorithm>
+#include <memory>
+#include <sstream>
+#include <string.h>
+
+ReplayCommunicationChannel::ReplayCommunicationChannel(
+    const std::vector<CapturedMessage>& messages,
+    double speed,
+    std::function<int64_t()> clock
+    ): messages_(messages)
+    , speed_(speed)
+    , clock_(clock)
+    , replayStartMicros_(-1)
+    , nextMessage_(0)
+    , offsetInMessage_(0)
+    , bytesSent_(0)
+    , open_(true)
+{
+}
+
+bool ReplayCommunicationChannel::NextMessageIsDue() const
+{
+    if (nextMessage_ >= messages_.size())
+        return false;
+    if (speed_ <= 0.0 || offsetInMessage_ > 0)
+        return true;
+
+    const int64_t now = clock_();
+    if (replayStartMicros_ < 0)
+        replayStartMicros_ = now;
+    const int64_t capturedOffset = messages_[nextMessage_].nTimeMicros - messages_.front().nTimeMicros;
+    return static_cast<double>(now - replayStartMicros_) * speed_ >= static_cast<double>(capturedOffset);
+}
+
+int ReplayCommunicationChannel::sendData(const void* buffer, size_t len) const
+{
+    bytesSent_ += len;
+    return static_cast<int>(len);
+}
+
+int ReplayCommunicationChannel::sendDataBuffers(const std::vector<DataBufferView>& buffers) const
+{
+    size_t totalBytes = 0;
+    for (const DataBufferView& view: buffers)
+        totalBytes += view.len;
+    bytesSent_ += totalBytes;
+    return static_cast<int>(totalBytes);
+}
+
+int ReplayCommunicationChannel::receiveData(void* buffer, size_t len) const
+{
+    unsigned char* destination = static_cast<unsigned char*>(buffer);
+    size_t bytesDelivered = 0;
+    while (bytesDelivered < len && NextMessageIsDue())
+    {
+        const std::vector<unsigned char>& frame = messages_[nextMessage_].frame;
+        const size_t chunk = std::min(len - bytesDelivered, frame.size() - offsetInMessage_);
+        memcpy(destination + bytesDelivered, frame.data() + offsetInMessage_, chunk);
+        bytesDelivered += chunk;
+        offsetInMessage_ += chunk;
+        if (offsetInMessage_ == frame.size())
+        {
+            ++nextMessage_;
+            offsetInMessage_ = 0;
+        }
+    }
+    // Nothing due yet looks like a socket that would block, which the node ignores
+    return bytesDelivered > 0? static_cast<int>(bytesDelivered): -1;
+}
+
+void ReplayCommunicationChannel::close()
+{
+    open_ = false;
+}
+
+bool ReplayCommunicationChannel::isValid() const
+{
+    return open_;
+}
+
+bool ReplayCommunicationChannel::hasErrors(bool logErrors) const
+{
+    return false;
+}
+
+bool ReplayCommunicationChannel::AllMessagesDelivered() const
+{
+    return nextMessage_ >= messages_.size();
+}
+
+uint64_t ReplayCommunicationChannel::BytesSent() const
+{
+    return bytesSent_;
+}
+
+LatencySummary::LatencySummary(
+    ): samples(0)
+    , totalMicros(0)
+    , maxMicros(0)
+{
+    std::fill(histogram, histogram + MessageTypeStatistics::NUMBER_OF_LATENCY_BUCKETS, 0u);
+}
+
+void LatencySummary::Add(int64_t micros)
+{
+    const uint64_t elapsed = micros > 0? static_cast<uint64_t>(micros): 0u;
+    ++samples;
+    totalMicros += elapsed;
+    maxMicros = std::max(maxMicros, elapsed);
+    ++histogram[MessageTypeStatistics::LatencyBucket(elapsed)];
+}
+
+std::string LatencySummary::ToString() const
+{
+    std::ostringstream stream;
+    stream << strprintf("n=%u avg=%.1fus max=%uus [", samples, samples > 0? static_cast<double>(totalMicros) / samples: 0.0, maxMicros);
+    for (unsigned bucket = 0; bucket < MessageTypeStatistics::NUMBER_OF_LATENCY_BUCKETS; ++bucket)
+    {
+        const uint64_t upperBound = MessageTypeStatistics::LatencyBucketUpperBound(bucket);
+        if (bucket > 0)
+            stream << " ";
+        stream << (upperBound > 0? strprintf("<%uus:", upperBound): std::string("rest:")) << histogram[bucket];
+    }
+    stream << "]";
+    return stream.str();
+}
+
+LockWaitProbe::LockWaitProbe(
+    CCriticalSection& lock,
+    int64_t intervalMillis
+    ): lock_(lock)
+    , intervalMillis_(intervalMillis)
+    , stopRequested_(false)
+    , waits_()
+    , thread_(&LockWaitProbe::Run, this)
+{
+}
+
+LockWaitProbe::~LockWaitProbe()
+{
+    Stop();
+}
+
+void LockWaitProbe::Run()
+{
+    while (!stopRequested_)
+    {
+        const int64_t waitStart = GetTimeMicros();
+        {
+            LOCK(lock_);
+            waits_.Add(GetTimeMicros() - waitStart);
+        }
+        MilliSleep(intervalMillis_);
+    }
+}
+
+void LockWaitProbe::Stop()
+{
+    stopRequested_ = true;
+    if (thread_.joinable())
+        thread_.join();
+}
+
+const LatencySummary& LockWaitProbe::Summary() const
+{
+    return waits_;
+}
+
+MessageReplayReport::MessageReplayReport(
+    ): messagesReplayed(0)
+    , bytesReplayed(0)
+    , bytesSent(0)
+    , elapsedMicros(0)
+    , handlerTotals()
+    , mainLockWait()
+    , sharedLockWait()
+{
+}
+
+double MessageReplayReport::MessagesPerSecond() const
+{
+    return elapsedMicros > 0? 1e6 * messagesReplayed / elapsedMicros: 0.0;
+}
+
+double MessageReplayReport::BytesPerSecond() const
+{
+    return elapsedMicros > 0? 1e6 * bytesReplayed / elapsedMicros: 0.0;
+}
+
+std::string MessageReplayReport::ToString() const
+{
+    std::ostringstream stream;
+    stream << strprintf("replayed %u messages (%u bytes) in %.3fs: %.1f msg/s, %.1f kB/s, %u bytes sent\n",
+        messagesReplayed, bytesReplayed, elapsedMicros / 1e6, MessagesPerSecond(), BytesPerSecond() / 1000, bytesSent);
+    for (const auto& commandAndTotals: handlerTotals)
+    {
+        const MessageTypeStatistics::Totals& totals = commandAndTotals.second;
+        if (totals.messagesReceived == 0)
+            continue;
+        LatencySummary handlerTimes;
+        handlerTimes.samples = totals.messagesReceived;
+        handlerTimes.totalMicros = totals.processingMicros;
+        handlerTimes.maxMicros = totals.maxProcessingMicros;
+        std::copy(totals.processingHistogram, totals.processingHistogram + MessageTypeStatistics::NUMBER_OF_LATENCY_BUCKETS, handlerTimes.histogram);
+        stream << strprintf("  %-12s %s\n", commandAndTotals.first, handlerTimes.ToString());
+    }
+    stream << "  cs_main wait       " << mainLockWait.ToString() << "\n";
+    stream << "  shared state wait  " << sharedLockWait.ToString() << "\n";
+    return stream.str();
+}
+
+MessageReplayHarness::MessageReplayHarness(
+    CNodeSignals& nodeSignals,
+    CAddrMan& addressManager,
+    CCriticalSection& mainLock
+    ): nodeSignals_(nodeSignals)
+    , addressManager_(addressManager)
+    , mainLock_(mainLock)
+    , clock_(GetTimeMicros)
+{
+}
+
+void MessageReplayHarness::ReplayPeer(
+    unsigned peerIndex,
+    const std::vector<CapturedMessage>& messages,
+    double speed,
+    CCriticalSection& sharedMessageStateLock,
+    std::map<std::string, MessageTypeStatistics::Totals>& handlerTotals,
+    std::atomic<uint64_t>& bytesSent)
+{
+    ReplayCommunicationChannel channel(messages, speed, clock_);
+    struct in_addr peerAddress;
+    peerAddress.s_addr = htonl(0x0a0b0000 + peerIndex + 1);
+    const CAddress addr(CService(CNetAddr(peerAddress), Params().GetDefaultPort()));
+    std::unique_ptr<CNode> node(CNode::CreateNode(channel, &nodeSignals_, addressManager_, addr, strprintf("replay%u", peerIndex), NodeConnectionFlags::INBOUND_CONN));
+
+    boost::condition_variable messageHandlerCondition;
+    while (!node->IsFlaggedForDisconnection())
+    {
+        if (node->SelectCommunicationMode() == CommsMode::SEND)
+            node->TrySendData();
+        else
+            node->TryReceiveData(messageHandlerCondition);
+
+        bool shouldSleep = true;
+        node->ProcessReceiveMessages(shouldSleep, sharedMessageStateLock);
+        if (node->CanSendMessagesToPeer())
+        {
+            LOCK(sharedMessageStateLock);
+            node->ProcessSendMessages(false);
+        }
+
+        if (shouldSleep && node->GetSendBufferStatus() == NodeBufferStatus::HAS_SPACE)
+        {
+            if (channel.AllMessagesDelivered())
+                break;
+            if (speed > 0.0)
+                MilliSleep(1);
+        }
+    }
+    handlerTotals = node->GetMessageStatistics().GetTotals();
+    bytesSent += channel.BytesSent();
+}
+
+MessageReplayReport MessageReplayHarness::Replay(const std::vector<std::vector<CapturedMessage>>& captures, double speed)
+{
+    MessageReplayReport report;
+    CCriticalSection sharedMessageStateLock;
+    std::vector<std::map<std::string, MessageTypeStatistics::Totals>> handlerTotalsByPeer(captures.size());
+    std::atomic<uint64_t> bytesSent(0);
+
+    LockWaitProbe mainLockProbe(mainLock_, 1);
+    LockWaitProbe sharedLockProbe(sharedMessageStateLock, 1);
+    const int64_t replayStart = clock_();
+    boost::thread_group peerThreads;
+    for (unsigned peerIndex = 0; peerIndex < captures.size(); ++peerIndex)
+    {
+        peerThreads.create_thread([&, peerIndex]() {
+            ReplayPeer(peerIndex, captures[peerIndex], speed, sharedMessageStateLock, handlerTotalsByPeer[peerIndex], bytesSent);
+        });
+    }
+    peerThreads.join_all();
+    report.elapsedMicros = clock_() - replayStart;
+    mainLockProbe.Stop();
+    sharedLockProbe.Stop();
+
+    for (const std::map<std::string, MessageTypeStatistics::Totals>& peerTotals: handlerTotalsByPeer)
+    {
+        for (const auto& commandAndTotals: peerTotals)
+        {
+            const MessageTypeStatistics::Totals& totals = commandAndTotals.second;
+            MessageTypeStatistics::Totals& combined = report.handlerTotals[commandAndTotals.first];
+            combined.messagesReceived += totals.messagesReceived;
+            combined.bytesReceived += totals.bytesReceived;
+            combined.messagesSent += totals.messagesSent;
+            combined.bytesSent += totals.bytesSent;
+            combined.processingMicros += totals.processingMicros;
+            combined.maxProcessingMicros = std::max(combined.maxProcessingMicros, totals.maxProcessingMicros);
+            for (unsigned bucket = 0; bucket < MessageTypeStatistics::NUMBER_OF_LATENCY_BUCKETS; ++bucket)
+                combined.processingHistogram[bucket] += totals.processingHistogram[bucket];
+            report.messagesReplayed += totals.messagesReceived;
+            report.bytesReplayed += totals.bytesReceived;
+        }
+    }
+    report.bytesSent = bytesSent;
+    report.mainLockWait = mainLockProbe.Summary();
+    report.sharedLockWait = sharedLockProbe.Summary();
+    return report;
+}
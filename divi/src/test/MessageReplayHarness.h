@@ -0,0 +1,132 @@
+#ifndef MESSAGE_REPLAY_HARNESS_H
+#define MESSAGE_REPLAY_HARNESS_H
+#include <atomic>
+#include <functional>
+#include <map>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <I_CommunicationChannel.h>
+#include <MessageCapture.h>
+#include <MessageTypeStatistics.h>
+#include <sync.h>
+
+#include <boost/thread.hpp>
+
+class CAddrMan;
+class CNodeSignals;
+
+/** Hands captured frames to a CNode as if they arrived on its socket, releasing each
+ *  frame once its capture time has come. A speed of 2 replays twice as fast as the
+ *  capture, a speed of 0 delivers everything as fast as the node reads it. Sent data
+ *  is counted and dropped. */
+class ReplayCommunicationChannel final: public I_CommunicationChannel
+{
+private:
+    const std::vector<CapturedMessage>& messages_;
+    const double speed_;
+    const std::function<int64_t()> clock_;
+    mutable int64_t replayStartMicros_;
+    mutable size_t nextMessage_;
+    mutable size_t offsetInMessage_;
+    mutable std::atomic<uint64_t> bytesSent_;
+    bool open_;
+
+    bool NextMessageIsDue() const;
+
+public:
+    ReplayCommunicationChannel(
+        const std::vector<CapturedMessage>& messages,
+        double speed,
+        std::function<int64_t()> clock);
+
+    int sendData(const void* buffer, size_t len) const override;
+    int sendDataBuffers(const std::vector<DataBufferView>& buffers) const override;
+    int receiveData(void* buffer, size_t len) const override;
+    void close() override;
+    bool isValid() const override;
+    bool hasErrors(bool logErrors) const override;
+
+    bool AllMessagesDelivered() const;
+    uint64_t BytesSent() const;
+};
+
+struct LatencySummary
+{
+    uint64_t samples;
+    uint64_t totalMicros;
+    uint64_t maxMicros;
+    uint64_t histogram[MessageTypeStatistics::NUMBER_OF_LATENCY_BUCKETS];
+
+    LatencySummary();
+    void Add(int64_t micros);
+    std::string ToString() const;
+};
+
+/** Measures how long a lock makes others wait by taking it at a fixed interval from a
+ *  thread of its own while the replay runs */
+class LockWaitProbe
+{
+private:
+    CCriticalSection& lock_;
+    const int64_t intervalMillis_;
+    std::atomic<bool> stopRequested_;
+    LatencySummary waits_;
+    boost::thread thread_;
+
+    void Run();
+
+public:
+    LockWaitProbe(CCriticalSection& lock, int64_t intervalMillis);
+    ~LockWaitProbe();
+    /** Stops probing; the summary is only valid afterwards */
+    void Stop();
+    const LatencySummary& Summary() const;
+};
+
+struct MessageReplayReport
+{
+    uint64_t messagesReplayed;
+    uint64_t bytesReplayed;
+    uint64_t bytesSent;
+    int64_t elapsedMicros;
+    std::map<std::string, MessageTypeStatistics::Totals> handlerTotals;
+    LatencySummary mainLockWait;
+    LatencySummary sharedLockWait;
+
+    MessageReplayReport();
+    double MessagesPerSecond() const;
+    double BytesPerSecond() const;
+    std::string ToString() const;
+};
+
+/** Replays captures (see -capturemessages) into the message handling code of this
+ *  process. Every capture becomes an inbound peer served by a thread of its own, and
+ *  all of them share one lock for the work that cannot run concurrently, as the
+ *  message handler threads do. */
+class MessageReplayHarness
+{
+private:
+    CNodeSignals& nodeSignals_;
+    CAddrMan& addressManager_;
+    CCriticalSection& mainLock_;
+    const std::function<int64_t()> clock_;
+
+    void ReplayPeer(
+        unsigned peerIndex,
+        const std::vector<CapturedMessage>& messages,
+        double speed,
+        CCriticalSection& sharedMessageStateLock,
+        std::map<std::string, MessageTypeStatistics::Totals>& handlerTotals,
+        std::atomic<uint64_t>& bytesSent);
+
+public:
+    MessageReplayHarness(
+        CNodeSignals& nodeSignals,
+        CAddrMan& addressManager,
+        CCriticalSection& mainLock);
+
+    MessageReplayReport Replay(const std::vector<std::vector<CapturedMessage>>& captures, double speed);
+};
+#endif// MESSAGE_REPLAY_HARNESS_H
@@ -0,0 +1,200 @@
+// Copyright (c) 2020 The DIVI developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <test/MessageReplayHarness.h>
+
+#include <chainparams.h>
+#include <clientversion.h>
+#include <hash.h>
+#include <main.h>
+#include <net.h>
+#include <Node.h>
+#include <NodeSignals.h>
+#include <protocol.h>
+#include <random.h>
+#include <streams.h>
+#include <timedata.h>
+#include <utiltime.h>
+#include <version.h>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <cstdlib>
+
+extern CCriticalSection cs_main;
+
+namespace
+{
+
+template <typename ...Args>
+CapturedMessage MakeCapturedMessage(int64_t nTimeMicros, const char* command, Args&&... args)
+{
+    CDataStream payload(SER_NETWORK, PROTOCOL_VERSION);
+    NetworkMessageSerializer::SerializeNextArgument(payload, std::forward<Args>(args)...);
+    CMessageHeader header(command, payload.size());
+    const uint256 hash = Hash(payload.begin(), payload.end());
+    memcpy(&header.nChecksum, &hash, sizeof(header.nChecksum));
+
+    CDataStream headerStream(SER_NETWORK, PROTOCOL_VERSION);
+    headerStream << header;
+
+    CapturedMessage message;
+    message.nTimeMicros = nTimeMicros;
+    message.frame.assign(headerStream.begin(), headerStream.end());
+    message.frame.insert(message.frame.end(), payload.begin(), payload.end());
+    return message;
+}
+
+std::vector<CapturedMessage> CaptureOfHandshakeAndPings(int64_t startMicros, int64_t spacingMicros, unsigned numberOfPings)
+{
+    std::vector<CapturedMessage> messages;
+    const CAddress addrMe(CService("127.0.0.1", Params().GetDefaultPort()));
+    const CAddress addrYou(CService("10.0.0.1", Params().GetDefaultPort()));
+    messages.push_back(MakeCapturedMessage(startMicros, "version",
+        PROTOCOL_VERSION, uint64_t(NODE_NETWORK), GetAdjustedTime(), addrMe, addrYou, GetRand(1 << 30), std::string("/replay/"), 0, true));
+    messages.push_back(MakeCapturedMessage(startMicros + spacingMicros, "verack"));
+    for (unsigned ping = 0; ping < numberOfPings; ++ping)
+        messages.push_back(MakeCapturedMessage(startMicros + (ping + 2) * spacingMicros, "ping", uint64_t(ping + 1)));
+    return messages;
+}
+
+boost::filesystem::path TemporaryCapturePath()
+{
+    return boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("capture_%%%%%%%%.dat");
+}
+
+struct ManualClock
+{
+    int64_t now = 0;
+    std::function<int64_t()> AsFunction() { return [this]() { return now; }; }
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(MessageReplay_tests)
+
+BOOST_AUTO_TEST_CASE(capturedMessagesAreReadBackInOrder)
+{
+    const boost::filesystem::path path = TemporaryCapturePath();
+    const std::vector<CapturedMessage> original = CaptureOfHandshakeAndPings(1000, 500, 3);
+    {
+        MessageCaptureWriter writer(path);
+        BOOST_REQUIRE(writer.IsOpen());
+        for (const CapturedMessage& message: original)
+        {
+            const char* frameStart = reinterpret_cast<const char*>(message.frame.data());
+            CDataStream frame(frameStart, frameStart + message.frame.size(), SER_NETWORK, PROTOCOL_VERSION);
+            CMessageHeader header;
+            frame >> header;
+            writer.Write(message.nTimeMicros, header, frame);
+        }
+    }
+
+    const std::vector<CapturedMessage> readBack = MessageCaptureReader::ReadAll(path);
+    BOOST_REQUIRE_EQUAL(readBack.size(), original.size());
+    for (unsigned index = 0; index < original.size(); ++index)
+    {
+        BOOST_CHECK_EQUAL(readBack[index].nTimeMicros, original[index].nTimeMicros);
+        BOOST_CHECK(readBack[index].frame == original[index].frame);
+    }
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(truncatedCaptureStopsAtLastCompleteMessage)
+{
+    const boost::filesystem::path path = TemporaryCapturePath();
+    const std::vector<CapturedMessage> original = CaptureOfHandshakeAndPings(0, 1, 2);
+    {
+        CAutoFile file(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        for (const CapturedMessage& message: original)
+            file << message;
+    }
+    boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 3);
+
+    BOOST_CHECK_EQUAL(MessageCaptureReader::ReadAll(path).size(), original.size() - 1);
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(channelReleasesMessagesAtTheirScaledCaptureTime)
+{
+    const std::vector<CapturedMessage> messages = CaptureOfHandshakeAndPings(5000000, 1000, 2);
+    ManualClock clock;
+    ReplayCommunicationChannel channel(messages, 2.0, clock.AsFunction());
+    std::vector<unsigned char> buffer(1 << 16);
+
+    BOOST_CHECK_EQUAL(channel.receiveData(buffer.data(), buffer.size()), static_cast<int>(messages[0].frame.size()));
+    BOOST_CHECK_EQUAL(channel.receiveData(buffer.data(), buffer.size()), -1);
+    BOOST_CHECK(!channel.hasErrors(false));
+
+    clock.now += 499;
+    BOOST_CHECK_EQUAL(channel.receiveData(buffer.data(), buffer.size()), -1);
+    clock.now += 1;
+    BOOST_CHECK_EQUAL(channel.receiveData(buffer.data(), buffer.size()), static_cast<int>(messages[1].frame.size()));
+
+    clock.now += 1000;
+    BOOST_CHECK(!channel.AllMessagesDelivered());
+    BOOST_CHECK_EQUAL(channel.receiveData(buffer.data(), buffer.size()), static_cast<int>(messages[2].frame.size() + messages[3].frame.size()));
+    BOOST_CHECK(channel.AllMessagesDelivered());
+}
+
+BOOST_AUTO_TEST_CASE(channelSplitsFramesAcrossSmallReads)
+{
+    const std::vector<CapturedMessage> messages = CaptureOfHandshakeAndPings(0, 1000000, 1);
+    ReplayCommunicationChannel channel(messages, 0.0, GetTimeMicros);
+    std::vector<unsigned char> received;
+    unsigned char buffer[7];
+    int bytes;
+    while ((bytes = channel.receiveData(buffer, sizeof(buffer))) > 0)
+        received.insert(received.end(), buffer, buffer + bytes);
+
+    std::vector<unsigned char> expected;
+    for (const CapturedMessage& message: messages)
+        expected.insert(expected.end(), message.frame.begin(), message.frame.end());
+    BOOST_CHECK(received == expected);
+    BOOST_CHECK_EQUAL(channel.sendData(buffer, 5), 5);
+    BOOST_CHECK_EQUAL(channel.BytesSent(), 5u);
+}
+
+BOOST_AUTO_TEST_CASE(replayRunsCapturesThroughTheMessageHandlers)
+{
+    std::vector<std::vector<CapturedMessage>> captures;
+    captures.push_back(CaptureOfHandshakeAndPings(0, 10, 20));
+    captures.push_back(CaptureOfHandshakeAndPings(0, 10, 5));
+
+    MessageReplayHarness harness(GetNodeSignals(), GetNetworkAddressManager(), cs_main);
+    const MessageReplayReport report = harness.Replay(captures, 0.0);
+    BOOST_TEST_MESSAGE(report.ToString());
+
+    BOOST_CHECK_EQUAL(report.messagesReplayed, 29u);
+    BOOST_CHECK_EQUAL(report.handlerTotals.at("version").messagesReceived, 2u);
+    BOOST_CHECK_EQUAL(report.handlerTotals.at("ping").messagesReceived, 25u);
+    BOOST_CHECK_EQUAL(report.handlerTotals.at("pong").messagesSent, 25u);
+    BOOST_CHECK_GT(report.bytesSent, 0u);
+    BOOST_CHECK_GT(report.elapsedMicros, 0);
+}
+
+/** Benchmarks a real capture: DIVI_REPLAY_CAPTURE=<file>[,<file>...] DIVI_REPLAY_SPEED=<factor, 0 for full speed> */
+BOOST_AUTO_TEST_CASE(replayCapturesNamedInTheEnvironment)
+{
+    const char* captureFiles = getenv("DIVI_REPLAY_CAPTURE");
+    if (!captureFiles)
+        return;
+    const char* speedSetting = getenv("DIVI_REPLAY_SPEED");
+    const double speed = speedSetting? atof(speedSetting): 0.0;
+
+    std::vector<std::string> paths;
+    boost::split(paths, captureFiles, boost::is_any_of(","));
+    std::vector<std::vector<CapturedMessage>> captures;
+    for (const std::string& path: paths)
+        captures.push_back(MessageCaptureReader::ReadAll(path));
+
+    MessageReplayHarness harness(GetNodeSignals(), GetNetworkAddressManager(), cs_main);
+    const MessageReplayReport report = harness.Replay(captures, speed);
+    BOOST_TEST_MESSAGE(report.ToString());
+    BOOST_CHECK_GT(report.messagesReplayed, 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,104 @@
+// Copyright (c) 2020 The DIVI developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <MessageTypeStatistics.h>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(MessageTypeStatistics_tests)
+
+BOOST_AUTO_TEST_CASE(onlyCommandsWithTrafficAreReported)
+{
+    MessageTypeStatistics statistics;
+    BOOST_CHECK(statistics.GetTotals().empty());
+
+    statistics.RecordReceived("inv", 61);
+    statistics.RecordReceived("inv", 97);
+    statistics.RecordSent("getdata", 61);
+
+    const std::map<std::string, MessageTypeStatistics::Totals> totals = statistics.GetTotals();
+    BOOST_CHECK_EQUAL(totals.size(), 2u);
+    BOOST_CHECK_EQUAL(totals.at("inv").messagesReceived, 2u);
+    BOOST_CHECK_EQUAL(totals.at("inv").bytesReceived, 158u);
+    BOOST_CHECK_EQUAL(totals.at("inv").messagesSent, 0u);
+    BOOST_CHECK_EQUAL(totals.at("getdata").messagesSent, 1u);
+    BOOST_CHECK_EQUAL(totals.at("getdata").bytesSent, 61u);
+}
+
+BOOST_AUTO_TEST_CASE(unknownCommandsShareOneEntry)
+{
+    MessageTypeStatistics statistics;
+    statistics.RecordReceived("nonsense", 24);
+    statistics.RecordReceived("gibberish", 30);
+
+    const std::map<std::string, MessageTypeStatistics::Totals> totals = statistics.GetTotals();
+    BOOST_CHECK_EQUAL(totals.size(), 1u);
+    BOOST_CHECK_EQUAL(totals.at(MessageTypeStatistics::OTHER_COMMAND).messagesReceived, 2u);
+    BOOST_CHECK_EQUAL(totals.at(MessageTypeStatistics::OTHER_COMMAND).bytesReceived, 54u);
+}
+
+BOOST_AUTO_TEST_CASE(processingTimeKeepsTotalAndMaximum)
+{
+    MessageTypeStatistics statistics;
+    statistics.RecordReceived("block", 1000);
+    statistics.RecordProcessingTime("block", 250);
+    statistics.RecordProcessingTime("block", 4000);
+    statistics.RecordProcessingTime("block", 750);
+    statistics.RecordProcessingTime("block", -5);
+
+    const MessageTypeStatistics::Totals totals = statistics.GetTotals().at("block");
+    BOOST_CHECK_EQUAL(totals.processingMicros, 5000u);
+    BOOST_CHECK_EQUAL(totals.maxProcessingMicros, 4000u);
+}
+
+BOOST_AUTO_TEST_CASE(processingTimesAreBucketedByDecade)
+{
+    BOOST_CHECK_EQUAL(MessageTypeStatistics::LatencyBucket(0), 0u);
+    BOOST_CHECK_EQUAL(MessageTypeStatistics::LatencyBucket(9), 0u);
+    BOOST_CHECK_EQUAL(MessageTypeStatistics::LatencyBucket(10), 1u);
+    BOOST_CHECK_EQUAL(MessageTypeStatistics::LatencyBucket(999999), 5u);
+    BOOST_CHECK_EQUAL(MessageTypeStatistics::LatencyBucket(1000000), 6u);
+    BOOST_CHECK_EQUAL(MessageTypeStatistics::LatencyBucket(1000000000), 6u);
+    BOOST_CHECK_EQUAL(MessageTypeStatistics::LatencyBucketUpperBound(0), 10u);
+    BOOST_CHECK_EQUAL(MessageTypeStatistics::LatencyBucketUpperBound(5), 1000000u);
+    BOOST_CHECK_EQUAL(MessageTypeStatistics::LatencyBucketUpperBound(6), 0u);
+
+    MessageTypeStatistics statistics;
+    statistics.RecordReceived("getdata", 61);
+    statistics.RecordProcessingTime("getdata", 5);
+    statistics.RecordProcessingTime("getdata", 50);
+    statistics.RecordProcessingTime("getdata", 70);
+    statistics.RecordProcessingTime("getdata", 5000000);
+
+    const MessageTypeStatistics::Totals totals = statistics.GetTotals().at("getdata");
+    BOOST_CHECK_EQUAL(totals.processingHistogram[0], 1u);
+    BOOST_CHECK_EQUAL(totals.processingHistogram[1], 2u);
+    BOOST_CHECK_EQUAL(totals.processingHistogram[2], 0u);
+    BOOST_CHECK_EQUAL(totals.processingHistogram[6], 1u);
+}
+
+BOOST_AUTO_TEST_CASE(recordsAreAddedToTheAggregate)
+{
+    MessageTypeStatistics aggregate;
+    MessageTypeStatistics firstPeer(&aggregate);
+    MessageTypeStatistics secondPeer(&aggregate);
+
+    firstPeer.RecordReceived("tx", 250);
+    firstPeer.RecordProcessingTime("tx", 100);
+    secondPeer.RecordReceived("tx", 300);
+    secondPeer.RecordProcessingTime("tx", 40);
+    secondPeer.RecordSent("ping", 32);
+
+    BOOST_CHECK_EQUAL(firstPeer.GetTotals().size(), 1u);
+    BOOST_CHECK_EQUAL(secondPeer.GetTotals().at("tx").bytesReceived, 300u);
+
+    const std::map<std::string, MessageTypeStatistics::Totals> totals = aggregate.GetTotals();
+    BOOST_CHECK_EQUAL(totals.at("tx").messagesReceived, 2u);
+    BOOST_CHECK_EQUAL(totals.at("tx").bytesReceived, 550u);
+    BOOST_CHECK_EQUAL(totals.at("tx").processingMicros, 140u);
+    BOOST_CHECK_EQUAL(totals.at("tx").maxProcessingMicros, 100u);
+    BOOST_CHECK_EQUAL(totals.at("ping").messagesSent, 1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
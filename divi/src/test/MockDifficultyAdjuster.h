@@ -0,0 +1,12 @@
+#ifndef MOCK_DIFFICULTY_ADJUSTER_H
+#define MOCK_DIFFICULTY_ADJUSTER_H
+#include <I_DifficultyAdjuster.h>
+
+#include <gmock/gmock.h>
+
+class MockDifficultyAdjuster: public I_DifficultyAdjuster
+{
+public:
+    MOCK_CONST_METHOD1(computeNextBlockDifficulty, unsigned(const CBlockIndex* chainTip));
+};
+#endif // MOCK_DIFFICULTY_ADJUSTER_H
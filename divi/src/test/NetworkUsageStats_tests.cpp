@@ -0,0 +1,67 @@
+// Copyright (c) 2020 The DIVI developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <Node.h>
+
+#include <chainparams.h>
+#include <defaultValues.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+
+struct UploadTargetFixture
+{
+    UploadTargetFixture()
+    {
+        NetworkUsageStats::SetMaxOutboundTarget(0);
+        NetworkUsageStats::SetMaxOutboundTimeframe(MAX_UPLOAD_TIMEFRAME);
+    }
+    ~UploadTargetFixture()
+    {
+        NetworkUsageStats::SetMaxOutboundTarget(0);
+    }
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(NetworkUsageStats_tests, UploadTargetFixture)
+
+BOOST_AUTO_TEST_CASE(withoutTargetNothingIsLimited)
+{
+    NetworkUsageStats::RecordBytesSent(1000 * 1000 * 1000);
+    BOOST_CHECK(!NetworkUsageStats::OutboundTargetReached(false));
+    BOOST_CHECK(!NetworkUsageStats::OutboundTargetReached(true));
+    BOOST_CHECK_EQUAL(NetworkUsageStats::GetOutboundTargetBytesLeft(), 0u);
+    BOOST_CHECK_EQUAL(NetworkUsageStats::GetMaxOutboundTimeLeftInCycle(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(historicalBlocksStopBeforeTheTargetIsReached)
+{
+    // Start a fresh cycle with a block relay reserve of about ten blocks
+    const uint64_t timeframe = 10 * Params().TargetSpacing();
+    NetworkUsageStats::SetMaxOutboundTimeframe(timeframe + 1);
+    const uint64_t target = 20 * UPLOAD_TARGET_RESERVE_PER_BLOCK;
+    NetworkUsageStats::SetMaxOutboundTarget(target);
+    NetworkUsageStats::RecordBytesSent(0);
+
+    const uint64_t bytesLeft = NetworkUsageStats::GetOutboundTargetBytesLeft();
+    BOOST_CHECK(bytesLeft <= target);
+    BOOST_CHECK(NetworkUsageStats::GetMaxOutboundTimeLeftInCycle() <= timeframe + 1);
+    BOOST_CHECK(!NetworkUsageStats::OutboundTargetReached(false));
+    BOOST_CHECK(!NetworkUsageStats::OutboundTargetReached(true));
+
+    // Eating into the block relay reserve stops historical blocks only
+    NetworkUsageStats::RecordBytesSent(bytesLeft - 5 * UPLOAD_TARGET_RESERVE_PER_BLOCK);
+    BOOST_CHECK(!NetworkUsageStats::OutboundTargetReached(false));
+    BOOST_CHECK(NetworkUsageStats::OutboundTargetReached(true));
+    BOOST_CHECK_EQUAL(NetworkUsageStats::GetOutboundTargetBytesLeft(), 5 * UPLOAD_TARGET_RESERVE_PER_BLOCK);
+
+    NetworkUsageStats::RecordBytesSent(5 * UPLOAD_TARGET_RESERVE_PER_BLOCK);
+    BOOST_CHECK(NetworkUsageStats::OutboundTargetReached(false));
+    BOOST_CHECK_EQUAL(NetworkUsageStats::GetOutboundTargetBytesLeft(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,140 @@
+#include <PeerMessageScheduler.h>
+
+#include <utiltime.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+template <typename Predicate>
+bool WaitUntil(Predicate predicate, int64_t timeoutInMilliseconds = 5000)
+{
+    const int64_t deadline = GetTimeMillis() + timeoutInMilliseconds;
+    while(!predicate())
+    {
+        if(GetTimeMillis() > deadline) return false;
+        MilliSleep(1);
+    }
+    return true;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(PeerMessageScheduler_tests)
+
+BOOST_AUTO_TEST_CASE(willNotSchedulePeerAgainWhileItsTurnIsPending)
+{
+    PeerMessageScheduler scheduler(1u);
+    std::atomic<bool> releaseTurn(false);
+    std::atomic<int> turnsRun(0);
+    auto blockingTurn = [&releaseTurn,&turnsRun]()
+    {
+        while(!releaseTurn) MilliSleep(1);
+        ++turnsRun;
+        return false;
+    };
+
+    BOOST_CHECK(scheduler.SchedulePeer(NodeId(1), blockingTurn));
+    BOOST_CHECK(!scheduler.SchedulePeer(NodeId(1), blockingTurn));
+    BOOST_CHECK(scheduler.PeerIsScheduled(NodeId(1)));
+
+    releaseTurn = true;
+    BOOST_CHECK(WaitUntil([&scheduler](){ return !scheduler.PeerIsScheduled(NodeId(1)); }));
+    BOOST_CHECK_EQUAL(turnsRun, 1);
+
+    BOOST_CHECK(scheduler.SchedulePeer(NodeId(1), blockingTurn));
+    BOOST_CHECK(WaitUntil([&turnsRun](){ return turnsRun == 2; }));
+}
+
+BOOST_AUTO_TEST_CASE(willNeverRunTurnsOfTheSamePeerConcurrently)
+{
+    constexpr int numberOfPeers = 4;
+    constexpr int turnsPerPeer = 50;
+    PeerMessageScheduler scheduler(4u);
+    BOOST_CHECK_EQUAL(scheduler.NumberOfThreads(), 4u);
+
+    std::vector<std::unique_ptr<std::atomic<int>>> activeTurns;
+    std::vector<std::unique_ptr<std::atomic<int>>> completedTurns;
+    std::atomic<bool> overlapDetected(false);
+    for(int peer = 0; peer < numberOfPeers; ++peer)
+    {
+        activeTurns.emplace_back(new std::atomic<int>(0));
+        completedTurns.emplace_back(new std::atomic<int>(0));
+    }
+    for(int peer = 0; peer < numberOfPeers; ++peer)
+    {
+        std::atomic<int>& active = *activeTurns[peer];
+        std::atomic<int>& completed = *completedTurns[peer];
+        BOOST_CHECK(scheduler.SchedulePeer(NodeId(peer),
+            [&active,&completed,&overlapDetected]()
+            {
+                if(++active > 1) overlapDetected = true;
+                MilliSleep(1);
+                --active;
+                return ++completed < turnsPerPeer;
+            }));
+    }
+
+    BOOST_CHECK(WaitUntil([&scheduler](){ return scheduler.NumberOfScheduledPeers() == 0u; }));
+    BOOST_CHECK(!overlapDetected);
+    for(int peer = 0; peer < numberOfPeers; ++peer)
+    {
+        BOOST_CHECK_EQUAL(*completedTurns[peer], turnsPerPeer);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(willRequeueBusyPeersBehindOtherReadyPeers)
+{
+    PeerMessageScheduler scheduler(1u);
+    std::atomic<bool> releaseFirstTurn(false);
+    std::atomic<int> busyPeerTurns(0);
+    std::atomic<int> busyPeerTurnsBeforeQuietPeerRan(-1);
+
+    BOOST_CHECK(scheduler.SchedulePeer(NodeId(1),
+        [&releaseFirstTurn,&busyPeerTurns]()
+        {
+            while(!releaseFirstTurn) MilliSleep(1);
+            return ++busyPeerTurns < 100;
+        }));
+    BOOST_CHECK(scheduler.SchedulePeer(NodeId(2),
+        [&busyPeerTurns,&busyPeerTurnsBeforeQuietPeerRan]()
+        {
+            busyPeerTurnsBeforeQuietPeerRan = busyPeerTurns.load();
+            return false;
+        }));
+
+    releaseFirstTurn = true;
+    BOOST_CHECK(WaitUntil([&scheduler](){ return scheduler.NumberOfScheduledPeers() == 0u; }));
+    BOOST_CHECK_EQUAL(busyPeerTurns, 100);
+    BOOST_CHECK_EQUAL(busyPeerTurnsBeforeQuietPeerRan, 1);
+}
+
+BOOST_AUTO_TEST_CASE(willReleaseQueuedTurnsWhenStopped)
+{
+    PeerMessageScheduler scheduler(1u);
+    std::atomic<bool> turnStarted(false);
+    std::shared_ptr<int> resourceHeldByTurn = std::make_shared<int>(0);
+    std::weak_ptr<int> observer = resourceHeldByTurn;
+
+    BOOST_CHECK(scheduler.SchedulePeer(NodeId(1),
+        [&turnStarted]()
+        {
+            turnStarted = true;
+            boost::this_thread::sleep_for(boost::chrono::seconds(60));
+            return false;
+        }));
+    BOOST_CHECK(WaitUntil([&turnStarted](){ return turnStarted.load(); }));
+    BOOST_CHECK(scheduler.SchedulePeer(NodeId(2), [resourceHeldByTurn](){ return false; }));
+    resourceHeldByTurn.reset();
+    BOOST_CHECK(!observer.expired());
+
+    scheduler.Stop();
+    BOOST_CHECK(observer.expired());
+    BOOST_CHECK_EQUAL(scheduler.NumberOfScheduledPeers(), 0u);
+    BOOST_CHECK(!scheduler.SchedulePeer(NodeId(3), [](){ return false; }));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,150 @@
+#include <test_only.h>
+
+#include <PipelinedBlockScanner.h>
+#include <I_BlockDataReader.h>
+#include <chain.h>
+#include <primitives/transaction.h>
+#include <test/FakeBlockIndexChain.h>
+
+#include <atomic>
+#include <set>
+#include <vector>
+#include <boost/thread/thread.hpp>
+
+namespace
+{
+/** Every block holds a transaction tagged with its height, plus one with two outputs
+ *  at even heights. Reads of lower blocks take longer, so that they finish out of order. */
+class FakeBlockDataReader final: public I_BlockDataReader
+{
+public:
+    std::set<int> unreadableHeights;
+    mutable std::atomic<unsigned> numberOfReads;
+
+    FakeBlockDataReader(): unreadableHeights(), numberOfReads(0u) {}
+
+    bool ReadBlock(const CBlockIndex* blockIndex, CBlock& block) const override
+    {
+        ++numberOfReads;
+        boost::this_thread::sleep_for(boost::chrono::microseconds(std::max(0, 2000 - 20 * blockIndex->nHeight)));
+        if(unreadableHeights.count(blockIndex->nHeight) > 0) return false;
+
+        block = CBlock();
+        CMutableTransaction taggedTransaction;
+        taggedTransaction.nLockTime = blockIndex->nHeight;
+        taggedTransaction.vout.push_back(CTxOut(COIN, CScript()));
+        block.vtx.push_back(taggedTransaction);
+        if(blockIndex->nHeight % 2 == 0)
+        {
+            CMutableTransaction payment;
+            payment.nLockTime = blockIndex->nHeight;
+            payment.vout.resize(2u, CTxOut(COIN, CScript()));
+            block.vtx.push_back(payment);
+        }
+        return true;
+    }
+    bool ReadBlockUndo(const CBlockIndex*, CBlockUndo&) const override
+    {
+        return false;
+    }
+};
+
+struct PipelinedBlockScannerTestFixture
+{
+    FakeBlockIndexWithHashes fakeChain;
+    FakeBlockDataReader blockReader;
+
+    PipelinedBlockScannerTestFixture(
+        ): fakeChain(100u, 1600000000u, 4u)
+        , blockReader()
+    {
+    }
+
+    std::vector<const CBlockIndex*> blocksBetween(int firstHeight, int lastHeight) const
+    {
+        std::vector<const CBlockIndex*> blocks;
+        for(int height = firstHeight; height <= lastHeight; ++height) blocks.push_back((*fakeChain.activeChain)[height]);
+        return blocks;
+    }
+
+    static bool hasTwoOutputs(const CTransaction& tx)
+    {
+        return tx.vout.size() == 2u;
+    }
+};
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(PipelinedBlockScanner_tests, PipelinedBlockScannerTestFixture)
+
+BOOST_AUTO_TEST_CASE(handsBackEveryBlockInChainOrder)
+{
+    PipelinedBlockScanner scanner(blockReader, hasTwoOutputs, 4u);
+    const std::vector<const CBlockIndex*> blocks = blocksBetween(1, 60);
+    scanner.scan(blocks);
+
+    std::vector<const CBlockIndex*> scannedBlocks;
+    for(std::unique_ptr<PipelinedBlockScanner::ScannedBlock> scannedBlock = scanner.nextBlock(); scannedBlock; scannedBlock = scanner.nextBlock())
+    {
+        BOOST_CHECK(scannedBlock->readSucceeded);
+        BOOST_CHECK_EQUAL(scannedBlock->block.vtx[0].nLockTime, static_cast<unsigned>(scannedBlock->blockIndex->nHeight));
+        scannedBlocks.push_back(scannedBlock->blockIndex);
+    }
+    BOOST_CHECK(scannedBlocks == blocks);
+    BOOST_CHECK(!scanner.nextBlock());
+}
+
+BOOST_AUTO_TEST_CASE(reportsTheTransactionsTheFilterAccepts)
+{
+    PipelinedBlockScanner scanner(blockReader, hasTwoOutputs, 3u);
+    scanner.scan(blocksBetween(10, 20));
+
+    for(std::unique_ptr<PipelinedBlockScanner::ScannedBlock> scannedBlock = scanner.nextBlock(); scannedBlock; scannedBlock = scanner.nextBlock())
+    {
+        const std::vector<unsigned> expectedMatches = scannedBlock->blockIndex->nHeight % 2 == 0? std::vector<unsigned>{1u}: std::vector<unsigned>{};
+        BOOST_CHECK(scannedBlock->matchingTransactions == expectedMatches);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(reportsBlocksThatCouldNotBeRead)
+{
+    blockReader.unreadableHeights.insert(5);
+    PipelinedBlockScanner scanner(blockReader, hasTwoOutputs, 2u);
+    scanner.scan(blocksBetween(1, 8));
+
+    for(std::unique_ptr<PipelinedBlockScanner::ScannedBlock> scannedBlock = scanner.nextBlock(); scannedBlock; scannedBlock = scanner.nextBlock())
+    {
+        BOOST_CHECK_EQUAL(scannedBlock->readSucceeded, scannedBlock->blockIndex->nHeight != 5);
+        BOOST_CHECK(scannedBlock->readSucceeded || scannedBlock->matchingTransactions.empty());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(dropsTheRestOfARunWhenANewOneStarts)
+{
+    PipelinedBlockScanner scanner(blockReader, hasTwoOutputs, 4u);
+    scanner.scan(blocksBetween(1, 50));
+    BOOST_CHECK_EQUAL(scanner.nextBlock()->blockIndex->nHeight, 1);
+    BOOST_CHECK_EQUAL(scanner.nextBlock()->blockIndex->nHeight, 2);
+
+    const std::vector<const CBlockIndex*> blocks = blocksBetween(70, 80);
+    scanner.scan(blocks);
+    std::vector<const CBlockIndex*> scannedBlocks;
+    for(std::unique_ptr<PipelinedBlockScanner::ScannedBlock> scannedBlock = scanner.nextBlock(); scannedBlock; scannedBlock = scanner.nextBlock())
+    {
+        scannedBlocks.push_back(scannedBlock->blockIndex);
+    }
+    BOOST_CHECK(scannedBlocks == blocks);
+}
+
+BOOST_AUTO_TEST_CASE(readsNoFurtherAheadThanAllowed)
+{
+    PipelinedBlockScanner scanner(blockReader, hasTwoOutputs, 4u, 5u);
+    scanner.scan(blocksBetween(1, 90));
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+    BOOST_CHECK(blockReader.numberOfReads <= 5u);
+
+    BOOST_CHECK(scanner.nextBlock());
+    boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+    BOOST_CHECK(blockReader.numberOfReads <= 6u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,169 @@
+#include <Node.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+class FakeCommunicationChannel final: public I_CommunicationChannel
+{
+public:
+    mutable std::string sentData;
+    mutable std::vector<size_t> buffersPerSend;
+    mutable unsigned sendBacklogNotifications;
+    int maxBytesPerSend;
+
+    FakeCommunicationChannel(): sentData(), buffersPerSend(), sendBacklogNotifications(0u), maxBytesPerSend(0)
+    {
+    }
+    virtual int sendData(const void* buffer, size_t len) const
+    {
+        return sendDataBuffers(std::vector<DataBufferView>(1, DataBufferView{buffer, len}));
+    }
+    virtual int sendDataBuffers(const std::vector<DataBufferView>& buffers) const
+    {
+        buffersPerSend.push_back(buffers.size());
+        size_t budget = static_cast<size_t>(maxBytesPerSend);
+        int bytesSent = 0;
+        for(const DataBufferView& buffer: buffers)
+        {
+            const size_t bytes = std::min(budget, buffer.len);
+            sentData.append(static_cast<const char*>(buffer.data), bytes);
+            budget -= bytes;
+            bytesSent += static_cast<int>(bytes);
+            if(budget == 0u) break;
+        }
+        return bytesSent;
+    }
+    virtual int receiveData(void* buffer, size_t len) const
+    {
+        return 0;
+    }
+    virtual void close()
+    {
+    }
+    virtual bool isValid() const
+    {
+        return true;
+    }
+    virtual bool hasErrors(bool logErrors) const
+    {
+        return false;
+    }
+    virtual void notifySendBacklog() const
+    {
+        ++sendBacklogNotifications;
+    }
+};
+
+class QueuedMessageConnectionTestFixture
+{
+public:
+    FakeCommunicationChannel channel;
+    bool successfullyConnected;
+    CommunicationLogger logger;
+    QueuedMessageConnection connection;
+
+    QueuedMessageConnectionTestFixture(
+        ): channel()
+        , successfullyConnected(false)
+        , logger()
+        , connection(channel,successfullyConnected,logger)
+    {
+    }
+
+    void PushMessage(const char* command, const std::string& payload)
+    {
+        unsigned messageSize = 0u;
+        connection.PushMessageAndRecordDataSize(messageSize, command, payload);
+    }
+
+    void FlushSendQueue()
+    {
+        for(unsigned attempt = 0; attempt < 1000u && connection.SelectCommunicationMode() == CommsMode::SEND; ++attempt)
+        {
+            connection.TrySendData();
+        }
+    }
+};
+
+std::string ToString(const SharedSerializedMessage& message)
+{
+    return std::string(message->begin(), message->end());
+}
+}
+
+BOOST_FIXTURE_TEST_SUITE(QueuedMessageConnection_tests, QueuedMessageConnectionTestFixture)
+
+BOOST_AUTO_TEST_CASE(willDeliverQueuedMessagesIntactAcrossPartialSends)
+{
+    PushMessage("ping", "first");
+    PushMessage("pong", std::string(1000u, 'x'));
+    PushMessage("inv", "third");
+    BOOST_CHECK(channel.sentData.empty());
+
+    channel.maxBytesPerSend = 7;
+    FlushSendQueue();
+
+    const std::string expected =
+        ToString(NetworkMessageSerializer::SerializeMessage(INIT_PROTO_VERSION, "ping", std::string("first"))) +
+        ToString(NetworkMessageSerializer::SerializeMessage(INIT_PROTO_VERSION, "pong", std::string(1000u, 'x'))) +
+        ToString(NetworkMessageSerializer::SerializeMessage(INIT_PROTO_VERSION, "inv", std::string("third")));
+    BOOST_CHECK(channel.sentData == expected);
+    BOOST_CHECK(connection.GetSendBufferStatus() == NodeBufferStatus::HAS_SPACE);
+}
+
+BOOST_AUTO_TEST_CASE(willSendSeveralQueuedMessagesInOneVectoredSend)
+{
+    PushMessage("ping", "first");
+    PushMessage("pong", "second");
+    PushMessage("inv", "third");
+    channel.buffersPerSend.clear();
+
+    channel.maxBytesPerSend = 1 << 20;
+    FlushSendQueue();
+
+    BOOST_CHECK_EQUAL(channel.buffersPerSend.size(), 1u);
+    BOOST_CHECK_EQUAL(channel.buffersPerSend.front(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE(willReportABacklogOnlyWhenTheOptimisticWriteFallsShort)
+{
+    channel.maxBytesPerSend = 1 << 20;
+    PushMessage("ping", "first");
+    BOOST_CHECK_EQUAL(channel.sendBacklogNotifications, 0u);
+
+    channel.maxBytesPerSend = 7;
+    PushMessage("pong", "second");
+    BOOST_CHECK_EQUAL(channel.sendBacklogNotifications, 1u);
+    // Already waiting for the channel, so no further notification
+    PushMessage("inv", "third");
+    BOOST_CHECK_EQUAL(channel.sendBacklogNotifications, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(willQueueSharedMessagesWithoutCopyingThem)
+{
+    FakeCommunicationChannel otherChannel;
+    bool otherSuccessfullyConnected = false;
+    CommunicationLogger otherLogger;
+    QueuedMessageConnection otherConnection(otherChannel, otherSuccessfullyConnected, otherLogger);
+
+    SharedSerializedMessage sharedMessage = NetworkMessageSerializer::SerializeMessage(INIT_PROTO_VERSION, "block", std::string(5000u, 'b'));
+    connection.PushSerializedMessage(sharedMessage);
+    otherConnection.PushSerializedMessage(sharedMessage);
+    BOOST_CHECK_EQUAL(sharedMessage.use_count(), 3);
+
+    channel.maxBytesPerSend = 1 << 20;
+    otherChannel.maxBytesPerSend = 1 << 20;
+    FlushSendQueue();
+    while(otherConnection.SelectCommunicationMode() == CommsMode::SEND) otherConnection.TrySendData();
+
+    BOOST_CHECK_EQUAL(sharedMessage.use_count(), 1);
+    BOOST_CHECK(channel.sentData == ToString(sharedMessage));
+    BOOST_CHECK(otherChannel.sentData == ToString(sharedMessage));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
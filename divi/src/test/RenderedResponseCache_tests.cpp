@@ -0,0 +1,152 @@
+#include <test/test_only.h>
+
+#include <RenderedResponseCache.h>
+#include <JsonStreamWriter.h>
+#include <NotificationInterface.h>
+#include <test/FakeBlockIndexChain.h>
+#include <chain.h>
+#include <primitives/transaction.h>
+#include <script/script.h>
+#include <json/json_spirit_writer_template.h>
+
+#include <memory>
+#include <string>
+
+namespace
+{
+std::shared_ptr<const std::string> Rendered(const std::string& text)
+{
+    return std::make_shared<const std::string>(text);
+}
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(RenderedResponseCache_tests)
+
+BOOST_AUTO_TEST_CASE(evictsLeastRecentlyUsedResponsesToStayWithinTheByteLimit)
+{
+    RenderedResponseCache cache(30u);
+    const uint256 tip = uint256(7);
+    cache.Insert(uint256(1), RenderedResponseCache::BLOCK_HEX, tip, Rendered(std::string(10u, 'a')));
+    cache.Insert(uint256(2), RenderedResponseCache::BLOCK_HEX, tip, Rendered(std::string(10u, 'b')));
+    cache.Insert(uint256(3), RenderedResponseCache::BLOCK_HEX, tip, Rendered(std::string(10u, 'c')));
+
+    BOOST_CHECK(cache.Get(uint256(1), RenderedResponseCache::BLOCK_HEX, tip));
+    cache.Insert(uint256(4), RenderedResponseCache::BLOCK_HEX, tip, Rendered(std::string(10u, 'd')));
+
+    BOOST_CHECK(cache.Get(uint256(1), RenderedResponseCache::BLOCK_HEX, tip));
+    BOOST_CHECK(!cache.Get(uint256(2), RenderedResponseCache::BLOCK_HEX, tip));
+    BOOST_CHECK(cache.Get(uint256(3), RenderedResponseCache::BLOCK_HEX, tip));
+    BOOST_CHECK(cache.Get(uint256(4), RenderedResponseCache::BLOCK_HEX, tip));
+
+    const RenderedResponseCache::Statistics stats = cache.GetStatistics();
+    BOOST_CHECK_EQUAL(stats.entries, 3u);
+    BOOST_CHECK_EQUAL(stats.bytes, 30u);
+    BOOST_CHECK_EQUAL(stats.evictions, 1u);
+    BOOST_CHECK_EQUAL(stats.hits, 4u);
+    BOOST_CHECK_EQUAL(stats.misses, 1u);
+
+    cache.Insert(uint256(5), RenderedResponseCache::BLOCK_HEX, tip, Rendered(std::string(31u, 'e')));
+    BOOST_CHECK(!cache.Get(uint256(5), RenderedResponseCache::BLOCK_HEX, tip));
+    BOOST_CHECK_EQUAL(cache.GetStatistics().entries, 3u);
+}
+
+BOOST_AUTO_TEST_CASE(jsonResponsesAreOnlyServedAtTheTipTheyWereRenderedAgainst)
+{
+    RenderedResponseCache cache(1000u);
+    const uint256 hash = uint256(1);
+    cache.Insert(hash, RenderedResponseCache::BLOCK_JSON, uint256(10), Rendered("{\"confirmations\":1}"));
+    cache.Insert(hash, RenderedResponseCache::BLOCK_HEX, uint256(10), Rendered("00ff"));
+    cache.Insert(hash, RenderedResponseCache::TRANSACTION_JSON, uint256(10), Rendered("{}"));
+    cache.Insert(hash, RenderedResponseCache::BLOCK_HEADER_JSON, uint256(10), Rendered("{\"version\":4}"));
+
+    BOOST_CHECK(cache.Get(hash, RenderedResponseCache::BLOCK_JSON, uint256(10)));
+    BOOST_CHECK(!cache.Get(hash, RenderedResponseCache::BLOCK_JSON, uint256(11)));
+    BOOST_CHECK(!cache.Get(hash, RenderedResponseCache::BLOCK_JSON, uint256(10)));
+    BOOST_CHECK(!cache.Get(hash, RenderedResponseCache::TRANSACTION_JSON, uint256(11)));
+    BOOST_CHECK(cache.Get(hash, RenderedResponseCache::BLOCK_HEX, uint256(11)));
+    BOOST_CHECK(cache.Get(hash, RenderedResponseCache::BLOCK_HEADER_JSON, uint256(11)));
+}
+
+BOOST_AUTO_TEST_CASE(invalidationDropsEveryFormatOfTheHash)
+{
+    RenderedResponseCache cache(1000u);
+    const uint256 tip = uint256(10);
+    cache.Insert(uint256(1), RenderedResponseCache::BLOCK_JSON, tip, Rendered("{}"));
+    cache.Insert(uint256(1), RenderedResponseCache::BLOCK_BINARY, tip, Rendered("xx"));
+    cache.Insert(uint256(1), RenderedResponseCache::TRANSACTION_HEX, tip, Rendered("ab"));
+    cache.Insert(uint256(2), RenderedResponseCache::BLOCK_BINARY, tip, Rendered("yy"));
+
+    cache.Invalidate(uint256(1));
+
+    BOOST_CHECK(!cache.Get(uint256(1), RenderedResponseCache::BLOCK_JSON, tip));
+    BOOST_CHECK(!cache.Get(uint256(1), RenderedResponseCache::BLOCK_BINARY, tip));
+    BOOST_CHECK(!cache.Get(uint256(1), RenderedResponseCache::TRANSACTION_HEX, tip));
+    BOOST_CHECK(cache.Get(uint256(2), RenderedResponseCache::BLOCK_BINARY, tip));
+    BOOST_CHECK_EQUAL(cache.GetStatistics().invalidations, 3u);
+    BOOST_CHECK_EQUAL(cache.GetStatistics().bytes, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(reorganizationsDropResponsesForDisconnectedBlocksAndTransactions)
+{
+    FakeBlockIndexWithHashes fakeChain(100, 1600000000, 4);
+    const CBlockIndex* oldTip = fakeChain.activeChain->Tip();
+    const CBlockIndex* forkPoint = oldTip->GetAncestor(oldTip->nHeight - 5);
+
+    RenderedResponseCache cache(1000u);
+    MainNotificationSignals signals;
+    cache.RegisterWith(signals);
+    signals.UpdatedBlockTip(oldTip);
+
+    CMutableTransaction disconnectedTx;
+    disconnectedTx.nLockTime = 1234;
+    disconnectedTx.vin.push_back(CTxIn(COutPoint(uint256(7), 0), CScript() << OP_TRUE));
+    const uint256 txid = CTransaction(disconnectedTx).GetHash();
+    const uint256 bareTxid = CTransaction(disconnectedTx).GetBareTxid();
+    BOOST_CHECK(bareTxid != txid);
+    cache.Insert(oldTip->GetBlockHash(), RenderedResponseCache::BLOCK_BINARY, uint256(0), Rendered("old"));
+    cache.Insert(forkPoint->GetBlockHash(), RenderedResponseCache::BLOCK_BINARY, uint256(0), Rendered("fork"));
+    cache.Insert(txid, RenderedResponseCache::TRANSACTION_HEX, uint256(0), Rendered("tx"));
+    cache.Insert(bareTxid, RenderedResponseCache::TRANSACTION_HEX, uint256(0), Rendered("tx"));
+
+    fakeChain.fork(10, 5);
+    signals.SyncTransactions(TransactionVector(1u, CTransaction(disconnectedTx)), nullptr, TransactionSyncType::BLOCK_DISCONNECT);
+    signals.UpdatedBlockTip(fakeChain.activeChain->Tip());
+
+    BOOST_CHECK(!cache.Get(oldTip->GetBlockHash(), RenderedResponseCache::BLOCK_BINARY, uint256(0)));
+    BOOST_CHECK(!cache.Get(txid, RenderedResponseCache::TRANSACTION_HEX, uint256(0)));
+    BOOST_CHECK(!cache.Get(bareTxid, RenderedResponseCache::TRANSACTION_HEX, uint256(0)));
+    BOOST_CHECK(cache.Get(forkPoint->GetBlockHash(), RenderedResponseCache::BLOCK_BINARY, uint256(0)));
+    cache.UnregisterWith(signals);
+}
+
+BOOST_AUTO_TEST_CASE(zeroByteLimitDisablesTheCache)
+{
+    RenderedResponseCache cache(0u);
+    BOOST_CHECK(!cache.IsEnabled());
+    cache.Insert(uint256(1), RenderedResponseCache::BLOCK_HEX, uint256(0), Rendered("00"));
+    BOOST_CHECK(!cache.Get(uint256(1), RenderedResponseCache::BLOCK_HEX, uint256(0)));
+
+    cache.SetMaxBytes(100u);
+    BOOST_CHECK(cache.IsEnabled());
+    cache.Insert(uint256(1), RenderedResponseCache::BLOCK_HEX, uint256(0), Rendered("00"));
+    cache.SetMaxBytes(1u);
+    BOOST_CHECK_EQUAL(cache.GetStatistics().entries, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(cachedJsonIsEmbeddedVerbatimByEitherWriter)
+{
+    const std::string cachedJson = "{\"hash\":\"00ab\",\"tx\":[1,2]}";
+    const JsonProducer producer = [&cachedJson](I_JsonWriter& writer) {
+        writer.BeginObject();
+        writer.Key("result");
+        writer.WriteRaw(cachedJson);
+        writer.WriteField("id", json_spirit::Value(1));
+        writer.EndObject();
+    };
+
+    const std::string expected = "{\"result\":" + cachedJson + ",\"id\":1}";
+    BOOST_CHECK_EQUAL(RenderJson(producer), expected);
+    BOOST_CHECK_EQUAL(json_spirit::write_string(BuildJsonValue(producer), false), expected);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,218 @@
+#include <test/test_only.h>
+
+#include <RpcBatchExecutor.h>
+#include <json/json_spirit_utils.h>
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+namespace
+{
+json_spirit::Object MakeRequest(int id, bool threadSafe)
+{
+    json_spirit::Object request;
+    request.push_back(json_spirit::Pair("id", id));
+    request.push_back(json_spirit::Pair("threadSafe", threadSafe));
+    return request;
+}
+
+bool IsThreadSafe(const json_spirit::Value& request)
+{
+    return json_spirit::find_value(request.get_obj(), "threadSafe").get_bool();
+}
+
+class RecordingHandler
+{
+private:
+    boost::mutex mutex_;
+    std::vector<int> executionOrder_;
+    std::atomic<unsigned> active_;
+    std::atomic<unsigned> maxActive_;
+
+public:
+    RecordingHandler(
+        ): mutex_()
+        , executionOrder_()
+        , active_(0u)
+        , maxActive_(0u)
+    {
+    }
+
+    json_spirit::Object operator()(const json_spirit::Value& request)
+    {
+        const unsigned nowActive = ++active_;
+        unsigned previousMax = maxActive_.load();
+        while (nowActive > previousMax && !maxActive_.compare_exchange_weak(previousMax, nowActive))
+        {
+        }
+        const int id = json_spirit::find_value(request.get_obj(), "id").get_int();
+        boost::this_thread::sleep_for(boost::chrono::milliseconds(IsThreadSafe(request)? 5: 1));
+        {
+            boost::unique_lock<boost::mutex> lock(mutex_);
+            executionOrder_.push_back(id);
+        }
+        --active_;
+
+        json_spirit::Object reply;
+        reply.push_back(json_spirit::Pair("result", id * 10));
+        return reply;
+    }
+
+    std::vector<int> ExecutionOrder()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        return executionOrder_;
+    }
+
+    unsigned MaxActive() const
+    {
+        return maxActive_.load();
+    }
+};
+
+class WorkerPool
+{
+private:
+    boost::asio::io_service service_;
+    std::unique_ptr<boost::asio::io_service::work> work_;
+    boost::thread_group threads_;
+
+public:
+    explicit WorkerPool(
+        unsigned numberOfThreads
+        ): service_()
+        , work_(new boost::asio::io_service::work(service_))
+        , threads_()
+    {
+        for (unsigned thread = 0; thread < numberOfThreads; ++thread)
+            threads_.create_thread(boost::bind(&boost::asio::io_service::run, &service_));
+    }
+
+    ~WorkerPool()
+    {
+        work_.reset();
+        threads_.join_all();
+    }
+
+    RpcBatchExecutor::TaskPoster Poster()
+    {
+        return [this](const boost::function<void()>& task) { service_.post(task); };
+    }
+};
+
+int ResultOf(const json_spirit::Value& reply)
+{
+    return json_spirit::find_value(reply.get_obj(), "result").get_int();
+}
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE(RpcBatchExecutor_tests)
+
+BOOST_AUTO_TEST_CASE(repliesComeBackInRequestOrder)
+{
+    WorkerPool pool(4);
+    RecordingHandler handler;
+    const RpcBatchExecutor executor(boost::ref(handler), &IsThreadSafe, pool.Poster(), 4);
+
+    json_spirit::Array requests;
+    for (int id = 0; id < 40; ++id)
+        requests.push_back(MakeRequest(id, true));
+
+    const json_spirit::Array replies = executor.Execute(requests);
+    BOOST_REQUIRE_EQUAL(replies.size(), requests.size());
+    for (int id = 0; id < 40; ++id)
+        BOOST_CHECK_EQUAL(ResultOf(replies[id]), id * 10);
+}
+
+BOOST_AUTO_TEST_CASE(threadSafeCallsRunConcurrentlyUpToTheLimit)
+{
+    WorkerPool pool(8);
+    RecordingHandler handler;
+    const RpcBatchExecutor executor(boost::ref(handler), &IsThreadSafe, pool.Poster(), 3);
+
+    json_spirit::Array requests;
+    for (int id = 0; id < 30; ++id)
+        requests.push_back(MakeRequest(id, true));
+
+    executor.Execute(requests);
+    BOOST_CHECK_GT(handler.MaxActive(), 1u);
+    BOOST_CHECK_LE(handler.MaxActive(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE(callsThatAreNotThreadSafeRunSeriallyBetweenConcurrentRuns)
+{
+    WorkerPool pool(4);
+    RecordingHandler handler;
+    const RpcBatchExecutor executor(boost::ref(handler), &IsThreadSafe, pool.Poster(), 4);
+
+    json_spirit::Array requests;
+    for (int id = 0; id < 8; ++id)
+        requests.push_back(MakeRequest(id, true));
+    requests.push_back(MakeRequest(8, false));
+    requests.push_back(MakeRequest(9, false));
+    for (int id = 10; id < 18; ++id)
+        requests.push_back(MakeRequest(id, true));
+
+    const json_spirit::Array replies = executor.Execute(requests);
+    BOOST_REQUIRE_EQUAL(replies.size(), 18u);
+    for (int id = 0; id < 18; ++id)
+        BOOST_CHECK_EQUAL(ResultOf(replies[id]), id * 10);
+
+    const std::vector<int> order = handler.ExecutionOrder();
+    BOOST_REQUIRE_EQUAL(order.size(), 18u);
+    BOOST_CHECK(std::is_permutation(order.begin(), order.begin() + 8, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7}).begin()));
+    BOOST_CHECK_EQUAL(order[8], 8);
+    BOOST_CHECK_EQUAL(order[9], 9);
+}
+
+BOOST_AUTO_TEST_CASE(batchCompletesWhenNoWorkerIsAvailable)
+{
+    RecordingHandler handler;
+    std::vector<boost::function<void()>> droppedTasks;
+    const RpcBatchExecutor executor(
+        boost::ref(handler),
+        &IsThreadSafe,
+        [&droppedTasks](const boost::function<void()>& task) { droppedTasks.push_back(task); },
+        4);
+
+    json_spirit::Array requests;
+    for (int id = 0; id < 10; ++id)
+        requests.push_back(MakeRequest(id, true));
+
+    const json_spirit::Array replies = executor.Execute(requests);
+    BOOST_CHECK_EQUAL(replies.size(), 10u);
+    BOOST_CHECK_EQUAL(handler.MaxActive(), 1u);
+    BOOST_CHECK_EQUAL(droppedTasks.size(), 3u);
+
+    // Helpers that only get scheduled after the batch returned have nothing left to do
+    for (const boost::function<void()>& task: droppedTasks)
+        task();
+    BOOST_CHECK_EQUAL(handler.ExecutionOrder().size(), 10u);
+}
+
+BOOST_AUTO_TEST_CASE(failuresInWorkersAreRethrownToTheCaller)
+{
+    WorkerPool pool(4);
+    const RpcBatchExecutor executor(
+        [](const json_spirit::Value& request) -> json_spirit::Object {
+            if (json_spirit::find_value(request.get_obj(), "id").get_int() == 5)
+                throw std::runtime_error("handler failed");
+            return json_spirit::Object();
+        },
+        &IsThreadSafe,
+        pool.Poster(),
+        4);
+
+    json_spirit::Array requests;
+    for (int id = 0; id < 10; ++id)
+        requests.push_back(MakeRequest(id, true));
+    BOOST_CHECK_THROW(executor.Execute(requests), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,53 @@
+#include <SharedMessageCache.h>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+SharedSerializedMessage MessageOfSize(size_t size)
+{
+    return std::make_shared<CSerializeData>(size, 'm');
+}
+}
+
+BOOST_AUTO_TEST_SUITE(SharedMessageCache_tests)
+
+BOOST_AUTO_TEST_CASE(willReturnTheSameBufferForRepeatedLookups)
+{
+    SharedMessageCache cache(1000u);
+    const SharedSerializedMessage message = MessageOfSize(100u);
+    cache.Insert(uint256(1), message);
+
+    BOOST_CHECK(cache.Get(uint256(1)) == message);
+    BOOST_CHECK(cache.Get(uint256(2)) == nullptr);
+    BOOST_CHECK_EQUAL(cache.TotalBytes(), 100u);
+}
+
+BOOST_AUTO_TEST_CASE(willEvictLeastRecentlyUsedMessagesOnceOverTheByteLimit)
+{
+    SharedMessageCache cache(300u);
+    cache.Insert(uint256(1), MessageOfSize(100u));
+    cache.Insert(uint256(2), MessageOfSize(100u));
+    cache.Insert(uint256(3), MessageOfSize(100u));
+    BOOST_CHECK(cache.Get(uint256(1)) != nullptr);
+
+    cache.Insert(uint256(4), MessageOfSize(100u));
+    BOOST_CHECK_EQUAL(cache.Size(), 3u);
+    BOOST_CHECK_EQUAL(cache.TotalBytes(), 300u);
+    BOOST_CHECK(cache.Get(uint256(2)) == nullptr);
+    BOOST_CHECK(cache.Get(uint256(1)) != nullptr);
+    BOOST_CHECK(cache.Get(uint256(3)) != nullptr);
+    BOOST_CHECK(cache.Get(uint256(4)) != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(willNotCacheMessagesLargerThanTheWholeCache)
+{
+    SharedMessageCache cache(300u);
+    cache.Insert(uint256(1), MessageOfSize(100u));
+    cache.Insert(uint256(2), MessageOfSize(301u));
+
+    BOOST_CHECK(cache.Get(uint256(2)) == nullptr);
+    BOOST_CHECK(cache.Get(uint256(1)) != nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
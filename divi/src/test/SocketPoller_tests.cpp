@@ -0,0 +1,143 @@
+#if defined(HAVE_CONFIG_H)
+#include "config/divi-config.h"
+#endif
+
+#include <SelectSocketPoller.h>
+#include <EpollSocketPoller.h>
+
+#include <utiltime.h>
+
+#include <memory>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#ifndef WIN32
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+class SocketPairForTesting
+{
+public:
+    SOCKET localEnd;
+    SOCKET remoteEnd;
+    SocketPairForTesting(): localEnd(INVALID_SOCKET), remoteEnd(INVALID_SOCKET)
+    {
+        int sockets[2];
+        BOOST_REQUIRE(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+        localEnd = sockets[0];
+        remoteEnd = sockets[1];
+    }
+    ~SocketPairForTesting()
+    {
+        close(localEnd);
+        close(remoteEnd);
+    }
+};
+
+std::vector<std::shared_ptr<I_SocketPoller>> AvailablePollers()
+{
+    std::vector<std::shared_ptr<I_SocketPoller>> pollers;
+    pollers.emplace_back(new SelectSocketPoller());
+#ifdef HAVE_SYS_EPOLL_H
+    pollers.emplace_back(new EpollSocketPoller());
+#endif
+    return pollers;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(SocketPoller_tests)
+
+BOOST_AUTO_TEST_CASE(pollersOnlyReportReceiveReadinessOnceDataArrives)
+{
+    for(const std::shared_ptr<I_SocketPoller>& poller: AvailablePollers())
+    {
+        SocketPairForTesting sockets;
+        poller->SetInterest(sockets.localEnd, false, true);
+        BOOST_CHECK_EQUAL(poller->PollSockets(0), 0);
+        BOOST_CHECK(poller->ReadySockets().empty());
+        BOOST_CHECK(!poller->IsReadyForReceive(sockets.localEnd));
+
+        const char byte = 'x';
+        BOOST_REQUIRE(write(sockets.remoteEnd, &byte, 1) == 1);
+        BOOST_CHECK_EQUAL(poller->PollSockets(0), 1);
+        BOOST_CHECK_MESSAGE(poller->IsReadyForReceive(sockets.localEnd), poller->BackendName());
+        BOOST_CHECK(!poller->IsReadyForSend(sockets.localEnd));
+        BOOST_CHECK(poller->ReadySockets() == std::vector<SOCKET>{sockets.localEnd});
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pollersOnlyReportEventsTheSocketIsRegisteredFor)
+{
+    for(const std::shared_ptr<I_SocketPoller>& poller: AvailablePollers())
+    {
+        SocketPairForTesting sockets;
+        poller->SetInterest(sockets.localEnd, true, false);
+        BOOST_CHECK_EQUAL(poller->PollSockets(0), 1);
+        BOOST_CHECK_MESSAGE(poller->IsReadyForSend(sockets.localEnd), poller->BackendName());
+
+        // Interest can change between rounds without re-creating the poller
+        poller->SetInterest(sockets.localEnd, false, false);
+        BOOST_CHECK_EQUAL(poller->PollSockets(0), 0);
+        BOOST_CHECK(!poller->IsReadyForSend(sockets.localEnd));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pollersKeepRegistrationsAcrossRoundsUntilRemoved)
+{
+    for(const std::shared_ptr<I_SocketPoller>& poller: AvailablePollers())
+    {
+        SocketPairForTesting idleSockets;
+        SocketPairForTesting busySockets;
+        poller->SetInterest(idleSockets.localEnd, false, true);
+        poller->SetInterest(busySockets.localEnd, false, true);
+
+        const char byte = 'x';
+        BOOST_REQUIRE(write(busySockets.remoteEnd, &byte, 1) == 1);
+        for(unsigned round = 0u; round < 3u; ++round)
+        {
+            BOOST_CHECK_EQUAL(poller->PollSockets(0), 1);
+            BOOST_CHECK_MESSAGE(poller->ReadySockets() == std::vector<SOCKET>{busySockets.localEnd}, poller->BackendName());
+        }
+
+        poller->RemoveSocket(busySockets.localEnd);
+        BOOST_CHECK_EQUAL(poller->PollSockets(0), 0);
+        BOOST_CHECK(!poller->IsReadyForReceive(busySockets.localEnd));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pollersReportHangupAsReadable)
+{
+    for(const std::shared_ptr<I_SocketPoller>& poller: AvailablePollers())
+    {
+        SocketPairForTesting sockets;
+        shutdown(sockets.remoteEnd, SHUT_RDWR);
+        poller->SetInterest(sockets.localEnd, false, true);
+        BOOST_CHECK(poller->PollSockets(0) > 0);
+        BOOST_CHECK_MESSAGE(poller->IsReadyForReceive(sockets.localEnd), poller->BackendName());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pollersReturnEarlyWhenWokenUp)
+{
+    for(const std::shared_ptr<I_SocketPoller>& poller: AvailablePollers())
+    {
+        SocketPairForTesting sockets;
+        poller->SetInterest(sockets.localEnd, false, true);
+        poller->Wakeup();
+        poller->Wakeup();
+
+        const int64_t pollStart = GetTimeMillis();
+        BOOST_CHECK_EQUAL(poller->PollSockets(10000), 0);
+        BOOST_CHECK_MESSAGE(GetTimeMillis() - pollStart < 5000, poller->BackendName());
+        BOOST_CHECK(poller->ReadySockets().empty());
+
+        // Wake-ups are consumed by the round they cut short
+        BOOST_CHECK_EQUAL(poller->PollSockets(0), 0);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif
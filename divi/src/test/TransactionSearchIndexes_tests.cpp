@@ -0,0 +1,180 @@
+#include <test/test_only.h>
+
+#include <TransactionSearchIndexes.h>
+#include <IndexDatabaseUpdates.h>
+#include <leveldbwrapper.h>
+#include <txdb.h>
+
+#include <set>
+#include <tuple>
+
+namespace
+{
+typedef std::pair<uint160, int> AddressHashAndType;
+
+const AddressHashAndType firstAddress(uint160(11), 1);
+const AddressHashAndType secondAddress(uint160(12), 2);
+
+uint256 TransactionAt(int height, unsigned txindex)
+{
+    return uint256(static_cast<uint64_t>(height) * 1000u + txindex);
+}
+
+struct SearchIndexPagingFixture
+{
+    CSearchIndexDB searchIndexes;
+    std::vector<std::pair<CAddressIndexKey, CAmount>> allEntries;
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> allUnspent;
+
+    SearchIndexPagingFixture(
+        ): searchIndexes(1 << 20, true)
+        , allEntries()
+        , allUnspent()
+    {
+        BOOST_REQUIRE(searchIndexes.ResetIndexes(true, false));
+        IndexDatabaseUpdates updates(nullptr, true, false);
+        for (int height = 1; height <= 6; ++height)
+        {
+            for (unsigned txindex = 0; txindex < 3; ++txindex)
+            {
+                const uint256 txid = TransactionAt(height, txindex);
+                // Output indices past 255 sort differently as numbers and as keys
+                for (size_t output: {size_t(1), size_t(256), size_t(300)})
+                {
+                    const AddressHashAndType& address = (txindex + output) % 2 == 0 ? firstAddress : secondAddress;
+                    const CAddressIndexKey key(address.second, address.first, height, txindex, txid, output, false);
+                    updates.addressIndex.push_back(std::make_pair(key, CAmount(output)));
+                    const CAddressUnspentKey unspentKey(address.second, address.first, txid, output);
+                    updates.addressUnspentIndex.push_back(
+                        std::make_pair(unspentKey, CAddressUnspentValue(CAmount(output), CScript(), height)));
+                }
+            }
+        }
+        allEntries = updates.addressIndex;
+        allUnspent = updates.addressUnspentIndex;
+
+        CLevelDBBatch batch;
+        CSearchIndexDB::AddressBalanceChanges balanceChanges;
+        CSearchIndexDB::BatchWriteUpdates(batch, updates, false, balanceChanges);
+        BOOST_REQUIRE(searchIndexes.CommitUpdates(batch, balanceChanges, uint256(1)));
+    }
+
+    std::vector<std::pair<CAddressIndexKey, CAmount>> AllDeltaPages(size_t limit, int start, int end, unsigned& numberOfPages) const
+    {
+        std::vector<std::pair<CAddressIndexKey, CAmount>> entries;
+        std::unique_ptr<CAddressIndexKey> after;
+        numberOfPages = 0;
+        for (bool more = true; more; ++numberOfPages)
+        {
+            std::vector<std::pair<CAddressIndexKey, CAmount>> page;
+            BOOST_REQUIRE(TransactionSearchIndexes::GetAddressIndexPage(
+                &searchIndexes, {secondAddress, firstAddress, firstAddress}, start, end, after.get(), limit, page, more));
+            BOOST_REQUIRE(page.size() <= limit);
+            BOOST_REQUIRE(!more || page.size() == limit);
+            entries.insert(entries.end(), page.begin(), page.end());
+            if (more)
+                after.reset(new CAddressIndexKey(page.back().first));
+        }
+        return entries;
+    }
+};
+
+std::tuple<int, unsigned, unsigned, uint160, size_t> Position(const CAddressIndexKey& key)
+{
+    return std::make_tuple(key.blockHeight, key.txindex, key.type, key.hashBytes, key.index);
+}
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(TransactionSearchIndexes_tests, SearchIndexPagingFixture)
+
+BOOST_AUTO_TEST_CASE(pagesOfDeltasCoverEveryEntryOnceInHeightOrder)
+{
+    for (size_t limit: {size_t(1), size_t(4), size_t(5), size_t(1000)})
+    {
+        unsigned numberOfPages = 0;
+        const auto entries = AllDeltaPages(limit, 0, 0, numberOfPages);
+        BOOST_CHECK_EQUAL(entries.size(), allEntries.size());
+        BOOST_CHECK_EQUAL(numberOfPages, (allEntries.size() + limit - 1) / limit);
+
+        std::set<std::tuple<int, unsigned, unsigned, uint160, size_t>> positions;
+        for (unsigned entry = 0; entry < entries.size(); ++entry)
+        {
+            BOOST_CHECK(positions.insert(Position(entries[entry].first)).second);
+            if (entry > 0)
+            {
+                const CAddressIndexKey& previous = entries[entry - 1].first;
+                const CAddressIndexKey& current = entries[entry].first;
+                BOOST_CHECK(std::make_pair(previous.blockHeight, previous.txindex) <= std::make_pair(current.blockHeight, current.txindex));
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pagesOfDeltasStayWithinTheHeightRange)
+{
+    unsigned numberOfPages = 0;
+    const auto entries = AllDeltaPages(4u, 2, 4, numberOfPages);
+    BOOST_CHECK_EQUAL(entries.size(), 3u * 3u * 3u);
+    for (const auto& entry: entries)
+    {
+        BOOST_CHECK(entry.first.blockHeight >= 2);
+        BOOST_CHECK(entry.first.blockHeight <= 4);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pagesOfTransactionsListEachTransactionOnce)
+{
+    std::vector<CAddressIndexKey> transactions;
+    std::unique_ptr<CAddressIndexKey> after;
+    for (bool more = true; more;)
+    {
+        std::vector<CAddressIndexKey> page;
+        BOOST_REQUIRE(TransactionSearchIndexes::GetAddressTransactionPage(
+            &searchIndexes, {firstAddress, secondAddress}, 0, 0, after.get(), 4u, page, more));
+        BOOST_REQUIRE(!more || page.size() == 4u);
+        transactions.insert(transactions.end(), page.begin(), page.end());
+        if (more)
+            after.reset(new CAddressIndexKey(page.back()));
+    }
+
+    BOOST_REQUIRE_EQUAL(transactions.size(), 6u * 3u);
+    for (unsigned position = 0; position < transactions.size(); ++position)
+    {
+        const int height = 1 + position / 3;
+        const unsigned txindex = position % 3;
+        BOOST_CHECK_EQUAL(transactions[position].blockHeight, height);
+        BOOST_CHECK_EQUAL(transactions[position].txindex, txindex);
+        BOOST_CHECK(transactions[position].txhash == TransactionAt(height, txindex));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pagesOfUnspentOutputsCoverEveryOutputOnce)
+{
+    for (size_t limit: {size_t(1), size_t(7), size_t(1000)})
+    {
+        std::set<std::pair<uint256, size_t>> outputs;
+        std::unique_ptr<CAddressUnspentKey> after;
+        for (bool more = true; more;)
+        {
+            std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> page;
+            BOOST_REQUIRE(TransactionSearchIndexes::GetAddressUnspentPage(
+                &searchIndexes, {secondAddress, firstAddress}, after.get(), limit, page, more));
+            BOOST_REQUIRE(!more || page.size() == limit);
+            for (const auto& output: page)
+                BOOST_CHECK(outputs.insert(std::make_pair(output.first.txhash, output.first.index)).second);
+            if (more)
+                after.reset(new CAddressUnspentKey(page.back().first));
+        }
+        BOOST_CHECK_EQUAL(outputs.size(), allUnspent.size());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(pagesRequireTheAddressIndex)
+{
+    BOOST_REQUIRE(searchIndexes.ResetIndexes(false, true));
+    std::vector<std::pair<CAddressIndexKey, CAmount>> page;
+    bool more = false;
+    BOOST_CHECK(!TransactionSearchIndexes::GetAddressIndexPage(&searchIndexes, {firstAddress}, 0, 0, nullptr, 10u, page, more));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
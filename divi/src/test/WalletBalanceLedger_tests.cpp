@@ -0,0 +1,194 @@
+#include <test_only.h>
+
+#include <WalletBalanceLedger.h>
+#include <WalletBalanceCalculator.h>
+#include <UtxoBalanceCalculator.h>
+#include <FakeWalletTransactions.h>
+
+#include <map>
+#include <vector>
+
+namespace
+{
+struct OutputSpec
+{
+    CAmount value;
+    isminetype ownership;
+};
+
+class WalletBalanceLedgerTestFixture: public FakeWalletTransactions
+{
+public:
+    UtxoBalanceCalculator utxoBalanceCalculator;
+    WalletBalanceCalculator fullScanCalculator;
+    WalletBalanceLedger ledger;
+
+    WalletBalanceLedgerTestFixture(
+        ): FakeWalletTransactions()
+        , utxoBalanceCalculator(ownershipDetector, spentOutputTracker)
+        , fullScanCalculator(ownershipDetector, utxoBalanceCalculator, txRecord, confsCalculator)
+        , ledger(ownershipDetector, spentOutputTracker, txRecord, confsCalculator)
+    {
+    }
+
+    uint256 addTransaction(
+        const std::vector<COutPoint>& inputs,
+        const std::vector<OutputSpec>& outputs,
+        int depth,
+        int blocksToMaturity = 0,
+        bool coinstake = false,
+        bool reported = true)
+    {
+        CMutableTransaction tx;
+        for(const COutPoint& input: inputs) tx.vin.push_back(CTxIn(input));
+        if(coinstake)
+        {
+            tx.vout.push_back(CTxOut());
+            tx.vout.back().SetEmpty();
+        }
+        for(const OutputSpec& output: outputs)
+        {
+            tx.vout.push_back(CTxOut(output.value, scriptOwnedAs(output.ownership)));
+        }
+        const uint256 txid = recordTransaction(tx, depth, blocksToMaturity).GetHash();
+        if(reported) report(txid);
+        return txid;
+    }
+
+    void report(const uint256& txid)
+    {
+        ledger.recomputeCachedTxEntries(walletTransactions.at(txid));
+        for(const CTxIn& input: walletTransactions.at(txid).vin)
+        {
+            const auto it = walletTransactions.find(input.prevout.hash);
+            if(it != walletTransactions.end()) ledger.recomputeCachedTxEntries(it->second);
+        }
+    }
+
+    void checkAgainstFullScan()
+    {
+        UtxoOwnershipFilter spendableOrOwnedVault(isminetype::ISMINE_SPENDABLE);
+        spendableOrOwnedVault.addOwnershipType(isminetype::ISMINE_OWNED_VAULT);
+        for(const UtxoOwnershipFilter& filter: {
+            UtxoOwnershipFilter(isminetype::ISMINE_SPENDABLE),
+            UtxoOwnershipFilter(isminetype::ISMINE_WATCH_ONLY),
+            UtxoOwnershipFilter(isminetype::ISMINE_OWNED_VAULT),
+            spendableOrOwnedVault})
+        {
+            BOOST_CHECK_EQUAL(ledger.getBalance(filter), fullScanCalculator.getBalance(filter));
+            BOOST_CHECK_EQUAL(ledger.getUnconfirmedBalance(filter), fullScanCalculator.getUnconfirmedBalance(filter));
+            BOOST_CHECK_EQUAL(ledger.getImmatureBalance(filter), fullScanCalculator.getImmatureBalance(filter));
+            BOOST_CHECK_EQUAL(ledger.getSpendableBalance(filter), fullScanCalculator.getSpendableBalance(filter));
+        }
+    }
+};
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(WalletBalanceLedger_tests, WalletBalanceLedgerTestFixture)
+
+BOOST_AUTO_TEST_CASE(agreesWithAFullScanAcrossBucketsAndOwnershipTypes)
+{
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)},
+        {{10*COIN, isminetype::ISMINE_SPENDABLE}, {7*COIN, isminetype::ISMINE_OWNED_VAULT}, {3*COIN, isminetype::ISMINE_WATCH_ONLY}}, 20);
+    addTransaction({COutPoint(funding, 0)},
+        {{4*COIN, isminetype::ISMINE_SPENDABLE}, {5*COIN, isminetype::ISMINE_NO}}, 0);
+    addTransaction({COutPoint(funding, 1)},
+        {{9*COIN, isminetype::ISMINE_OWNED_VAULT}}, 3, 5, true);
+    addTransaction({COutPoint(uint256(2), 0)},
+        {{2*COIN, isminetype::ISMINE_SPENDABLE}}, -1);
+    checkAgainstFullScan();
+
+    BOOST_CHECK_EQUAL(ledger.getBalance(isminetype::ISMINE_SPENDABLE), 0*COIN);
+    BOOST_CHECK_EQUAL(ledger.getUnconfirmedBalance(isminetype::ISMINE_SPENDABLE), 4*COIN);
+    BOOST_CHECK_EQUAL(ledger.getImmatureBalance(isminetype::ISMINE_OWNED_VAULT), 9*COIN);
+    BOOST_CHECK_EQUAL(ledger.getBalance(isminetype::ISMINE_WATCH_ONLY), 3*COIN);
+}
+
+BOOST_AUTO_TEST_CASE(recreditsOutputsWhoseSpenderLeftTheMempoolWithoutBeingReported)
+{
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)}, {{10*COIN, isminetype::ISMINE_SPENDABLE}}, 20);
+    const uint256 spend = addTransaction({COutPoint(funding, 0)}, {{6*COIN, isminetype::ISMINE_SPENDABLE}}, 0);
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 0*COIN);
+    BOOST_CHECK_EQUAL(ledger.getUnconfirmedBalance(), 6*COIN);
+
+    depthByTxid[spend] = -1;
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 10*COIN);
+    BOOST_CHECK_EQUAL(ledger.getUnconfirmedBalance(), 0*COIN);
+    checkAgainstFullScan();
+}
+
+BOOST_AUTO_TEST_CASE(maturesRewardsAsTheChainGrowsWithoutBeingReported)
+{
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)}, {{10*COIN, isminetype::ISMINE_SPENDABLE}}, 20);
+    const uint256 stake = addTransaction({COutPoint(funding, 0)}, {{12*COIN, isminetype::ISMINE_SPENDABLE}}, 1, 20, true);
+    BOOST_CHECK_EQUAL(ledger.getImmatureBalance(), 12*COIN);
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 0*COIN);
+
+    depthByTxid[stake] = 21;
+    blocksToMaturityByTxid[stake] = 0;
+    BOOST_CHECK_EQUAL(ledger.getImmatureBalance(), 0*COIN);
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 12*COIN);
+    checkAgainstFullScan();
+}
+
+BOOST_AUTO_TEST_CASE(onlyReevaluatesConfirmedTransactionsOnceReported)
+{
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)}, {{10*COIN, isminetype::ISMINE_SPENDABLE}}, 20);
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 10*COIN);
+
+    depthByTxid[funding] = -1;
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 10*COIN);
+
+    report(funding);
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 0*COIN);
+    checkAgainstFullScan();
+}
+
+BOOST_AUTO_TEST_CASE(picksUpTransactionsRecordedWithoutBeingReported)
+{
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)}, {{10*COIN, isminetype::ISMINE_SPENDABLE}}, 20);
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 10*COIN);
+
+    addTransaction({COutPoint(uint256(2), 0)}, {{5*COIN, isminetype::ISMINE_SPENDABLE}}, 8, 0, false, false);
+    addTransaction({COutPoint(funding, 0)}, {{1*COIN, isminetype::ISMINE_SPENDABLE}}, 2, 0, false, false);
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 6*COIN);
+    checkAgainstFullScan();
+}
+
+BOOST_AUTO_TEST_CASE(reclassifiesEverythingOnceInvalidated)
+{
+    addTransaction({COutPoint(uint256(1), 0)}, {{10*COIN, isminetype::ISMINE_NO}}, 20);
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 0*COIN);
+
+    for(auto& scriptAndOwnership: ownershipByScript) scriptAndOwnership.second = isminetype::ISMINE_SPENDABLE;
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 0*COIN);
+
+    ledger.invalidate();
+    BOOST_CHECK_EQUAL(ledger.getBalance(), 10*COIN);
+    checkAgainstFullScan();
+}
+
+BOOST_AUTO_TEST_CASE(spendableBalanceOnlyIncludesUnconfirmedOutputsOfFullyOwnedTransactions)
+{
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)}, {{10*COIN, isminetype::ISMINE_SPENDABLE}}, 20);
+    addTransaction({COutPoint(funding, 0)}, {{6*COIN, isminetype::ISMINE_SPENDABLE}}, 0);
+    addTransaction({COutPoint(uint256(2), 0)}, {{3*COIN, isminetype::ISMINE_SPENDABLE}}, 0);
+    BOOST_CHECK_EQUAL(ledger.getUnconfirmedBalance(), 9*COIN);
+    BOOST_CHECK_EQUAL(ledger.getSpendableBalance(), 6*COIN);
+    checkAgainstFullScan();
+}
+
+BOOST_AUTO_TEST_CASE(staysConsistentWhenCheckingAgainstAFullScan)
+{
+    WalletBalanceLedger checkedLedger(ownershipDetector, spentOutputTracker, txRecord, confsCalculator, &fullScanCalculator);
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)}, {{10*COIN, isminetype::ISMINE_SPENDABLE}}, 20);
+    const uint256 spend = addTransaction({COutPoint(funding, 0)}, {{6*COIN, isminetype::ISMINE_SPENDABLE}}, 0);
+    BOOST_CHECK_EQUAL(checkedLedger.getSpendableBalance(), 6*COIN);
+
+    depthByTxid[spend] = 1;
+    checkedLedger.recomputeCachedTxEntries(walletTransactions.at(spend));
+    BOOST_CHECK_EQUAL(checkedLedger.getBalance(), 6*COIN);
+    BOOST_CHECK_EQUAL(checkedLedger.getUnconfirmedBalance(), 0*COIN);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
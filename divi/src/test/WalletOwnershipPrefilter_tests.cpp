@@ -0,0 +1,191 @@
+#include <test_only.h>
+
+#include <WalletOwnershipPrefilter.h>
+#include <keystore.h>
+#include <primitives/transaction.h>
+#include <script/standard.h>
+#include <script/StakingVaultScript.h>
+#include <wallet_ismine.h>
+
+#include <vector>
+
+namespace
+{
+class WalletOwnershipPrefilterTestFixture
+{
+public:
+    CBasicKeyStore keyStore;
+    WalletOwnershipPrefilter prefilter;
+
+    WalletOwnershipPrefilterTestFixture(
+        ): keyStore()
+        , prefilter()
+    {
+    }
+
+    CPubKey addKey()
+    {
+        CKey key;
+        key.MakeNewKey(true);
+        keyStore.AddKey(key);
+        prefilter.addKey(key.GetPubKey().GetID());
+        return key.GetPubKey();
+    }
+
+    static CPubKey foreignKey()
+    {
+        CKey key;
+        key.MakeNewKey(true);
+        return key.GetPubKey();
+    }
+
+    void addRedeemScript(const CScript& redeemScript)
+    {
+        keyStore.AddCScript(redeemScript);
+        prefilter.addRedeemScript(redeemScript);
+    }
+
+    void addWatchOnly(const CScript& script)
+    {
+        keyStore.AddWatchOnly(script);
+        prefilter.addScript(script);
+    }
+
+    static CScript payToPubKey(const CPubKey& pubkey)
+    {
+        return CScript() << ToByteVector(pubkey) << OP_CHECKSIG;
+    }
+
+    static CScript vaultScript(const CPubKey& owner, const CPubKey& manager)
+    {
+        return CreateStakingVaultScript(ToByteVector(owner.GetID()), ToByteVector(manager.GetID()));
+    }
+};
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(WalletOwnershipPrefilter_tests, WalletOwnershipPrefilterTestFixture)
+
+BOOST_AUTO_TEST_CASE(acceptsScriptsPayingToKnownKeysOnly)
+{
+    const CPubKey ownKey = addKey();
+    const CPubKey otherKey = foreignKey();
+
+    BOOST_CHECK(prefilter.mightOwn(GetScriptForDestination(ownKey.GetID())));
+    BOOST_CHECK(prefilter.mightOwn(payToPubKey(ownKey)));
+    BOOST_CHECK(!prefilter.mightOwn(GetScriptForDestination(otherKey.GetID())));
+    BOOST_CHECK(!prefilter.mightOwn(payToPubKey(otherKey)));
+}
+
+BOOST_AUTO_TEST_CASE(acceptsScriptHashesOfKnownRedeemScriptsOnly)
+{
+    const CScript redeemScript = GetScriptForMultisig(1, {addKey(), foreignKey()});
+    addRedeemScript(redeemScript);
+
+    BOOST_CHECK(prefilter.mightOwn(GetScriptForDestination(CScriptID(redeemScript))));
+    BOOST_CHECK(!prefilter.mightOwn(GetScriptForDestination(CScriptID(GetScriptForMultisig(1, {foreignKey()})))));
+}
+
+BOOST_AUTO_TEST_CASE(acceptsVaultsNamingEitherKnownKey)
+{
+    const CPubKey ownKey = addKey();
+
+    BOOST_CHECK(prefilter.mightOwn(vaultScript(ownKey, foreignKey())));
+    BOOST_CHECK(prefilter.mightOwn(vaultScript(foreignKey(), ownKey)));
+    BOOST_CHECK(!prefilter.mightOwn(vaultScript(foreignKey(), foreignKey())));
+}
+
+BOOST_AUTO_TEST_CASE(acceptsBareMultisigOnlyWhenAllKeysAreKnown)
+{
+    const CPubKey firstKey = addKey();
+    const CPubKey secondKey = addKey();
+
+    BOOST_CHECK(prefilter.mightOwn(GetScriptForMultisig(2, {firstKey, secondKey})));
+    BOOST_CHECK(!prefilter.mightOwn(GetScriptForMultisig(1, {firstKey, foreignKey()})));
+}
+
+BOOST_AUTO_TEST_CASE(acceptsWatchOnlyScriptsAsAWhole)
+{
+    const CScript watchedScript = GetScriptForDestination(foreignKey().GetID());
+    const CScript nonStandardScript = CScript() << OP_TRUE;
+    addWatchOnly(watchedScript);
+    addWatchOnly(nonStandardScript);
+
+    BOOST_CHECK(prefilter.mightOwn(watchedScript));
+    BOOST_CHECK(prefilter.mightOwn(nonStandardScript));
+    BOOST_CHECK(!prefilter.mightOwn(CScript() << OP_FALSE));
+}
+
+BOOST_AUTO_TEST_CASE(concernsTransactionsWithAnyAcceptedOutput)
+{
+    const CPubKey ownKey = addKey();
+    CMutableTransaction tx;
+    tx.vout.push_back(CTxOut(COIN, GetScriptForDestination(foreignKey().GetID())));
+    BOOST_CHECK(!prefilter.mightConcern(tx));
+
+    tx.vout.push_back(CTxOut(COIN, GetScriptForDestination(ownKey.GetID())));
+    BOOST_CHECK(prefilter.mightConcern(tx));
+}
+
+BOOST_AUTO_TEST_CASE(concernsWalletTransactionsAndTheirSpends)
+{
+    CMutableTransaction walletTx;
+    walletTx.vout.push_back(CTxOut(COIN, GetScriptForDestination(foreignKey().GetID())));
+    prefilter.addTransaction(walletTx.GetHash());
+    BOOST_CHECK(prefilter.mightConcern(walletTx));
+
+    CMutableTransaction spend;
+    spend.vin.push_back(CTxIn(COutPoint(uint256(1), 0u)));
+    spend.vout.push_back(CTxOut(COIN, GetScriptForDestination(foreignKey().GetID())));
+    BOOST_CHECK(!prefilter.mightConcern(spend));
+
+    spend.vin.push_back(CTxIn(COutPoint(walletTx.GetHash(), 0u)));
+    BOOST_CHECK(prefilter.mightConcern(spend));
+}
+
+BOOST_AUTO_TEST_CASE(copiesAreUnaffectedByLaterAdditions)
+{
+    const WalletOwnershipPrefilter snapshot(prefilter);
+    const CPubKey ownKey = addKey();
+
+    BOOST_CHECK(prefilter.mightOwn(GetScriptForDestination(ownKey.GetID())));
+    BOOST_CHECK(!snapshot.mightOwn(GetScriptForDestination(ownKey.GetID())));
+}
+
+BOOST_AUTO_TEST_CASE(neverRejectsScriptsTheKeyStoreRecognizes)
+{
+    std::vector<CPubKey> ownKeys;
+    for(unsigned keyCount = 0u; keyCount < 4u; ++keyCount) ownKeys.push_back(addKey());
+    const CScript redeemScript = GetScriptForDestination(ownKeys[0].GetID());
+    addRedeemScript(redeemScript);
+    const CScript watchedScript = GetScriptForDestination(foreignKey().GetID());
+    addWatchOnly(watchedScript);
+
+    std::vector<CScript> scripts = {
+        GetScriptForDestination(CScriptID(redeemScript)),
+        GetScriptForDestination(CScriptID(GetScriptForDestination(foreignKey().GetID()))),
+        watchedScript,
+        GetScriptForMultisig(2, {ownKeys[2], ownKeys[3]}),
+        GetScriptForMultisig(1, {ownKeys[2], foreignKey()}),
+        CScript() << OP_META << ToByteVector(ownKeys[0].GetID()),
+    };
+    for(const CPubKey& ownKey: ownKeys)
+    {
+        const CPubKey otherKey = foreignKey();
+        scripts.push_back(GetScriptForDestination(ownKey.GetID()));
+        scripts.push_back(payToPubKey(ownKey));
+        scripts.push_back(vaultScript(ownKey, otherKey));
+        scripts.push_back(vaultScript(otherKey, ownKey));
+        scripts.push_back(GetScriptForDestination(otherKey.GetID()));
+    }
+
+    unsigned recognizedScripts = 0u;
+    for(const CScript& script: scripts)
+    {
+        if(IsMine(keyStore, script) == isminetype::ISMINE_NO) continue;
+        ++recognizedScripts;
+        BOOST_CHECK(prefilter.mightOwn(script));
+    }
+    BOOST_CHECK(recognizedScripts > ownKeys.size());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
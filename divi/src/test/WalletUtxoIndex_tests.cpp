@@ -0,0 +1,143 @@
+#include <test_only.h>
+
+#include <WalletUtxoIndex.h>
+#include <FakeWalletTransactions.h>
+
+#include <map>
+#include <vector>
+
+using ::testing::_;
+
+namespace
+{
+constexpr int MAXIMUM_REORG_DEPTH = 10;
+
+class WalletUtxoIndexTestFixture: public FakeWalletTransactions
+{
+public:
+    WalletUtxoIndex utxoIndex;
+
+    WalletUtxoIndexTestFixture(
+        ): FakeWalletTransactions()
+        , utxoIndex(ownershipDetector, spentOutputTracker, txRecord, confsCalculator, MAXIMUM_REORG_DEPTH)
+    {
+    }
+
+    uint256 addTransaction(
+        const std::vector<COutPoint>& inputs,
+        const std::vector<isminetype>& outputOwnership,
+        int depth,
+        bool reported = true)
+    {
+        CMutableTransaction tx;
+        for(const COutPoint& input: inputs) tx.vin.push_back(CTxIn(input));
+        for(const isminetype ownership: outputOwnership)
+        {
+            tx.vout.push_back(CTxOut(COIN, scriptOwnedAs(ownership)));
+        }
+        const CWalletTx& walletTx = recordTransaction(tx, depth);
+        const uint256 txid = walletTx.GetHash();
+        if(reported)
+        {
+            utxoIndex.recomputeCachedTxEntries(walletTx);
+            for(const COutPoint& input: inputs)
+            {
+                const auto it = walletTransactions.find(input.hash);
+                if(it != walletTransactions.end()) utxoIndex.recomputeCachedTxEntries(it->second);
+            }
+        }
+        return txid;
+    }
+
+    std::vector<uint256> transactionsWithUnspentOutputs(const UtxoOwnershipFilter& ownershipFilter) const
+    {
+        std::vector<uint256> txids;
+        for(const CWalletTx* tx: utxoIndex.GetTransactionsWithUnspentOutputs(ownershipFilter))
+        {
+            txids.push_back(tx->GetHash());
+        }
+        return txids;
+    }
+};
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE(WalletUtxoIndex_tests, WalletUtxoIndexTestFixture)
+
+BOOST_AUTO_TEST_CASE(listsTransactionsByTheOwnershipOfTheirUnspentOutputs)
+{
+    const uint256 spendable = addTransaction({COutPoint(uint256(1), 0)}, {isminetype::ISMINE_SPENDABLE, isminetype::ISMINE_NO}, 5);
+    const uint256 vault = addTransaction({COutPoint(uint256(2), 0)}, {isminetype::ISMINE_OWNED_VAULT}, 5);
+    addTransaction({COutPoint(uint256(3), 0)}, {isminetype::ISMINE_NO}, 5);
+
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 2u);
+    BOOST_CHECK(transactionsWithUnspentOutputs(isminetype::ISMINE_SPENDABLE) == std::vector<uint256>{spendable});
+    BOOST_CHECK(transactionsWithUnspentOutputs(isminetype::ISMINE_OWNED_VAULT) == std::vector<uint256>{vault});
+    BOOST_CHECK(transactionsWithUnspentOutputs(isminetype::ISMINE_WATCH_ONLY).empty());
+
+    UtxoOwnershipFilter spendableOrVault(isminetype::ISMINE_SPENDABLE);
+    spendableOrVault.addOwnershipType(isminetype::ISMINE_OWNED_VAULT);
+    BOOST_CHECK_EQUAL(transactionsWithUnspentOutputs(spendableOrVault).size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(dropsOutputsOnceTheirSpendIsReported)
+{
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)}, {isminetype::ISMINE_SPENDABLE, isminetype::ISMINE_SPENDABLE}, 5);
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 2u);
+
+    const uint256 spend = addTransaction({COutPoint(funding, 0), COutPoint(funding, 1)}, {isminetype::ISMINE_SPENDABLE}, 0);
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 1u);
+    BOOST_CHECK(transactionsWithUnspentOutputs(isminetype::ISMINE_SPENDABLE) == std::vector<uint256>{spend});
+}
+
+BOOST_AUTO_TEST_CASE(recreditsOutputsWhoseSpendStoppedCountingWithoutBeingReported)
+{
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)}, {isminetype::ISMINE_SPENDABLE}, 20);
+    const uint256 mempoolSpend = addTransaction({COutPoint(funding, 0)}, {isminetype::ISMINE_NO}, 0);
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 0u);
+
+    depthByTxid[mempoolSpend] = -1;
+    BOOST_CHECK(transactionsWithUnspentOutputs(isminetype::ISMINE_SPENDABLE) == std::vector<uint256>{funding});
+
+    const uint256 minedSpend = addTransaction({COutPoint(funding, 0)}, {isminetype::ISMINE_NO}, MAXIMUM_REORG_DEPTH - 1);
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 0u);
+
+    depthByTxid[minedSpend] = -1;
+    BOOST_CHECK(transactionsWithUnspentOutputs(isminetype::ISMINE_SPENDABLE) == std::vector<uint256>{funding});
+}
+
+BOOST_AUTO_TEST_CASE(stopsRecheckingSpendsOnceTheyAreDeeperThanAReorg)
+{
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)}, {isminetype::ISMINE_SPENDABLE}, 20);
+    const uint256 spend = addTransaction({COutPoint(funding, 0)}, {isminetype::ISMINE_NO}, 1);
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 0u);
+
+    depthByTxid[spend] = MAXIMUM_REORG_DEPTH;
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 0u);
+
+    EXPECT_CALL(confsCalculator, GetNumberOfBlockConfirmations(_)).Times(0);
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(picksUpTransactionsRecordedWithoutBeingReported)
+{
+    const uint256 funding = addTransaction({COutPoint(uint256(1), 0)}, {isminetype::ISMINE_SPENDABLE}, 5);
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 1u);
+
+    const uint256 spend = addTransaction({COutPoint(funding, 0)}, {isminetype::ISMINE_SPENDABLE, isminetype::ISMINE_SPENDABLE}, 0, false);
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 2u);
+    BOOST_CHECK(transactionsWithUnspentOutputs(isminetype::ISMINE_SPENDABLE) == std::vector<uint256>{spend});
+}
+
+BOOST_AUTO_TEST_CASE(reclassifiesEverythingOnceInvalidated)
+{
+    addTransaction({COutPoint(uint256(1), 0)}, {isminetype::ISMINE_NO, isminetype::ISMINE_NO}, 5);
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 0u);
+
+    for(auto& scriptAndOwnership: ownershipByScript) scriptAndOwnership.second = isminetype::ISMINE_WATCH_ONLY;
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 0u);
+
+    utxoIndex.invalidate();
+    BOOST_CHECK_EQUAL(utxoIndex.NumberOfUnspentOutputs(), 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,105 @@
+#include <zmq/ZMQPublishQueue.h>
+
+#include <utiltime.h>
+
+#include <atomic>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+namespace
+{
+template <typename Predicate>
+bool WaitUntil(Predicate predicate, int64_t timeoutInMilliseconds = 5000)
+{
+    const int64_t deadline = GetTimeMillis() + timeoutInMilliseconds;
+    while(!predicate())
+    {
+        if(GetTimeMillis() > deadline) return false;
+        MilliSleep(1);
+    }
+    return true;
+}
+}
+
+BOOST_AUTO_TEST_SUITE(ZMQPublishQueue_tests)
+
+BOOST_AUTO_TEST_CASE(willPublishMessagesInTheOrderTheyWereQueued)
+{
+    ZMQPublishQueue queue(100u);
+    boost::mutex publishedMutex;
+    std::vector<int> published;
+    for(int message = 0; message < 50; ++message)
+    {
+        BOOST_CHECK(queue.Enqueue([message,&published,&publishedMutex]()
+        {
+            boost::unique_lock<boost::mutex> lock(publishedMutex);
+            published.push_back(message);
+        }));
+    }
+
+    BOOST_CHECK(WaitUntil([&published,&publishedMutex]()
+    {
+        boost::unique_lock<boost::mutex> lock(publishedMutex);
+        return published.size() == 50u;
+    }));
+    for(int message = 0; message < 50; ++message)
+    {
+        BOOST_CHECK_EQUAL(published[message], message);
+    }
+    BOOST_CHECK_EQUAL(queue.NumberOfDroppedMessages(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(willDropMessagesInsteadOfWaitingWhileTheQueueIsFull)
+{
+    ZMQPublishQueue queue(3u);
+    std::atomic<bool> publisherStarted(false);
+    std::atomic<bool> releasePublisher(false);
+    std::atomic<int> messagesPublished(0);
+    auto slowSubscriber = [&publisherStarted,&releasePublisher,&messagesPublished]()
+    {
+        publisherStarted = true;
+        while(!releasePublisher) MilliSleep(1);
+        ++messagesPublished;
+    };
+    auto message = [&messagesPublished]() { ++messagesPublished; };
+
+    BOOST_CHECK(queue.Enqueue(slowSubscriber));
+    BOOST_CHECK(WaitUntil([&publisherStarted](){ return publisherStarted.load(); }));
+    for(int queued = 0; queued < 3; ++queued)
+    {
+        BOOST_CHECK(queue.Enqueue(message));
+    }
+    BOOST_CHECK(!queue.Enqueue(message));
+    BOOST_CHECK(!queue.Enqueue(message));
+    BOOST_CHECK_EQUAL(queue.NumberOfQueuedMessages(), 3u);
+    BOOST_CHECK_EQUAL(queue.NumberOfDroppedMessages(), 2u);
+
+    releasePublisher = true;
+    BOOST_CHECK(WaitUntil([&messagesPublished](){ return messagesPublished == 4; }));
+    BOOST_CHECK(queue.Enqueue(message));
+    BOOST_CHECK(WaitUntil([&messagesPublished](){ return messagesPublished == 5; }));
+}
+
+BOOST_AUTO_TEST_CASE(willDropQueuedMessagesWhenStopped)
+{
+    ZMQPublishQueue queue(10u);
+    std::atomic<bool> publisherStarted(false);
+    std::atomic<int> messagesPublished(0);
+    BOOST_CHECK(queue.Enqueue([&publisherStarted]()
+    {
+        publisherStarted = true;
+        boost::this_thread::sleep_for(boost::chrono::seconds(60));
+    }));
+    BOOST_CHECK(WaitUntil([&publisherStarted](){ return publisherStarted.load(); }));
+    BOOST_CHECK(queue.Enqueue([&messagesPublished]() { ++messagesPublished; }));
+
+    queue.Stop();
+    BOOST_CHECK_EQUAL(messagesPublished, 0);
+    BOOST_CHECK_EQUAL(queue.NumberOfQueuedMessages(), 0u);
+    BOOST_CHECK_EQUAL(queue.NumberOfDroppedMessages(), 1u);
+    BOOST_CHECK(!queue.Enqueue([&messagesPublished]() { ++messagesPublished; }));
+    BOOST_CHECK_EQUAL(queue.NumberOfDroppedMessages(), 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,164 @@
+// Copyright (c) 2012-2013 The Bitcoin Core developers
+// Copyright (c) 2020 The DIVI developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addrman.h"
+
+#include "clientversion.h"
+#include "streams.h"
+
+#include <memory>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+class CAddrManTest : public CAddrMan
+{
+public:
+    CAddrInfo* Find(const CNetAddr& addr, int* pnId = NULL)
+    {
+        return CAddrMan::Find(addr, pnId);
+    }
+
+    CAddrInfo* Create(const CAddress& addr, const CNetAddr& addrSource, int* pnId = NULL)
+    {
+        return CAddrMan::Create(addr, addrSource, pnId);
+    }
+
+    void Delete(int nId)
+    {
+        CAddrMan::Delete(nId);
+    }
+};
+
+static CAddress AddressFromIndex(int index)
+{
+    return CAddress(CService(strprintf("250.%d.%d.1", (index >> 8) & 0xff, index & 0xff), 8333));
+}
+
+BOOST_AUTO_TEST_SUITE(addrman_tests)
+
+BOOST_AUTO_TEST_CASE(addrman_simple)
+{
+    CAddrManTest addrman;
+    CNetAddr source("252.2.2.2");
+
+    BOOST_CHECK_EQUAL(addrman.size(), 0);
+    BOOST_CHECK(addrman.Select() == CAddress());
+
+    CService addr1("250.1.1.1", 8333);
+    BOOST_CHECK(addrman.Add(CAddress(addr1), source));
+    BOOST_CHECK_EQUAL(addrman.size(), 1);
+    BOOST_CHECK(addrman.Select() == addr1);
+
+    // Adding the same address again does not create a second entry
+    BOOST_CHECK(!addrman.Add(CAddress(addr1), source));
+    BOOST_CHECK_EQUAL(addrman.size(), 1);
+
+    // Entries are looked up by IP, regardless of the port
+    BOOST_CHECK(addrman.Find(CService("250.1.1.1", 9999)) != NULL);
+    BOOST_CHECK(addrman.Find(CService("250.1.1.2", 8333)) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(addrman_delete_reuses_ids)
+{
+    CAddrManTest addrman;
+    CNetAddr source("252.2.2.2");
+
+    int nId1 = -1;
+    int nId2 = -1;
+    addrman.Create(AddressFromIndex(1), source, &nId1);
+    addrman.Create(AddressFromIndex(2), source, &nId2);
+    BOOST_CHECK_EQUAL(addrman.size(), 2);
+
+    addrman.Delete(nId1);
+    BOOST_CHECK_EQUAL(addrman.size(), 1);
+    BOOST_CHECK(addrman.Find(AddressFromIndex(1)) == NULL);
+    BOOST_CHECK(addrman.Find(AddressFromIndex(2)) != NULL);
+
+    int nId3 = -1;
+    CAddrInfo* info = addrman.Create(AddressFromIndex(3), source, &nId3);
+    BOOST_CHECK_EQUAL(nId3, nId1);
+    BOOST_CHECK(*info == AddressFromIndex(3));
+    int nIdFound = -1;
+    BOOST_CHECK(addrman.Find(AddressFromIndex(3), &nIdFound) == info);
+    BOOST_CHECK_EQUAL(nIdFound, nId3);
+    BOOST_CHECK_EQUAL(addrman.size(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(addrman_serialization_round_trip)
+{
+    CAddrManTest addrman;
+    for (int index = 0; index < 500; index++) {
+        CNetAddr source(strprintf("252.%d.2.2", index % 16));
+        addrman.Add(AddressFromIndex(index), source);
+    }
+    for (int index = 0; index < 500; index += 10)
+        addrman.Good(AddressFromIndex(index));
+    const int nAddresses = addrman.size();
+    BOOST_CHECK(nAddresses > 0);
+
+    CDataStream stream(SER_DISK, CLIENT_VERSION);
+    stream << addrman;
+
+    CAddrManTest loaded;
+    stream >> loaded;
+    BOOST_CHECK_EQUAL(loaded.size(), nAddresses);
+    for (int index = 0; index < 500; index++) {
+        BOOST_CHECK_EQUAL(loaded.Find(AddressFromIndex(index)) != NULL, addrman.Find(AddressFromIndex(index)) != NULL);
+    }
+
+    // Writing the loaded tables back out gives the same bytes
+    CDataStream original(SER_DISK, CLIENT_VERSION);
+    original << addrman;
+    CDataStream reserialized(SER_DISK, CLIENT_VERSION);
+    reserialized << loaded;
+    BOOST_CHECK(original.str() == reserialized.str());
+}
+
+BOOST_AUTO_TEST_CASE(addrman_snapshot_serializes_like_the_manager)
+{
+    CAddrManTest addrman;
+    CNetAddr source("252.2.2.2");
+    for (int index = 0; index < 100; index++)
+        addrman.Add(AddressFromIndex(index), source);
+    addrman.Good(AddressFromIndex(7));
+
+    std::unique_ptr<CAddrMan::Snapshot> snapshot(new CAddrMan::Snapshot());
+    addrman.GetSnapshot(*snapshot);
+
+    // Changes made after the snapshot was taken do not show up in it
+    CDataStream expected(SER_DISK, CLIENT_VERSION);
+    expected << addrman;
+    addrman.Add(AddressFromIndex(1000), source);
+
+    CDataStream fromSnapshot(SER_DISK, CLIENT_VERSION);
+    fromSnapshot << *snapshot;
+    BOOST_CHECK(expected.str() == fromSnapshot.str());
+}
+
+BOOST_AUTO_TEST_CASE(addrman_rejects_impossible_table_sizes)
+{
+    const uint256 nKey;
+    const int validTried = 0;
+    const int nUBuckets = ADDRMAN_NEW_BUCKET_COUNT ^ (1 << 30);
+    for (int nNew : {-1, ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE + 1}) {
+        CDataStream stream(SER_DISK, CLIENT_VERSION);
+        stream << (unsigned char)1 << (unsigned char)32 << nKey << nNew << validTried << nUBuckets;
+        CAddrManTest loaded;
+        BOOST_CHECK_THROW(stream >> loaded, std::ios_base::failure);
+        BOOST_CHECK_EQUAL(loaded.size(), 0);
+    }
+
+    const int validNew = 0;
+    for (int nTried : {-1, ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE + 1}) {
+        CDataStream stream(SER_DISK, CLIENT_VERSION);
+        stream << (unsigned char)1 << (unsigned char)32 << nKey << validNew << nTried << nUBuckets;
+        CAddrManTest loaded;
+        BOOST_CHECK_THROW(stream >> loaded, std::ios_base::failure);
+        BOOST_CHECK_EQUAL(loaded.size(), 0);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
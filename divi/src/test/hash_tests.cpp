@@ -46,4 +46,36 @@ BOOST_AUTO_TEST_CASE(murmurhash3)
 #undef T
 }
 
+BOOST_AUTO_TEST_CASE(siphash)
+{
+    CSipHasher hasher(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x726fdb47dd0e0e31ull);
+    static const unsigned char t0[1] = {0};
+    hasher.Write(t0, 1);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x74f839c593dc67fdull);
+    static const unsigned char t1[7] = {1,2,3,4,5,6,7};
+    hasher.Write(t1, 7);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x93f5f5799a932462ull);
+    hasher.Write(0x0F0E0D0C0B0A0908ULL);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x3f2acc7f57c29bdbull);
+    static const unsigned char t2[2] = {16,17};
+    hasher.Write(t2, 2);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x4bc1b3f0968dd39cull);
+    static const unsigned char t3[9] = {18,19,20,21,22,23,24,25,26};
+    hasher.Write(t3, 9);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x2f2e6163076bcfadull);
+    static const unsigned char t4[5] = {27,28,29,30,31};
+    hasher.Write(t4, 5);
+    BOOST_CHECK_EQUAL(hasher.Finalize(),  0x7127512f72f27cceull);
+
+    // The uint256 specialization must agree with the generic hasher over the same bytes
+    uint256 value = uint256("1f1e1d1c1b1a191817161514131211100f0e0d0c0b0a09080706050403020100");
+    std::vector<unsigned char> valueBytes(value.begin(), value.end());
+    BOOST_CHECK_EQUAL(valueBytes[0], 0u);
+    BOOST_CHECK_EQUAL(SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, value), 0x7127512f72f27cceull);
+    BOOST_CHECK_EQUAL(
+        SipHashUint256(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL, value),
+        CSipHasher(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL).Write(value.begin(), 32).Finalize());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
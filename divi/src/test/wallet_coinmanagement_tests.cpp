@@ -326,6 +326,19 @@ BOOST_AUTO_TEST_CASE(willReturnCorrectBalanceWhenTransactionIsConfirmed)
     BOOST_CHECK_EQUAL_MESSAGE(wallet.GetBalance(), 100*COIN,"Total balance was not the expected amount");
 }
 
+BOOST_AUTO_TEST_CASE(willCountFundsAlreadyTrackedOnceTheirKeyIsImported)
+{
+    CKey key; key.MakeNewKey(true);
+    CScript importedScript = GetScriptForDestination(key.GetPubKey().GetID());
+    unsigned outputIndex=0;
+    const CWalletTx& importedTx = fakeWallet.AddDefaultTx(importedScript,outputIndex,100*COIN);
+    fakeWallet.FakeAddToChain(importedTx);
+    BOOST_CHECK_EQUAL_MESSAGE(wallet.GetBalance(), 0,"Funds of a foreign key were counted");
+
+    BOOST_CHECK(wallet.ImportKeyPubKey(key,key.GetPubKey()));
+    BOOST_CHECK_EQUAL_MESSAGE(wallet.GetBalance(), 100*COIN,"Funds of the imported key were not counted");
+}
+
 BOOST_AUTO_TEST_CASE(willFindStakingBalanceIncludesBalanceEvenWhenOwnWalletFundsAreNotVaulted)
 {
     CScript normalScript = GetScriptForDestination(walletKeyForTests.GetID());
@@ -7,6 +7,7 @@
 #include "txdb.h"
 #include "uint256.h"
 #include <stdint.h>
+#include <set>
 #include <coins.h>
 #include <boost/thread.hpp>
 #include <BlockFileInfo.h>
@@ -28,6 +29,7 @@ namespace
 constexpr char DB_ADDRESSINDEX = 'a';
 constexpr char DB_SPENTINDEX = 'p';
 constexpr char DB_ADDRESSUNSPENTINDEX = 'u';
+constexpr char DB_ADDRESSBALANCE = 's';
 constexpr char DB_TXINDEX = 't';
 constexpr char DB_BARETXIDINDEX = 'T';
 constexpr char DB_COINS = 'c';
@@ -159,8 +161,6 @@ bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe
     ) : CLevelDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
-    , addressIndexing_(false)
-    , spentIndexing_(false)
     , txIndexing_(true)
 {
 }
@@ -319,32 +319,6 @@ bool CBlockTreeDB::WriteBestBlockHash(const uint256 bestBlockHash)
     return Write(DB_BESTBLOCKHASH, bestBlockHash);
 }
 
-bool CBlockTreeDB::UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect) {
-    CLevelDBBatch batch;
-    for (std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CLevelDBBatch batch;
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Write(make_pair(DB_ADDRESSINDEX, it->first), it->second);
-    return WriteBatch(batch);
-}
-
-bool CBlockTreeDB::EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount > >&vect) {
-    CLevelDBBatch batch;
-    for (std::vector<std::pair<CAddressIndexKey, CAmount> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
-        batch.Erase(make_pair(DB_ADDRESSINDEX, it->first));
-    return WriteBatch(batch);
-}
-
 template<typename K> bool GetKey(leveldb::Slice slKey, K& key) {
     try {
         CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
@@ -355,21 +329,15 @@ template<typename K> bool GetKey(leveldb::Slice slKey, K& key) {
     return true;
 }
 
-bool CBlockTreeDB::ReadAddressUnspentIndex(
-    uint160 addressHash,
-    int type,
-    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const
+bool CSearchIndexDB::ScanAddressUnspentIndex(const CAddressUnspentKey& from, const AddressUnspentVisitor& visit) const
 {
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CBlockTreeDB*>(this)->NewIterator());
+    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CSearchIndexDB*>(this)->NewIterator());
 
     CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-    CAddressUnspentKey addressKey;
-    addressKey.type = type;
-    addressKey.hashBytes = addressHash;
-    std::pair<char, CAddressUnspentKey> indexKey = std::make_pair(DB_ADDRESSUNSPENTINDEX, addressKey);
+    std::pair<char, CAddressUnspentKey> indexKey = std::make_pair(DB_ADDRESSUNSPENTINDEX, from);
     ssKey.reserve(ssKey.GetSerializeSize(indexKey));
     ssKey << indexKey;
 
@@ -379,19 +347,19 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressUnspentKey> key;
-        if (GetKey(pcursor->key(), key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == addressHash && key.second.type == static_cast<unsigned>(type))
+        if (GetKey(pcursor->key(), key) && key.first == DB_ADDRESSUNSPENTINDEX && key.second.hashBytes == from.hashBytes && key.second.type == from.type)
         {
+            CAddressUnspentValue nValue;
             try {
                 leveldb::Slice slValue = pcursor->value();
                 CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CAddressUnspentValue nValue;
                 ssValue >> nValue;
-
-                unspentOutputs.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
             } catch (const std::exception&) {
                 return error("failed to get address unspent value");
             }
+            if (!visit(key.second, nValue))
+                break;
+            pcursor->Next();
         } else {
             break;
         }
@@ -400,24 +368,29 @@ bool CBlockTreeDB::ReadAddressUnspentIndex(
     return true;
 }
 
-bool CBlockTreeDB::ReadAddressIndex(
+bool CSearchIndexDB::ReadAddressUnspentIndex(
     uint160 addressHash,
     int type,
-    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
-    int start,
-    int end) const
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &unspentOutputs) const
+{
+    CAddressUnspentKey from;
+    from.type = type;
+    from.hashBytes = addressHash;
+    return ScanAddressUnspentIndex(from, [&unspentOutputs](const CAddressUnspentKey& key, const CAddressUnspentValue& value) {
+        unspentOutputs.push_back(make_pair(key, value));
+        return true;
+    });
+}
+
+bool CSearchIndexDB::ScanAddressIndex(const CAddressIndexKey& from, int endHeight, const AddressIndexVisitor& visit) const
 {
     /* It seems that there are no "const iterators" for LevelDB.  Since we
        only need read operations on it, use a const-cast to get around
        that restriction.  */
-    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CBlockTreeDB*>(this)->NewIterator());
+    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CSearchIndexDB*>(this)->NewIterator());
 
     CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-    CAddressIndexKey addressKey;
-    addressKey.type = type;
-    addressKey.hashBytes = addressHash;
-    if(end > 0 && start > 0 ) addressKey.blockHeight = start;
-    std::pair<char, CAddressIndexKey> indexKey = std::make_pair(DB_ADDRESSINDEX, addressKey);
+    std::pair<char, CAddressIndexKey> indexKey = std::make_pair(DB_ADDRESSINDEX, from);
     ssKey.reserve(ssKey.GetSerializeSize(indexKey));
     ssKey << indexKey;
 
@@ -427,24 +400,24 @@ bool CBlockTreeDB::ReadAddressIndex(
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         std::pair<char,CAddressIndexKey> key;
-        if (GetKey(pcursor->key(), key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == addressHash && key.second.type == static_cast<unsigned>(type))
+        if (GetKey(pcursor->key(), key) && key.first == DB_ADDRESSINDEX && key.second.hashBytes == from.hashBytes && key.second.type == from.type)
         {
-            if (end > 0 && key.second.blockHeight > end)
+            if (endHeight > 0 && key.second.blockHeight > endHeight)
             {
                 break;
             }
 
+            CAmount nValue;
             try{
                 leveldb::Slice slValue = pcursor->value();
                 CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CAmount nValue;
                 ssValue >> nValue;
-
-                addressIndex.push_back(make_pair(key.second, nValue));
-                pcursor->Next();
             } catch (const std::exception&) {
                 return error("failed to get address index value");
             }
+            if (!visit(key.second, nValue))
+                break;
+            pcursor->Next();
         } else {
             break;
         }
@@ -453,71 +426,187 @@ bool CBlockTreeDB::ReadAddressIndex(
     return true;
 }
 
-bool CBlockTreeDB::ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const {
-    return Read(make_pair(DB_SPENTINDEX, key), value);
+bool CSearchIndexDB::ReadAddressIndex(
+    uint160 addressHash,
+    int type,
+    std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
+    int start,
+    int end) const
+{
+    CAddressIndexKey from;
+    from.type = type;
+    from.hashBytes = addressHash;
+    if(end > 0 && start > 0 ) from.blockHeight = start;
+    return ScanAddressIndex(from, end, [&addressIndex](const CAddressIndexKey& key, CAmount value) {
+        addressIndex.push_back(make_pair(key, value));
+        return true;
+    });
 }
 
-bool CBlockTreeDB::UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect) {
-    CLevelDBBatch batch;
-    for (std::vector<std::pair<CSpentIndexKey,CSpentIndexValue> >::const_iterator it=vect.begin(); it!=vect.end(); it++) {
-        if (it->second.IsNull()) {
-            batch.Erase(make_pair(DB_SPENTINDEX, it->first));
-        } else {
-            batch.Write(make_pair(DB_SPENTINDEX, it->first), it->second);
-        }
-    }
-    return WriteBatch(batch);
+bool CSearchIndexDB::ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const {
+    return Read(make_pair(DB_SPENTINDEX, key), value);
 }
 
-void CBlockTreeDB::SetAddressIndexing(bool addressIndexing)
+void CBlockTreeDB::SetTxIndexing(bool txIndexing)
 {
-    addressIndexing_ = addressIndexing;
+    txIndexing_ = txIndexing;
 }
-bool CBlockTreeDB::GetAddressIndexing() const
+bool CBlockTreeDB::GetTxIndexing() const
 {
-    return addressIndexing_;
+    return txIndexing_;
 }
-void CBlockTreeDB::SetSpentIndexing(bool spentIndexing)
+
+void CBlockTreeDB::LoadIndexingFlags()
 {
-    spentIndexing_ =spentIndexing;
+    // Check whether we have an tx index
+    ReadFlag("txindex", txIndexing_);
+    LogPrintf("%s: transaction index %s\n",__func__, txIndexing_ ? "enabled" : "disabled");
 }
-bool CBlockTreeDB::GetSpentIndexing() const
+
+void CBlockTreeDB::WriteIndexingFlags(bool txIndexing)
 {
-    return spentIndexing_;
+    SetTxIndexing(txIndexing);
+    WriteFlag("txindex", txIndexing_);
 }
 
-void CBlockTreeDB::SetTxIndexing(bool txIndexing)
+CSearchIndexDB::CSearchIndexDB(size_t nCacheSize, bool fMemory, bool fWipe
+    ) : CLevelDBWrapper(GetDataDir() / "indexes", nCacheSize, fMemory, fWipe)
+    , addressIndexing_(false)
+    , spentIndexing_(false)
 {
-    txIndexing_ = txIndexing;
 }
-bool CBlockTreeDB::GetTxIndexing() const
+
+bool CSearchIndexDB::GetAddressIndexing() const
 {
-    return txIndexing_;
+    return addressIndexing_;
+}
+bool CSearchIndexDB::GetSpentIndexing() const
+{
+    return spentIndexing_;
 }
 
-void CBlockTreeDB::LoadIndexingFlags()
+bool CSearchIndexDB::LoadIndexingFlags()
 {
-    // Check whether we have an address index
-    ReadFlag("addressindex", addressIndexing_);
-    LogPrintf("%s: address index %s\n", __func__, addressIndexing_ ? "enabled" : "disabled");
+    char addressFlag;
+    char spentFlag;
+    char balancesFlag;
+    // Indexes built before address balances were kept have to be rebuilt as well
+    if (!Read(std::make_pair(DB_NAMEDFLAG, std::string("addressindex")), addressFlag) ||
+        !Read(std::make_pair(DB_NAMEDFLAG, std::string("spentindex")), spentFlag) ||
+        !Read(std::make_pair(DB_NAMEDFLAG, std::string("addressbalances")), balancesFlag))
+        return false;
+    addressIndexing_ = addressFlag == '1';
+    spentIndexing_ = spentFlag == '1';
+    return true;
+}
 
-    // Check whether we have a spent index
-    ReadFlag("spentindex", spentIndexing_);
-    LogPrintf("%s: spent index %s\n", __func__, spentIndexing_ ? "enabled" : "disabled");
+bool CSearchIndexDB::ResetIndexes(bool addressIndexing, bool spentIndexing)
+{
+    static const size_t maximumErasuresPerBatch = 100000;
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    CLevelDBBatch batch;
+    size_t erasuresInBatch = 0;
+    for (pcursor->SeekToFirst(); pcursor->Valid(); pcursor->Next()) {
+        boost::this_thread::interruption_point();
+        std::pair<char, CAddressIndexKey> addressIndexKey;
+        std::pair<char, CAddressUnspentKey> addressUnspentKey;
+        std::pair<char, CSpentIndexKey> spentIndexKey;
+        std::pair<char, CAddressIndexIteratorKey> addressBalanceKey;
+        const char keyType = pcursor->key().empty()? '\0': pcursor->key()[0];
+        if (keyType == DB_ADDRESSINDEX && GetKey(pcursor->key(), addressIndexKey))
+            batch.Erase(addressIndexKey);
+        else if (keyType == DB_ADDRESSBALANCE && GetKey(pcursor->key(), addressBalanceKey))
+            batch.Erase(addressBalanceKey);
+        else if (keyType == DB_ADDRESSUNSPENTINDEX && GetKey(pcursor->key(), addressUnspentKey))
+            batch.Erase(addressUnspentKey);
+        else if (keyType == DB_SPENTINDEX && GetKey(pcursor->key(), spentIndexKey))
+            batch.Erase(spentIndexKey);
+        else
+            continue;
+
+        if (++erasuresInBatch == maximumErasuresPerBatch) {
+            if (!WriteBatch(batch))
+                return false;
+            batch = CLevelDBBatch();
+            erasuresInBatch = 0;
+        }
+    }
+    batch.Erase(DB_BESTBLOCKHASH);
+    batch.Write(std::make_pair(DB_NAMEDFLAG, std::string("addressindex")), addressIndexing ? '1' : '0');
+    batch.Write(std::make_pair(DB_NAMEDFLAG, std::string("spentindex")), spentIndexing ? '1' : '0');
+    batch.Write(std::make_pair(DB_NAMEDFLAG, std::string("addressbalances")), '1');
+    if (!WriteBatch(batch, true))
+        return false;
 
-    // Check whether we have an tx index
-    ReadFlag("txindex", txIndexing_);
-    LogPrintf("%s: transaction index %s\n",__func__, txIndexing_ ? "enabled" : "disabled");
+    addressIndexing_ = addressIndexing;
+    spentIndexing_ = spentIndexing;
+    return true;
 }
 
-void CBlockTreeDB::WriteIndexingFlags(bool addressIndexing, bool spentIndexing, bool txIndexing)
+bool CSearchIndexDB::ReadBestBlockHash(uint256& bestBlockHash) const
 {
-    SetAddressIndexing(addressIndexing);
-    WriteFlag("addressindex", addressIndexing_);
+    return Read(DB_BESTBLOCKHASH, bestBlockHash);
+}
 
-    SetSpentIndexing(spentIndexing);
-    WriteFlag("spentindex", spentIndexing_);
+void CSearchIndexDB::BatchWriteUpdates(
+    CLevelDBBatch& batch,
+    const IndexDatabaseUpdates& updates,
+    bool disconnecting,
+    AddressBalanceChanges& balanceChanges)
+{
+    const int sign = disconnecting ? -1 : 1;
+    std::set<std::pair<std::pair<unsigned int, uint160>, uint256>> transactionsOfAddresses;
+    for (const auto& entry : updates.addressIndex) {
+        if (disconnecting)
+            batch.Erase(make_pair(DB_ADDRESSINDEX, entry.first));
+        else
+            batch.Write(make_pair(DB_ADDRESSINDEX, entry.first), entry.second);
+
+        const std::pair<unsigned int, uint160> address(entry.first.type, entry.first.hashBytes);
+        CAddressBalance& change = balanceChanges[address];
+        change.balance += sign * entry.second;
+        if (entry.second > 0)
+            change.received += sign * entry.second;
+        if (transactionsOfAddresses.insert(std::make_pair(address, entry.first.txhash)).second)
+            change.txCount += sign;
+    }
+    for (const auto& entry : updates.addressUnspentIndex) {
+        if (entry.second.IsNull())
+            batch.Erase(make_pair(DB_ADDRESSUNSPENTINDEX, entry.first));
+        else
+            batch.Write(make_pair(DB_ADDRESSUNSPENTINDEX, entry.first), entry.second);
+    }
+    for (const auto& entry : updates.spentIndex) {
+        if (entry.second.IsNull())
+            batch.Erase(make_pair(DB_SPENTINDEX, entry.first));
+        else
+            batch.Write(make_pair(DB_SPENTINDEX, entry.first), entry.second);
+    }
+}
 
-    SetTxIndexing(txIndexing);
-    WriteFlag("txindex", txIndexing_);
-}
\ No newline at end of file
+bool CSearchIndexDB::CommitUpdates(CLevelDBBatch& batch, const AddressBalanceChanges& balanceChanges, const uint256& bestBlockHash)
+{
+    for (const auto& addressAndChange : balanceChanges) {
+        const CAddressIndexIteratorKey key(addressAndChange.first.first, addressAndChange.first.second);
+        const CAddressBalance& change = addressAndChange.second;
+        CAddressBalance balance;
+        if (Exists(make_pair(DB_ADDRESSBALANCE, key)) && !Read(make_pair(DB_ADDRESSBALANCE, key), balance))
+            return false;
+        balance.balance += change.balance;
+        balance.received += change.received;
+        balance.txCount += change.txCount;
+        if (balance.IsNull())
+            batch.Erase(make_pair(DB_ADDRESSBALANCE, key));
+        else
+            batch.Write(make_pair(DB_ADDRESSBALANCE, key), balance);
+    }
+    batch.Write(DB_BESTBLOCKHASH, bestBlockHash);
+    return WriteBatch(batch);
+}
+
+bool CSearchIndexDB::ReadAddressBalance(uint160 addressHash, int type, CAddressBalance& balance) const
+{
+    const std::pair<char, CAddressIndexIteratorKey> key(DB_ADDRESSBALANCE, CAddressIndexIteratorKey(type, addressHash));
+    balance.SetNull();
+    return !Exists(key) || Read(key, balance);
+}
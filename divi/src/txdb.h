@@ -9,6 +9,7 @@
 
 #include "leveldbwrapper.h"
 #include <coins.h>
+#include <functional>
 #include <map>
 #include <string>
 #include <utility>
@@ -25,10 +26,12 @@ struct CAddressIndexIteratorHeightKey;
 struct CSpentIndexKey;
 struct CAddressUnspentKey;
 struct CAddressUnspentValue;
+struct CAddressBalance;
 struct CDiskTxPos;
 struct CCoinsStats;
 struct CSpentIndexValue;
 struct TxIndexEntry;
+struct IndexDatabaseUpdates;
 struct BlockMap;
 
 /** CCoinsView backed by the LevelDB coin database (chainstate/) */
@@ -69,18 +72,12 @@ private:
     CBlockTreeDB(const CBlockTreeDB&);
     void operator=(const CBlockTreeDB&);
 
-    bool addressIndexing_;
-    bool spentIndexing_;
     bool txIndexing_;
 public:
-    void SetAddressIndexing(bool addressIndexing);
-    bool GetAddressIndexing() const;
-    void SetSpentIndexing(bool spentIndexing);
-    bool GetSpentIndexing() const;
     void SetTxIndexing(bool txIndexing);
     bool GetTxIndexing() const;
     void LoadIndexingFlags();
-    void WriteIndexingFlags(bool addressIndexing, bool spentIndexing, bool txIndexing);
+    void WriteIndexingFlags(bool txIndexing);
 
     bool WriteBlockIndex(const CDiskBlockIndex& blockindex);
     bool ReadBlockFileInfo(int nFile, CBlockFileInfo& fileinfo) const;
@@ -97,18 +94,66 @@ public:
     bool WriteBestBlockHash(const uint256 bestBlockHash);
 
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos) const;
-    bool WriteAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
-    bool EraseAddressIndex(const std::vector<std::pair<CAddressIndexKey, CAmount> > &vect);
+    bool WriteTxIndex(const std::vector<TxIndexEntry>& list);
+};
+
+/** Access to the optional address and spent indexes (indexes/).  They are
+ *  kept apart from the block database because AsyncIndexBuilder maintains
+ *  them in the background, so they may trail the active chain.  */
+class CSearchIndexDB : public CLevelDBWrapper
+{
+public:
+    CSearchIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+
+private:
+    CSearchIndexDB(const CSearchIndexDB&);
+    void operator=(const CSearchIndexDB&);
+
+    bool addressIndexing_;
+    bool spentIndexing_;
+public:
+    bool GetAddressIndexing() const;
+    bool GetSpentIndexing() const;
+    /** Loads which indexes the stored entries belong to; false if nothing was ever stored */
+    bool LoadIndexingFlags();
+    /** Erases all stored entries, after which the given indexes are built from the genesis block */
+    bool ResetIndexes(bool addressIndexing, bool spentIndexing);
+
+    /** Changes to the address balances, keyed by address type and hash */
+    typedef std::map<std::pair<unsigned int, uint160>, CAddressBalance> AddressBalanceChanges;
+
+    /** The last block whose updates are included in the indexes */
+    bool ReadBestBlockHash(uint256& bestBlockHash) const;
+    /** Queues the updates of a connected (or disconnected) block into batch; the
+     *  balance changes they imply are added up in balanceChanges */
+    static void BatchWriteUpdates(
+        CLevelDBBatch& batch,
+        const IndexDatabaseUpdates& updates,
+        bool disconnecting,
+        AddressBalanceChanges& balanceChanges);
+    /** Writes batch atomically together with the block it brings the indexes to,
+     *  applying balanceChanges to the stored balances */
+    bool CommitUpdates(CLevelDBBatch& batch, const AddressBalanceChanges& balanceChanges, const uint256& bestBlockHash);
+
+    /** Return false to stop a scan early */
+    typedef std::function<bool(const CAddressIndexKey&, CAmount)> AddressIndexVisitor;
+    typedef std::function<bool(const CAddressUnspentKey&, const CAddressUnspentValue&)> AddressUnspentVisitor;
+
+    /** Visits the address index entries of the address in from, in key order (by height
+     *  and position in the block), starting at from and up to endHeight (0 for the tip) */
+    bool ScanAddressIndex(const CAddressIndexKey& from, int endHeight, const AddressIndexVisitor& visit) const;
+    /** Visits the unspent outputs of the address in from, in key order (by txid and
+     *  output index), starting at from */
+    bool ScanAddressUnspentIndex(const CAddressUnspentKey& from, const AddressUnspentVisitor& visit) const;
+
     bool ReadAddressIndex(uint160 addressHash, int type,
                           std::vector<std::pair<CAddressIndexKey, CAmount> > &addressIndex,
                           int start = 0, int end = 0) const;
+    /** A null balance if the address never appeared on the indexed chain */
+    bool ReadAddressBalance(uint160 addressHash, int type, CAddressBalance& balance) const;
     bool ReadSpentIndex(const CSpentIndexKey &key, CSpentIndexValue &value) const;
     bool ReadAddressUnspentIndex(uint160 addressHash, int type,
                                  std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue> > &vect) const;
-
-    bool WriteTxIndex(const std::vector<TxIndexEntry>& list);
-    bool UpdateSpentIndex(const std::vector<std::pair<CSpentIndexKey, CSpentIndexValue> >&vect);
-    bool UpdateAddressUnspentIndex(const std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue > >&vect);
 };
 
 #endif // BITCOIN_TXDB_H
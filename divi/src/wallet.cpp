@@ -36,11 +36,13 @@
 #include <I_CoinSelectionAlgorithm.h>
 #include <MerkleTxConfirmationNumberCalculator.h>
 #include <random.h>
-#include <BlockScanner.h>
+#include <PipelinedBlockScanner.h>
 #include <ui_interface.h>
 #include <UtxoBalanceCalculator.h>
 #include <WalletBalanceCalculator.h>
-#include <CachedUtxoBalanceCalculator.h>
+#include <WalletBalanceLedger.h>
+#include <WalletUtxoIndex.h>
+#include <WalletOwnershipPrefilter.h>
 #include <script/StakingVaultScript.h>
 #include <I_WalletDatabaseEndpointFactory.h>
 #include <AvailableUtxoCollector.h>
@@ -160,6 +162,14 @@ CWallet::CWallet(
     , transactionRecord_(new WalletTransactionRecord(cs_wallet) )
     , outputTracker_( new SpentOutputTracker(*transactionRecord_,confirmationNumberCalculator_) )
     , ownershipDetector_(new WalletUtxoOwnershipDetector(*static_cast<CKeyStore*>(this), mapHdPubKeys))
+    , ownershipPrefilter_(new WalletOwnershipPrefilter())
+    , utxoIndex_(
+        new WalletUtxoIndex(
+            *ownershipDetector_,
+            *outputTracker_,
+            *transactionRecord_,
+            confirmationNumberCalculator_,
+            settings.GetArg("-maxreorg", Params().MaxReorganizationDepth())))
     , availableUtxoCollector_(
         new AvailableUtxoCollector(
             settings,
@@ -169,16 +179,23 @@ CWallet::CWallet(
             confirmationNumberCalculator_,
             *ownershipDetector_,
             *outputTracker_,
+            *utxoIndex_,
             setLockedCoins,
             cs_main))
     , utxoBalanceCalculator_( new UtxoBalanceCalculator(*ownershipDetector_,*outputTracker_) )
-    , cachedUtxoBalanceCalculator_( new CachedUtxoBalanceCalculator(*utxoBalanceCalculator_) )
     , balanceCalculator_(
         new WalletBalanceCalculator(
             *ownershipDetector_,
-            *cachedUtxoBalanceCalculator_,
+            *utxoBalanceCalculator_,
             *transactionRecord_,
             confirmationNumberCalculator_  ))
+    , balanceLedger_(
+        new WalletBalanceLedger(
+            *ownershipDetector_,
+            *outputTracker_,
+            *transactionRecord_,
+            confirmationNumberCalculator_,
+            settings.GetBoolArg("-checkwalletbalances", false)? balanceCalculator_.get(): nullptr))
     , cachedTxDeltasCalculator_(new CachedTransactionDeltasCalculator(*ownershipDetector_, *transactionRecord_, Params().MaxMoneyOut()))
     , nWalletVersion(FEATURE_BASE)
     , nWalletMaxVersion(FEATURE_BASE)
@@ -191,15 +208,18 @@ CWallet::CWallet(
     , setExternalKeyPool()
     , walletStakingOnly(false)
     , defaultKeyPoolTopUp_(defaultKeyTopUp)
+    , rescanProgress_(-1)
+    , rescanStartTime_(0)
 {
 }
 
 CWallet::~CWallet()
 {
+    balanceLedger_.reset();
     balanceCalculator_.reset();
-    cachedUtxoBalanceCalculator_.reset();
     utxoBalanceCalculator_.reset();
     availableUtxoCollector_.reset();
+    utxoIndex_.reset();
     ownershipDetector_.reset();
     outputTracker_.reset();
     transactionRecord_.reset();
@@ -276,42 +296,141 @@ static int computeProgress(int currentHeight,int startHeight,int endHeight)
     return std::max(1, std::min(99, progress));
 }
 
-void CWallet::verifySyncToActiveChain(const I_BlockDataReader& blockReader, bool startFromGenesis)
+static unsigned rescanThreadCount()
 {
-    LOCK2(cs_main,cs_wallet);
-    const CBlockIndex* const startingBlockIndex = getNextUnsycnedBlockIndexInMainChain(startFromGenesis);
-    if(!startingBlockIndex) return;
+    int numberOfThreads = settings.GetArg("-rescanthreads", DEFAULT_RESCAN_THREADS);
+    if(numberOfThreads <= 0) numberOfThreads += boost::thread::hardware_concurrency();
+    return std::max(1, std::min(numberOfThreads, MAX_RESCAN_THREADS));
+}
 
-    BlockScanner blockScanner(blockReader, activeChain_,startingBlockIndex);
+/** The transactions of a scanned block the wallet has to look at: those the prefilter let
+ *  through, and those related to transactions the wallet has, including the ones added
+ *  by earlier blocks of the same scan, which the prefilter could not know about */
+static TransactionVector transactionsToSync(const CWallet& wallet, const PipelinedBlockScanner::ScannedBlock& scannedBlock)
+{
+    TransactionVector transactions;
+    std::set<uint256> selectedTxids;
+    auto nextMatch = scannedBlock.matchingTransactions.begin();
+    for(unsigned transactionIndex = 0u; transactionIndex < scannedBlock.block.vtx.size(); ++transactionIndex)
+    {
+        const CTransaction& tx = scannedBlock.block.vtx[transactionIndex];
+        bool selected = nextMatch != scannedBlock.matchingTransactions.end() && *nextMatch == transactionIndex;
+        if(selected) ++nextMatch;
+        selected = selected || wallet.GetWalletTx(tx.GetHash()) != nullptr;
+        for(const CTxIn& input: tx.vin)
+        {
+            if(selected) break;
+            selected = selectedTxids.count(input.prevout.hash) > 0 || wallet.GetWalletTx(input.prevout.hash) != nullptr;
+        }
+        if(!selected) continue;
+        selectedTxids.insert(tx.GetHash());
+        transactions.push_back(tx);
+    }
+    return transactions;
+}
 
-    const int endHeight = activeChain_.Tip()->nHeight;
-    const int startHeight = startingBlockIndex->nHeight;
-    const unsigned numberOfBlocksToScan = endHeight - startHeight +1;
-    unsigned currentHeight = startingBlockIndex->nHeight;
-    int64_t nNow = GetTime();
+std::shared_ptr<const WalletOwnershipPrefilter> CWallet::createOwnershipPrefilter() const
+{
+    LOCK(cs_wallet);
+    return std::make_shared<WalletOwnershipPrefilter>(*ownershipPrefilter_);
+}
+
+/** Blocks are read and tested against a snapshot of the wallet's keys and scripts on
+ *  several threads, while only the transactions that may concern the wallet are synced,
+ *  in chain order. cs_main and cs_wallet are taken per block rather than for the whole
+ *  scan, and the scan follows the active chain through reorganizations. */
+void CWallet::verifySyncToActiveChain(const I_BlockDataReader& blockReader, bool startFromGenesis)
+{
+    const CBlockIndex* lastScannedBlockIndex;
+    int startHeight;
+    int endHeight;
+    {
+        LOCK2(cs_main,cs_wallet);
+        const CBlockIndex* const startingBlockIndex = getNextUnsycnedBlockIndexInMainChain(startFromGenesis);
+        if(!startingBlockIndex) return;
+        lastScannedBlockIndex = startingBlockIndex->pprev;
+        startHeight = startingBlockIndex->nHeight;
+        endHeight = activeChain_.Tip()->nHeight;
+    }
 
     const std::string typeOfScanMessage = startFromGenesis? "Rescanning" : "Scanning";
     LogPrintf("%s... from height %d to %d\n",typeOfScanMessage, startHeight,endHeight);
-    while(blockScanner.advanceToNextBlock() && numberOfBlocksToScan > 0u)
+    const std::shared_ptr<const WalletOwnershipPrefilter> prefilter = createOwnershipPrefilter();
+    PipelinedBlockScanner blockScanner(
+        blockReader,
+        [prefilter](const CTransaction& tx) { return prefilter->mightConcern(tx); },
+        rescanThreadCount());
+    rescanStartTime_ = GetTime();
+    rescanProgress_ = 0;
+    ShowProgress(translate("Rescanning..."), 0);
+
+    const unsigned blocksPerRun = 1000u;
+    int64_t nNow = GetTime();
+    bool readFailed = false;
+    while(!readFailed)
     {
-        if (currentHeight % 100 == 0)
+        std::vector<const CBlockIndex*> blocksToScan;
         {
-            const int progress = computeProgress(currentHeight,startHeight,endHeight);
-            LogPrintf("%s...%d%%\n",typeOfScanMessage, progress);
+            LOCK(cs_main);
+            const CBlockIndex* blockIndex = lastScannedBlockIndex?
+                activeChain_.Next(activeChain_.FindFork(lastScannedBlockIndex)): activeChain_.Genesis();
+            for(; blockIndex && blocksToScan.size() < blocksPerRun; blockIndex = activeChain_.Next(blockIndex))
+            {
+                blocksToScan.push_back(blockIndex);
+            }
+            endHeight = std::max(endHeight, activeChain_.Height());
         }
-        SyncTransactions(blockScanner.blockTransactions(), &blockScanner.blockRef(), TransactionSyncType::RESCAN);
-        if (GetTime() >= nNow + 60)
+        if(blocksToScan.empty()) break;
+
+        blockScanner.scan(blocksToScan);
+        for(std::unique_ptr<PipelinedBlockScanner::ScannedBlock> scannedBlock = blockScanner.nextBlock();
+            scannedBlock;
+            scannedBlock = blockScanner.nextBlock())
         {
-            nNow = GetTime();
-            LogPrintf("%s - at block %d. Progress=%d%%\n",typeOfScanMessage, currentHeight, computeProgress(currentHeight,startHeight,endHeight));
+            const int currentHeight = scannedBlock->blockIndex->nHeight;
+            if(!scannedBlock->readSucceeded)
+            {
+                LogPrintf("%s - unable to read block %d\n",typeOfScanMessage, currentHeight);
+                readFailed = true;
+                break;
+            }
+            {
+                LOCK2(cs_main,cs_wallet);
+                // Reorganized away: the next run starts from the fork
+                if(!activeChain_.Contains(scannedBlock->blockIndex)) break;
+                SyncTransactions(transactionsToSync(*this, *scannedBlock), &scannedBlock->block, TransactionSyncType::RESCAN);
+                lastScannedBlockIndex = scannedBlock->blockIndex;
+            }
+
+            const int progress = computeProgress(currentHeight,startHeight,endHeight);
+            if(progress != rescanProgress_)
+            {
+                rescanProgress_ = progress;
+                ShowProgress(translate("Rescanning..."), progress);
+                uiInterface.InitMessage(strprintf("%s... %d%%",typeOfScanMessage, progress));
+            }
+            if (GetTime() >= nNow + 60)
+            {
+                nNow = GetTime();
+                LogPrintf("%s - at block %d. Progress=%d%%\n",typeOfScanMessage, currentHeight, progress);
+            }
         }
-        currentHeight += 1;
     }
     LogPrintf("%s...done\n",typeOfScanMessage);
+    rescanProgress_ = -1;
+    ShowProgress("", 100);
 
+    LOCK2(cs_main,cs_wallet);
     SetBestChain(activeChain_.GetLocator());
 }
 
+bool CWallet::GetRescanProgress(int& progress, int64_t& startTime) const
+{
+    progress = rescanProgress_;
+    startTime = rescanStartTime_;
+    return progress >= 0;
+}
+
 bool CWallet::loadMasterKey(unsigned int masterKeyIndex, CMasterKey& masterKey)
 {
     if (mapMasterKeys.count(masterKeyIndex) != 0) {
@@ -324,8 +443,36 @@ bool CWallet::loadMasterKey(unsigned int masterKeyIndex, CMasterKey& masterKey)
     return true;
 }
 
+void CWallet::invalidateOwnershipCaches()
+{
+    utxoIndex_->invalidate();
+    balanceLedger_->invalidate();
+}
+
+void CWallet::reevaluateTransactionsPaying(const CScript& script, const CTxDestination& destination)
+{
+    AssertLockHeld(cs_wallet);
+    for(const auto& hashAndTransaction: transactionRecord_->GetWalletTransactions())
+    {
+        const CWalletTx& walletTransaction = hashAndTransaction.second;
+        for(const CTxOut& output: walletTransaction.vout)
+        {
+            CTxDestination outputDestination;
+            if(output.scriptPubKey == script ||
+                (ExtractDestination(output.scriptPubKey, outputDestination) && outputDestination == destination))
+            {
+                utxoIndex_->recomputeCachedTxEntries(walletTransaction);
+                balanceLedger_->recomputeCachedTxEntries(walletTransaction);
+                break;
+            }
+        }
+    }
+}
+
 bool CWallet::loadKey(const CKey& key, const CPubKey& pubkey)
 {
+    LOCK(cs_wallet);
+    ownershipPrefilter_->addKey(pubkey.GetID());
     return CCryptoKeyStore::AddKeyPubKey(key, pubkey);
 }
 
@@ -570,6 +717,7 @@ bool CWallet::loadHDPubKey(const CHDPubKey &hdPubKey)
     AssertLockHeld(cs_wallet);
 
     mapHdPubKeys[hdPubKey.extPubKey.pubkey.GetID()] = hdPubKey;
+    ownershipPrefilter_->addKey(hdPubKey.extPubKey.pubkey.GetID());
     return true;
 }
 
@@ -585,6 +733,7 @@ bool CWallet::AddHDPubKey(const CExtPubKey &extPubKey, bool fInternal)
     hdPubKey.hdchainID = hdChainCurrent.GetID();
     hdPubKey.nChangeIndex = fInternal ? 1 : 0;
     mapHdPubKeys[extPubKey.pubkey.GetID()] = hdPubKey;
+    ownershipPrefilter_->addKey(extPubKey.pubkey.GetID());
 
     // check if we need to remove from watch-only
     CScript script;
@@ -600,6 +749,7 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     AssertLockHeld(cs_wallet); // mapKeyMetadata
     if (!CCryptoKeyStore::AddKeyPubKey(secret, pubkey))
         return false;
+    ownershipPrefilter_->addKey(pubkey.GetID());
 
     // check if we need to remove from watch-only
     CScript script;
@@ -614,6 +764,15 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     return true;
 }
 
+bool CWallet::ImportKeyPubKey(const CKey& secret, const CPubKey& pubkey)
+{
+    AssertLockHeld(cs_wallet);
+    if (!AddKeyPubKey(secret, pubkey))
+        return false;
+    reevaluateTransactionsPaying(GetScriptForDestination(pubkey.GetID()), pubkey.GetID());
+    return true;
+}
+
 void CWallet::reserializeTransactions(const std::vector<uint256>& transactionIDs)
 {
     auto walletDB = walletDatabaseEndpointFactory_.getDatabaseEndpoint();
@@ -664,6 +823,8 @@ void CWallet::updateTimeFirstKey(int64_t nCreateTime)
 
 bool CWallet::loadCryptedKey(const CPubKey& vchPubKey, const std::vector<unsigned char>& vchCryptedSecret)
 {
+    LOCK(cs_wallet);
+    ownershipPrefilter_->addKey(vchPubKey.GetID());
     return CCryptoKeyStore::AddCryptedKey(vchPubKey, vchCryptedSecret);
 }
 
@@ -671,6 +832,11 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    {
+        LOCK(cs_wallet);
+        ownershipPrefilter_->addRedeemScript(redeemScript);
+        reevaluateTransactionsPaying(redeemScript, CScriptID(redeemScript));
+    }
 
     return walletDatabaseEndpointFactory_.getDatabaseEndpoint()->WriteCScript(Hash160(redeemScript), redeemScript);
 }
@@ -687,6 +853,8 @@ bool CWallet::loadCScript(const CScript& redeemScript)
         return true;
     }
 
+    LOCK(cs_wallet);
+    ownershipPrefilter_->addRedeemScript(redeemScript);
     return CCryptoKeyStore::AddCScript(redeemScript);
 }
 
@@ -710,6 +878,7 @@ bool CWallet::RemoveVault(const CScript& vaultScript)
     {
         LOCK2(cs_wallet,cs_KeyStore);
         mapScripts.erase(CScriptID(vaultScript));
+        invalidateOwnershipCaches();
         return true;
     }
     return false;
@@ -720,6 +889,11 @@ bool CWallet::AddWatchOnly(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest))
         return false;
+    {
+        LOCK(cs_wallet);
+        ownershipPrefilter_->addScript(dest);
+        reevaluateTransactionsPaying(dest, CScriptID(dest));
+    }
     nTimeFirstKey = 1; // No birthday information for watch-only keys.
     NotifyWatchonlyChanged(true);
 
@@ -731,6 +905,7 @@ bool CWallet::RemoveWatchOnly(const CScript& dest)
     AssertLockHeld(cs_wallet);
     if (!CCryptoKeyStore::RemoveWatchOnly(dest))
         return false;
+    invalidateOwnershipCaches();
     if (!HaveWatchOnly())
         NotifyWatchonlyChanged(false);
 
@@ -742,6 +917,7 @@ bool CWallet::loadWatchOnly(const CScript& dest)
     // Watch-only addresses have no birthday information for now,
     // so set the wallet birthday to the beginning of time.
     updateTimeFirstKey(1);
+    ownershipPrefilter_->addScript(dest);
     return CCryptoKeyStore::AddWatchOnly(dest);
 }
 
@@ -749,6 +925,11 @@ bool CWallet::AddMultiSig(const CScript& dest)
 {
     if (!CCryptoKeyStore::AddMultiSig(dest))
         return false;
+    {
+        LOCK(cs_wallet);
+        ownershipPrefilter_->addScript(dest);
+        reevaluateTransactionsPaying(dest, CScriptID(dest));
+    }
     nTimeFirstKey = 1; // No birthday information
     NotifyMultiSigChanged(true);
 
@@ -760,6 +941,7 @@ bool CWallet::RemoveMultiSig(const CScript& dest)
     AssertLockHeld(cs_wallet);
     if (!CCryptoKeyStore::RemoveMultiSig(dest))
         return false;
+    invalidateOwnershipCaches();
     if (!HaveMultiSig())
         NotifyMultiSigChanged(false);
 
@@ -771,6 +953,7 @@ bool CWallet::loadMultiSig(const CScript& dest)
     // MultiSig addresses have no birthday information for now,
     // so set the wallet birthday to the beginning of time.
     updateTimeFirstKey(1);
+    ownershipPrefilter_->addScript(dest);
     return CCryptoKeyStore::AddMultiSig(dest);
 }
 
@@ -1087,6 +1270,7 @@ int64_t CWallet::smartWalletTxTimestampEstimation(const CWalletTx& wtx)
 void CWallet::loadWalletTransaction(const CWalletTx& wtxIn)
 {
     outputTracker_->UpdateSpends(wtxIn, true);
+    ownershipPrefilter_->addTransaction(wtxIn.GetHash());
 }
 
 static bool topologicallySortTransactions(
@@ -1198,15 +1382,23 @@ bool CWallet::PruneWallet()
     }
 
     cachedTxDeltasCalculator_.reset();
+    balanceLedger_.reset();
     balanceCalculator_.reset();
-    cachedUtxoBalanceCalculator_.reset();
     utxoBalanceCalculator_.reset();
     availableUtxoCollector_.reset();
+    utxoIndex_.reset();
     outputTracker_.reset();
     transactionRecord_.reset();
 
     transactionRecord_.reset(new PrunedWalletTransactionRecord(cs_wallet,totalTxs));
     outputTracker_.reset( new SpentOutputTracker(*transactionRecord_,confirmationNumberCalculator_) );
+    utxoIndex_.reset(
+        new WalletUtxoIndex(
+            *ownershipDetector_,
+            *outputTracker_,
+            *transactionRecord_,
+            confirmationNumberCalculator_,
+            settings.GetArg("-maxreorg", Params().MaxReorganizationDepth())));
     availableUtxoCollector_.reset(
         new AvailableUtxoCollector(
             settings,
@@ -1216,16 +1408,23 @@ bool CWallet::PruneWallet()
             confirmationNumberCalculator_,
             *ownershipDetector_,
             *outputTracker_,
+            *utxoIndex_,
             setLockedCoins,
             cs_main));
     utxoBalanceCalculator_.reset( new UtxoBalanceCalculator(*ownershipDetector_,*outputTracker_) );
-    cachedUtxoBalanceCalculator_.reset( new CachedUtxoBalanceCalculator(*utxoBalanceCalculator_) );
     balanceCalculator_.reset(
         new WalletBalanceCalculator(
             *ownershipDetector_,
-            *cachedUtxoBalanceCalculator_,
+            *utxoBalanceCalculator_,
             *transactionRecord_,
             confirmationNumberCalculator_  ));
+    balanceLedger_.reset(
+        new WalletBalanceLedger(
+            *ownershipDetector_,
+            *outputTracker_,
+            *transactionRecord_,
+            confirmationNumberCalculator_,
+            settings.GetBoolArg("-checkwalletbalances", false)? balanceCalculator_.get(): nullptr));
     cachedTxDeltasCalculator_.reset(new CachedTransactionDeltasCalculator(*ownershipDetector_, *transactionRecord_, Params().MaxMoneyOut()));
 
 
@@ -1245,7 +1444,9 @@ bool CWallet::addToWallet(const CWalletTx& wtxIn,bool blockDisconnection)
     // Inserts only if not already there, returns tx inserted or tx found
     std::pair<CWalletTx*, bool> walletTxAndRecordStatus = outputTracker_->UpdateSpends(wtxIn,false);
     CWalletTx& wtx = *walletTxAndRecordStatus.first;
-    cachedUtxoBalanceCalculator_->recomputeCachedTxEntries(wtx);
+    ownershipPrefilter_->addTransaction(wtx.GetHash());
+    balanceLedger_->recomputeCachedTxEntries(wtx);
+    utxoIndex_->recomputeCachedTxEntries(wtx);
     cachedTxDeltasCalculator_->recomputeCachedTxEntries(wtx);
     bool transactionHashIsNewToWallet = walletTxAndRecordStatus.second;
 
@@ -1276,7 +1477,8 @@ bool CWallet::addToWallet(const CWalletTx& wtxIn,bool blockDisconnection)
     }
 
     // Break debit/credit balance caches:
-    cachedUtxoBalanceCalculator_->recomputeCachedTxEntries(wtx);
+    balanceLedger_->recomputeCachedTxEntries(wtx);
+    utxoIndex_->recomputeCachedTxEntries(wtx);
     cachedTxDeltasCalculator_->recomputeCachedTxEntries(wtx);
 
     // Notify UI of new or updated transaction
@@ -1317,7 +1519,8 @@ void CWallet::addTransactions(const TransactionVector& txs, const CBlock* pblock
     AssertLockHeld(cs_wallet);
     for(const CTransaction& tx: txs)
     {
-        if (!addToWalletIfInvolvingMe(tx, pblock, true,syncType))
+        // Most transactions are ruled out by the prefilter, without solving their scripts
+        if (!ownershipPrefilter_->mightConcern(tx) || !addToWalletIfInvolvingMe(tx, pblock, true,syncType))
             continue; // Not one of ours
 
         // If a transaction changes 'conflicted' state, that changes the balance
@@ -1328,7 +1531,8 @@ void CWallet::addTransactions(const TransactionVector& txs, const CBlock* pblock
             CWalletTx* wtx = const_cast<CWalletTx*>(GetWalletTx(txin.prevout.hash));
             if (wtx != nullptr)
             {
-                cachedUtxoBalanceCalculator_->recomputeCachedTxEntries(*wtx);
+                balanceLedger_->recomputeCachedTxEntries(*wtx);
+                utxoIndex_->recomputeCachedTxEntries(*wtx);
                 cachedTxDeltasCalculator_->recomputeCachedTxEntries(*wtx);
             }
         }
@@ -1372,7 +1576,7 @@ CAmount CWallet::GetVaultedBalance() const
     LOCK2(cs_main,cs_wallet);
     UtxoOwnershipFilter filter;
     filter.addOwnershipType(isminetype::ISMINE_OWNED_VAULT);
-    return balanceCalculator_->getBalance(filter);
+    return balanceLedger_->getBalance(filter);
 }
 CAmount CWallet::GetStakingBalance() const
 {
@@ -1381,7 +1585,7 @@ CAmount CWallet::GetStakingBalance() const
     filter.addOwnershipType(isminetype::ISMINE_SPENDABLE);
     filter.addOwnershipType(isminetype::ISMINE_MANAGED_VAULT);
     CAmount totalLockedCoinsBalance = lockedCoinBalance(filter);
-    return balanceCalculator_->getBalance(filter) - totalLockedCoinsBalance;
+    return balanceLedger_->getBalance(filter) - totalLockedCoinsBalance;
 }
 
 CAmount CWallet::GetSpendableBalance() const
@@ -1389,7 +1593,7 @@ CAmount CWallet::GetSpendableBalance() const
     LOCK2(cs_main,cs_wallet);
     UtxoOwnershipFilter filter;
     filter.addOwnershipType(isminetype::ISMINE_SPENDABLE);
-    return balanceCalculator_->getSpendableBalance(filter);
+    return balanceLedger_->getSpendableBalance(filter);
 }
 
 CAmount CWallet::GetBalance() const
@@ -1398,7 +1602,7 @@ CAmount CWallet::GetBalance() const
     UtxoOwnershipFilter filter;
     filter.addOwnershipType(isminetype::ISMINE_SPENDABLE);
     filter.addOwnershipType(isminetype::ISMINE_OWNED_VAULT);
-    return balanceCalculator_->getBalance(filter);
+    return balanceLedger_->getBalance(filter);
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
@@ -1406,7 +1610,7 @@ CAmount CWallet::GetUnconfirmedBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        nTotal += balanceCalculator_->getUnconfirmedBalance();
+        nTotal += balanceLedger_->getUnconfirmedBalance();
     }
     return nTotal;
 }
@@ -1416,7 +1620,7 @@ CAmount CWallet::GetImmatureBalance() const
     CAmount nTotal = 0;
     {
         LOCK2(cs_main, cs_wallet);
-        nTotal += balanceCalculator_->getImmatureBalance();
+        nTotal += balanceLedger_->getImmatureBalance();
     }
     return nTotal;
 }
@@ -1891,7 +2095,8 @@ bool CWallet::CommitTransaction(CWalletTx& wtxNew, CReserveKey& reservekey)
                         LogPrintf("%s: Spending inputs not recorded in wallet - %s\n", __func__, txin.prevout.hash);
                         assert(coinPtr);
                     }
-                    cachedUtxoBalanceCalculator_->recomputeCachedTxEntries(*coinPtr);
+                    balanceLedger_->recomputeCachedTxEntries(*coinPtr);
+                    utxoIndex_->recomputeCachedTxEntries(*coinPtr);
                     cachedTxDeltasCalculator_->recomputeCachedTxEntries(*coinPtr);
                     NotifyTransactionChanged(coinPtr->GetHash(), TransactionNotificationType::SPEND_FROM);
                     updated_hashes.insert(txin.prevout.hash);
@@ -2207,7 +2412,8 @@ void CWallet::LockCoin(const COutPoint& output)
     CWalletTx* txPtr = const_cast<CWalletTx*>(GetWalletTx(output.hash));
     if (txPtr != nullptr)
     {
-        cachedUtxoBalanceCalculator_->recomputeCachedTxEntries(*txPtr);
+        balanceLedger_->recomputeCachedTxEntries(*txPtr);
+        utxoIndex_->recomputeCachedTxEntries(*txPtr);
         cachedTxDeltasCalculator_->recomputeCachedTxEntries(*txPtr);
     }
 }
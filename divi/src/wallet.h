@@ -32,6 +32,7 @@
 #include <LockedCoinsSet.h>
 #include <AvailableCoinsType.h>
 #include <CachedTransactionDeltas.h>
+#include <atomic>
 
 class I_CoinSelectionAlgorithm;
 class CKeyMetadata;
@@ -58,8 +59,11 @@ class I_MerkleTxConfirmationNumberCalculator;
 class I_VaultManagerDatabase;
 class VaultManager;
 class CBlockLocator;
+class WalletOwnershipPrefilter;
 class I_BlockDataReader;
 class I_WalletBalanceCalculator;
+class WalletBalanceLedger;
+class WalletUtxoIndex;
 class AvailableUtxoCollector;
 class I_WalletDatabaseEndpointFactory;
 class ChangeOutputCreator;
@@ -171,10 +175,12 @@ private:
     std::unique_ptr<I_AppendOnlyTransactionRecord> transactionRecord_;
     std::unique_ptr<I_SpentOutputTracker> outputTracker_;
     std::unique_ptr<I_UtxoOwnershipDetector> ownershipDetector_;
+    std::unique_ptr<WalletOwnershipPrefilter> ownershipPrefilter_;
+    std::unique_ptr<WalletUtxoIndex> utxoIndex_;
     std::unique_ptr<AvailableUtxoCollector> availableUtxoCollector_;
     std::unique_ptr<I_TransactionDetailCalculator<CAmount>> utxoBalanceCalculator_;
-    std::unique_ptr<I_CachedTransactionDetailCalculator<CAmount>> cachedUtxoBalanceCalculator_;
     std::unique_ptr<I_WalletBalanceCalculator> balanceCalculator_;
+    std::unique_ptr<WalletBalanceLedger> balanceLedger_;
     std::unique_ptr<I_CachedTransactionDetailCalculator<CachedTransactionDeltas>> cachedTxDeltasCalculator_;
     mutable std::map<uint256,std::map<uint8_t, CachedTransactionDeltas>> cachedTransactionDeltasByHash_;
 
@@ -193,6 +199,8 @@ private:
     std::set<int64_t> setExternalKeyPool;
     bool walletStakingOnly;
     int64_t defaultKeyPoolTopUp_;
+    std::atomic<int> rescanProgress_;
+    std::atomic<int64_t> rescanStartTime_;
 
     void deriveNewChildKey(const CKeyMetadata& metadata, CKey& secretRet, uint32_t nAccountIndex, bool fInternal /*= false*/);
     void addTransactions(const TransactionVector& txs, const CBlock* pblock,const TransactionSyncType syncType);
@@ -212,6 +220,11 @@ private:
     bool canSupportFeature(enum WalletFeature wf);
     const CBlockIndex* getNextUnsycnedBlockIndexInMainChain(bool syncFromGenesis = false);
     int64_t getTimestampOfFistKey() const;
+    std::shared_ptr<const WalletOwnershipPrefilter> createOwnershipPrefilter() const;
+    /** Keys or scripts were removed, so cached ownership of any output may be stale */
+    void invalidateOwnershipCaches();
+    /** Recompute cached ownership of the transactions with an output paying to a newly added script or destination */
+    void reevaluateTransactionsPaying(const CScript& script, const CTxDestination& destination);
     bool canBePruned(const CWalletTx& wtx, const std::set<uint256>& unprunedTransactionIds, const int minimumNumberOfConfs) const;
 
     CAmount lockedCoinBalance(const UtxoOwnershipFilter& filter) const;
@@ -276,6 +289,8 @@ public:
     const AddressBookManager& getAddressBookManager() const;
 
     void verifySyncToActiveChain(const I_BlockDataReader& blockReader, bool startFromGenesis);
+    /** Percentage done and start time of a running chain scan; false if none is running */
+    bool GetRescanProgress(int& progress, int64_t& startTime) const;
     CKeyMetadata getKeyMetadata(const CBitcoinAddress& address) const;
 
     bool SetAddressLabel(const CTxDestination& address, const std::string& strName);
@@ -326,6 +341,8 @@ public:
     bool GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const override;
     bool GetKey(const CKeyID &address, CKey& keyOut) const override;
     bool AddKeyPubKey(const CKey& key, const CPubKey& pubkey) override;
+    /** Adds a key that did not come from this wallet, so transactions it already tracks may pay to it */
+    bool ImportKeyPubKey(const CKey& key, const CPubKey& pubkey);
 
     bool AddCScript(const CScript& redeemScript) override;
     bool AddWatchOnly(const CScript& dest) override;
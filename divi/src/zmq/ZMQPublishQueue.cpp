@@ -0,0 +1,91 @@
+#include <zmq/ZMQPublishQueue.h>
+
+#include <ThreadManagementHelpers.h>
+
+ZMQPublishQueue::ZMQPublishQueue(
+    size_t maxQueuedMessages
+    ): maxQueuedMessages_(std::max<size_t>(maxQueuedMessages, 1u))
+    , mutex_()
+    , messageAvailable_()
+    , queuedMessages_()
+    , droppedMessages_(0)
+    , workers_()
+    , stopped_(false)
+{
+    workers_.create_thread([this](){ TraceThread("zmqpub", [this](){ PublishMessages(); }); });
+}
+
+ZMQPublishQueue::~ZMQPublishQueue()
+{
+    Stop();
+}
+
+bool ZMQPublishQueue::Enqueue(PublishTask task)
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        if(stopped_ || queuedMessages_.size() >= maxQueuedMessages_)
+        {
+            ++droppedMessages_;
+            return false;
+        }
+        queuedMessages_.push_back(std::move(task));
+    }
+    messageAvailable_.notify_one();
+    return true;
+}
+
+size_t ZMQPublishQueue::NumberOfQueuedMessages() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return queuedMessages_.size();
+}
+
+uint64_t ZMQPublishQueue::NumberOfDroppedMessages() const
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    return droppedMessages_;
+}
+
+void ZMQPublishQueue::Stop()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        if(stopped_) return;
+        stopped_ = true;
+    }
+    workers_.interrupt_all();
+    workers_.join_all();
+
+    std::deque<PublishTask> droppedTasks;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex_);
+        droppedTasks.swap(queuedMessages_);
+        droppedMessages_ += droppedTasks.size();
+    }
+}
+
+bool ZMQPublishQueue::WaitForMessage(PublishTask& task)
+{
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while(queuedMessages_.empty() && !stopped_)
+    {
+        messageAvailable_.wait(lock);
+    }
+    if(stopped_) return false;
+
+    task = std::move(queuedMessages_.front());
+    queuedMessages_.pop_front();
+    return true;
+}
+
+void ZMQPublishQueue::PublishMessages()
+{
+    PublishTask task;
+    while(WaitForMessage(task))
+    {
+        task();
+        task = PublishTask();
+        boost::this_thread::interruption_point();
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef ZMQ_PUBLISH_QUEUE_H
+#define ZMQ_PUBLISH_QUEUE_H
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+/** Hands ZMQ notifications over to a single publisher thread, so that slow
+ *  subscribers and payload serialization never hold up block validation.
+ *  The queue is bounded: a message that does not fit any more is dropped
+ *  rather than making the notifying thread wait, and since publishers number
+ *  their messages when queuing them, subscribers see the drop as a gap in the
+ *  sequence numbers.
+ */
+class ZMQPublishQueue
+{
+public:
+    /** Sends one message; runs on the publisher thread */
+    typedef std::function<void()> PublishTask;
+private:
+    const size_t maxQueuedMessages_;
+
+    mutable boost::mutex mutex_;
+    boost::condition_variable messageAvailable_;
+    std::deque<PublishTask> queuedMessages_;
+    uint64_t droppedMessages_;
+    boost::thread_group workers_;
+    bool stopped_;
+
+    bool WaitForMessage(PublishTask& task);
+    void PublishMessages();
+public:
+    explicit ZMQPublishQueue(size_t maxQueuedMessages);
+    ~ZMQPublishQueue();
+
+    /** Queues a message; returns false, counting it as dropped, if the queue is full or stopped */
+    bool Enqueue(PublishTask task);
+    size_t NumberOfQueuedMessages() const;
+    uint64_t NumberOfDroppedMessages() const;
+    /** Interrupts and joins the publisher thread; messages still queued are dropped */
+    void Stop();
+};
+#endif// ZMQ_PUBLISH_QUEUE_H
@@ -6,32 +6,41 @@
 #define BITCOIN_ZMQ_ZMQABSTRACTNOTIFIER_H
 
 #include "zmqconfig.h"
+#include <memory>
 
+class CBlock;
 class CBlockIndex;
 class CTransaction;
 class CZMQAbstractNotifier;
+class ZMQPublishQueue;
 
 typedef CZMQAbstractNotifier* (*CZMQNotifierFactory)();
 
 class CZMQAbstractNotifier
 {
 public:
-    CZMQAbstractNotifier() : psocket(0) { }
+    CZMQAbstractNotifier() : psocket(0), publishQueue(0) { }
     virtual ~CZMQAbstractNotifier();
 
     std::string GetType() const { return type; }
     void SetType(const std::string &t) { type = t; }
     std::string GetAddress() const { return address; }
     void SetAddress(const std::string &a) { address = a; }
+    void SetPublishQueue(ZMQPublishQueue *queue) { publishQueue = queue; }
 
     virtual bool Initialize(void *pcontext) = 0;
     virtual void Shutdown() = 0;
 
-    virtual bool NotifyBlock(const CBlockIndex *pindex);
+    /** block is the connected block when it is still in memory, null otherwise.
+     *  Returning false retires the notifier. */
+    virtual bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &block);
     virtual bool NotifyTransaction(const CTransaction &transaction);
+    /** Whether NotifyBlock makes use of the block itself, so it is worth keeping */
+    virtual bool UsesBlockData() const { return false; }
 
 protected:
     void *psocket;
+    ZMQPublishQueue *publishQueue;
     std::string type;
     std::string address;
 };
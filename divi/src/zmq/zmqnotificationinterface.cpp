@@ -10,13 +10,24 @@
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include <zmq/ZMQNotifierFactory.h>
+#include <zmq/ZMQPublishQueue.h>
+#include <chain.h>
+#include <defaultValues.h>
 
 void zmqError(const char *str)
 {
     LogPrint("zmq", "zmq: Error: %s, errno=%s\n", str, zmq_strerror(errno));
 }
 
-CZMQNotificationInterface::CZMQNotificationInterface() : pcontext(NULL)
+CZMQNotificationInterface::CZMQNotificationInterface(
+    size_t maxQueuedMessages
+    ): pcontext(NULL)
+    , maxQueuedMessages(maxQueuedMessages)
+    , publishQueue()
+    , cs_notifiers()
+    , notifiers()
+    , retiredNotifiers()
+    , lastConnectedBlock()
 {
 }
 
@@ -28,6 +39,10 @@ CZMQNotificationInterface::~CZMQNotificationInterface()
     {
         delete *i;
     }
+    for (std::list<CZMQAbstractNotifier*>::iterator i=retiredNotifiers.begin(); i!=retiredNotifiers.end(); ++i)
+    {
+        delete *i;
+    }
 }
 
 CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const Settings &settings)
@@ -52,7 +67,8 @@ CZMQNotificationInterface* CZMQNotificationInterface::CreateWithArguments(const
 
     if (!notifiers.empty())
     {
-        notificationInterface = new CZMQNotificationInterface();
+        const int64_t maxQueuedMessages = settings.GetArg("-zmqqueuesize", DEFAULT_ZMQ_QUEUE_SIZE);
+        notificationInterface = new CZMQNotificationInterface(static_cast<size_t>(std::max<int64_t>(maxQueuedMessages, 1)));
         notificationInterface->notifiers = notifiers;
 
         if (!notificationInterface->Initialize())
@@ -78,11 +94,13 @@ bool CZMQNotificationInterface::Initialize()
         zmqError("Unable to initialize context");
         return false;
     }
+    publishQueue.reset(new ZMQPublishQueue(maxQueuedMessages));
 
     std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin();
     for (; i!=notifiers.end(); ++i)
     {
         CZMQAbstractNotifier *notifier = *i;
+        notifier->SetPublishQueue(publishQueue.get());
         if (notifier->Initialize(pcontext))
         {
             LogPrint("zmq", "  Notifier %s ready (address = %s)\n", notifier->GetType(), notifier->GetAddress());
@@ -108,51 +126,73 @@ void CZMQNotificationInterface::Shutdown()
     LogPrint("zmq", "zmq: Shutdown notification interface\n");
     if (pcontext)
     {
+        // The publisher thread must be done with the sockets before they are closed
+        publishQueue->Stop();
+        LogPrint("zmq", "zmq: %u messages dropped\n", publishQueue->NumberOfDroppedMessages());
         for (std::list<CZMQAbstractNotifier*>::iterator i=notifiers.begin(); i!=notifiers.end(); ++i)
         {
             CZMQAbstractNotifier *notifier = *i;
             LogPrint("zmq", "   Shutdown notifier %s at %s\n", notifier->GetType(), notifier->GetAddress());
             notifier->Shutdown();
         }
+        for (std::list<CZMQAbstractNotifier*>::iterator i=retiredNotifiers.begin(); i!=retiredNotifiers.end(); ++i)
+        {
+            (*i)->Shutdown();
+        }
         zmq_ctx_destroy(pcontext);
 
         pcontext = 0;
     }
 }
 
-void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
+void CZMQNotificationInterface::NotifyAll(const std::function<bool(CZMQAbstractNotifier*)>& notify)
 {
     for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
     {
         CZMQAbstractNotifier *notifier = *i;
-        if (notifier->NotifyBlock(pindex))
+        if (notify(notifier))
         {
             i++;
         }
         else
         {
-            notifier->Shutdown();
+            LogPrint("zmq", "zmq: Retiring notifier %s at %s\n", notifier->GetType(), notifier->GetAddress());
+            retiredNotifiers.push_back(notifier);
             i = notifiers.erase(i);
         }
     }
 }
 
+void CZMQNotificationInterface::UpdatedBlockTip(const CBlockIndex *pindex)
+{
+    boost::unique_lock<boost::mutex> lock(cs_notifiers);
+    std::shared_ptr<const CBlock> block;
+    if (lastConnectedBlock && lastConnectedBlock->GetHash() == pindex->GetBlockHash())
+        block = lastConnectedBlock;
+    lastConnectedBlock.reset();
+
+    NotifyAll([pindex, &block](CZMQAbstractNotifier* notifier) { return notifier->NotifyBlock(pindex, block); });
+}
+
 void CZMQNotificationInterface::SyncTransactions(const TransactionVector & txs, const CBlock *pblock, const TransactionSyncType syncType)
 {
-    for(const CTransaction& tx: txs)
+    boost::unique_lock<boost::mutex> lock(cs_notifiers);
+    if (syncType == TransactionSyncType::NEW_BLOCK && pblock)
     {
-        for (std::list<CZMQAbstractNotifier*>::iterator i = notifiers.begin(); i!=notifiers.end(); )
+        // Blocks are connected before the tip update is signalled, and only the final tip is published
+        lastConnectedBlock.reset();
+        for (CZMQAbstractNotifier* notifier: notifiers)
         {
-            CZMQAbstractNotifier *notifier = *i;
-            if (notifier->NotifyTransaction(tx))
-            {
-                i++;
-            }
-            else
+            if (notifier->UsesBlockData())
             {
-                notifier->Shutdown();
-                i = notifiers.erase(i);
+                lastConnectedBlock = std::make_shared<const CBlock>(*pblock);
+                break;
             }
         }
     }
-}
\ No newline at end of file
+
+    for(const CTransaction& tx: txs)
+    {
+        NotifyAll([&tx](CZMQAbstractNotifier* notifier) { return notifier->NotifyTransaction(tx); });
+    }
+}
@@ -7,11 +7,16 @@
 
 #include "NotificationInterface.h"
 #include <string>
+#include <functional>
+#include <list>
 #include <map>
+#include <memory>
+#include <boost/thread/mutex.hpp>
 
 class CBlockIndex;
 class CZMQAbstractNotifier;
 class Settings;
+class ZMQPublishQueue;
 
 class CZMQNotificationInterface : public NotificationInterface
 {
@@ -29,10 +34,19 @@ protected:
     void UpdatedBlockTip(const CBlockIndex *pindex) override;
 
 private:
-    CZMQNotificationInterface();
+    explicit CZMQNotificationInterface(size_t maxQueuedMessages);
+
+    void NotifyAll(const std::function<bool(CZMQAbstractNotifier*)>& notify);
 
     void *pcontext;
+    const size_t maxQueuedMessages;
+    std::unique_ptr<ZMQPublishQueue> publishQueue;
+    boost::mutex cs_notifiers;
     std::list<CZMQAbstractNotifier*> notifiers;
+    // failed notifiers stay allocated until shutdown, since queued messages still point at them
+    std::list<CZMQAbstractNotifier*> retiredNotifiers;
+    // the last connected block, handed to raw block notifiers instead of reading it back from disk
+    std::shared_ptr<const CBlock> lastConnectedBlock;
 };
 
 #endif // BITCOIN_ZMQ_ZMQNOTIFICATIONINTERFACE_H
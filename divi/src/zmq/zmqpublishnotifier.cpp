@@ -13,11 +13,13 @@
 #include <sync.h>
 #include "primitives/block.h"
 #include "primitives/transaction.h"
+#include <zmq/ZMQPublishQueue.h>
+#include <algorithm>
 
 extern CCriticalSection cs_main;
 static std::multimap<std::string, CZMQAbstractPublishNotifier*> mapPublishNotifiers;
 
-// Internal function to send multipart message
+// Internal function to send multipart message; fails with EAGAIN rather than waiting on subscribers
 static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
 {
     va_list args;
@@ -39,10 +41,11 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
 
         data = va_arg(args, const void*);
 
-        rc = zmq_msg_send(&msg, sock, data ? ZMQ_SNDMORE : 0);
+        rc = zmq_msg_send(&msg, sock, ZMQ_DONTWAIT | (data ? ZMQ_SNDMORE : 0));
         if (rc == -1)
         {
-            zmqError("Unable to send ZMQ msg");
+            if (errno != EAGAIN)
+                zmqError("Unable to send ZMQ msg");
             zmq_msg_close(&msg);
             return -1;
         }
@@ -57,6 +60,10 @@ static int zmq_send_multipart(void *sock, const void* data, size_t size, ...)
     return 0;
 }
 
+CZMQAbstractPublishNotifier::CZMQAbstractPublishNotifier() : nSequence(0), fFailed(false)
+{
+}
+
 bool CZMQAbstractPublishNotifier::Initialize(void *pcontext)
 {
     assert(!psocket);
@@ -126,70 +133,109 @@ void CZMQAbstractPublishNotifier::Shutdown()
     psocket = 0;
 }
 
-bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size)
+bool CZMQAbstractPublishNotifier::SendMessage(const char *command, const void* data, size_t size, uint32_t sequence)
 {
     assert(psocket);
 
     /* send three parts, command & data & a LE 4byte sequence number */
     unsigned char msgseq[sizeof(uint32_t)];
-    WriteLE32(&msgseq[0], nSequence);
+    WriteLE32(&msgseq[0], sequence);
     int rc = zmq_send_multipart(psocket, command, strlen(command), data, size, msgseq, (size_t)sizeof(uint32_t), (void*)0);
     if (rc == -1)
+    {
+        // A full send buffer only costs this message; the sequence number gap shows it
+        if (errno == EAGAIN)
+        {
+            LogPrint("zmq", "zmq: Dropped %s message %u\n", command, sequence);
+            return true;
+        }
+        return false;
+    }
+    return true;
+}
+
+bool CZMQAbstractPublishNotifier::QueueMessage(const char *command, PayloadRenderer renderPayload)
+{
+    assert(publishQueue);
+    if (fFailed)
         return false;
 
-    /* increment memory only sequence number after sending */
-    nSequence++;
+    const uint32_t sequence = nSequence++;
+    const bool queued = publishQueue->Enqueue([this, command, renderPayload, sequence]()
+    {
+        std::vector<unsigned char> payload;
+        if (fFailed || !renderPayload(payload))
+            return;
+        if (!SendMessage(command, payload.data(), payload.size(), sequence))
+            fFailed = true;
+    });
+    if (!queued)
+        LogPrint("zmq", "zmq: Publisher queue full, dropped %s message %u\n", command, sequence);
+    return true;
+}
 
+static bool RenderHash(const uint256 &hash, std::vector<unsigned char> &payload)
+{
+    payload.assign(hash.begin(), hash.end());
+    std::reverse(payload.begin(), payload.end());
     return true;
 }
 
-bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishHashBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &/*block*/)
 {
     uint256 hash = pindex->GetBlockHash();
     LogPrint("zmq", "zmq: Publish hashblock %s\n", hash);
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(ZMQ_MSG_HASHBLOCK, data, 32);
+    return QueueMessage(ZMQ_MSG_HASHBLOCK, std::bind(RenderHash, hash, std::placeholders::_1));
 }
 
 bool CZMQPublishHashTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish hashtx %s\n", hash);
-    char data[32];
-    for (unsigned int i = 0; i < 32; i++)
-        data[31 - i] = hash.begin()[i];
-    return SendMessage(ZMQ_MSG_HASHTX, data, 32);
+    return QueueMessage(ZMQ_MSG_HASHTX, std::bind(RenderHash, hash, std::placeholders::_1));
 }
 
-bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex)
+bool CZMQPublishRawBlockNotifier::NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &block)
 {
     LogPrint("zmq", "zmq: Publish rawblock %s\n", pindex->GetBlockHash());
 
-// XX42    const Consensus::Params& consensusParams = Params().GetConsensus();
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    return QueueMessage(ZMQ_MSG_RAWBLOCK, [pindex, block](std::vector<unsigned char> &payload)
     {
-        LOCK(cs_main);
-        CBlock block;
-// XX42        if(!ReadBlockFromDisk(block, pindex, consensusParams))
-        if(!ReadBlockFromDisk(block, pindex))
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        if (block)
         {
-            zmqError("Can't read block from disk");
-            return false;
+            ss << *block;
         }
-
-        ss << block;
-    }
-
-    return SendMessage(ZMQ_MSG_RAWBLOCK, &(*ss.begin()), ss.size());
+        else
+        {
+            // Only blocks that were not connected through this process have to come from disk
+            CDiskBlockPos blockPosition;
+            {
+                LOCK(cs_main);
+                blockPosition = pindex->GetBlockPos();
+            }
+            CBlock blockFromDisk;
+            if (!ReadBlockFromDisk(blockFromDisk, blockPosition))
+            {
+                zmqError("Can't read block from disk");
+                return false;
+            }
+            ss << blockFromDisk;
+        }
+        payload.assign(ss.begin(), ss.end());
+        return true;
+    });
 }
 
 bool CZMQPublishRawTransactionNotifier::NotifyTransaction(const CTransaction &transaction)
 {
     uint256 hash = transaction.GetHash();
     LogPrint("zmq", "zmq: Publish rawtx %s\n", hash);
-    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-    ss << transaction;
-    return SendMessage(ZMQ_MSG_RAWTX, &(*ss.begin()), ss.size());
-}
\ No newline at end of file
+    return QueueMessage(ZMQ_MSG_RAWTX, [transaction](std::vector<unsigned char> &payload)
+    {
+        CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+        ss << transaction;
+        payload.assign(ss.begin(), ss.end());
+        return true;
+    });
+}
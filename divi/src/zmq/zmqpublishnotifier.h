@@ -6,6 +6,9 @@
 #define BITCOIN_ZMQ_ZMQPUBLISHNOTIFIER_H
 
 #include <zmq/zmqabstractnotifier.h>
+#include <atomic>
+#include <functional>
+#include <vector>
 
 class CBlockIndex;
 constexpr char ZMQ_MSG_HASHBLOCK[]  = "hashblock";
@@ -15,17 +18,25 @@ constexpr char ZMQ_MSG_RAWTX[]      = "rawtx";
 class CZMQAbstractPublishNotifier : public CZMQAbstractNotifier
 {
 private:
-    uint32_t nSequence; // upcounting per message sequence number
+    uint32_t nSequence; // upcounting per message sequence number, assigned when queuing
+    std::atomic<bool> fFailed; // set by the publisher thread once sending failed
 
 public:
+    /** Produces the message data on the publisher thread; false if there is nothing to send */
+    typedef std::function<bool(std::vector<unsigned char>&)> PayloadRenderer;
 
-    /* send zmq multipart message
+    CZMQAbstractPublishNotifier();
+
+    /* send zmq multipart message without waiting for subscribers
        parts:
           * command
           * data
           * message sequence number
     */
-    bool SendMessage(const char *command, const void* data, size_t size);
+    bool SendMessage(const char *command, const void* data, size_t size, uint32_t sequence);
+    /* number the message and hand it to the publisher thread, which renders and sends it.
+       Messages dropped on the way still use up their number, so subscribers see a gap. */
+    bool QueueMessage(const char *command, PayloadRenderer renderPayload);
 
     bool Initialize(void *pcontext);
     void Shutdown();
@@ -34,7 +45,7 @@ public:
 class CZMQPublishHashBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &block) override;
 };
 
 class CZMQPublishHashTransactionNotifier : public CZMQAbstractPublishNotifier
@@ -45,7 +56,8 @@ public:
 class CZMQPublishRawBlockNotifier : public CZMQAbstractPublishNotifier
 {
 public:
-    bool NotifyBlock(const CBlockIndex *pindex) override;
+    bool NotifyBlock(const CBlockIndex *pindex, const std::shared_ptr<const CBlock> &block) override;
+    bool UsesBlockData() const override { return true; }
 };
 
 class CZMQPublishRawTransactionNotifier : public CZMQAbstractPublishNotifier